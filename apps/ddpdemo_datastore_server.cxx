@@ -0,0 +1,65 @@
+/**
+ * @file ddpdemo_datastore_server.cxx
+ *
+ * A server process that hosts DataStores on behalf of SocketDataStore
+ * clients.  Usage: ddpdemo_datastore_server <socket path>
+ *
+ * The server runs until it receives SIGINT or SIGTERM.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/SocketDataStoreServer.hpp"
+
+#include "ers/ers.h"
+
+#include <csignal>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+dunedaq::ddpdemo::SocketDataStoreServer* theServer = nullptr;
+
+void
+stopServer(int /*signal*/)
+{
+  if (theServer != nullptr) {
+    theServer->stop();
+  }
+}
+
+} // namespace ""
+
+int
+main(int argc, char* argv[])
+{
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <socket path>" << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<dunedaq::ddpdemo::SocketDataStoreServer> server;
+  try {
+    server.reset(new dunedaq::ddpdemo::SocketDataStoreServer(argv[1]));
+  } catch (const ers::Issue& excpt) {
+    ers::fatal(excpt);
+    return 1;
+  }
+
+  theServer = server.get();
+  struct sigaction action;
+  action.sa_handler = stopServer;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  ERS_INFO("Serving DataStores at " << argv[1]);
+  server->run();
+  theServer = nullptr;
+  ERS_INFO("Shutting down");
+  return 0;
+}
@@ -15,6 +15,8 @@
 #ifndef DDPDEMO_INCLUDE_DDPDEMO_DATASTORE_HPP_
 #define DDPDEMO_INCLUDE_DDPDEMO_DATASTORE_HPP_
 
+#include "ddpdemo/DataStoreStatistics.hpp"
+#include "ddpdemo/EventDataBlock.hpp"
 #include "ddpdemo/KeyedDataBlock.hpp"
 
 #include <appfwk/NamedObject.hpp>
@@ -27,6 +29,7 @@
 #include <cetlib/compiler_macros.h>
 #include <memory>
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <memory>
@@ -90,17 +93,164 @@ public:
    */
   virtual void write(const KeyedDataBlock& dataBlock) = 0;
 
+  /**
+   * @brief Writes the specified data payloads into the DataStore.  The default
+   * implementation writes them one at a time; DataStores that can do better
+   * with a batch (e.g. by taking a lock or opening a file only once) override it.
+   * @param dataBlockList Data blocks to write.
+   */
+  virtual void write(const std::vector<KeyedDataBlock>& dataBlockList)
+  {
+    for (auto& dataBlock : dataBlockList) {
+      write(dataBlock);
+    }
+  }
+
+  /**
+   * @brief Adds the data block with the specified key to the DataStore as a
+   * reference to the copy that is stored in the source DataStore (e.g. an HDF5
+   * external link), so that no payload bytes are copied.  The default
+   * implementation refuses, which is appropriate for DataStores that can not
+   * refer to data that is stored elsewhere.
+   * @return whether the reference was written
+   */
+  virtual bool writeLink(const DataStore& /*source*/, const StorageKey& /*key*/) { return false; }
+
+  /**
+   * @brief Tells whether this DataStore can copy data blocks from the source
+   * DataStore natively (e.g. HDF5 object copies between files), without the
+   * data passing through a KeyedDataBlock.  The default is no.
+   */
+  virtual bool acceptsNativeCopy(const DataStore& /*source*/) const { return false; }
+
+  /**
+   * @brief Copies the data block with the specified key from the source
+   * DataStore.  The default implementation reads it and writes it; DataStores
+   * that accept a native copy from the source override it.
+   * @return the number of bytes that were copied
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key)
+  {
+    KeyedDataBlock dataBlock = source.read(key);
+    write(dataBlock);
+    return dataBlock.getDataSizeBytes();
+  }
+
+  /**
+   * @brief Replaces a reference that was written by writeLink() with a copy of
+   * the data, so that the DataStore no longer depends on the source.
+   * @return whether a reference was replaced (false if the data block was
+   * already stored in this DataStore)
+   */
+  virtual bool materialize(const StorageKey& /*key*/) { return false; }
+
+  /**
+   * @brief Makes sure that any data that the DataStore has buffered internally
+   * is passed on to the underlying storage.  The default implementation does nothing,
+   * which is appropriate for DataStores that do not buffer data.
+   */
+  virtual void flush() {}
+
+  /**
+   * @brief Gives the DataStore a place to record the latency of its internal
+   * processing steps (e.g. file open, dataset creation).  The default
+   * implementation ignores the statistics, which is appropriate for DataStores
+   * that do not time their internal steps.
+   * @param statistics Statistics to record into, or null to stop recording.
+   */
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> /*statistics*/) {}
+
   /**
    * @brief Returns the list of all keys that currently existing in the DataStore
    * @return list of StorageKeys
    */
   virtual std::vector<StorageKey> getAllExistingKeys() const = 0;
 
+  /**
+   * @brief Returns the keys of the data blocks that are stored in the specified
+   * file, for DataStores that keep their data in files, so that new files can
+   * be followed as they appear.  The default implementation returns no keys,
+   * which is also the answer for files that do not belong to the DataStore;
+   * DataStores that wrap other DataStores forward it to them.
+   * @param fileName Full name of the file
+   * @return list of StorageKeys
+   */
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& /*fileName*/) const { return {}; }
+
   // Ideas for future work...
-  // virtual void write(const std::vector<KeyedDataBlock>& dataBlockList) = 0;
   virtual KeyedDataBlock read(const StorageKey& key) = 0;
   // virtual std::vector<KeyedDataBlock> read(const std::vector<StorageKey>& key) = 0;
 
+  /**
+   * @brief Reads part of a data block: "length" bytes, starting "offset" bytes
+   * into it, clipped to the end of the block (the data_size of the returned
+   * block is the number of bytes that were read).  The default implementation
+   * reads the whole block and refers to the range within it; DataStores that
+   * can read part of a block from storage (e.g. HDF5 hyperslabs, pread) override it.
+   * @param key Key of the data block
+   * @param offset Offset of the first byte to read
+   * @param length Number of bytes to read
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length)
+  {
+    KeyedDataBlock dataBlock = read(key);
+    size_t rangeOffset = std::min(offset, dataBlock.getDataSizeBytes());
+    size_t rangeLength = std::min(length, dataBlock.getDataSizeBytes() - rangeOffset);
+
+    // the range is not copied: the result shares the ownership of the whole block
+    KeyedDataBlock rangeBlock(key);
+    rangeBlock.data_size = rangeLength;
+    rangeBlock.unowned_data_start = nullptr;
+    if (dataBlock.owned_data_start.get() != nullptr) {
+      // (owned payloads are allocated with new[])
+      std::shared_ptr<const void> owner(dataBlock.owned_data_start.release(), std::default_delete<char[]>());
+      rangeBlock.shared_data_start = std::shared_ptr<const void>(owner, static_cast<const char*>(owner.get()) + rangeOffset);
+    } else if (dataBlock.shared_data_start.get() != nullptr) {
+      rangeBlock.shared_data_start = std::shared_ptr<const void>(
+        dataBlock.shared_data_start, static_cast<const char*>(dataBlock.shared_data_start.get()) + rangeOffset);
+    } else if (dataBlock.unowned_data_start != nullptr) {
+      rangeBlock.unowned_data_start = static_cast<const char*>(dataBlock.unowned_data_start) + rangeOffset;
+    }
+    return rangeBlock;
+  }
+
+  /**
+   * @brief Tells the DataStore that the data block with the specified key
+   * will be read soon, so that it can start bringing the data into memory
+   * (e.g. with posix_fadvise() on the range of the file that holds it) without
+   * waiting for it.  The default implementation ignores the hint, which is
+   * appropriate for DataStores that do not know where their data is on disk.
+   * @param key Key of the data block
+   */
+  virtual void adviseWillRead(const StorageKey& /*key*/) {}
+
+  /**
+   * @brief Reads all of the fragments of the specified event, in geoLocation
+   * order, into a single buffer.  The default implementation looks the keys up
+   * in getAllExistingKeys() and reads the fragments one at a time; DataStores
+   * that keep the fragments of an event together override it.
+   * @param eventID ID of the event
+   */
+  virtual EventDataBlock readEvent(int eventID)
+  {
+    std::vector<StorageKey> keyList;
+    for (auto& key : getAllExistingKeys()) {
+      if (key.getEventID() == eventID) {
+        keyList.push_back(key);
+      }
+    }
+    std::sort(keyList.begin(), keyList.end(), [](const StorageKey& lhs, const StorageKey& rhs) {
+      return lhs.getGeoLocation() < rhs.getGeoLocation();
+    });
+
+    std::vector<KeyedDataBlock> fragments;
+    fragments.reserve(keyList.size());
+    for (auto& key : keyList) {
+      fragments.push_back(read(key));
+    }
+    return EventDataBlock(eventID, fragments);
+  }
+
 private:
   DataStore(const DataStore&) = delete;
   DataStore& operator=(const DataStore&) = delete;
@@ -0,0 +1,273 @@
+/**
+ * @file DataStoreStatistics.hpp
+ *
+ * Latency histograms and byte counters for DataStore operations.  These are
+ * filled by the InstrumentedDataStore, and by DataStores that time their
+ * internal processing steps when statistics are attached to them.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_INCLUDE_DDPDEMO_DATASTORESTATISTICS_HPP_
+#define DDPDEMO_INCLUDE_DDPDEMO_DATASTORESTATISTICS_HPP_
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief A histogram of latencies (in nanoseconds) with logarithmic buckets,
+ * in the style of HdrHistogram: every power of two is split into
+ * SUB_BUCKET_COUNT linear sub-buckets, so that the relative error of any
+ * reported value is below 1/SUB_BUCKET_COUNT, over the full 64-bit range.
+ * Recording a value is lock-free and may be done from several threads.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr unsigned SUB_BUCKET_BITS = 3;
+  static constexpr uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+  LatencyHistogram()
+    : count_(0)
+    , sum_(0)
+    , min_(std::numeric_limits<uint64_t>::max())
+    , max_(0)
+  {
+    for (auto& bucket : buckets_) {
+      bucket = 0;
+    }
+  }
+
+  void record(uint64_t value)
+  {
+    buckets_[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t current = min_.load(std::memory_order_relaxed);
+    while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+    current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the highest value that is equivalent (i.e. falls in the
+   * same bucket) to the value at the specified percentile (0-100).
+   */
+  uint64_t getValueAtPercentile(double percentile) const
+  {
+    uint64_t count = getCount();
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t threshold = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+    if (threshold < 1) {
+      threshold = 1;
+    }
+    uint64_t runningCount = 0;
+    for (size_t idx = 0; idx < BUCKET_COUNT; ++idx) {
+      runningCount += buckets_[idx].load(std::memory_order_relaxed);
+      if (runningCount >= threshold) {
+        return std::min(getBucketUpperBound(idx), max_.load(std::memory_order_relaxed));
+      }
+    }
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  nlohmann::json toJson() const
+  {
+    nlohmann::json result;
+    uint64_t count = getCount();
+    result["count"] = count;
+    if (count == 0) {
+      return result;
+    }
+    result["min_nsec"] = min_.load(std::memory_order_relaxed);
+    result["mean_nsec"] = sum_.load(std::memory_order_relaxed) / count;
+    result["p50_nsec"] = getValueAtPercentile(50.0);
+    result["p90_nsec"] = getValueAtPercentile(90.0);
+    result["p99_nsec"] = getValueAtPercentile(99.0);
+    result["p99.9_nsec"] = getValueAtPercentile(99.9);
+    result["max_nsec"] = max_.load(std::memory_order_relaxed);
+
+    // only the buckets that have entries, as [upper bound, count] pairs
+    nlohmann::json bucketList = nlohmann::json::array();
+    for (size_t idx = 0; idx < BUCKET_COUNT; ++idx) {
+      uint64_t bucketCount = buckets_[idx].load(std::memory_order_relaxed);
+      if (bucketCount > 0) {
+        bucketList.push_back({ getBucketUpperBound(idx), bucketCount });
+      }
+    }
+    result["buckets"] = bucketList;
+    return result;
+  }
+
+  static size_t getBucketIndex(uint64_t value)
+  {
+    if (value < SUB_BUCKET_COUNT) {
+      return value;
+    }
+    unsigned shift = (63 - __builtin_clzll(value)) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+  }
+
+  static uint64_t getBucketUpperBound(size_t index)
+  {
+    if (index < SUB_BUCKET_COUNT) {
+      return index;
+    }
+    unsigned shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t lowerBound = (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+    return lowerBound + ((uint64_t(1) << shift) - 1);
+  }
+
+private:
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> min_;
+  std::atomic<uint64_t> max_;
+};
+
+/**
+ * @brief The latency histogram and byte count of one kind of operation
+ * (e.g. "write", or a processing step such as "hdf5_write_raw").  The
+ * number of operations is the count of the histogram.
+ */
+class OperationStatistics
+{
+public:
+  OperationStatistics()
+    : bytes_(0)
+  {}
+
+  void record(uint64_t nsec, size_t bytes)
+  {
+    histogram_.record(nsec);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  const LatencyHistogram& getHistogram() const { return histogram_; }
+  uint64_t getBytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+  nlohmann::json toJson() const
+  {
+    nlohmann::json result = histogram_.toJson();
+    result["bytes"] = getBytes();
+    return result;
+  }
+
+private:
+  LatencyHistogram histogram_;
+  std::atomic<uint64_t> bytes_;
+};
+
+/**
+ * @brief The statistics of all of the operations of one DataStore, by name.
+ */
+class DataStoreStatistics
+{
+public:
+  /**
+   * @brief Returns the statistics of the named operation, creating them if
+   * needed.  The returned reference stays valid for the lifetime of this object,
+   * so callers on hot paths should look it up once and keep it.
+   */
+  OperationStatistics& getOperation(const std::string& operationName)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<OperationStatistics>& operation = operations_[operationName];
+    if (operation.get() == nullptr) {
+      operation.reset(new OperationStatistics());
+    }
+    return *operation;
+  }
+
+  nlohmann::json toJson() const
+  {
+    nlohmann::json result = nlohmann::json::object();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : operations_) {
+      result[entry.first] = entry.second->toJson();
+    }
+    return result;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<OperationStatistics>> operations_;
+};
+
+/**
+ * @brief Records the time between its construction and destruction in the
+ * specified OperationStatistics.  Nothing is timed if that is null, so that
+ * optional timers cost (almost) nothing when they are not in use.
+ */
+class OperationTimer
+{
+public:
+  explicit OperationTimer(OperationStatistics* operation, size_t bytes = 0)
+    : operation_(operation)
+    , bytes_(bytes)
+  {
+    if (operation_ != nullptr) {
+      startTime_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~OperationTimer() { stop(); }
+
+  /**
+   * @brief Records the elapsed time now, instead of at destruction.
+   */
+  void stop()
+  {
+    if (operation_ != nullptr) {
+      auto elapsed = std::chrono::steady_clock::now() - startTime_;
+      operation_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), bytes_);
+      operation_ = nullptr;
+    }
+  }
+
+  /**
+   * @brief Records nothing, e.g. when the operation turned out not to be possible.
+   */
+  void cancel() { operation_ = nullptr; }
+
+  void setBytes(size_t bytes) { bytes_ = bytes; }
+
+private:
+  OperationTimer(const OperationTimer&) = delete;
+  OperationTimer& operator=(const OperationTimer&) = delete;
+
+  OperationStatistics* operation_;
+  size_t bytes_;
+  std::chrono::steady_clock::time_point startTime_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_INCLUDE_DDPDEMO_DATASTORESTATISTICS_HPP_
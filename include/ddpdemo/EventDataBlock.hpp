@@ -0,0 +1,104 @@
+/**
+ * @file EventDataBlock.hpp
+ *
+ * EventDataBlock holds all of the fragments of one event in a single
+ * contiguous buffer, with a table of where each fragment starts, so that
+ * consumers that want a whole event (e.g. reconstruction) get it in one piece.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_INCLUDE_DDPDEMO_EVENTDATABLOCK_HPP_
+#define DDPDEMO_INCLUDE_DDPDEMO_EVENTDATABLOCK_HPP_
+
+#include "ddpdemo/KeyedDataBlock.hpp"
+#include "ddpdemo/StorageKey.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief The fragments of one event, in a single buffer.
+ */
+struct EventDataBlock
+{
+  // These data members will be made private, at some point in time.
+  int event_id;
+  // the keys of the fragments, in the order in which they are stored
+  std::vector<StorageKey> fragment_keys;
+  // where each fragment starts in the buffer, plus a final entry for the end of the last one
+  std::vector<size_t> fragment_offsets;
+  std::shared_ptr<char> data_start;
+
+  explicit EventDataBlock(int eventID)
+    : event_id(eventID)
+    , fragment_offsets(1, 0)
+  {}
+
+  /**
+   * @brief Builds an event from separate fragments, by copying them into one buffer.
+   */
+  EventDataBlock(int eventID, const std::vector<KeyedDataBlock>& fragments)
+    : EventDataBlock(eventID)
+  {
+    for (auto& fragment : fragments) {
+      addFragment(fragment.data_key, fragment.getDataSizeBytes());
+    }
+    char* buffer = allocate();
+    for (size_t idx = 0; idx < fragments.size(); ++idx) {
+      if (fragments[idx].getDataSizeBytes() > 0) {
+        memcpy(buffer + fragment_offsets[idx], fragments[idx].getDataStart(), fragments[idx].getDataSizeBytes());
+      }
+    }
+  }
+
+  /**
+   * @brief Adds a fragment of the specified size to the table.  Once all of
+   * the fragments have been added, allocate() creates the buffer for them.
+   */
+  void addFragment(const StorageKey& key, size_t size)
+  {
+    fragment_keys.push_back(key);
+    fragment_offsets.push_back(fragment_offsets.back() + size);
+  }
+
+  /**
+   * @brief Allocates the buffer for the fragments in the table, and returns its start.
+   */
+  char* allocate()
+  {
+    data_start.reset(new char[getDataSizeBytes()], std::default_delete<char[]>());
+    return data_start.get();
+  }
+
+  size_t getFragmentCount() const { return fragment_keys.size(); }
+  size_t getDataSizeBytes() const { return fragment_offsets.back(); }
+  const void* getDataStart() const { return data_start.get(); }
+
+  const void* getFragmentStart(size_t index) const { return data_start.get() + fragment_offsets[index]; }
+  size_t getFragmentSize(size_t index) const { return fragment_offsets[index + 1] - fragment_offsets[index]; }
+
+  /**
+   * @brief Returns one fragment as a KeyedDataBlock, which refers to (and
+   * shares the ownership of) the event's buffer instead of copying it.
+   */
+  KeyedDataBlock getFragment(size_t index) const
+  {
+    KeyedDataBlock dataBlock(fragment_keys[index]);
+    dataBlock.data_size = getFragmentSize(index);
+    dataBlock.unowned_data_start = nullptr;
+    dataBlock.shared_data_start = std::shared_ptr<const void>(data_start, getFragmentStart(index));
+    return dataBlock;
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_INCLUDE_DDPDEMO_EVENTDATABLOCK_HPP_
@@ -28,6 +28,9 @@ public:
   size_t data_size;
   const void* unowned_data_start;
   std::unique_ptr<char> owned_data_start;
+  // Shared, read-only ownership of the data, for data that is handed to several
+  // consumers (or cached) without being copied.
+  std::shared_ptr<const void> shared_data_start;
 
   explicit KeyedDataBlock(const StorageKey& theKey)
     : data_key(theKey)
@@ -37,6 +40,8 @@ public:
   {
     if (owned_data_start.get() != nullptr) {
       return static_cast<const void*>(owned_data_start.get());
+    } else if (shared_data_start.get() != nullptr) {
+      return shared_data_start.get();
     } else {
       return unowned_data_start;
     }
@@ -0,0 +1,357 @@
+/**
+ * @file SharedMemoryRing.hpp
+ *
+ * A lock-free, multiple-producer/single-consumer ring of data block
+ * descriptors in a named POSIX shared-memory segment, with the payloads in a
+ * slab in the same segment.  Every ring slot owns one fixed-size payload
+ * slot in the slab, so producers write their payloads straight into shared
+ * memory and the consumer hands them to a DataStore from there, without
+ * copies or system calls per data block.
+ *
+ * The ring is the bounded queue of D. Vyukov: each slot carries a sequence
+ * number that tells producers and the consumer whether it is free or filled.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_INCLUDE_DDPDEMO_SHAREDMEMORYRING_HPP_
+#define DDPDEMO_INCLUDE_DDPDEMO_SHAREDMEMORYRING_HPP_
+
+#include "ddpdemo/KeyedDataBlock.hpp"
+
+#include "ers/ers.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace dunedaq {
+
+/**
+ * @brief An ERS Issue for failures to create or attach to a shared-memory ring
+ */
+ERS_DECLARE_ISSUE(ddpdemo,
+                  SharedMemoryRingUnavailable,
+                  "The shared-memory ring \"" << segment_name << "\" is not available: " << reason,
+                  ((std::string)segment_name)((std::string)reason))
+
+/**
+ * @brief An ERS Issue for data blocks that do not fit into a payload slot
+ */
+ERS_DECLARE_ISSUE(ddpdemo,
+                  SharedMemoryRingSlotTooSmall,
+                  "The data block with eventID " << eventID << " and geoLocation " << geoLocation << " has " << size
+                                                 << " bytes, which is more than the slot size of " << slot_size
+                                                 << " bytes.",
+                  ((int)eventID)((int)geoLocation)((size_t)size)((size_t)slot_size))
+
+namespace ddpdemo {
+
+/**
+ * @brief SharedMemoryRing passes data blocks between processes through shared memory.
+ */
+class SharedMemoryRing
+{
+public:
+  static constexpr uint64_t MAGIC = 0x474e495252444444; // "DDDRRING"
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  static constexpr size_t DETECTOR_ID_SIZE = 32; ///< longer detector IDs are truncated
+
+  /**
+   * @brief A slot that a producer has claimed, and may fill before publishing it.
+   */
+  struct Reservation
+  {
+    uint64_t position = 0;
+    void* payload = nullptr;
+    size_t capacity = 0;
+  };
+
+  /**
+   * @brief Creates the named segment (replacing any stale one) and
+   * initializes an empty ring in it.  The segment is removed when the
+   * returned object is destroyed.
+   * @param slotCount number of ring slots, rounded up to a power of two
+   * @param slotPayloadSize maximum payload size of a data block
+   */
+  static std::unique_ptr<SharedMemoryRing> create(const std::string& segmentName,
+                                                  size_t slotCount,
+                                                  size_t slotPayloadSize)
+  {
+    size_t roundedSlotCount = 1;
+    while (roundedSlotCount < slotCount) {
+      roundedSlotCount <<= 1;
+    }
+    size_t roundedPayloadSize = (slotPayloadSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    size_t segmentSize = getSegmentSize_(roundedSlotCount, roundedPayloadSize);
+
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+      throw SharedMemoryRingUnavailable(ERS_HERE, segmentName, strerror(errno));
+    }
+    if (ftruncate(fd, segmentSize) != 0) {
+      int savedErrno = errno;
+      close(fd);
+      shm_unlink(segmentName.c_str());
+      throw SharedMemoryRingUnavailable(ERS_HERE, segmentName, strerror(savedErrno));
+    }
+    std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing(segmentName, fd, segmentSize, true));
+
+    SegmentHeader* header = new (ring->segment_) SegmentHeader();
+    header->slotCount = roundedSlotCount;
+    header->slotPayloadSize = roundedPayloadSize;
+    header->enqueuePosition.store(0, std::memory_order_relaxed);
+    header->dequeuePosition.store(0, std::memory_order_relaxed);
+    ring->setPointers_();
+    for (size_t idx = 0; idx < roundedSlotCount; ++idx) {
+      SlotHeader* slot = new (&ring->slots_[idx]) SlotHeader();
+      slot->sequence.store(idx, std::memory_order_relaxed);
+    }
+    header->magic.store(MAGIC, std::memory_order_release);
+    return ring;
+  }
+
+  /**
+   * @brief Attaches to a ring that has been (or, within the timeout, will be)
+   * created by another process.
+   */
+  static std::unique_ptr<SharedMemoryRing> attach(const std::string& segmentName, size_t timeoutMsec)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMsec);
+    while (true) {
+      int fd = shm_open(segmentName.c_str(), O_RDWR, 0);
+      if (fd >= 0) {
+        struct stat fileStatus;
+        if (fstat(fd, &fileStatus) == 0 && static_cast<size_t>(fileStatus.st_size) >= sizeof(SegmentHeader)) {
+          std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing(segmentName, fd, fileStatus.st_size, false));
+          const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(ring->segment_); // NOLINT
+          if (header->magic.load(std::memory_order_acquire) == MAGIC &&
+              getSegmentSize_(header->slotCount, header->slotPayloadSize) <= ring->segmentSize_) {
+            ring->setPointers_();
+            return ring;
+          }
+        } else {
+          close(fd);
+        }
+      } else if (errno != ENOENT) {
+        throw SharedMemoryRingUnavailable(ERS_HERE, segmentName, strerror(errno));
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        throw SharedMemoryRingUnavailable(ERS_HERE, segmentName, "it has not been created");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  ~SharedMemoryRing()
+  {
+    munmap(segment_, segmentSize_);
+    if (owner_) {
+      shm_unlink(segmentName_.c_str());
+    }
+  }
+
+  /**
+   * @brief Claims the next free slot for a producer, without blocking.
+   * @return false if the ring is full
+   */
+  bool tryClaim(Reservation& reservation)
+  {
+    uint64_t position = header_->enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      SlotHeader& slot = slots_[position & mask_];
+      int64_t difference =
+        static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(position);
+      if (difference == 0) {
+        if (header_->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = header_->enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+    reservation.position = position;
+    reservation.payload = slab_ + (position & mask_) * header_->slotPayloadSize;
+    reservation.capacity = header_->slotPayloadSize;
+    return true;
+  }
+
+  /**
+   * @brief Makes a claimed slot, whose payload has been filled in, visible to the consumer.
+   */
+  void publish(const Reservation& reservation, const StorageKey& key, size_t size)
+  {
+    SlotHeader& slot = slots_[reservation.position & mask_];
+    slot.eventId = key.getEventID();
+    slot.geoLocation = key.getGeoLocation();
+    slot.dataSize = size;
+    std::string detectorID = key.getDetectorID();
+    strncpy(slot.detectorID, detectorID.c_str(), DETECTOR_ID_SIZE - 1);
+    slot.detectorID[DETECTOR_ID_SIZE - 1] = '\0';
+    slot.sequence.store(reservation.position + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copies the data block into the next free slot and publishes it.
+   * @return false if the ring is full
+   */
+  bool tryPublish(const KeyedDataBlock& dataBlock)
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    if (size > header_->slotPayloadSize) {
+      throw SharedMemoryRingSlotTooSmall(ERS_HERE,
+                                         dataBlock.data_key.getEventID(),
+                                         dataBlock.data_key.getGeoLocation(),
+                                         size,
+                                         header_->slotPayloadSize);
+    }
+    Reservation reservation;
+    if (!tryClaim(reservation)) {
+      return false;
+    }
+    memcpy(reservation.payload, dataBlock.getDataStart(), size);
+    publish(reservation, dataBlock.data_key, size);
+    return true;
+  }
+
+  /**
+   * @brief Passes the oldest published data block to the handler, then frees
+   * its slot (also if the handler throws).  The data block refers to the
+   * payload in shared memory, so the handler must not keep it.  Only one
+   * thread in one process may consume from a ring.
+   * @return false if no published data block was available
+   */
+  template<typename Handler>
+  bool tryConsume(Handler&& handler)
+  {
+    uint64_t position = header_->dequeuePosition.load(std::memory_order_relaxed);
+    SlotHeader& slot = slots_[position & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+      return false;
+    }
+
+    struct SlotReleaser
+    {
+      SharedMemoryRing* ring;
+      SlotHeader* slot;
+      uint64_t position;
+      ~SlotReleaser()
+      {
+        slot->sequence.store(position + ring->header_->slotCount, std::memory_order_release);
+        ring->header_->dequeuePosition.store(position + 1, std::memory_order_relaxed);
+      }
+    } releaser{ this, &slot, position };
+
+    KeyedDataBlock dataBlock(StorageKey(slot.eventId, slot.detectorID, slot.geoLocation));
+    dataBlock.unowned_data_start = slab_ + (position & mask_) * header_->slotPayloadSize;
+    dataBlock.data_size = slot.dataSize;
+    handler(static_cast<const KeyedDataBlock&>(dataBlock));
+    return true;
+  }
+
+  /**
+   * @brief Returns the number of slots that have been claimed by producers and
+   * not yet freed by the consumer, which is a measure of the back-pressure.
+   */
+  size_t getOccupancy() const
+  {
+    uint64_t dequeuePosition = header_->dequeuePosition.load(std::memory_order_relaxed);
+    uint64_t enqueuePosition = header_->enqueuePosition.load(std::memory_order_relaxed);
+    return (enqueuePosition > dequeuePosition) ? (enqueuePosition - dequeuePosition) : 0;
+  }
+
+  size_t getSlotCount() const { return header_->slotCount; }
+  size_t getSlotPayloadSize() const { return header_->slotPayloadSize; }
+
+private:
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+  SharedMemoryRing(SharedMemoryRing&&) = delete;
+  SharedMemoryRing& operator=(SharedMemoryRing&&) = delete;
+
+  // The std::atomic members are lock-free, and therefore usable between processes.
+  struct SegmentHeader
+  {
+    std::atomic<uint64_t> magic;
+    uint64_t slotCount;
+    uint64_t slotPayloadSize;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> enqueuePosition;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> dequeuePosition;
+  };
+
+  struct alignas(CACHE_LINE_SIZE) SlotHeader
+  {
+    std::atomic<uint64_t> sequence;
+    int32_t eventId;
+    int32_t geoLocation;
+    uint64_t dataSize;
+    char detectorID[DETECTOR_ID_SIZE];
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+
+  std::string segmentName_;
+  size_t segmentSize_;
+  bool owner_;
+  char* segment_;
+  SegmentHeader* header_;
+  SlotHeader* slots_;
+  char* slab_;
+  uint64_t mask_;
+
+  SharedMemoryRing(const std::string& segmentName, int fd, size_t segmentSize, bool owner)
+    : segmentName_(segmentName)
+    , segmentSize_(segmentSize)
+    , owner_(owner)
+    , header_(nullptr)
+    , slots_(nullptr)
+    , slab_(nullptr)
+    , mask_(0)
+  {
+    // the whole segment is faulted in now, so that no page faults happen per data block
+    void* address = mmap(nullptr, segmentSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    int savedErrno = errno;
+    close(fd);
+    if (address == MAP_FAILED) {
+      if (owner_) {
+        shm_unlink(segmentName_.c_str());
+      }
+      throw SharedMemoryRingUnavailable(ERS_HERE, segmentName_, strerror(savedErrno));
+    }
+    segment_ = static_cast<char*>(address);
+  }
+
+  static size_t getSegmentSize_(size_t slotCount, size_t slotPayloadSize)
+  {
+    return sizeof(SegmentHeader) + slotCount * sizeof(SlotHeader) + slotCount * slotPayloadSize;
+  }
+
+  void setPointers_()
+  {
+    header_ = reinterpret_cast<SegmentHeader*>(segment_);                        // NOLINT
+    slots_ = reinterpret_cast<SlotHeader*>(segment_ + sizeof(SegmentHeader));    // NOLINT
+    slab_ = segment_ + sizeof(SegmentHeader) + header_->slotCount * sizeof(SlotHeader);
+    mask_ = header_->slotCount - 1;
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_INCLUDE_DDPDEMO_SHAREDMEMORYRING_HPP_
@@ -0,0 +1,276 @@
+/**
+ * @file SocketDataStoreProtocol.hpp
+ *
+ * The messages that are exchanged between the SocketDataStore plugin and the
+ * DataStore server process, over a Unix-domain SOCK_SEQPACKET socket.  Only
+ * small, fixed-size message headers (plus storage keys, configurations and
+ * error messages) go through the socket; data payloads are passed in shared
+ * memory (memfd) whose file descriptors are sent with SCM_RIGHTS.
+ *
+ * Several messages may be batched into one packet.  A packet carries at most
+ * one file descriptor, which belongs to the first message of the packet.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTOREPROTOCOL_HPP_
+#define DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTOREPROTOCOL_HPP_
+
+#include "ddpdemo/StorageKey.hpp"
+
+#include "ers/ers.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+/**
+ * @brief An ERS Issue for failures of the socket or shared-memory system calls
+ */
+ERS_DECLARE_ISSUE(ddpdemo,
+                  SocketCommunicationFailed,
+                  "The " << operation << " operation failed: " << reason,
+                  ((std::string)operation)((std::string)reason))
+
+namespace ddpdemo {
+
+/**
+ * @brief Message layout and helper functions for the SocketDataStore protocol.
+ */
+class SocketDataStoreProtocol
+{
+public:
+  static constexpr uint32_t MAGIC = 0x53504444; // "DDPS"
+  static constexpr size_t MAX_PACKET_SIZE = 64 * 1024;
+
+  enum MessageType : uint32_t
+  {
+    // client to server
+    Hello = 1,       ///< fd = payload arena, dataSize = arena size, extra = DataStore configuration
+    Setup = 2,       ///< offset = event ID
+    Write = 3,       ///< offset/dataSize = payload location in the arena, extra = detector ID
+    WriteWithFd = 4, ///< fd = payload of dataSize bytes, extra = detector ID
+    Read = 5,        ///< extra = detector ID
+    GetKeys = 6,
+    Flush = 7,
+    GetKeysInFile = 8, ///< extra = file name
+    ReadRange = 9,     ///< offset/dataSize = range within the data block, extra = detector ID
+    // server to client
+    Completed = 101,  ///< all requests up to and including requestId have been processed
+    Error = 102,      ///< the request failed, extra = error message
+    ReadResult = 103, ///< fd = payload of dataSize bytes (none if dataSize is zero)
+    KeyList = 104     ///< extra = encoded keys
+  };
+
+  struct MessageHeader
+  {
+    uint32_t magic = MAGIC;
+    uint32_t type = 0;
+    uint64_t requestId = 0;
+    int32_t eventId = 0;
+    int32_t geoLocation = 0;
+    uint64_t offset = 0;
+    uint64_t dataSize = 0;
+    uint32_t reserved = 0;
+    uint32_t extraLength = 0; ///< number of bytes of variable-length data that follow the header
+  };
+
+  struct Message
+  {
+    MessageHeader header;
+    std::string extra;
+  };
+
+  static void appendMessage(std::string& packet, const MessageHeader& header, const std::string& extra = "")
+  {
+    MessageHeader localHeader = header;
+    localHeader.extraLength = extra.size();
+    packet.append(reinterpret_cast<const char*>(&localHeader), sizeof(localHeader)); // NOLINT
+    packet.append(extra);
+  }
+
+  /**
+   * @brief Returns whether a message with the specified extra data still fits into the packet.
+   */
+  static bool fitsInPacket(const std::string& packet, const std::string& extra)
+  {
+    return packet.size() + sizeof(MessageHeader) + extra.size() <= MAX_PACKET_SIZE;
+  }
+
+  static void appendKey(std::string& buffer, const StorageKey& key)
+  {
+    int32_t values[3] = { key.getEventID(), key.getGeoLocation(), 0 };
+    std::string detectorID = key.getDetectorID();
+    values[2] = detectorID.size();
+    buffer.append(reinterpret_cast<const char*>(values), sizeof(values)); // NOLINT
+    buffer.append(detectorID);
+  }
+
+  /**
+   * @brief Decodes the key at the specified position of the buffer, and moves the position past it.
+   */
+  static StorageKey extractKey(const std::string& buffer, size_t& position)
+  {
+    int32_t values[3];
+    if (position + sizeof(values) > buffer.size()) {
+      throw SocketCommunicationFailed(ERS_HERE, "key decoding", "truncated key list");
+    }
+    memcpy(values, buffer.data() + position, sizeof(values));
+    position += sizeof(values);
+    if (values[2] < 0 || position + values[2] > buffer.size()) {
+      throw SocketCommunicationFailed(ERS_HERE, "key decoding", "truncated key list");
+    }
+    std::string detectorID = buffer.substr(position, values[2]);
+    position += values[2];
+    return StorageKey(values[0], detectorID, values[1]);
+  }
+
+  /**
+   * @brief Sends the packet, together with the specified file descriptor if it is not negative.
+   */
+  static void sendPacket(int socketFd, const std::string& packet, int fdToPass = -1)
+  {
+    struct iovec iov;
+    iov.iov_base = const_cast<char*>(packet.data()); // NOLINT
+    iov.iov_len = packet.size();
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (fdToPass >= 0) {
+      memset(control, 0, sizeof(control));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &fdToPass, sizeof(int));
+    }
+
+    ssize_t result;
+    do {
+      result = sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+      throw SocketCommunicationFailed(ERS_HERE, "sendmsg", strerror(errno));
+    }
+  }
+
+  /**
+   * @brief Receives one packet and splits it into messages.  A file descriptor
+   * that came with the packet is returned in receivedFd (otherwise it is -1),
+   * and the caller is responsible for closing it.
+   * @return false if the peer has closed the connection
+   */
+  static bool receivePacket(int socketFd, std::vector<Message>& messages, int& receivedFd)
+  {
+    messages.clear();
+    receivedFd = -1;
+
+    std::vector<char> buffer(MAX_PACKET_SIZE);
+    struct iovec iov;
+    iov.iov_base = buffer.data();
+    iov.iov_len = buffer.size();
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t result;
+    do {
+      result = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+      if (errno == ECONNRESET) {
+        return false;
+      }
+      throw SocketCommunicationFailed(ERS_HERE, "recvmsg", strerror(errno));
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&receivedFd, CMSG_DATA(cmsg), sizeof(int));
+      }
+    }
+    if (result == 0) {
+      return false;
+    }
+    if (msg.msg_flags & MSG_TRUNC) {
+      throw SocketCommunicationFailed(ERS_HERE, "recvmsg", "the packet is larger than the maximum packet size");
+    }
+
+    size_t position = 0;
+    while (position < static_cast<size_t>(result)) {
+      Message message;
+      if (position + sizeof(MessageHeader) > static_cast<size_t>(result)) {
+        throw SocketCommunicationFailed(ERS_HERE, "recvmsg", "truncated message header");
+      }
+      memcpy(&message.header, buffer.data() + position, sizeof(MessageHeader));
+      position += sizeof(MessageHeader);
+      if (message.header.magic != MAGIC || position + message.header.extraLength > static_cast<size_t>(result)) {
+        throw SocketCommunicationFailed(ERS_HERE, "recvmsg", "corrupt message");
+      }
+      message.extra.assign(buffer.data() + position, message.header.extraLength);
+      position += message.header.extraLength;
+      messages.push_back(std::move(message));
+    }
+    return true;
+  }
+
+  /**
+   * @brief Creates an anonymous shared-memory file of the specified size.
+   * @return the file descriptor
+   */
+  static int createSharedMemory(const std::string& name, size_t size)
+  {
+    int fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+    if (fd < 0) {
+      throw SocketCommunicationFailed(ERS_HERE, "memfd_create", strerror(errno));
+    }
+    if (ftruncate(fd, size) != 0) {
+      int savedErrno = errno;
+      close(fd);
+      throw SocketCommunicationFailed(ERS_HERE, "ftruncate", strerror(savedErrno));
+    }
+    return fd;
+  }
+
+  /**
+   * @brief Maps the shared-memory file.  A size of zero maps nothing and returns null.
+   */
+  static void* mapSharedMemory(int fd, size_t size, bool writable)
+  {
+    if (size == 0) {
+      return nullptr;
+    }
+    void* address = mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      throw SocketCommunicationFailed(ERS_HERE, "mmap", strerror(errno));
+    }
+    return address;
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTOREPROTOCOL_HPP_
@@ -0,0 +1,363 @@
+/**
+ * @file SocketDataStoreServer.hpp
+ *
+ * The server side of the SocketDataStore: it listens on a Unix-domain socket
+ * and, for every client that connects, creates the DataStore that the client
+ * asks for and performs the client's requests on it.  This allows DataStores
+ * to run in a process of their own, so that a crashing or stalled store does
+ * not take the readout application down with it.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTORESERVER_HPP_
+#define DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTORESERVER_HPP_
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/SocketDataStoreProtocol.hpp"
+
+#include "ers/ers.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief SocketDataStoreServer hosts DataStores on behalf of SocketDataStore clients.
+ */
+class SocketDataStoreServer
+{
+public:
+  /**
+   * @brief Creates the listening socket.  An existing socket file at the
+   * specified path is replaced.
+   */
+  explicit SocketDataStoreServer(const std::string& socketPath)
+    : socketPath_(socketPath)
+    , stopRequested_(false)
+  {
+    struct sockaddr_un address;
+    if (socketPath_.size() >= sizeof(address.sun_path)) {
+      throw SocketCommunicationFailed(ERS_HERE, "bind", "the socket path \"" + socketPath_ + "\" is too long");
+    }
+    listenFd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+      throw SocketCommunicationFailed(ERS_HERE, "socket", strerror(errno));
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath_.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath_.c_str());
+    if (bind(listenFd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || // NOLINT
+        listen(listenFd_, SOMAXCONN) != 0) {
+      int savedErrno = errno;
+      close(listenFd_);
+      throw SocketCommunicationFailed(ERS_HERE, "bind", socketPath_ + ": " + strerror(savedErrno));
+    }
+  }
+
+  ~SocketDataStoreServer()
+  {
+    close(listenFd_);
+    unlink(socketPath_.c_str());
+  }
+
+  /**
+   * @brief Accepts and serves clients until stop() is called.  When it
+   * returns, all client connections have been closed and their DataStores
+   * destroyed.
+   */
+  void run()
+  {
+    std::vector<std::thread> clientThreads;
+    while (!stopRequested_) {
+      int clientFd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (clientFd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        if (!stopRequested_) {
+          ers::error(SocketCommunicationFailed(ERS_HERE, "accept", strerror(errno)));
+        }
+        break;
+      }
+      {
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        clientFds_.push_back(clientFd);
+      }
+      clientThreads.emplace_back(&SocketDataStoreServer::serveClient_, this, clientFd);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(clientMutex_);
+      for (int clientFd : clientFds_) {
+        shutdown(clientFd, SHUT_RDWR);
+      }
+    }
+    for (auto& clientThread : clientThreads) {
+      clientThread.join();
+    }
+  }
+
+  /**
+   * @brief Asks run() to return.  This only sets a flag and shuts the
+   * listening socket down, so it may be called from a signal handler.
+   */
+  void stop()
+  {
+    stopRequested_ = true;
+    shutdown(listenFd_, SHUT_RDWR);
+  }
+
+private:
+  SocketDataStoreServer(const SocketDataStoreServer&) = delete;
+  SocketDataStoreServer& operator=(const SocketDataStoreServer&) = delete;
+  SocketDataStoreServer(SocketDataStoreServer&&) = delete;
+  SocketDataStoreServer& operator=(SocketDataStoreServer&&) = delete;
+
+  typedef SocketDataStoreProtocol Protocol;
+
+  std::string socketPath_;
+  int listenFd_;
+  std::atomic<bool> stopRequested_;
+  std::mutex clientMutex_;
+  std::vector<int> clientFds_;
+
+  void serveClient_(int clientFd)
+  {
+    void* arena = nullptr;
+    size_t arenaSize = 0;
+    try {
+      std::unique_ptr<DataStore> store;
+      std::vector<Protocol::Message> messages;
+      int receivedFd = -1;
+      while (Protocol::receivePacket(clientFd, messages, receivedFd)) {
+        std::string response;
+        uint64_t lastRequestId = 0;
+        for (auto& message : messages) {
+          const Protocol::MessageHeader& request = message.header;
+          lastRequestId = request.requestId;
+          try {
+            if (request.type == Protocol::Hello) {
+              if (receivedFd < 0 || arena != nullptr) {
+                throw SocketCommunicationFailed(ERS_HERE, "hello", "unexpected connection handshake");
+              }
+              arenaSize = request.dataSize;
+              arena = Protocol::mapSharedMemory(receivedFd, arenaSize, false);
+              close(receivedFd);
+              receivedFd = -1;
+              store = makeDataStore(nlohmann::json::parse(message.extra));
+              continue;
+            }
+            if (store.get() == nullptr) {
+              throw SocketCommunicationFailed(ERS_HERE, "request", "no DataStore has been created for this client");
+            }
+            processRequest_(clientFd, *store, message, arena, arenaSize, receivedFd, response);
+          } catch (const std::exception& excpt) {
+            Protocol::MessageHeader error;
+            error.type = Protocol::Error;
+            error.requestId = request.requestId;
+            std::string errorText = excpt.what();
+            if (!Protocol::fitsInPacket(response, errorText)) {
+              Protocol::sendPacket(clientFd, response);
+              response.clear();
+            }
+            Protocol::appendMessage(response, error, errorText.substr(0, Protocol::MAX_PACKET_SIZE / 2));
+          }
+        }
+        if (receivedFd >= 0) {
+          close(receivedFd);
+        }
+
+        // a single acknowledgement for all of the requests in the packet
+        Protocol::MessageHeader completed;
+        completed.type = Protocol::Completed;
+        completed.requestId = lastRequestId;
+        if (!Protocol::fitsInPacket(response, "")) {
+          Protocol::sendPacket(clientFd, response);
+          response.clear();
+        }
+        Protocol::appendMessage(response, completed);
+        Protocol::sendPacket(clientFd, response);
+      }
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+
+    if (arena != nullptr) {
+      munmap(arena, arenaSize);
+    }
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    for (auto iter = clientFds_.begin(); iter != clientFds_.end(); ++iter) {
+      if (*iter == clientFd) {
+        clientFds_.erase(iter);
+        break;
+      }
+    }
+    close(clientFd);
+  }
+
+  /**
+   * @brief Performs one request on the client's DataStore.  Results are added to
+   * the response packet, except for read results, which carry a file descriptor
+   * and are therefore sent in a packet of their own.
+   */
+  void processRequest_(int clientFd,
+                       DataStore& store,
+                       const Protocol::Message& message,
+                       const void* arena,
+                       size_t arenaSize,
+                       int& receivedFd,
+                       std::string& response)
+  {
+    const Protocol::MessageHeader& request = message.header;
+    StorageKey key(request.eventId, message.extra, request.geoLocation);
+
+    if (request.type == Protocol::Setup) {
+      store.setup(request.offset);
+
+    } else if (request.type == Protocol::Write) {
+      if (request.offset + request.dataSize > arenaSize) {
+        throw SocketCommunicationFailed(ERS_HERE, "write", "the data block is outside of the shared memory");
+      }
+      KeyedDataBlock dataBlock(key);
+      dataBlock.unowned_data_start = static_cast<const char*>(arena) + request.offset;
+      dataBlock.data_size = request.dataSize;
+      store.write(dataBlock);
+
+    } else if (request.type == Protocol::WriteWithFd) {
+      if (receivedFd < 0) {
+        throw SocketCommunicationFailed(ERS_HERE, "write", "the data block was sent without shared memory");
+      }
+      void* payload = Protocol::mapSharedMemory(receivedFd, request.dataSize, false);
+      close(receivedFd);
+      receivedFd = -1;
+      KeyedDataBlock dataBlock(key);
+      dataBlock.unowned_data_start = payload;
+      dataBlock.data_size = request.dataSize;
+      try {
+        store.write(dataBlock);
+      } catch (...) {
+        munmap(payload, request.dataSize);
+        throw;
+      }
+      munmap(payload, request.dataSize);
+
+    } else if (request.type == Protocol::Read) {
+      sendReadResult_(clientFd, store.read(key), request.requestId, response);
+
+    } else if (request.type == Protocol::ReadRange) {
+      sendReadResult_(clientFd, store.read(key, request.offset, request.dataSize), request.requestId, response);
+
+    } else if (request.type == Protocol::GetKeys) {
+      appendKeyList_(clientFd, store.getAllExistingKeys(), request.requestId, response);
+
+    } else if (request.type == Protocol::GetKeysInFile) {
+      appendKeyList_(clientFd, store.getKeysInFile(message.extra), request.requestId, response);
+
+    } else if (request.type == Protocol::Flush) {
+      store.flush();
+
+    } else {
+      throw SocketCommunicationFailed(ERS_HERE, "request", "unknown request type " + std::to_string(request.type));
+    }
+  }
+
+  /**
+   * @brief Sends a read result, with a shared-memory copy of the data block.
+   */
+  static void sendReadResult_(int clientFd, const KeyedDataBlock& dataBlock, uint64_t requestId, std::string& response)
+  {
+    Protocol::MessageHeader result;
+    result.type = Protocol::ReadResult;
+    result.requestId = requestId;
+    result.dataSize = dataBlock.getDataSizeBytes();
+    int payloadFd = -1;
+    if (result.dataSize > 0) {
+      payloadFd = Protocol::createSharedMemory("ddpdemo_read", result.dataSize);
+      try {
+        void* payload = Protocol::mapSharedMemory(payloadFd, result.dataSize, true);
+        memcpy(payload, dataBlock.getDataStart(), result.dataSize);
+        munmap(payload, result.dataSize);
+      } catch (...) {
+        close(payloadFd);
+        throw;
+      }
+    }
+    // earlier responses go first, so that the client sees them in order
+    if (!response.empty()) {
+      Protocol::sendPacket(clientFd, response);
+      response.clear();
+    }
+    std::string resultPacket;
+    Protocol::appendMessage(resultPacket, result);
+    try {
+      Protocol::sendPacket(clientFd, resultPacket, payloadFd);
+    } catch (...) {
+      if (payloadFd >= 0) {
+        close(payloadFd);
+      }
+      throw;
+    }
+    if (payloadFd >= 0) {
+      close(payloadFd);
+    }
+  }
+
+  /**
+   * @brief Adds the encoded keys to the response, split over as many messages as needed.
+   */
+  static void appendKeyList_(int clientFd,
+                             const std::vector<StorageKey>& keyList,
+                             uint64_t requestId,
+                             std::string& response)
+  {
+    Protocol::MessageHeader result;
+    result.type = Protocol::KeyList;
+    result.requestId = requestId;
+    std::string encodedKeys;
+    for (auto& listedKey : keyList) {
+      Protocol::appendKey(encodedKeys, listedKey);
+      if (encodedKeys.size() >= Protocol::MAX_PACKET_SIZE / 2) {
+        appendResponse_(clientFd, response, result, encodedKeys);
+        encodedKeys.clear();
+      }
+    }
+    if (!encodedKeys.empty()) {
+      appendResponse_(clientFd, response, result, encodedKeys);
+    }
+  }
+
+  static void appendResponse_(int clientFd,
+                              std::string& response,
+                              const Protocol::MessageHeader& header,
+                              const std::string& extra)
+  {
+    if (!Protocol::fitsInPacket(response, extra)) {
+      Protocol::sendPacket(clientFd, response);
+      response.clear();
+    }
+    Protocol::appendMessage(response, header, extra);
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_INCLUDE_DDPDEMO_SOCKETDATASTORESERVER_HPP_
@@ -11,6 +11,7 @@
  * received with this code.
  */
 
+#include <functional>
 #include <string>
 
 namespace dunedaq {
@@ -52,6 +53,14 @@ public:
 
   int getGeoLocation() const;
 
+  bool operator==(const StorageKey& other) const;
+  bool operator!=(const StorageKey& other) const { return !(*this == other); }
+
+  /**
+   * @brief Orders keys by event ID, then geographic location, then detector ID
+   */
+  bool operator<(const StorageKey& other) const;
+
 private:
   Key m_key;
 };
@@ -59,4 +68,21 @@ private:
 } // namespace ddpdemo
 } // namespace dunedaq
 
+namespace std {
+/**
+ * @brief Hash function for StorageKeys, so that they can be used in unordered containers
+ */
+template<>
+struct hash<dunedaq::ddpdemo::StorageKey>
+{
+  size_t operator()(const dunedaq::ddpdemo::StorageKey& key) const
+  {
+    size_t result = std::hash<int>()(key.getEventID());
+    result ^= std::hash<int>()(key.getGeoLocation()) + 0x9e3779b97f4a7c15 + (result << 6) + (result >> 2);
+    result ^= std::hash<std::string>()(key.getDetectorID()) + 0x9e3779b97f4a7c15 + (result << 6) + (result >> 2);
+    return result;
+  }
+};
+} // namespace std
+
 #endif // DDPDEMO_INCLUDE_DDPDEMO_STORAGEKEY_HPP_
@@ -0,0 +1,107 @@
+#ifndef DDPDEMO_SRC_BOUNDEDQUEUE_HPP_
+#define DDPDEMO_SRC_BOUNDEDQUEUE_HPP_
+/**
+ * @file BoundedQueue.hpp
+ *
+ * BoundedQueue is a small blocking FIFO that connects the stages of a
+ * pipeline inside one module: producers wait when it is full, consumers wait
+ * when it is empty, and closing it lets the consumers drain what is left and
+ * then finish.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief BoundedQueue is a blocking, fixed-capacity queue with close semantics.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacity)
+    : capacity_(std::max(capacity, static_cast<size_t>(1)))
+  {}
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * @brief Waits for space and appends the item.  Returns false (and drops
+   * the item) if the queue has been closed.
+   */
+  bool push(T&& item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    spaceCondition_.wait(lock, [&] { return closed_ || queue_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    queue_.push_back(std::move(item));
+    itemCondition_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Waits for an item and removes it.  Returns false once the queue has
+   * been closed and everything in it has been taken.
+   */
+  bool pop(T& item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    itemCondition_.wait(lock, [&] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return false;
+    }
+    item = std::move(queue_.front());
+    queue_.pop_front();
+    spaceCondition_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Closes the queue: further pushes fail, and pops fail once it is empty.
+   */
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    itemCondition_.notify_all();
+    spaceCondition_.notify_all();
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  const size_t capacity_;
+  std::deque<T> queue_;
+  bool closed_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable itemCondition_;
+  std::condition_variable spaceCondition_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_BOUNDEDQUEUE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,3 @@
+#include "CachingDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::CachingDataStore)
@@ -0,0 +1,387 @@
+#ifndef DDPDEMO_SRC_CACHINGDATASTORE_HPP_
+#define DDPDEMO_SRC_CACHINGDATASTORE_HPP_
+
+/**
+ * @file CachingDataStore.hpp
+ *
+ * An implementation of the DataStore interface that keeps the most recently
+ * read data blocks of a child DataStore in memory, up to a byte budget, so
+ * that readers that come back to the same data blocks (e.g. monitoring and
+ * event displays) do not go back to the child store each time.  The cache is
+ * split into shards, each with its own lock and least-recently-used order, so
+ * that concurrent readers rarely wait for each other.  Cached data blocks are
+ * handed out as shared, read-only references, so a hit never copies the
+ * payload.  Writes go straight to the child store, and drop any cached copy
+ * of the data blocks that they replace.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidCacheConfiguration,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Invalid cache configuration: " << reason,
+                       ((std::string)name),
+                       ((std::string)reason))
+
+namespace ddpdemo {
+
+/**
+ * @brief CachingDataStore serves repeated reads of a child DataStore from an
+ * LRU cache with a byte budget.
+ */
+class CachingDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_CAPACITY_BYTES = 256 * 1024 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_SHARD_COUNT = 16;
+
+  explicit CachingDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , hitCount_(0)
+    , missCount_(0)
+    , evictionCount_(0)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    size_t capacity = conf.value<size_t>("capacity_bytes", REASONABLE_DEFAULT_CAPACITY_BYTES);
+    size_t shardCount = conf.value<size_t>("shard_count", REASONABLE_DEFAULT_SHARD_COUNT);
+    if (shardCount == 0) {
+      throw InvalidCacheConfiguration(ERS_HERE, get_name(), "shard_count must be greater than zero");
+    }
+    // each shard gets an equal share of the budget
+    shardCapacity_ = capacity / shardCount;
+    for (size_t idx = 0; idx < shardCount; ++idx) {
+      shards_.emplace_back(new Shard());
+    }
+    childIsThreadSafe_ = conf.value<bool>("child_is_thread_safe", false);
+
+    childStore_ = makeDataStore(conf["child_data_store_parameters"]);
+  }
+
+  ~CachingDataStore() { logStatistics_(); }
+
+  virtual void setup(const size_t eventId) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    childStore_->setup(eventId);
+  }
+
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    childStore_->attachStatistics(statistics);
+  }
+
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    childStore_->write(dataBlock);
+    invalidate_(dataBlock.data_key);
+  }
+
+  virtual void write(const std::vector<KeyedDataBlock>& dataBlockList) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    childStore_->write(dataBlockList);
+    for (auto& dataBlock : dataBlockList) {
+      invalidate_(dataBlock.data_key);
+    }
+  }
+
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    bool linked = childStore_->writeLink(source, key);
+    invalidate_(key);
+    return linked;
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    return childStore_->acceptsNativeCopy(source);
+  }
+
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    size_t copiedBytes = childStore_->writeNativeCopy(source, key);
+    invalidate_(key);
+    return copiedBytes;
+  }
+
+  virtual bool materialize(const StorageKey& key) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    return childStore_->materialize(key);
+  }
+
+  /**
+   * @brief Returns the data block from the cache, or reads it from the child
+   * store and caches it.  The returned data block shares the cached payload.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    Entry entry;
+    size_t generation = 0;
+    if (lookup_(key, entry, generation)) {
+      return makeBlock_(key, entry, 0, entry.size);
+    }
+
+    KeyedDataBlock dataBlock(key);
+    {
+      std::unique_lock<std::mutex> childLock = lockChild_();
+      dataBlock = childStore_->read(key);
+    }
+    entry.size = dataBlock.getDataSizeBytes();
+    entry.data = shareData_(dataBlock);
+    insert_(key, entry, generation);
+    return makeBlock_(key, entry, 0, entry.size);
+  }
+
+  /**
+   * @brief Returns part of a cached data block, without copying it.  Ranges
+   * of data blocks that are not cached are read from the child store, and
+   * are not cached.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    Entry entry;
+    size_t generation = 0;
+    if (lookup_(key, entry, generation)) {
+      offset = std::min(offset, entry.size);
+      return makeBlock_(key, entry, offset, std::min(length, entry.size - offset));
+    }
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    return childStore_->read(key, offset, length);
+  }
+
+  /**
+   * @brief Passes the hint on to the child store, unless the data block is cached.
+   */
+  virtual void adviseWillRead(const StorageKey& key) override
+  {
+    {
+      Shard& shard = getShard_(key);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.index.count(key) > 0) {
+        return;
+      }
+    }
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    childStore_->adviseWillRead(key);
+  }
+
+  virtual EventDataBlock readEvent(int eventID) override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    return childStore_->readEvent(eventID);
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    return childStore_->getAllExistingKeys();
+  }
+
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    std::unique_lock<std::mutex> childLock = lockChild_();
+    return childStore_->getKeysInFile(fileName);
+  }
+
+  /**
+   * @brief Flushes the child store, and reports the cache statistics.
+   */
+  virtual void flush() override
+  {
+    {
+      std::unique_lock<std::mutex> childLock = lockChild_();
+      childStore_->flush();
+    }
+    logStatistics_();
+  }
+
+  size_t getHitCount() const { return hitCount_.load(std::memory_order_relaxed); }
+  size_t getMissCount() const { return missCount_.load(std::memory_order_relaxed); }
+  size_t getEvictionCount() const { return evictionCount_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the number of payload bytes that are currently cached.
+   */
+  size_t getCachedBytes() const
+  {
+    size_t bytes = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      bytes += shard->bytes;
+    }
+    return bytes;
+  }
+
+private:
+  CachingDataStore(const CachingDataStore&) = delete;
+  CachingDataStore& operator=(const CachingDataStore&) = delete;
+  CachingDataStore(CachingDataStore&&) = delete;
+  CachingDataStore& operator=(CachingDataStore&&) = delete;
+
+  struct Entry
+  {
+    std::shared_ptr<const void> data;
+    size_t size = 0;
+  };
+
+  // the most recently used keys are at the front of the list
+  struct Shard
+  {
+    std::mutex mutex;
+    std::list<std::pair<StorageKey, Entry>> lruList;
+    std::unordered_map<StorageKey, std::list<std::pair<StorageKey, Entry>>::iterator> index;
+    size_t bytes = 0;
+    // counts the invalidations, so that a read that overlapped a write does not cache stale data
+    size_t generation = 0;
+  };
+
+  Shard& getShard_(const StorageKey& key) { return *shards_[std::hash<StorageKey>()(key) % shards_.size()]; }
+
+  std::unique_lock<std::mutex> lockChild_() const
+  {
+    if (childIsThreadSafe_) {
+      return std::unique_lock<std::mutex>();
+    }
+    return std::unique_lock<std::mutex>(childMutex_);
+  }
+
+  bool lookup_(const StorageKey& key, Entry& entry, size_t& generation)
+  {
+    Shard& shard = getShard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    if (iter == shard.index.end()) {
+      generation = shard.generation;
+      ++missCount_;
+      return false;
+    }
+    shard.lruList.splice(shard.lruList.begin(), shard.lruList, iter->second);
+    entry = iter->second->second;
+    ++hitCount_;
+    return true;
+  }
+
+  void insert_(const StorageKey& key, const Entry& entry, size_t generation)
+  {
+    // data blocks that do not fit in a shard would only flush it
+    if (entry.size > shardCapacity_) {
+      return;
+    }
+    Shard& shard = getShard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.generation != generation || shard.index.count(key) > 0) {
+      // a write may have replaced the data since it was read, or another reader cached it in the meantime
+      return;
+    }
+    while (shard.bytes + entry.size > shardCapacity_ && !shard.lruList.empty()) {
+      shard.bytes -= shard.lruList.back().second.size;
+      shard.index.erase(shard.lruList.back().first);
+      shard.lruList.pop_back();
+      ++evictionCount_;
+    }
+    shard.lruList.emplace_front(key, entry);
+    shard.index.emplace(key, shard.lruList.begin());
+    shard.bytes += entry.size;
+  }
+
+  void invalidate_(const StorageKey& key)
+  {
+    Shard& shard = getShard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end()) {
+      shard.bytes -= iter->second->second.size;
+      shard.lruList.erase(iter->second);
+      shard.index.erase(iter);
+    }
+  }
+
+  // takes over (or shares) the payload of a data block that was read from the
+  // child store; only payloads that the block does not own are copied
+  static std::shared_ptr<const void> shareData_(KeyedDataBlock& dataBlock)
+  {
+    if (dataBlock.shared_data_start.get() != nullptr) {
+      return dataBlock.shared_data_start;
+    }
+    if (dataBlock.owned_data_start.get() != nullptr) {
+      return std::shared_ptr<const void>(dataBlock.owned_data_start.release(), std::default_delete<char[]>());
+    }
+    size_t size = dataBlock.getDataSizeBytes();
+    std::shared_ptr<char> copy(new char[std::max(size, static_cast<size_t>(1))], std::default_delete<char[]>());
+    if (size > 0) {
+      memcpy(copy.get(), dataBlock.getDataStart(), size);
+    }
+    return copy;
+  }
+
+  static KeyedDataBlock makeBlock_(const StorageKey& key, const Entry& entry, size_t offset, size_t length)
+  {
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = length;
+    dataBlock.unowned_data_start = nullptr;
+    dataBlock.shared_data_start =
+      std::shared_ptr<const void>(entry.data, static_cast<const char*>(entry.data.get()) + offset);
+    return dataBlock;
+  }
+
+  void logStatistics_() const
+  {
+    size_t lookupCount = getHitCount() + getMissCount();
+    if (lookupCount == 0) {
+      return;
+    }
+    TLOG(TLVL_DEBUG) << get_name() << ": Read cache hits " << getHitCount() << " of " << lookupCount << " reads ("
+                     << (100.0 * getHitCount() / lookupCount) << "%), " << getEvictionCount() << " evictions, "
+                     << getCachedBytes() << " bytes cached.";
+  }
+
+  std::unique_ptr<DataStore> childStore_;
+  bool childIsThreadSafe_;
+  mutable std::mutex childMutex_;
+
+  size_t shardCapacity_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  std::atomic<size_t> hitCount_;
+  std::atomic<size_t> missCount_;
+  std::atomic<size_t> evictionCount_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_CACHINGDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
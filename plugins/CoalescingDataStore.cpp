@@ -0,0 +1,3 @@
+#include "CoalescingDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::CoalescingDataStore)
@@ -0,0 +1,596 @@
+#ifndef DDPDEMO_SRC_COALESCINGDATASTORE_HPP_
+#define DDPDEMO_SRC_COALESCINGDATASTORE_HPP_
+
+/**
+ * @file CoalescingDataStore.hpp
+ *
+ * An implementation of the DataStore interface that packs small data blocks
+ * (e.g. trigger primitives) into large "packs", each of which is written to a
+ * child DataStore with a single write call.  A pack holds the payloads of its
+ * data blocks back-to-back, followed by an index of their keys, offsets and
+ * sizes.  The packing is invisible to users of this store: read() and
+ * getAllExistingKeys() work with the keys of the original data blocks.  When
+ * a packed data block is replaced by one that is written straight to the
+ * child store, the next pack records that (with a "tombstone" index record),
+ * so that a new instance does not find the old copy again.  A
+ * background thread writes the current pack once it reaches its age limit,
+ * so the limit also holds when no more data blocks arrive.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       CorruptDataPack,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The data pack with sequence number " << sequence << " in the child DataStore is corrupt ("
+                                                             << reason << ").",
+                       ((std::string)name),
+                       ((int)sequence)((std::string)reason))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       PackWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Unable to write the data pack with sequence number " << sequence
+                                                                             << " to the child DataStore.",
+                       ((std::string)name),
+                       ((int)sequence))
+
+namespace ddpdemo {
+
+/**
+ * @brief CoalescingDataStore accumulates small data blocks in a memory arena
+ * and writes them to a child DataStore as packs.
+ */
+class CoalescingDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_SMALL_BLOCK_THRESHOLD_BYTES = 64 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_PACK_SIZE_BYTES = 4 * 1024 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_PACK_MAX_AGE_MSEC = 1000;
+
+  // Packs are stored in the child store under this (reserved) event ID, just
+  // below StorageKey::INVALID_EVENTID, with the pack sequence number as the
+  // geographic location.  The detector ID is not used, since not all stores
+  // keep it (e.g. the HDF5DataStore).
+  static constexpr int PACK_EVENTID = std::numeric_limits<int>::max() - 1;
+
+  explicit CoalescingDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , nextPackSequence_(0)
+    , packCount_(0)
+    , packedBlockCount_(0)
+    , stopRequested_(false)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    smallBlockThreshold_ =
+      conf.value<size_t>("small_block_threshold_bytes", REASONABLE_DEFAULT_SMALL_BLOCK_THRESHOLD_BYTES);
+    packSize_ = conf.value<size_t>("pack_size_bytes", REASONABLE_DEFAULT_PACK_SIZE_BYTES);
+    packMaxAge_ =
+      std::chrono::milliseconds(conf.value<size_t>("pack_max_age_msec", REASONABLE_DEFAULT_PACK_MAX_AGE_MSEC));
+
+    childStore_ = makeDataStore(conf["child_data_store_parameters"]);
+    loadExistingPacks_();
+
+    arena_.reserve(packSize_);
+    ageThread_ = std::thread(&CoalescingDataStore::ageLoop_, this);
+  }
+
+  ~CoalescingDataStore()
+  {
+    try {
+      flush();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopRequested_ = true;
+    }
+    ageCondition_.notify_all();
+    ageThread_.join();
+
+    TLOG(TLVL_DEBUG) << get_name() << ": Wrote " << packedBlockCount_ << " data blocks in " << packCount_
+                     << " packs.";
+  }
+
+  virtual void setup(const size_t eventId) override
+  {
+    // the age thread may be writing a pack to the child store
+    std::lock_guard<std::mutex> lock(mutex_);
+    childStore_->setup(eventId);
+  }
+
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    childStore_->attachStatistics(statistics);
+  }
+
+  /**
+   * @brief Appends small data blocks to the current pack, which is written to
+   * the child store once it is full or older than the configured age limit
+   * (by this call or by the background thread, whichever comes first).
+   * Larger data blocks are written straight to the child store.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (size > smallBlockThreshold_) {
+      childStore_->write(dataBlock);
+      replaceInPacks_(dataBlock.data_key);
+      return;
+    }
+
+    if (!openPackEntries_.empty() && arena_.size() + size + getIndexSize_(openPackEntries_.size() + 1) > packSize_) {
+      writePack_();
+    }
+    if (openPackEntries_.empty()) {
+      openPackTime_ = std::chrono::steady_clock::now();
+      ageCondition_.notify_all();
+    }
+
+    removeFromPacks_(dataBlock.data_key);
+    PackEntry entry(dataBlock.data_key);
+    entry.offset = arena_.size();
+    entry.size = size;
+    const char* data = static_cast<const char*>(dataBlock.getDataStart());
+    arena_.insert(arena_.end(), data, data + size);
+    openPackIndex_[entry.key] = openPackEntries_.size();
+    openPackEntries_.push_back(entry);
+
+    if (arena_.size() + getIndexSize_(openPackEntries_.size()) >= packSize_ ||
+        std::chrono::steady_clock::now() - openPackTime_ >= packMaxAge_) {
+      writePack_();
+    }
+  }
+
+  /**
+   * @brief Writes the reference to the child store.  A packed copy of the data
+   * block is dropped once the reference has been written.
+   */
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!childStore_->writeLink(source, key)) {
+      return false;
+    }
+    replaceInPacks_(key);
+    return true;
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return childStore_->acceptsNativeCopy(source);
+  }
+
+  /**
+   * @brief Native copies go straight to the child store, like large data blocks do.
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t copiedBytes = childStore_->writeNativeCopy(source, key);
+    replaceInPacks_(key);
+    return copiedBytes;
+  }
+
+  virtual bool materialize(const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return childStore_->materialize(key);
+  }
+
+  /**
+   * @brief Writes the current pack, even if it is not full, and flushes the child store.
+   */
+  virtual void flush() override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!openPackEntries_.empty()) {
+      writePack_();
+    }
+    childStore_->flush();
+  }
+
+  /**
+   * @brief Returns the data block from the current pack, from a pack in the
+   * child store, or from the child store itself, in that order.  Data blocks
+   * from stored packs share the pack's buffer instead of being copied.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto openIter = openPackIndex_.find(key);
+    if (openIter != openPackIndex_.end()) {
+      const PackEntry& entry = openPackEntries_[openIter->second];
+      KeyedDataBlock dataBlock(key);
+      dataBlock.data_size = entry.size;
+      char* membuffer = new char[entry.size];
+      memcpy(membuffer, arena_.data() + entry.offset, entry.size);
+      std::unique_ptr<char> memPtr(membuffer);
+      dataBlock.owned_data_start = std::move(memPtr);
+      return dataBlock;
+    }
+
+    auto packIter = packIndex_.find(key);
+    if (packIter == packIndex_.end()) {
+      return childStore_->read(key);
+    }
+
+    std::shared_ptr<const KeyedDataBlock> pack = readPack_(packIter->second.sequence);
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = packIter->second.size;
+    dataBlock.shared_data_start = std::shared_ptr<const void>(
+      pack, static_cast<const char*>(pack->getDataStart()) + packIter->second.offset);
+    return dataBlock;
+  }
+
+  size_t getPackCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return packCount_;
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<StorageKey> childKeyList = childStore_->getAllExistingKeys();
+
+    std::vector<StorageKey> keyList;
+    std::unordered_set<StorageKey> keySet;
+    for (auto& key : childKeyList) {
+      if (key.getEventID() != PACK_EVENTID && keySet.insert(key).second) {
+        keyList.push_back(key);
+      }
+    }
+    for (auto& indexEntry : packIndex_) {
+      if (keySet.insert(indexEntry.first).second) {
+        keyList.push_back(indexEntry.first);
+      }
+    }
+    for (auto& indexEntry : openPackIndex_) {
+      if (keySet.insert(indexEntry.first).second) {
+        keyList.push_back(indexEntry.first);
+      }
+    }
+    return keyList;
+  }
+
+  /**
+   * @brief Returns the keys in the specified file of the child store, with the
+   * packs in it replaced by the keys of the data blocks that they hold.
+   */
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<StorageKey> keyList;
+    std::unordered_set<int> packSequences;
+    for (auto& key : childStore_->getKeysInFile(fileName)) {
+      if (key.getEventID() == PACK_EVENTID) {
+        packSequences.insert(key.getGeoLocation());
+      } else {
+        keyList.push_back(key);
+      }
+    }
+    for (auto& indexEntry : packIndex_) {
+      if (packSequences.count(indexEntry.second.sequence) != 0) {
+        keyList.push_back(indexEntry.first);
+      }
+    }
+    return keyList;
+  }
+
+private:
+  CoalescingDataStore(const CoalescingDataStore&) = delete;
+  CoalescingDataStore& operator=(const CoalescingDataStore&) = delete;
+  CoalescingDataStore(CoalescingDataStore&&) = delete;
+  CoalescingDataStore& operator=(CoalescingDataStore&&) = delete;
+
+  // The index at the end of each pack is a list of IndexRecords, each
+  // followed by the detector ID, and then an IndexTrailer.  A record with the
+  // tombstone flag (and no payload) removes the key from the earlier packs.
+  static constexpr uint32_t PACK_MAGIC = 0x4b434150; // "PACK"
+  static constexpr uint32_t RECORD_FLAG_TOMBSTONE = 1;
+
+  struct IndexRecord
+  {
+    int32_t eventId;
+    int32_t geoLocation;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t detectorIdLength;
+    uint32_t flags;
+  };
+
+  struct IndexTrailer
+  {
+    uint64_t indexOffset;
+    uint32_t entryCount;
+    uint32_t magic;
+  };
+
+  struct PackEntry
+  {
+    explicit PackEntry(const StorageKey& theKey)
+      : key(theKey)
+    {}
+
+    StorageKey key;
+    size_t offset = 0;
+    size_t size = 0;
+    bool tombstone = false;
+  };
+
+  struct PackLocation
+  {
+    int sequence;
+    size_t offset;
+    size_t size;
+  };
+
+  // Configuration
+  size_t smallBlockThreshold_;
+  size_t packSize_;
+  std::chrono::milliseconds packMaxAge_;
+
+  // Everything below is protected by mutex_
+  std::unique_ptr<DataStore> childStore_;
+
+  // The pack that is being filled
+  std::vector<char> arena_;
+  std::vector<PackEntry> openPackEntries_;
+  std::unordered_map<StorageKey, size_t> openPackIndex_;
+  std::chrono::steady_clock::time_point openPackTime_;
+
+  // Where the data blocks in the child store's packs are, and the most recently read pack
+  std::unordered_map<StorageKey, PackLocation> packIndex_;
+  int nextPackSequence_;
+  int cachedPackSequence_ = -1;
+  std::shared_ptr<const KeyedDataBlock> cachedPack_;
+
+  size_t packCount_;
+  size_t packedBlockCount_;
+  mutable std::mutex mutex_;
+
+  // The background thread that writes packs which have reached their age limit
+  bool stopRequested_;
+  std::condition_variable ageCondition_;
+  std::thread ageThread_;
+
+  static size_t getRecordSize_(const StorageKey& key)
+  {
+    // each record is padded to keep the next one aligned
+    return (sizeof(IndexRecord) + key.getDetectorID().size() + 7) & ~static_cast<size_t>(7);
+  }
+
+  // an estimate that is used to keep packs within their size limit
+  static size_t getIndexSize_(size_t entryCount)
+  {
+    return entryCount * (sizeof(IndexRecord) + 16) + sizeof(IndexTrailer);
+  }
+
+  static StorageKey getPackKey_(int sequence) { return StorageKey(PACK_EVENTID, StorageKey::INVALID_DETECTORID, sequence); }
+
+  // A data block that is written again replaces the earlier copy, wherever that is
+  void removeFromPacks_(const StorageKey& key)
+  {
+    packIndex_.erase(key);
+    auto openIter = openPackIndex_.find(key);
+    if (openIter != openPackIndex_.end()) {
+      // the payload stays in the arena, but is no longer referenced
+      PackEntry& entry = openPackEntries_[openIter->second];
+      entry.key = StorageKey(StorageKey::INVALID_EVENTID, StorageKey::INVALID_DETECTORID, StorageKey::INVALID_GEOLOCATION);
+      openPackIndex_.erase(openIter);
+    }
+  }
+
+  // A data block that has been written straight to the child store replaces
+  // the packed copies; if one of those is already in a stored pack, a
+  // tombstone in the current pack keeps it from being found again
+  void replaceInPacks_(const StorageKey& key)
+  {
+    const bool isInStoredPack = (packIndex_.count(key) != 0);
+    removeFromPacks_(key);
+    if (!isInStoredPack) {
+      return;
+    }
+    if (openPackEntries_.empty()) {
+      openPackTime_ = std::chrono::steady_clock::now();
+      ageCondition_.notify_all();
+    }
+    PackEntry entry(key);
+    entry.offset = arena_.size();
+    entry.tombstone = true;
+    openPackEntries_.push_back(entry);
+  }
+
+  void writePack_()
+  {
+    // the index is appended to the payloads, so the whole pack is written from the arena
+    const size_t indexOffset = arena_.size();
+    uint32_t entryCount = 0;
+    uint32_t tombstoneCount = 0;
+    for (auto& entry : openPackEntries_) {
+      if (!entry.tombstone && openPackIndex_.count(entry.key) == 0) {
+        continue;
+      }
+      IndexRecord record;
+      record.eventId = entry.key.getEventID();
+      record.geoLocation = entry.key.getGeoLocation();
+      record.offset = entry.offset;
+      record.size = entry.size;
+      std::string detectorId = entry.key.getDetectorID();
+      record.detectorIdLength = detectorId.size();
+      record.flags = entry.tombstone ? RECORD_FLAG_TOMBSTONE : 0;
+
+      size_t recordStart = arena_.size();
+      arena_.resize(recordStart + getRecordSize_(entry.key), 0);
+      memcpy(arena_.data() + recordStart, &record, sizeof(record));
+      memcpy(arena_.data() + recordStart + sizeof(record), detectorId.data(), detectorId.size());
+      ++entryCount;
+      if (entry.tombstone) {
+        ++tombstoneCount;
+      }
+    }
+    IndexTrailer trailer;
+    trailer.indexOffset = indexOffset;
+    trailer.entryCount = entryCount;
+    trailer.magic = PACK_MAGIC;
+    size_t trailerStart = arena_.size();
+    arena_.resize(trailerStart + sizeof(trailer));
+    memcpy(arena_.data() + trailerStart, &trailer, sizeof(trailer));
+
+    const int sequence = nextPackSequence_;
+    TLOG(TLVL_DEBUG) << get_name() << ": Writing pack " << sequence << " with " << entryCount << " data blocks ("
+                     << arena_.size() << " bytes) to the child store";
+    KeyedDataBlock pack(getPackKey_(sequence));
+    pack.unowned_data_start = arena_.data();
+    pack.data_size = arena_.size();
+    try {
+      childStore_->write(pack);
+    } catch (...) {
+      // the pack stays open, without its index, so that it can be written again
+      arena_.resize(indexOffset);
+      throw;
+    }
+    ++nextPackSequence_;
+    ++packCount_;
+    packedBlockCount_ += entryCount - tombstoneCount;
+
+    for (auto& entry : openPackEntries_) {
+      if (!entry.tombstone && openPackIndex_.count(entry.key) != 0) {
+        packIndex_[entry.key] = PackLocation{ sequence, entry.offset, entry.size };
+      }
+    }
+    arena_.clear();
+    openPackEntries_.clear();
+    openPackIndex_.clear();
+  }
+
+  void ageLoop_()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+      if (openPackEntries_.empty()) {
+        ageCondition_.wait(lock);
+        continue;
+      }
+      auto deadline = openPackTime_ + packMaxAge_;
+      if (std::chrono::steady_clock::now() < deadline) {
+        ageCondition_.wait_until(lock, deadline);
+        continue;
+      }
+      try {
+        writePack_();
+      } catch (const std::exception& excpt) {
+        ers::error(PackWriteFailed(ERS_HERE, get_name(), nextPackSequence_, excpt));
+        // retried once another age limit has passed, or by the next flush
+        openPackTime_ = std::chrono::steady_clock::now();
+      }
+    }
+  }
+
+  std::shared_ptr<const KeyedDataBlock> readPack_(int sequence)
+  {
+    if (sequence != cachedPackSequence_) {
+      cachedPack_.reset(new KeyedDataBlock(childStore_->read(getPackKey_(sequence))));
+      cachedPackSequence_ = sequence;
+    }
+    return cachedPack_;
+  }
+
+  // Rebuilds the pack index from the packs that are already in the child store
+  void loadExistingPacks_()
+  {
+    std::vector<StorageKey> packKeyList;
+    for (auto& key : childStore_->getAllExistingKeys()) {
+      if (key.getEventID() == PACK_EVENTID) {
+        packKeyList.push_back(key);
+      }
+    }
+    std::sort(packKeyList.begin(), packKeyList.end());
+
+    for (auto& packKey : packKeyList) {
+      const int sequence = packKey.getGeoLocation();
+      std::shared_ptr<const KeyedDataBlock> pack = readPack_(sequence);
+      const char* packStart = static_cast<const char*>(pack->getDataStart());
+      const size_t packSize = pack->getDataSizeBytes();
+
+      IndexTrailer trailer;
+      if (packSize < sizeof(trailer)) {
+        throw CorruptDataPack(ERS_HERE, get_name(), sequence, "it is too small for the index");
+      }
+      memcpy(&trailer, packStart + packSize - sizeof(trailer), sizeof(trailer));
+      if (trailer.magic != PACK_MAGIC || trailer.indexOffset > packSize - sizeof(trailer)) {
+        throw CorruptDataPack(ERS_HERE, get_name(), sequence, "the index trailer is not valid");
+      }
+
+      size_t position = trailer.indexOffset;
+      for (uint32_t idx = 0; idx < trailer.entryCount; ++idx) {
+        IndexRecord record;
+        if (position + sizeof(record) > packSize - sizeof(trailer)) {
+          throw CorruptDataPack(ERS_HERE, get_name(), sequence, "the index is truncated");
+        }
+        memcpy(&record, packStart + position, sizeof(record));
+        if (position + sizeof(record) + record.detectorIdLength > packSize - sizeof(trailer) ||
+            record.offset + record.size > trailer.indexOffset) {
+          throw CorruptDataPack(ERS_HERE, get_name(), sequence, "an index record is out of range");
+        }
+        StorageKey key(record.eventId,
+                       std::string(packStart + position + sizeof(record), record.detectorIdLength),
+                       record.geoLocation);
+        if (record.flags & RECORD_FLAG_TOMBSTONE) {
+          packIndex_.erase(key);
+        } else {
+          packIndex_[key] = PackLocation{ sequence, record.offset, record.size };
+        }
+        position += getRecordSize_(key);
+      }
+      nextPackSequence_ = std::max(nextPackSequence_, sequence + 1);
+    }
+
+    if (!packKeyList.empty()) {
+      TLOG(TLVL_DEBUG) << get_name() << ": Found " << packIndex_.size() << " data blocks in " << packKeyList.size()
+                       << " existing packs";
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_COALESCINGDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -15,8 +15,10 @@
 #include <TRACE/trace.h>
 #include <ers/ers.h>
 
+#include <algorithm>
 #include <chrono>
-#include <cstdlib>
+#include <functional>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -42,9 +44,18 @@ DataGenerator::DataGenerator(const std::string& name)
 }
 
 void
-DataGenerator::init( const data_t& )
+DataGenerator::init( const data_t& init_data )
 {
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering init() method";
+  // the output queue is optional; without one, the data is written to the DataStore
+  outputQueue_.reset();
+  if (init_data.contains("qinfos")) {
+    for (const auto& qinfo : init_data["qinfos"]) {
+      if (qinfo.value<std::string>("name", "") == "output") {
+        outputQueue_.reset(new sink_t(qinfo["inst"].get<std::string>()));
+      }
+    }
+  }
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
 }
 
@@ -60,10 +71,43 @@ DataGenerator::do_conf( const data_t& payload )
   io_size_ = payload.value<size_t>("io_size", static_cast<size_t>(REASONABLE_IO_SIZE_BYTES));
   sleepMsecWhileRunning_ = payload.value<size_t>("sleep_msec_while_running",
                                                       static_cast<size_t>(REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING));
-  
-  // Create the HDF5DataStore instance
-  dataWriter_ = makeDataStore( payload["data_store_parameters"] ) ; 
-  
+  msecBetweenReports_ = payload.value<size_t>("msec_between_reports", REASONABLE_DEFAULT_MSECBETWEENREPORTS);
+
+  generatorThreadCount_ =
+    payload.value<size_t>("generator_thread_count", static_cast<size_t>(REASONABLE_DEFAULT_GENERATORTHREADCOUNT));
+  generatorThreadCount_ = std::max(std::min(generatorThreadCount_, nGeoLoc_), static_cast<size_t>(1));
+  sharedStoreIsThreadSafe_ = payload.value<bool>("shared_store_is_thread_safe", false);
+
+  // When a target rate is configured, the pacers replace the fixed sleep between events.
+  // Every thread paces whole events, so that the threads stay in step.
+  pacers_.clear();
+  for (size_t idx = 0; idx < generatorThreadCount_; ++idx) {
+    pacers_.emplace_back(new RatePacer(payload, static_cast<double>(nGeoLoc_ * io_size_)));
+  }
+
+  // The payloads are generated up front, so that this does not limit the write rate
+  payloadGenerator_.reset(new PayloadGenerator(payload, io_size_));
+
+  queueTimeoutMsec_ = payload.value<size_t>("queue_timeout_msec", REASONABLE_DEFAULT_QUEUETIMEOUTMSEC);
+
+  // Create the DataStore instance(s), unless the data goes to the output queue
+  dataWriters_.clear();
+  if (outputQueue_.get() != nullptr) {
+    TLOG(TLVL_WORK_STEPS) << get_name() << ": Sending data to the output queue instead of a DataStore";
+  } else if (payload.value<bool>("data_store_per_thread", false)) {
+    for (size_t idx = 0; idx < generatorThreadCount_; ++idx) {
+      // each thread's store gets its own name, and its own files
+      nlohmann::json storeParams = payload["data_store_parameters"];
+      storeParams["name"] = storeParams.value<std::string>("name", "store") + "_" + std::to_string(idx);
+      if (storeParams.contains("filename_prefix")) {
+        storeParams["filename_prefix"] = storeParams["filename_prefix"].get<std::string>() + "_thread" + std::to_string(idx);
+      }
+      dataWriters_.push_back(makeDataStore(storeParams));
+    }
+  } else {
+    dataWriters_.push_back(makeDataStore(payload["data_store_parameters"]));
+  }
+
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
 }
 
@@ -92,6 +136,12 @@ DataGenerator::do_unconfigure( const data_t& )
   nGeoLoc_ = REASONABLE_DEFAULT_GEOLOC;
   io_size_ = REASONABLE_IO_SIZE_BYTES;
   sleepMsecWhileRunning_ = REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING;
+  msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  generatorThreadCount_ = REASONABLE_DEFAULT_GENERATORTHREADCOUNT;
+  sharedStoreIsThreadSafe_ = false;
+  pacers_.clear();
+  payloadGenerator_.reset();
+  dataWriters_.clear();
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_unconfigure() method";
 }
 
@@ -99,46 +149,154 @@ void
 DataGenerator::do_work(std::atomic<bool>& running_flag)
 {
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
-  size_t writtenCount = 0;
 
   // ensure that we have a valid dataWriter instance
-  if (dataWriter_.get() == nullptr) {
+  if (dataWriters_.empty() && outputQueue_.get() == nullptr) {
     throw InvalidDataWriterError(ERS_HERE, get_name());
   }
 
-  // create a memory buffer
-  void* membuffer = malloc(io_size_);
-  memset(membuffer, 'X', io_size_);
+  TLOG(TLVL_WORK_STEPS) << get_name() << ": Generating data with " << generatorThreadCount_ << " threads";
 
-  TLOG(TLVL_WORK_STEPS) << get_name() << ": Generating data ";
+  eventClaims_.reset();
+  std::atomic<bool> workers_running_flag(true);
+  std::vector<std::thread> workers;
+  for (size_t idx = 0; idx < generatorThreadCount_; ++idx) {
+    workers.emplace_back(&DataGenerator::generate_slice, this, idx, std::ref(workers_running_flag));
+  }
 
-  int eventID = 1;
   while (running_flag.load()) {
-    for (size_t geoID = 0; geoID < nGeoLoc_; ++geoID) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  // every thread finishes the events that any thread has started
+  int lastEventID = eventClaims_.close();
+  workers_running_flag.store(false);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (dataWriters_.size() == 1) {
+    dataWriters_[0]->flush();
+  }
+
+  std::ostringstream oss_summ;
+  oss_summ << ": Exiting the do_work() method, wrote " << lastEventID << " fake events with " << generatorThreadCount_
+           << " threads. ";
+  ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
+}
+
+bool
+DataGenerator::send_to_queue(KeyedDataBlock& dataBlock, std::atomic<bool>& workers_running_flag, size_t& queueFullCount)
+{
+  // while the run is going, a full queue is waited out; after the stop, the
+  // data block is given one more chance before it is dropped, in case the
+  // consumer has already been stopped
+  while (true) {
+    bool lastChance = !workers_running_flag.load();
+    try {
+      outputQueue_->push(std::move(dataBlock), std::chrono::milliseconds(queueTimeoutMsec_));
+      return true;
+    } catch (const dunedaq::appfwk::QueueTimeoutExpired& excpt) {
+      ++queueFullCount;
+      if (lastChance) {
+        ers::warning(excpt);
+        return false;
+      }
+    }
+  }
+}
+
+void
+DataGenerator::generate_slice(size_t threadIndex, std::atomic<bool>& workers_running_flag)
+{
+  const size_t firstGeoID = threadIndex * nGeoLoc_ / generatorThreadCount_;
+  const size_t endGeoID = (threadIndex + 1) * nGeoLoc_ / generatorThreadCount_;
+  DataStore* dataWriter = dataWriters_.empty() ? nullptr : dataWriters_[(dataWriters_.size() == 1) ? 0 : threadIndex].get();
+  const bool serializeWrites = (dataWriters_.size() == 1 && generatorThreadCount_ > 1 && !sharedStoreIsThreadSafe_);
+  RatePacer& pacer = *pacers_[threadIndex];
+  size_t writtenCount = 0;
+  size_t queueFullCount = 0;
+
+  TLOG(TLVL_WORK_STEPS) << get_name() << ": Thread " << threadIndex << " generating data for geoIDs " << firstGeoID
+                        << " to " << (endGeoID - 1);
+
+  bool paced = pacer.isEnabled();
+  auto reportTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecBetweenReports_);
+  if (paced) {
+    pacer.start(std::chrono::steady_clock::now());
+  }
+
+  int eventID = 1;
+  while (true) {
+    // an interrupted wait is not an error, since the thread may still need to finish this event
+    if (paced) {
+      pacer.acquire(workers_running_flag);
+    }
+    if (!eventClaims_.claim(eventID)) {
+      break;
+    }
+
+    for (size_t geoID = firstGeoID; geoID < endGeoID; ++geoID) {
       // AAA: Component ID is fixed, to be changed later
       StorageKey dataKey(eventID, "FELIX", geoID);
       KeyedDataBlock dataBlock(dataKey);
       dataBlock.data_size = io_size_;
 
-      // Set the dataBlock pointer to the start of the constant memory buffer
-      dataBlock.unowned_data_start = membuffer;
+      if (outputQueue_.get() != nullptr) {
+        // queued data blocks share the payload buffer, which keeps it alive until they are written
+        dataBlock.shared_data_start = payloadGenerator_->getSharedBuffer(eventID * nGeoLoc_ + geoID);
+        if (send_to_queue(dataBlock, workers_running_flag, queueFullCount)) {
+          ++writtenCount;
+        }
+        continue;
+      }
+
+      // Set the dataBlock pointer to the start of one of the pre-generated payload buffers
+      dataBlock.unowned_data_start = payloadGenerator_->getBuffer(eventID * nGeoLoc_ + geoID);
 
-      dataWriter_->write(dataBlock);
-      ++writtenCount;
+      try {
+        if (serializeWrites) {
+          std::lock_guard<std::mutex> lock(sharedStoreMutex_);
+          dataWriter->write(dataBlock);
+        } else {
+          dataWriter->write(dataBlock);
+        }
+        ++writtenCount;
+      } catch (const ers::Issue& excpt) {
+        // a failed write is reported, and the other threads carry on
+        ers::error(excpt);
+      }
     }
     ++eventID;
 
-    TLOG(TLVL_WORK_STEPS) << get_name() << ": Start of sleep between sends";
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleepMsecWhileRunning_));
+    if (paced) {
+      if (std::chrono::steady_clock::now() >= reportTime) {
+        std::ostringstream oss_prog;
+        oss_prog << ": Thread " << threadIndex << " wrote " << writtenCount << " fragments so far; the pacer "
+                 << pacer.getReport(std::chrono::steady_clock::now()) << ".";
+        ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_prog.str()));
+        reportTime += std::chrono::milliseconds(msecBetweenReports_);
+      }
+    } else if (workers_running_flag.load()) {
+      TLOG(TLVL_WORK_STEPS) << get_name() << ": Start of sleep between sends";
+      std::this_thread::sleep_for(std::chrono::milliseconds(sleepMsecWhileRunning_));
+    }
     TLOG(TLVL_WORK_STEPS) << get_name() << ": End of do_work loop";
   }
-  free(membuffer);
+  if (dataWriters_.size() > 1) {
+    dataWriter->flush();
+  }
 
   std::ostringstream oss_summ;
-  oss_summ << ": Exiting the do_work() method, wrote " << writtenCount << " fragments associated with " << (eventID - 1)
-           << " fake events. ";
+  oss_summ << ": Thread " << threadIndex << " wrote " << writtenCount << " fragments for geoIDs " << firstGeoID << " to "
+           << (endGeoID - 1) << ", associated with " << (eventID - 1) << " fake events. ";
+  if (outputQueue_.get() != nullptr) {
+    oss_summ << "The output queue was full " << queueFullCount << " times. ";
+  }
+  if (paced) {
+    oss_summ << "The pacer " << pacer.getReport(std::chrono::steady_clock::now()) << ".";
+  }
   ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
-  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
 }
 
 } // namespace ddpdemo
@@ -12,13 +12,19 @@
 #ifndef DDPDEMO_SRC_DATAGENERATOR_HPP_
 #define DDPDEMO_SRC_DATAGENERATOR_HPP_
 
+#include "EventClaimTracker.hpp"
+#include "PayloadGenerator.hpp"
+#include "RatePacer.hpp"
 #include "ddpdemo/DataStore.hpp"
 
 #include <appfwk/DAQModule.hpp>
+#include <appfwk/DAQSink.hpp>
 #include <appfwk/ThreadHelper.hpp>
 #include <ers/Issue.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -27,7 +33,8 @@ namespace ddpdemo {
 
 /**
  * @brief DataGenerator creates fake events and writes
- * them to one or more HDF5 files..
+ * them to one or more HDF5 files..  The geographic locations
+ * of each event can be split up between several generator threads.
  */
 class DataGenerator : public dunedaq::appfwk::DAQModule
 {
@@ -56,18 +63,43 @@ private:
   dunedaq::appfwk::ThreadHelper thread_;
   void do_work(std::atomic<bool>&);
 
+  // Generator threads, each of which writes a slice of the geographic locations
+  void generate_slice(size_t threadIndex, std::atomic<bool>& workers_running_flag);
+  bool send_to_queue(KeyedDataBlock& dataBlock, std::atomic<bool>& workers_running_flag, size_t& queueFullCount);
+
   // Configuration defaults
   const size_t REASONABLE_DEFAULT_GEOLOC = 5;
   const size_t REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING = 1000;
   const size_t REASONABLE_IO_SIZE_BYTES = 1024;
+  const size_t REASONABLE_DEFAULT_MSECBETWEENREPORTS = 10000;
+  const size_t REASONABLE_DEFAULT_GENERATORTHREADCOUNT = 1;
+  const size_t REASONABLE_DEFAULT_QUEUETIMEOUTMSEC = 100;
 
   // Configuration
   size_t nGeoLoc_ = REASONABLE_DEFAULT_GEOLOC;
   size_t io_size_ = REASONABLE_IO_SIZE_BYTES;
   size_t sleepMsecWhileRunning_ = REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING;
-
-  // Workers
-  std::unique_ptr<DataStore> dataWriter_;
+  size_t msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  size_t generatorThreadCount_ = REASONABLE_DEFAULT_GENERATORTHREADCOUNT;
+  bool sharedStoreIsThreadSafe_ = false;
+  size_t queueTimeoutMsec_ = REASONABLE_DEFAULT_QUEUETIMEOUTMSEC;
+
+  // Workers.  There is either one DataStore per generator thread, or a single
+  // one that all threads share (in which case writes to it are serialized with
+  // sharedStoreMutex_, unless it is known to be thread-safe).
+  std::vector<std::unique_ptr<DataStore>> dataWriters_;
+  std::mutex sharedStoreMutex_;
+  std::vector<std::unique_ptr<RatePacer>> pacers_;
+  std::unique_ptr<PayloadGenerator> payloadGenerator_;
+
+  // When the module has an "output" queue, the data blocks are sent to it (e.g.
+  // for a DataStoreWriter) instead of being written to a DataStore
+  using sink_t = dunedaq::appfwk::DAQSink<KeyedDataBlock>;
+  std::unique_ptr<sink_t> outputQueue_;
+
+  // Event IDs are claimed by each thread before it writes its slice, so that
+  // every thread can finish the same set of events when the run is stopped
+  EventClaimTracker eventClaims_;
 };
 } // namespace ddpdemo
 
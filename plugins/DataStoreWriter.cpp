@@ -0,0 +1,194 @@
+/**
+ * @file DataStoreWriter.cpp DataStoreWriter class implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "DataStoreWriter.hpp"
+
+#include <appfwk/cmd/Nljs.hpp>
+
+#include <TRACE/trace.h>
+#include <ers/ers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Name used by TRACE TLOG calls from this source file
+ */
+#define TRACE_NAME "DataStoreWriter" // NOLINT
+#define TLVL_ENTER_EXIT_METHODS 10   // NOLINT
+#define TLVL_WORK_STEPS 15           // NOLINT
+
+namespace dunedaq {
+namespace ddpdemo {
+
+DataStoreWriter::DataStoreWriter(const std::string& name)
+  : dunedaq::appfwk::DAQModule(name)
+  , thread_(std::bind(&DataStoreWriter::do_work, this, std::placeholders::_1))
+{
+  register_command("conf", &DataStoreWriter::do_conf);
+  register_command("start", &DataStoreWriter::do_start);
+  register_command("stop", &DataStoreWriter::do_stop);
+  register_command("unconfigure", &DataStoreWriter::do_unconfigure);
+}
+
+void
+DataStoreWriter::init(const data_t& init_data)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering init() method";
+  auto qi = appfwk::qindex(init_data, { "input" });
+  inputQueue_.reset(new source_t(qi["input"].inst));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
+}
+
+void
+DataStoreWriter::do_conf(const data_t& args)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_conf() method";
+  writerThreadCount_ = std::max(args.value<size_t>("writer_thread_count", REASONABLE_DEFAULT_WRITERTHREADCOUNT),
+                                static_cast<size_t>(1));
+  batchSize_ = std::max(args.value<size_t>("batch_size", REASONABLE_DEFAULT_BATCHSIZE), static_cast<size_t>(1));
+  queueTimeoutMsec_ = args.value<size_t>("queue_timeout_msec", REASONABLE_DEFAULT_QUEUETIMEOUTMSEC);
+  msecBetweenReports_ = args.value<size_t>("msec_between_reports", REASONABLE_DEFAULT_MSECBETWEENREPORTS);
+  sharedStoreIsThreadSafe_ = args.value<bool>("shared_store_is_thread_safe", false);
+
+  dataWriters_.clear();
+  if (args.value<bool>("data_store_per_thread", false)) {
+    for (size_t idx = 0; idx < writerThreadCount_; ++idx) {
+      // each thread's store gets its own name, and its own files
+      nlohmann::json storeParams = args["data_store_parameters"];
+      storeParams["name"] = storeParams.value<std::string>("name", "store") + "_" + std::to_string(idx);
+      if (storeParams.contains("filename_prefix")) {
+        storeParams["filename_prefix"] = storeParams["filename_prefix"].get<std::string>() + "_thread" + std::to_string(idx);
+      }
+      dataWriters_.push_back(makeDataStore(storeParams));
+    }
+  } else {
+    dataWriters_.push_back(makeDataStore(args["data_store_parameters"]));
+  }
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
+}
+
+void
+DataStoreWriter::do_start(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_start() method";
+  thread_.start_working_thread();
+  ERS_LOG(get_name() << " successfully started");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_start() method";
+}
+
+void
+DataStoreWriter::do_stop(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_stop() method";
+  thread_.stop_working_thread();
+  ERS_LOG(get_name() << " successfully stopped");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
+}
+
+void
+DataStoreWriter::do_unconfigure(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_unconfigure() method";
+  writerThreadCount_ = REASONABLE_DEFAULT_WRITERTHREADCOUNT;
+  batchSize_ = REASONABLE_DEFAULT_BATCHSIZE;
+  queueTimeoutMsec_ = REASONABLE_DEFAULT_QUEUETIMEOUTMSEC;
+  msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  sharedStoreIsThreadSafe_ = false;
+  dataWriters_.clear();
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_unconfigure() method";
+}
+
+void
+DataStoreWriter::do_work(std::atomic<bool>& running_flag)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
+
+  // ensure that we have a valid dataWriter instance
+  if (dataWriters_.empty()) {
+    throw InvalidDataStoreError(ERS_HERE, get_name(), "writing");
+  }
+
+  batchWriter_.reset(
+    new batch_writer_t(get_name(), *inputQueue_, batchSize_, std::chrono::milliseconds(queueTimeoutMsec_)));
+  batch_writer_t::Statistics& statistics = batchWriter_->getStatistics();
+  std::atomic<bool> workers_running_flag(true);
+  std::vector<std::thread> workers;
+  for (size_t idx = 0; idx < writerThreadCount_; ++idx) {
+    workers.emplace_back(&DataStoreWriter::write_batches, this, idx, std::ref(workers_running_flag));
+  }
+
+  auto reportTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecBetweenReports_);
+  auto intervalStart = std::chrono::steady_clock::now();
+  while (running_flag.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto now = std::chrono::steady_clock::now();
+    if (now >= reportTime) {
+      size_t blocks = statistics.blockCount.exchange(0);
+      size_t bytes = statistics.byteCount.exchange(0);
+      size_t batches = statistics.batchCount.exchange(0);
+      size_t fullBatches = statistics.fullBatchCount.exchange(0);
+      size_t emptyPolls = statistics.emptyPollCount.exchange(0);
+      size_t failedBatches = statistics.failedBatchCount.exchange(0);
+      size_t failedBlocks = statistics.failedBlockCount.exchange(0);
+      double seconds = std::chrono::duration<double>(now - intervalStart).count();
+
+      std::ostringstream oss_prog;
+      oss_prog << ": Wrote " << blocks << " data blocks (" << (bytes / seconds / 1.0e6) << " MB/s) in "
+               << (batches - failedBatches) << " batches; mean batch fill "
+               << ((batches > 0) ? static_cast<double>(blocks + failedBlocks) / batches : 0.0) << " of " << batchSize_
+               << ", " << fullBatches << " full batches (data waiting in the queue), " << emptyPolls
+               << " polls of an empty queue.";
+      if (failedBatches > 0) {
+        oss_prog << " " << failedBatches << " batches with " << failedBlocks << " data blocks could not be written.";
+      }
+      ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_prog.str()));
+      intervalStart = now;
+      reportTime += std::chrono::milliseconds(msecBetweenReports_);
+    }
+  }
+
+  // the writer threads drain the queue before they exit
+  workers_running_flag.store(false);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (auto& dataWriter : dataWriters_) {
+    dataWriter->flush();
+  }
+
+  std::ostringstream oss_summ;
+  oss_summ << ": Exiting the do_work() method, wrote " << statistics.totalBlockCount.load() << " data blocks with "
+           << writerThreadCount_ << " writer threads";
+  if (statistics.totalFailedBlockCount.load() > 0) {
+    oss_summ << "; " << statistics.totalFailedBlockCount.load() << " data blocks could not be written";
+  }
+  oss_summ << ".";
+  ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
+}
+
+void
+DataStoreWriter::write_batches(size_t threadIndex, std::atomic<bool>& workers_running_flag)
+{
+  DataStore& dataWriter = *dataWriters_[(dataWriters_.size() == 1) ? 0 : threadIndex];
+  const bool serializeWrites = (dataWriters_.size() == 1 && writerThreadCount_ > 1 && !sharedStoreIsThreadSafe_);
+
+  TLOG(TLVL_WORK_STEPS) << get_name() << ": Thread " << threadIndex << " writing batches";
+  batchWriter_->run(dataWriter, serializeWrites ? &sharedStoreMutex_ : nullptr, workers_running_flag);
+}
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+DEFINE_DUNE_DAQ_MODULE(dunedaq::ddpdemo::DataStoreWriter)
@@ -0,0 +1,118 @@
+/**
+ * @file DataStoreWriter.hpp
+ *
+ * DataStoreWriter is a DAQModule that takes KeyedDataBlocks from an appfwk
+ * queue and writes them, in batches, to a DataStore.  It separates the storage
+ * stage from the modules that produce the data (e.g. a DataGenerator with an
+ * "output" queue), so that it can be pipelined and scaled on its own.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_SRC_DATASTOREWRITER_HPP_
+#define DDPDEMO_SRC_DATASTOREWRITER_HPP_
+
+#include "QueueBatchWriter.hpp"
+#include "ddpdemo/DataStore.hpp"
+
+#include <appfwk/DAQModule.hpp>
+#include <appfwk/DAQSource.hpp>
+#include <appfwk/ThreadHelper.hpp>
+#include <ers/Issue.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief DataStoreWriter writes the data blocks that arrive on its input queue to a DataStore.
+ */
+class DataStoreWriter : public dunedaq::appfwk::DAQModule
+{
+public:
+  /**
+   * @brief DataStoreWriter Constructor
+   * @param name Instance name for this DataStoreWriter instance
+   */
+  explicit DataStoreWriter(const std::string& name);
+
+  DataStoreWriter(const DataStoreWriter&) = delete;            ///< DataStoreWriter is not copy-constructible
+  DataStoreWriter& operator=(const DataStoreWriter&) = delete; ///< DataStoreWriter is not copy-assignable
+  DataStoreWriter(DataStoreWriter&&) = delete;                 ///< DataStoreWriter is not move-constructible
+  DataStoreWriter& operator=(DataStoreWriter&&) = delete;      ///< DataStoreWriter is not move-assignable
+
+  void init(const data_t&) override;
+
+private:
+  // Commands
+  void do_conf(const data_t&);
+  void do_start(const data_t&);
+  void do_stop(const data_t&);
+  void do_unconfigure(const data_t&);
+
+  // Threading
+  dunedaq::appfwk::ThreadHelper thread_;
+  void do_work(std::atomic<bool>&);
+
+  // Writer threads, each of which takes batches from the queue
+  void write_batches(size_t threadIndex, std::atomic<bool>& workers_running_flag);
+
+  // Configuration defaults
+  const size_t REASONABLE_DEFAULT_WRITERTHREADCOUNT = 1;
+  const size_t REASONABLE_DEFAULT_BATCHSIZE = 16;
+  const size_t REASONABLE_DEFAULT_QUEUETIMEOUTMSEC = 100;
+  const size_t REASONABLE_DEFAULT_MSECBETWEENREPORTS = 10000;
+
+  // Configuration
+  size_t writerThreadCount_ = REASONABLE_DEFAULT_WRITERTHREADCOUNT;
+  size_t batchSize_ = REASONABLE_DEFAULT_BATCHSIZE;
+  size_t queueTimeoutMsec_ = REASONABLE_DEFAULT_QUEUETIMEOUTMSEC;
+  size_t msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  bool sharedStoreIsThreadSafe_ = false;
+
+  // Queue
+  using source_t = dunedaq::appfwk::DAQSource<KeyedDataBlock>;
+  std::unique_ptr<source_t> inputQueue_;
+
+  // Takes the batches from the queue, for all of the writer threads, and
+  // keeps the statistics, which are reported (and reset) periodically.  Since
+  // the queue does not report its depth, the batch fill is reported instead:
+  // full batches mean that data is waiting in the queue, and empty polls that
+  // it is drained.
+  using batch_writer_t = QueueBatchWriter<source_t, dunedaq::appfwk::QueueTimeoutExpired>;
+  std::unique_ptr<batch_writer_t> batchWriter_;
+
+  // Workers.  As in the DataGenerator, there is either one DataStore per
+  // writer thread, or a single shared one.
+  std::vector<std::unique_ptr<DataStore>> dataWriters_;
+  std::mutex sharedStoreMutex_;
+};
+} // namespace ddpdemo
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       ProgressUpdate,
+                       appfwk::GeneralDAQModuleIssue,
+                       message,
+                       ((std::string)name),
+                       ((std::string)message))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidDataStoreError,
+                       appfwk::GeneralDAQModuleIssue,
+                       "A valid dataStore instance is not available for "
+                         << operation
+                         << ", so it will not be possible to write data. A likely cause for this is a skipped or "
+                            "missed Configure transition.",
+                       ((std::string)name),
+                       ((std::string)operation))
+
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_DATASTOREWRITER_HPP_
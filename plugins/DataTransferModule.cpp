@@ -9,16 +9,21 @@
 #include "ddpdemo/datatransfermodule/Nljs.hpp"
 
 #include "DataTransferModule.hpp"
+#include "PrefetchingReader.hpp"
 #include "ddpdemo/DataStore.hpp"
 #include "ddpdemo/KeyedDataBlock.hpp"
 
 #include <TRACE/trace.h>
 #include <ers/ers.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <functional>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 /**
@@ -34,6 +39,13 @@ namespace ddpdemo {
 DataTransferModule::DataTransferModule(const std::string& name)
   : dunedaq::appfwk::DAQModule(name)
   , thread_(std::bind(&DataTransferModule::do_work, this, std::placeholders::_1))
+  , keyCount_(0)
+  , byteCount_(0)
+  , failureCount_(0)
+  , readNanosec_(0)
+  , writeNanosec_(0)
+  , prefetchHitCount_(0)
+  , prefetchMissCount_(0)
 {
   register_command("conf", &DataTransferModule::do_conf);
   register_command("start", &DataTransferModule::do_start);
@@ -56,6 +68,27 @@ DataTransferModule::do_conf(const data_t& payload)
   datatransfermodule::Conf tmpConfig = payload.get<datatransfermodule::Conf>();
 
   sleepMsecWhileRunning_ = tmpConfig.sleep_msec_while_running;
+  readerThreadCount_ = std::max(payload.value<size_t>("reader_thread_count", REASONABLE_DEFAULT_READERTHREADCOUNT),
+                                static_cast<size_t>(1));
+  writerThreadCount_ = std::max(payload.value<size_t>("writer_thread_count", REASONABLE_DEFAULT_WRITERTHREADCOUNT),
+                                static_cast<size_t>(1));
+  batchSize_ = std::max(payload.value<size_t>("batch_size", REASONABLE_DEFAULT_BATCHSIZE), static_cast<size_t>(1));
+  maxInFlightBytes_ = payload.value<size_t>("max_in_flight_bytes", REASONABLE_DEFAULT_MAXINFLIGHTBYTES);
+  prefetchDepth_ = payload.value<size_t>("prefetch_depth", 0);
+  prefetchMaxBytes_ = payload.value<size_t>("prefetch_max_bytes", PrefetchingReader::REASONABLE_DEFAULT_MAX_BYTES);
+  inputStoreIsThreadSafe_ = payload.value<bool>("input_store_is_thread_safe", false);
+  outputStoreIsThreadSafe_ = payload.value<bool>("output_store_is_thread_safe", false);
+  allowNativeCopy_ = payload.value<bool>("allow_native_copy", true);
+  progressFile_ = payload.value<std::string>("progress_file", "");
+  progressSaveIntervalMsec_ =
+    payload.value<size_t>("progress_save_interval_msec", TransferProgress::REASONABLE_DEFAULT_SAVE_INTERVAL_MSEC);
+  followInput_ = payload.value<bool>("follow", false);
+  followDirectory_ = payload["input_data_store_parameters"].value<std::string>("directory_path", ".");
+  followConf_ = payload;
+  combineMode_ = payload.value<std::string>("combine_mode", "copy");
+  if (combineMode_ != "copy" && combineMode_ != "link" && combineMode_ != "materialize") {
+    throw InvalidCombineMode(ERS_HERE, get_name(), combineMode_);
+  }
 
   inputDataStore_ = makeDataStore(payload["input_data_store_parameters"]);
 
@@ -87,6 +120,21 @@ DataTransferModule::do_unconfigure(const data_t& /*args*/)
 {
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_unconfigure() method";
   sleepMsecWhileRunning_ = REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING;
+  readerThreadCount_ = REASONABLE_DEFAULT_READERTHREADCOUNT;
+  writerThreadCount_ = REASONABLE_DEFAULT_WRITERTHREADCOUNT;
+  batchSize_ = REASONABLE_DEFAULT_BATCHSIZE;
+  maxInFlightBytes_ = REASONABLE_DEFAULT_MAXINFLIGHTBYTES;
+  prefetchDepth_ = 0;
+  prefetchMaxBytes_ = PrefetchingReader::REASONABLE_DEFAULT_MAX_BYTES;
+  inputStoreIsThreadSafe_ = false;
+  outputStoreIsThreadSafe_ = false;
+  combineMode_ = "copy";
+  allowNativeCopy_ = true;
+  progressFile_ = "";
+  progressSaveIntervalMsec_ = TransferProgress::REASONABLE_DEFAULT_SAVE_INTERVAL_MSEC;
+  followInput_ = false;
+  followConf_ = nlohmann::json();
+  freeBatches_.clear();
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_unconfigure() method";
 }
 
@@ -103,12 +151,76 @@ DataTransferModule::do_work(std::atomic<bool>& running_flag)
     throw InvalidDataStoreError(ERS_HERE, get_name(), "writing");
   }
 
-  std::vector<StorageKey> keyList = inputDataStore_->getAllExistingKeys();
-  for (auto& key : keyList) {
-    KeyedDataBlock dataBlock = inputDataStore_->read(key);
-    outputDataStore_->write(dataBlock);
+  keyCount_ = 0;
+  byteCount_ = 0;
+  failureCount_ = 0;
+  readNanosec_ = 0;
+  writeNanosec_ = 0;
+  prefetchHitCount_ = 0;
+  prefetchMissCount_ = 0;
+  auto startTime = std::chrono::steady_clock::now();
+
+  linkRefused_ = false;
+  size_t listedCount = 0;
+  size_t skippedCount = 0;
+  if (!progressFile_.empty() && combineMode_ != "materialize") {
+    // data blocks that an earlier (possibly interrupted) transfer completed are skipped
+    progress_.reset(new TransferProgress(progressFile_, progressSaveIntervalMsec_));
+  }
+
+  if (combineMode_ == "materialize") {
+    std::vector<StorageKey> keyList = outputDataStore_->getAllExistingKeys();
+    listedCount = keyList.size();
+    materialize_data(keyList, running_flag);
+  } else if (followInput_) {
+    // the input files are transferred as they are completed, until the run is stopped
+    DirectoryWatcher watcher(followDirectory_, followConf_);
+    while (running_flag.load()) {
+      for (auto& fileName : watcher.waitForCompleteFiles()) {
+        std::vector<StorageKey> keyList;
+        try {
+          keyList = inputDataStore_->getKeysInFile(fileName);
+        } catch (const std::exception& excpt) {
+          ers::warning(FollowedFileUnreadable(ERS_HERE, get_name(), fileName, excpt));
+          watcher.retryLater(fileName);
+          continue;
+        }
+        TLOG(TLVL_WORK_STEPS) << get_name() << ": Found " << keyList.size() << " data blocks in the completed file "
+                              << fileName;
+        listedCount += keyList.size();
+        skippedCount += skip_done(keyList);
+        transfer_data(keyList, running_flag);
+        outputDataStore_->flush();
+      }
+    }
+  } else {
+    std::vector<StorageKey> keyList = inputDataStore_->getAllExistingKeys();
+    listedCount = keyList.size();
+    skippedCount = skip_done(keyList);
+    transfer_data(keyList, running_flag);
+  }
+  outputDataStore_->flush();
+  size_t progressRangeCount = 0;
+  if (progress_.get() != nullptr) {
+    progress_->save();
+    progressRangeCount = progress_->getRangeCount();
+    progress_.reset();
   }
 
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  std::ostringstream oss_prog;
+  oss_prog << ": Transferred " << keyCount_.load() << " of " << listedCount << " data blocks in " << combineMode_
+           << " mode (" << (byteCount_.load() / 1.0e6) << " MB) in " << seconds << " sec, "
+           << ((seconds > 0) ? byteCount_.load() / seconds / 1.0e6 : 0.0) << " MB/s; the " << readerThreadCount_
+           << " readers were busy for " << (readNanosec_.load() / 1.0e9) << " sec and the " << writerThreadCount_
+           << " writers for " << (writeNanosec_.load() / 1.0e9) << " sec, and " << failureCount_.load()
+           << " data blocks failed.";
+  if (!progressFile_.empty() && combineMode_ != "materialize") {
+    oss_prog << " " << skippedCount << " data blocks were skipped, since earlier transfers completed them; the "
+             << "progress record in " << progressFile_ << " holds " << progressRangeCount << " ranges of eventIDs.";
+  }
+  ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_prog.str()));
+
   while (running_flag.load()) {
     TLOG(TLVL_WORK_STEPS) << get_name() << ": Start of sleep while waiting for run Stop";
     std::this_thread::sleep_for(std::chrono::milliseconds(sleepMsecWhileRunning_));
@@ -116,11 +228,330 @@ DataTransferModule::do_work(std::atomic<bool>& running_flag)
   }
 
   std::ostringstream oss_summ;
-  oss_summ << ": Exiting the do_work() method, copied data for " << keyList.size() << " keys.";
+  oss_summ << ": Exiting the do_work() method, copied data for " << keyCount_.load() << " keys.";
   ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
   TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
 }
 
+void
+DataTransferModule::transfer_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag)
+{
+  if (combineMode_ == "link" && !linkRefused_) {
+    if (link_data(keyList, running_flag)) {
+      return;
+    }
+    linkRefused_ = true;
+  }
+  if (allowNativeCopy_ && outputDataStore_->acceptsNativeCopy(*inputDataStore_)) {
+    native_copy_data(keyList, running_flag);
+  } else {
+    copy_data(keyList, running_flag);
+  }
+}
+
+size_t
+DataTransferModule::skip_done(std::vector<StorageKey>& keyList)
+{
+  if (progress_.get() == nullptr) {
+    return 0;
+  }
+  std::vector<StorageKey> pendingKeyList;
+  for (auto& key : keyList) {
+    if (!progress_->isDone(key)) {
+      pendingKeyList.push_back(key);
+    }
+  }
+  size_t skippedCount = keyList.size() - pendingKeyList.size();
+  keyList.swap(pendingKeyList);
+  return skippedCount;
+}
+
+void
+DataTransferModule::copy_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag)
+{
+  // each stage has enough queued batches to keep all of its threads busy
+  BoundedQueue<KeyBatch> keyQueue(2 * readerThreadCount_);
+  BoundedQueue<BlockBatch> blockQueue(2 * writerThreadCount_);
+  std::vector<std::thread> writers;
+  for (size_t idx = 0; idx < writerThreadCount_; ++idx) {
+    writers.emplace_back(&DataTransferModule::write_batches, this, std::ref(blockQueue));
+  }
+
+  if (prefetchDepth_ > 0) {
+    // the reader threads read ahead in key order instead, and this thread batches their data blocks
+    prefetch_batches(keyList, blockQueue, running_flag);
+  } else {
+    std::vector<std::thread> readers;
+    for (size_t idx = 0; idx < readerThreadCount_; ++idx) {
+      readers.emplace_back(&DataTransferModule::read_batches, this, std::ref(keyQueue), std::ref(blockQueue));
+    }
+
+    // the key lister hands out consecutive keys together, so that a batch tends
+    // to stay within one input file (and one output file)
+    for (size_t idx = 0; idx < keyList.size() && running_flag.load(); idx += batchSize_) {
+      KeyBatch keyBatch(keyList.begin() + idx, keyList.begin() + std::min(idx + batchSize_, keyList.size()));
+      keyQueue.push(std::move(keyBatch));
+    }
+
+    // each stage finishes its work before the next one is closed
+    keyQueue.close();
+    for (auto& reader : readers) {
+      reader.join();
+    }
+  }
+  blockQueue.close();
+  for (auto& writer : writers) {
+    writer.join();
+  }
+}
+
+void
+DataTransferModule::native_copy_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag)
+{
+  // the stores copy the data between themselves, so there is nothing to pipeline
+  for (size_t idx = 0; idx < keyList.size() && running_flag.load(); ++idx) {
+    const StorageKey& key = keyList[idx];
+    auto writeStart = std::chrono::steady_clock::now();
+    try {
+      byteCount_ += outputDataStore_->writeNativeCopy(*inputDataStore_, key);
+      ++keyCount_;
+      mark_done(key);
+    } catch (const std::exception& excpt) {
+      ++failureCount_;
+      ers::error(DataTransferFailed(ERS_HERE, get_name(), "copy", key.getEventID(), key.getGeoLocation(), excpt));
+    }
+    save_progress_if_due();
+    writeNanosec_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - writeStart)
+                       .count();
+  }
+}
+
+bool
+DataTransferModule::link_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag)
+{
+  for (size_t idx = 0; idx < keyList.size() && running_flag.load(); ++idx) {
+    const StorageKey& key = keyList[idx];
+    try {
+      if (!outputDataStore_->writeLink(*inputDataStore_, key)) {
+        // the answer depends only on the two stores, so only the first key can be refused
+        ers::warning(LinkedCombineNotSupported(ERS_HERE, get_name()));
+        return false;
+      }
+      ++keyCount_;
+      mark_done(key);
+    } catch (const std::exception& excpt) {
+      ++failureCount_;
+      ers::error(DataTransferFailed(ERS_HERE, get_name(), "link", key.getEventID(), key.getGeoLocation(), excpt));
+    }
+    save_progress_if_due();
+  }
+  return true;
+}
+
+void
+DataTransferModule::materialize_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag)
+{
+  for (size_t idx = 0; idx < keyList.size() && running_flag.load(); ++idx) {
+    const StorageKey& key = keyList[idx];
+    try {
+      // data blocks that are already stored in the output files are left alone
+      if (outputDataStore_->materialize(key)) {
+        ++keyCount_;
+      }
+    } catch (const std::exception& excpt) {
+      ++failureCount_;
+      ers::error(
+        DataTransferFailed(ERS_HERE, get_name(), "materialize", key.getEventID(), key.getGeoLocation(), excpt));
+    }
+  }
+}
+
+void
+DataTransferModule::read_batches(BoundedQueue<KeyBatch>& keyQueue, BoundedQueue<BlockBatch>& blockQueue)
+{
+  KeyBatch keyBatch;
+  while (keyQueue.pop(keyBatch)) {
+    BlockBatch blockBatch = get_free_batch();
+    for (auto& key : keyBatch) {
+      std::unique_lock<std::mutex> inFlightLock(inFlightMutex_);
+      if (inFlightBytes_ >= maxInFlightBytes_ && !blockBatch.empty()) {
+        // the blocks that this reader holds are passed on before it waits, so
+        // that all of the bytes in flight are on their way to a writer
+        inFlightLock.unlock();
+        blockQueue.push(std::move(blockBatch));
+        blockBatch = get_free_batch();
+        inFlightLock.lock();
+      }
+      inFlightCondition_.wait(inFlightLock, [&] { return inFlightBytes_ < maxInFlightBytes_ || inFlightBytes_ == 0; });
+      inFlightLock.unlock();
+
+      auto readStart = std::chrono::steady_clock::now();
+      try {
+        std::unique_lock<std::mutex> storeLock(inputStoreMutex_, std::defer_lock);
+        if (!inputStoreIsThreadSafe_) {
+          storeLock.lock();
+        }
+        blockBatch.push_back(inputDataStore_->read(key));
+      } catch (const std::exception& excpt) {
+        ++failureCount_;
+        ers::error(DataTransferFailed(ERS_HERE, get_name(), "read", key.getEventID(), key.getGeoLocation(), excpt));
+        continue;
+      }
+      readNanosec_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - readStart)
+                        .count();
+
+      inFlightLock.lock();
+      inFlightBytes_ += blockBatch.back().getDataSizeBytes();
+    }
+    if (!blockBatch.empty()) {
+      blockQueue.push(std::move(blockBatch));
+    }
+  }
+}
+
+void
+DataTransferModule::prefetch_batches(const std::vector<StorageKey>& keyList,
+                                     BoundedQueue<BlockBatch>& blockQueue,
+                                     std::atomic<bool>& running_flag)
+{
+  if (keyList.empty()) {
+    return;
+  }
+  PrefetchingReader prefetcher(*inputDataStore_,
+                               keyList,
+                               prefetchDepth_,
+                               prefetchMaxBytes_,
+                               readerThreadCount_,
+                               inputStoreIsThreadSafe_ ? nullptr : &inputStoreMutex_);
+
+  BlockBatch blockBatch = get_free_batch();
+  KeyedDataBlock dataBlock(keyList[0]);
+  for (size_t idx = 0; idx < keyList.size() && running_flag.load(); ++idx) {
+    std::unique_lock<std::mutex> inFlightLock(inFlightMutex_);
+    if (inFlightBytes_ >= maxInFlightBytes_ && !blockBatch.empty()) {
+      inFlightLock.unlock();
+      blockQueue.push(std::move(blockBatch));
+      blockBatch = get_free_batch();
+      inFlightLock.lock();
+    }
+    inFlightCondition_.wait(inFlightLock, [&] { return inFlightBytes_ < maxInFlightBytes_ || inFlightBytes_ == 0; });
+    inFlightLock.unlock();
+
+    try {
+      prefetcher.next(dataBlock);
+    } catch (const std::exception& excpt) {
+      ++failureCount_;
+      const StorageKey& key = keyList[idx];
+      ers::error(DataTransferFailed(ERS_HERE, get_name(), "read", key.getEventID(), key.getGeoLocation(), excpt));
+      continue;
+    }
+
+    inFlightLock.lock();
+    inFlightBytes_ += dataBlock.getDataSizeBytes();
+    inFlightLock.unlock();
+    blockBatch.push_back(std::move(dataBlock));
+    if (blockBatch.size() >= batchSize_) {
+      blockQueue.push(std::move(blockBatch));
+      blockBatch = get_free_batch();
+    }
+  }
+  if (!blockBatch.empty()) {
+    blockQueue.push(std::move(blockBatch));
+  }
+
+  readNanosec_ += prefetcher.getReadNanosec();
+  prefetchHitCount_ += prefetcher.getHitCount();
+  prefetchMissCount_ += prefetcher.getMissCount();
+}
+
+void
+DataTransferModule::write_batches(BoundedQueue<BlockBatch>& blockQueue)
+{
+  BlockBatch blockBatch;
+  while (blockQueue.pop(blockBatch)) {
+    size_t bytes = 0;
+    for (auto& dataBlock : blockBatch) {
+      bytes += dataBlock.getDataSizeBytes();
+    }
+    TLOG(TLVL_WORK_STEPS) << get_name() << ": Writing a batch of " << blockBatch.size() << " data blocks";
+
+    auto writeStart = std::chrono::steady_clock::now();
+    try {
+      std::unique_lock<std::mutex> storeLock(outputStoreMutex_, std::defer_lock);
+      if (!outputStoreIsThreadSafe_) {
+        storeLock.lock();
+      }
+      outputDataStore_->write(blockBatch);
+      keyCount_ += blockBatch.size();
+      byteCount_ += bytes;
+      for (auto& dataBlock : blockBatch) {
+        mark_done(dataBlock.data_key);
+      }
+    } catch (const std::exception& excpt) {
+      failureCount_ += blockBatch.size();
+      ers::error(DataTransferFailed(ERS_HERE, get_name(), "write", blockBatch[0].data_key.getEventID(),
+                                    blockBatch[0].data_key.getGeoLocation(), excpt));
+    }
+    writeNanosec_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - writeStart)
+                       .count();
+
+    release_batch(std::move(blockBatch), bytes);
+    save_progress_if_due();
+  }
+}
+
+void
+DataTransferModule::mark_done(const StorageKey& key)
+{
+  if (progress_.get() != nullptr) {
+    progress_->markDone(key);
+  }
+}
+
+void
+DataTransferModule::save_progress_if_due()
+{
+  if (progress_.get() != nullptr && progress_->isSaveDue()) {
+    // the record is taken before the output is flushed, and saved after it, so
+    // that it never runs ahead of the data, even while other threads keep
+    // writing (and marking their data blocks as done) during the flush
+    TransferProgress::Snapshot snapshot = progress_->takeSnapshot();
+    {
+      std::unique_lock<std::mutex> storeLock(outputStoreMutex_, std::defer_lock);
+      if (!outputStoreIsThreadSafe_) {
+        storeLock.lock();
+      }
+      outputDataStore_->flush();
+    }
+    progress_->save(snapshot);
+  }
+}
+
+DataTransferModule::BlockBatch
+DataTransferModule::get_free_batch()
+{
+  std::lock_guard<std::mutex> lock(inFlightMutex_);
+  BlockBatch batch;
+  if (freeBatches_.empty()) {
+    batch.reserve(batchSize_);
+  } else {
+    batch = std::move(freeBatches_.back());
+    freeBatches_.pop_back();
+  }
+  return batch;
+}
+
+void
+DataTransferModule::release_batch(BlockBatch&& batch, size_t bytes)
+{
+  // clearing the batch releases the payloads, but keeps its capacity for the next one
+  batch.clear();
+  std::lock_guard<std::mutex> lock(inFlightMutex_);
+  inFlightBytes_ -= bytes;
+  freeBatches_.push_back(std::move(batch));
+  inFlightCondition_.notify_all();
+}
+
 } // namespace ddpdemo
 } // namespace dunedaq
 
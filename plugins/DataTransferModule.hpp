@@ -2,7 +2,17 @@
  * @file DataTransferModule.hpp
  *
  * DataTransferModule is a simple module that transfers data from
- * one DataStore to another.
+ * one DataStore to another.  The transfer is a pipeline: the list of keys
+ * is handed out in batches to reader threads, and the data blocks that they
+ * read are handed to writer threads, through bounded queues, so that reading
+ * and writing overlap.  Alternatively, the output can refer to the input
+ * data instead of copying it (e.g. with HDF5 external links), and those
+ * references can later be replaced by copies.  Stores that can copy data
+ * between themselves natively (e.g. two HDF5DataStores) do so instead.
+ * Optionally, the completed data blocks are recorded in a file, and skipped
+ * by later transfers, and the input directory is followed, so that new files
+ * are transferred as soon as they are complete.  The reads can also be
+ * issued ahead of the writers, in key order, by a PrefetchingReader.
  *
  * This is part of the DUNE DAQ Software Suite, copyright 2020.
  * Licensing/copyright details are in the COPYING file that you should have
@@ -12,13 +22,19 @@
 #ifndef DDPDEMO_SRC_DATATRANSFERMODULE_HPP_
 #define DDPDEMO_SRC_DATATRANSFERMODULE_HPP_
 
+#include "BoundedQueue.hpp"
+#include "DirectoryWatcher.hpp"
+#include "TransferProgress.hpp"
 #include "ddpdemo/DataStore.hpp"
 
 #include <appfwk/DAQModule.hpp>
 #include <appfwk/ThreadHelper.hpp>
 #include <ers/Issue.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -55,15 +71,79 @@ private:
   dunedaq::appfwk::ThreadHelper thread_;
   void do_work(std::atomic<bool>&);
 
+  // Transfer modes
+  void transfer_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag);
+  size_t skip_done(std::vector<StorageKey>& keyList);
+  void copy_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag);
+  void native_copy_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag);
+  bool link_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag);
+  void materialize_data(const std::vector<StorageKey>& keyList, std::atomic<bool>& running_flag);
+
+  // Pipeline stages
+  using KeyBatch = std::vector<StorageKey>;
+  using BlockBatch = std::vector<KeyedDataBlock>;
+  void read_batches(BoundedQueue<KeyBatch>& keyQueue, BoundedQueue<BlockBatch>& blockQueue);
+  void prefetch_batches(const std::vector<StorageKey>& keyList,
+                        BoundedQueue<BlockBatch>& blockQueue,
+                        std::atomic<bool>& running_flag);
+  void write_batches(BoundedQueue<BlockBatch>& blockQueue);
+  void mark_done(const StorageKey& key);
+  void save_progress_if_due();
+  BlockBatch get_free_batch();
+  void release_batch(BlockBatch&& batch, size_t bytes);
+
   // Configuration defaults
   const size_t REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING = 1000;
+  const size_t REASONABLE_DEFAULT_READERTHREADCOUNT = 1;
+  const size_t REASONABLE_DEFAULT_WRITERTHREADCOUNT = 1;
+  const size_t REASONABLE_DEFAULT_BATCHSIZE = 16;
+  const size_t REASONABLE_DEFAULT_MAXINFLIGHTBYTES = 268435456;
 
   // Configuration
   size_t sleepMsecWhileRunning_ = REASONABLE_DEFAULT_SLEEPMSECWHILERUNNING;
-
-  // Workers
+  size_t readerThreadCount_ = REASONABLE_DEFAULT_READERTHREADCOUNT;
+  size_t writerThreadCount_ = REASONABLE_DEFAULT_WRITERTHREADCOUNT;
+  size_t batchSize_ = REASONABLE_DEFAULT_BATCHSIZE;
+  size_t maxInFlightBytes_ = REASONABLE_DEFAULT_MAXINFLIGHTBYTES;
+  size_t prefetchDepth_ = 0;
+  size_t prefetchMaxBytes_ = 0;
+  bool inputStoreIsThreadSafe_ = false;
+  bool outputStoreIsThreadSafe_ = false;
+  std::string combineMode_ = "copy";
+  bool allowNativeCopy_ = true;
+  std::string progressFile_;
+  size_t progressSaveIntervalMsec_ = TransferProgress::REASONABLE_DEFAULT_SAVE_INTERVAL_MSEC;
+  bool followInput_ = false;
+  std::string followDirectory_;
+  nlohmann::json followConf_;
+  bool linkRefused_ = false;
+
+  // Workers.  Unless the stores are known to be thread-safe, the readers (and
+  // the writers) take turns with their store, but reading still overlaps writing.
   std::unique_ptr<DataStore> inputDataStore_;
   std::unique_ptr<DataStore> outputDataStore_;
+  std::mutex inputStoreMutex_;
+  std::mutex outputStoreMutex_;
+
+  // The bytes that have been read but not yet written, which the readers keep
+  // below the in-flight limit, and the batch containers that the writers have
+  // finished with, which the readers reuse.
+  std::mutex inFlightMutex_;
+  std::condition_variable inFlightCondition_;
+  size_t inFlightBytes_ = 0;
+  std::vector<BlockBatch> freeBatches_;
+
+  // The record of the completed data blocks, when one is kept
+  std::unique_ptr<TransferProgress> progress_;
+
+  // Statistics
+  std::atomic<size_t> keyCount_;
+  std::atomic<size_t> byteCount_;
+  std::atomic<size_t> failureCount_;
+  std::atomic<uint64_t> readNanosec_;
+  std::atomic<uint64_t> writeNanosec_;
+  std::atomic<size_t> prefetchHitCount_;
+  std::atomic<size_t> prefetchMissCount_;
 };
 } // namespace ddpdemo
 
@@ -84,6 +164,37 @@ ERS_DECLARE_ISSUE_BASE(ddpdemo,
                        ((std::string)name),
                        ((std::string)operation))
 
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidCombineMode,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The combine mode \"" << mode
+                                              << "\" is not supported; the supported modes are \"copy\", \"link\" and "
+                                                 "\"materialize\".",
+                       ((std::string)name),
+                       ((std::string)mode))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       LinkedCombineNotSupported,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The output DataStore can not refer to data in the input DataStore, so the data will be copied.",
+                       ((std::string)name),
+                       ERS_EMPTY)
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       FollowedFileUnreadable,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The keys in the file " << filename << " could not be listed yet; it will be tried again.",
+                       ((std::string)name),
+                       ((std::string)filename))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       DataTransferFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Failed to " << operation << " the data block with eventID " << eventID << " and geoLocation "
+                                    << geoLocation << ".",
+                       ((std::string)name),
+                       ((std::string)operation)((int)eventID)((int)geoLocation))
+
 } // namespace dunedaq
 
 #endif // DDPDEMO_SRC_DATATRANSFERMODULE_HPP_
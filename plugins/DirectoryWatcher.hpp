@@ -0,0 +1,261 @@
+#ifndef DDPDEMO_SRC_DIRECTORYWATCHER_HPP_
+#define DDPDEMO_SRC_DIRECTORYWATCHER_HPP_
+/**
+ * @file DirectoryWatcher.hpp
+ *
+ * DirectoryWatcher reports the files in a directory as they become complete,
+ * so that they can be processed while the files that follow them are still
+ * being written.  It uses inotify to hear about new files with low latency,
+ * and falls back to rescanning the directory where inotify is not available
+ * (e.g. on network filesystems).
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <ers/Issue.h>
+#include <nlohmann/json.hpp>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  InvalidCompletenessRule,
+                  "The completeness rule \"" << rule
+                                             << "\" is not supported; the supported rules are \"close\", \"marker\" "
+                                                "and \"settle\".",
+                  ((std::string)rule))
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  DirectoryWatchUnavailable,
+                  "The directory \"" << directory << "\" can not be watched with inotify, so it will be rescanned every "
+                                     << interval << " msec instead.",
+                  ((std::string)directory)((size_t)interval))
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  DirectoryWatchOverflow,
+                  "The inotify event queue of the directory \""
+                    << directory << "\" overflowed, so files that have not been reported yet are complete once they are "
+                    << settleTime << " msec old.",
+                  ((std::string)directory)((size_t)settleTime))
+
+namespace ddpdemo {
+
+/**
+ * @brief DirectoryWatcher reports the files in a directory that are complete.
+ *
+ * The supported completeness rules are:
+ *   "close":  a file is complete when it has been closed after being written
+ *             (or renamed into the directory); files that already exist when
+ *             the watch starts are complete once they are "settle_msec" old,
+ *             and so are the files whose events may have been lost when the
+ *             inotify event queue overflowed
+ *   "marker": a file is complete when a marker file, with the same name plus
+ *             "marker_suffix", exists next to it
+ *   "settle": a file is complete when it has not been modified for "settle_msec"
+ * Without inotify, "close" behaves like "settle".
+ */
+class DirectoryWatcher
+{
+public:
+  enum class Rule
+  {
+    Close,
+    Marker,
+    Settle
+  };
+
+  static constexpr size_t REASONABLE_DEFAULT_SETTLE_MSEC = 5000;
+  static constexpr size_t REASONABLE_DEFAULT_POLL_MSEC = 1000;
+
+  DirectoryWatcher(const std::string& directoryPath, const nlohmann::json& conf)
+    : directoryPath_(directoryPath)
+    , inotifyFD_(-1)
+    , overflowReported_(false)
+  {
+    std::string ruleName = conf.value<std::string>("completeness_rule", "close");
+    if (ruleName == "close") {
+      rule_ = Rule::Close;
+    } else if (ruleName == "marker") {
+      rule_ = Rule::Marker;
+    } else if (ruleName == "settle") {
+      rule_ = Rule::Settle;
+    } else {
+      throw InvalidCompletenessRule(ERS_HERE, ruleName);
+    }
+    markerSuffix_ = conf.value<std::string>("marker_suffix", ".done");
+    settleTime_ = std::chrono::milliseconds(conf.value<size_t>("settle_msec", REASONABLE_DEFAULT_SETTLE_MSEC));
+    pollInterval_ = std::chrono::milliseconds(conf.value<size_t>("follow_poll_msec", REASONABLE_DEFAULT_POLL_MSEC));
+
+    if (conf.value<bool>("use_inotify", true)) {
+      inotifyFD_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (inotifyFD_ >= 0 &&
+          inotify_add_watch(inotifyFD_, directoryPath_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotifyFD_);
+        inotifyFD_ = -1;
+      }
+      if (inotifyFD_ < 0) {
+        ers::warning(DirectoryWatchUnavailable(ERS_HERE, directoryPath_, pollInterval_.count()));
+      }
+    }
+
+    // the files that are already there may be half-written, too
+    for (const auto& entry : std::filesystem::directory_iterator(directoryPath_)) {
+      settleFiles_.insert(entry.path().filename().string());
+    }
+  }
+
+  ~DirectoryWatcher()
+  {
+    if (inotifyFD_ >= 0) {
+      close(inotifyFD_);
+    }
+  }
+
+  DirectoryWatcher(const DirectoryWatcher&) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  bool isUsingInotify() const { return inotifyFD_ >= 0; }
+
+  /**
+   * @brief Waits (for at most the poll interval) for files to become complete,
+   * and returns the full names of those that have.  Each file is reported once.
+   */
+  std::vector<std::string> waitForCompleteFiles()
+  {
+    if (inotifyFD_ >= 0) {
+      // a file event ends the wait early; the timeout still lets the age-based rules progress
+      struct pollfd pollDescriptor = { inotifyFD_, POLLIN, 0 };
+      if (poll(&pollDescriptor, 1, pollInterval_.count()) > 0) {
+        readEvents_();
+      }
+    } else {
+      std::this_thread::sleep_for(pollInterval_);
+    }
+    return scan_();
+  }
+
+  /**
+   * @brief Reports the specified file again, once it is complete according to
+   * the rule (e.g. when it could not be read yet).
+   */
+  void retryLater(const std::string& fullFileName)
+  {
+    const std::string fileName = std::filesystem::path(fullFileName).filename().string();
+    if (reportedFiles_.erase(fileName) > 0) {
+      closedFiles_.insert(fileName);
+    }
+  }
+
+private:
+  void readEvents_()
+  {
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    bool overflowed = false;
+    while ((length = read(inotifyFD_, buffer, sizeof(buffer))) > 0) {
+      for (char* ptr = buffer; ptr < buffer + length;) {
+        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+        if (event->mask & IN_Q_OVERFLOW) {
+          overflowed = true;
+        } else if (event->len > 0 && (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+          closedFiles_.insert(event->name);
+        }
+        ptr += sizeof(struct inotify_event) + event->len;
+      }
+    }
+
+    // the close events of any of the files that have not been reported may have been lost
+    if (overflowed) {
+      if (!overflowReported_) {
+        ers::warning(DirectoryWatchOverflow(ERS_HERE, directoryPath_, settleTime_.count()));
+        overflowReported_ = true;
+      }
+      for (const auto& entry : std::filesystem::directory_iterator(directoryPath_)) {
+        const std::string fileName = entry.path().filename().string();
+        if (reportedFiles_.count(fileName) == 0) {
+          settleFiles_.insert(fileName);
+        }
+      }
+    }
+  }
+
+  bool isComplete_(const std::filesystem::directory_entry& entry, const std::string& fileName) const
+  {
+    auto isSettled = [&]() {
+      auto age = std::filesystem::file_time_type::clock::now() - entry.last_write_time();
+      return age >= settleTime_;
+    };
+    switch (rule_) {
+      case Rule::Marker:
+        return std::filesystem::exists(entry.path().string() + markerSuffix_);
+      case Rule::Settle:
+        return isSettled();
+      default:
+        if (inotifyFD_ < 0) {
+          return isSettled();
+        }
+        if (closedFiles_.count(fileName) > 0) {
+          return true;
+        }
+        return settleFiles_.count(fileName) > 0 && isSettled();
+    }
+  }
+
+  std::vector<std::string> scan_()
+  {
+    std::vector<std::string> completeFiles;
+    for (const auto& entry : std::filesystem::directory_iterator(directoryPath_)) {
+      const std::string fileName = entry.path().filename().string();
+      if (!entry.is_regular_file() || reportedFiles_.count(fileName) > 0) {
+        continue;
+      }
+      if (rule_ == Rule::Marker && fileName.size() > markerSuffix_.size() &&
+          fileName.compare(fileName.size() - markerSuffix_.size(), markerSuffix_.size(), markerSuffix_) == 0) {
+        continue;
+      }
+      if (isComplete_(entry, fileName)) {
+        reportedFiles_.insert(fileName);
+        closedFiles_.erase(fileName);
+        settleFiles_.erase(fileName);
+        completeFiles.push_back(entry.path().string());
+      }
+    }
+    std::sort(completeFiles.begin(), completeFiles.end());
+    return completeFiles;
+  }
+
+  std::string directoryPath_;
+  Rule rule_;
+  std::string markerSuffix_;
+  std::chrono::milliseconds settleTime_;
+  std::chrono::milliseconds pollInterval_;
+  int inotifyFD_;
+  bool overflowReported_;
+
+  // files whose close events may not have been seen, which are complete once they have settled
+  std::set<std::string> settleFiles_;
+  std::set<std::string> closedFiles_;
+  std::set<std::string> reportedFiles_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_DIRECTORYWATCHER_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
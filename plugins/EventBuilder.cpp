@@ -0,0 +1,267 @@
+/**
+ * @file EventBuilder.cpp EventBuilder class implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "EventBuilder.hpp"
+
+#include <appfwk/cmd/Nljs.hpp>
+
+#include <TRACE/trace.h>
+#include <ers/ers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Name used by TRACE TLOG calls from this source file
+ */
+#define TRACE_NAME "EventBuilder"  // NOLINT
+#define TLVL_ENTER_EXIT_METHODS 10 // NOLINT
+#define TLVL_WORK_STEPS 15         // NOLINT
+
+namespace dunedaq {
+namespace ddpdemo {
+
+EventBuilder::EventBuilder(const std::string& name)
+  : dunedaq::appfwk::DAQModule(name)
+  , thread_(std::bind(&EventBuilder::do_work, this, std::placeholders::_1))
+  , fragmentCount_(0)
+  , duplicateCount_(0)
+  , lateCount_(0)
+  , completeEventCount_(0)
+  , incompleteEventCount_(0)
+  , maxHeldBytes_(0)
+  , totalEventCount_(0)
+{
+  register_command("conf", &EventBuilder::do_conf);
+  register_command("start", &EventBuilder::do_start);
+  register_command("stop", &EventBuilder::do_stop);
+  register_command("unconfigure", &EventBuilder::do_unconfigure);
+}
+
+void
+EventBuilder::init(const data_t& init_data)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering init() method";
+  auto qi = appfwk::qindex(init_data, { "input" });
+  inputQueue_.reset(new source_t(qi["input"].inst));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
+}
+
+void
+EventBuilder::do_conf(const data_t& args)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_conf() method";
+  expectedGeoLocationCount_ = std::max(
+    args.value<size_t>("expected_geo_location_count", REASONABLE_DEFAULT_EXPECTEDGEOLOCATIONCOUNT), static_cast<size_t>(1));
+  eventTimeoutMsec_ = args.value<size_t>("event_timeout_msec", REASONABLE_DEFAULT_EVENTTIMEOUTMSEC);
+  builderThreadCount_ = std::max(args.value<size_t>("builder_thread_count", REASONABLE_DEFAULT_BUILDERTHREADCOUNT),
+                                 static_cast<size_t>(1));
+  shardCount_ = std::max(args.value<size_t>("shard_count", REASONABLE_DEFAULT_SHARDCOUNT), static_cast<size_t>(1));
+  closedEventCount_ = args.value<size_t>("closed_event_count", REASONABLE_DEFAULT_CLOSEDEVENTCOUNT);
+  queueTimeoutMsec_ = args.value<size_t>("queue_timeout_msec", REASONABLE_DEFAULT_QUEUETIMEOUTMSEC);
+  msecBetweenReports_ = args.value<size_t>("msec_between_reports", REASONABLE_DEFAULT_MSECBETWEENREPORTS);
+  outputStoreIsThreadSafe_ = args.value<bool>("output_store_is_thread_safe", false);
+
+  dataWriter_ = makeDataStore(args["data_store_parameters"]);
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
+}
+
+void
+EventBuilder::do_start(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_start() method";
+  thread_.start_working_thread();
+  ERS_LOG(get_name() << " successfully started");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_start() method";
+}
+
+void
+EventBuilder::do_stop(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_stop() method";
+  thread_.stop_working_thread();
+  ERS_LOG(get_name() << " successfully stopped");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
+}
+
+void
+EventBuilder::do_unconfigure(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_unconfigure() method";
+  expectedGeoLocationCount_ = REASONABLE_DEFAULT_EXPECTEDGEOLOCATIONCOUNT;
+  eventTimeoutMsec_ = REASONABLE_DEFAULT_EVENTTIMEOUTMSEC;
+  builderThreadCount_ = REASONABLE_DEFAULT_BUILDERTHREADCOUNT;
+  shardCount_ = REASONABLE_DEFAULT_SHARDCOUNT;
+  closedEventCount_ = REASONABLE_DEFAULT_CLOSEDEVENTCOUNT;
+  queueTimeoutMsec_ = REASONABLE_DEFAULT_QUEUETIMEOUTMSEC;
+  msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  outputStoreIsThreadSafe_ = false;
+  dataWriter_.reset();
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_unconfigure() method";
+}
+
+void
+EventBuilder::do_work(std::atomic<bool>& running_flag)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
+
+  // ensure that we have a valid dataWriter instance
+  if (dataWriter_.get() == nullptr) {
+    throw InvalidDataStoreError(ERS_HERE, get_name(), "writing");
+  }
+
+  partialEvents_.reset(new PartialEventTable(expectedGeoLocationCount_, shardCount_, closedEventCount_));
+  completionLatencies_.reset(new LatencyHistogram);
+  totalEventCount_ = 0;
+  maxHeldBytes_ = 0;
+  std::atomic<bool> builders_running_flag(true);
+  std::vector<std::thread> builders;
+  for (size_t idx = 0; idx < builderThreadCount_; ++idx) {
+    builders.emplace_back(&EventBuilder::build_events, this, std::ref(builders_running_flag));
+  }
+
+  // the timeouts are checked a few times per timeout period, which bounds the
+  // time that is spent scanning the table
+  const std::chrono::milliseconds eventTimeout(eventTimeoutMsec_);
+  const std::chrono::milliseconds sweepInterval(std::max(eventTimeoutMsec_ / 8, static_cast<size_t>(10)));
+  auto sweepTime = std::chrono::steady_clock::now() + sweepInterval;
+  auto reportTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecBetweenReports_);
+  auto intervalStart = std::chrono::steady_clock::now();
+  std::vector<PartialEventTable::Event> expiredEvents;
+  while (running_flag.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto now = std::chrono::steady_clock::now();
+    if (now >= sweepTime) {
+      expiredEvents.clear();
+      partialEvents_->takeExpired(now - eventTimeout, expiredEvents);
+      for (auto& event : expiredEvents) {
+        write_event(event, false);
+      }
+      sweepTime = now + sweepInterval;
+    }
+    if (now >= reportTime) {
+      size_t fragments = fragmentCount_.exchange(0);
+      size_t duplicates = duplicateCount_.exchange(0);
+      size_t lateFragments = lateCount_.exchange(0);
+      size_t completeEvents = completeEventCount_.exchange(0);
+      size_t incompleteEvents = incompleteEventCount_.exchange(0);
+      size_t maxHeldBytes = maxHeldBytes_.exchange(partialEvents_->getHeldBytes());
+      double seconds = std::chrono::duration<double>(now - intervalStart).count();
+
+      std::ostringstream oss_prog;
+      oss_prog << ": Received " << fragments << " fragments (" << (fragments / seconds) << " Hz, " << duplicates
+               << " duplicates, " << lateFragments << " late), wrote " << completeEvents << " complete and "
+               << incompleteEvents << " timed-out events; " << partialEvents_->getEventCount()
+               << " partial events hold " << partialEvents_->getHeldBytes() << " bytes (at most " << maxHeldBytes
+               << " since the last report); time to completion p50 "
+               << (completionLatencies_->getValueAtPercentile(50.0) / 1.0e6) << " msec, p99 "
+               << (completionLatencies_->getValueAtPercentile(99.0) / 1.0e6) << " msec.";
+      ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_prog.str()));
+      intervalStart = now;
+      reportTime += std::chrono::milliseconds(msecBetweenReports_);
+    }
+  }
+
+  // the builder threads drain the queue before they exit, and whatever is
+  // still incomplete after that is written as it is
+  builders_running_flag.store(false);
+  for (auto& builder : builders) {
+    builder.join();
+  }
+  expiredEvents.clear();
+  partialEvents_->takeAll(expiredEvents);
+  for (auto& event : expiredEvents) {
+    write_event(event, false);
+  }
+  dataWriter_->flush();
+
+  std::ostringstream oss_summ;
+  oss_summ << ": Exiting the do_work() method, wrote " << totalEventCount_.load() << " events ("
+           << completionLatencies_->getCount() << " complete) with " << builderThreadCount_
+           << " builder threads; time to completion " << completionLatencies_->toJson().dump() << ".";
+  ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
+}
+
+void
+EventBuilder::build_events(std::atomic<bool>& builders_running_flag)
+{
+  const std::chrono::milliseconds queueTimeout(queueTimeoutMsec_);
+  PartialEventTable::Event completedEvent;
+  while (true) {
+    KeyedDataBlock dataBlock(
+      StorageKey(StorageKey::INVALID_EVENTID, StorageKey::INVALID_DETECTORID, StorageKey::INVALID_GEOLOCATION));
+    try {
+      inputQueue_->pop(dataBlock, queueTimeout);
+    } catch (const dunedaq::appfwk::QueueTimeoutExpired&) {
+      if (!builders_running_flag.load()) {
+        break;
+      }
+      continue;
+    }
+
+    ++fragmentCount_;
+    auto result = partialEvents_->add(std::move(dataBlock), completedEvent);
+    if (result == PartialEventTable::AddResult::Duplicate) {
+      ++duplicateCount_;
+    } else if (result == PartialEventTable::AddResult::Late) {
+      ++lateCount_;
+    } else if (result == PartialEventTable::AddResult::Completed) {
+      write_event(completedEvent, true);
+    } else {
+      size_t heldBytes = partialEvents_->getHeldBytes();
+      size_t maxHeldBytes = maxHeldBytes_.load(std::memory_order_relaxed);
+      while (heldBytes > maxHeldBytes && !maxHeldBytes_.compare_exchange_weak(maxHeldBytes, heldBytes)) {
+      }
+    }
+  }
+}
+
+void
+EventBuilder::write_event(PartialEventTable::Event& event, bool complete)
+{
+  if (complete) {
+    auto latency = std::chrono::steady_clock::now() - event.firstArrival;
+    completionLatencies_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    ++completeEventCount_;
+  } else {
+    ers::warning(
+      IncompleteEvent(ERS_HERE, get_name(), event.eventID, event.fragments.size(), expectedGeoLocationCount_));
+    ++incompleteEventCount_;
+  }
+  ++totalEventCount_;
+
+  // the fragments are written in geoLocation order, whatever order they arrived in
+  std::sort(event.fragments.begin(), event.fragments.end(), [](const KeyedDataBlock& lhs, const KeyedDataBlock& rhs) {
+    return lhs.data_key.getGeoLocation() < rhs.data_key.getGeoLocation();
+  });
+  TLOG(TLVL_WORK_STEPS) << get_name() << ": Writing event " << event.eventID << " with " << event.fragments.size()
+                        << " fragments";
+  try {
+    if (outputStoreIsThreadSafe_) {
+      dataWriter_->write(event.fragments);
+    } else {
+      std::lock_guard<std::mutex> lock(outputMutex_);
+      dataWriter_->write(event.fragments);
+    }
+  } catch (const ers::Issue& excpt) {
+    ers::error(EventWriteFailed(ERS_HERE, get_name(), event.eventID, event.fragments.size(), excpt));
+  }
+  event.fragments.clear();
+}
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+DEFINE_DUNE_DAQ_MODULE(dunedaq::ddpdemo::EventBuilder)
@@ -0,0 +1,146 @@
+/**
+ * @file EventBuilder.hpp
+ *
+ * EventBuilder is a DAQModule that takes fragments (KeyedDataBlocks) from an
+ * appfwk queue, in any order, and assembles them into events.  An event is
+ * written to the output DataStore, as a single batch, as soon as it has a
+ * fragment from every expected geoLocation, or when it has waited longer than
+ * the event timeout.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_SRC_EVENTBUILDER_HPP_
+#define DDPDEMO_SRC_EVENTBUILDER_HPP_
+
+#include "PartialEventTable.hpp"
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/DataStoreStatistics.hpp"
+
+#include <appfwk/DAQModule.hpp>
+#include <appfwk/DAQSource.hpp>
+#include <appfwk/ThreadHelper.hpp>
+#include <ers/Issue.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief EventBuilder assembles the fragments that arrive on its input queue into events.
+ */
+class EventBuilder : public dunedaq::appfwk::DAQModule
+{
+public:
+  /**
+   * @brief EventBuilder Constructor
+   * @param name Instance name for this EventBuilder instance
+   */
+  explicit EventBuilder(const std::string& name);
+
+  EventBuilder(const EventBuilder&) = delete;            ///< EventBuilder is not copy-constructible
+  EventBuilder& operator=(const EventBuilder&) = delete; ///< EventBuilder is not copy-assignable
+  EventBuilder(EventBuilder&&) = delete;                 ///< EventBuilder is not move-constructible
+  EventBuilder& operator=(EventBuilder&&) = delete;      ///< EventBuilder is not move-assignable
+
+  void init(const data_t&) override;
+
+private:
+  // Commands
+  void do_conf(const data_t&);
+  void do_start(const data_t&);
+  void do_stop(const data_t&);
+  void do_unconfigure(const data_t&);
+
+  // Threading
+  dunedaq::appfwk::ThreadHelper thread_;
+  void do_work(std::atomic<bool>&);
+
+  // Builder threads, each of which takes fragments from the queue
+  void build_events(std::atomic<bool>& builders_running_flag);
+
+  // Writes an event (complete or not) to the output store
+  void write_event(PartialEventTable::Event& event, bool complete);
+
+  // Configuration defaults
+  const size_t REASONABLE_DEFAULT_EXPECTEDGEOLOCATIONCOUNT = 10;
+  const size_t REASONABLE_DEFAULT_EVENTTIMEOUTMSEC = 5000;
+  const size_t REASONABLE_DEFAULT_BUILDERTHREADCOUNT = 1;
+  const size_t REASONABLE_DEFAULT_SHARDCOUNT = PartialEventTable::REASONABLE_DEFAULT_SHARD_COUNT;
+  const size_t REASONABLE_DEFAULT_CLOSEDEVENTCOUNT = PartialEventTable::REASONABLE_DEFAULT_CLOSED_EVENT_COUNT;
+  const size_t REASONABLE_DEFAULT_QUEUETIMEOUTMSEC = 100;
+  const size_t REASONABLE_DEFAULT_MSECBETWEENREPORTS = 10000;
+
+  // Configuration
+  size_t expectedGeoLocationCount_ = REASONABLE_DEFAULT_EXPECTEDGEOLOCATIONCOUNT;
+  size_t eventTimeoutMsec_ = REASONABLE_DEFAULT_EVENTTIMEOUTMSEC;
+  size_t builderThreadCount_ = REASONABLE_DEFAULT_BUILDERTHREADCOUNT;
+  size_t shardCount_ = REASONABLE_DEFAULT_SHARDCOUNT;
+  size_t closedEventCount_ = REASONABLE_DEFAULT_CLOSEDEVENTCOUNT;
+  size_t queueTimeoutMsec_ = REASONABLE_DEFAULT_QUEUETIMEOUTMSEC;
+  size_t msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  bool outputStoreIsThreadSafe_ = false;
+
+  // Queue
+  using source_t = dunedaq::appfwk::DAQSource<KeyedDataBlock>;
+  std::unique_ptr<source_t> inputQueue_;
+
+  // Workers
+  std::unique_ptr<DataStore> dataWriter_;
+  std::mutex outputMutex_;
+  std::unique_ptr<PartialEventTable> partialEvents_;
+
+  // Statistics.  The counts are reported (and reset) periodically; the time
+  // from the first fragment of an event to its completion is accumulated over the run.
+  std::atomic<size_t> fragmentCount_;
+  std::atomic<size_t> duplicateCount_;
+  std::atomic<size_t> lateCount_;
+  std::atomic<size_t> completeEventCount_;
+  std::atomic<size_t> incompleteEventCount_;
+  std::atomic<size_t> maxHeldBytes_;
+  std::atomic<size_t> totalEventCount_;
+  std::unique_ptr<LatencyHistogram> completionLatencies_;
+};
+} // namespace ddpdemo
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       ProgressUpdate,
+                       appfwk::GeneralDAQModuleIssue,
+                       message,
+                       ((std::string)name),
+                       ((std::string)message))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidDataStoreError,
+                       appfwk::GeneralDAQModuleIssue,
+                       "A valid dataStore instance is not available for "
+                         << operation
+                         << ", so it will not be possible to write data. A likely cause for this is a skipped or "
+                            "missed Configure transition.",
+                       ((std::string)name),
+                       ((std::string)operation))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       IncompleteEvent,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Event " << eventID << " is being written with " << fragmentCount << " of the " << expectedCount
+                                << " expected fragments.",
+                       ((std::string)name),
+                       ((int)eventID)((size_t)fragmentCount)((size_t)expectedCount))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       EventWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Failed to write event " << eventID << ", with " << fragmentCount << " fragments.",
+                       ((std::string)name),
+                       ((int)eventID)((size_t)fragmentCount))
+
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_EVENTBUILDER_HPP_
@@ -0,0 +1,78 @@
+#ifndef DDPDEMO_SRC_EVENTCLAIMTRACKER_HPP_
+#define DDPDEMO_SRC_EVENTCLAIMTRACKER_HPP_
+/**
+ * @file EventClaimTracker.hpp
+ *
+ * EventClaimTracker keeps the generator threads that each write a slice of
+ * the geoLocations of every event in step at the end of a run.  Each thread
+ * claims an event ID before it writes its slice of that event.  When the run
+ * is stopped, the highest event ID that any thread has claimed becomes the
+ * last one, so every thread finishes the same set of events, and no event is
+ * left with only some of its fragments.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief EventClaimTracker decides which events the generator threads still write after a stop.
+ */
+class EventClaimTracker
+{
+public:
+  EventClaimTracker() { reset(); }
+
+  /**
+   * @brief Starts a new run, in which no event has been claimed and there is no last event yet.
+   */
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    highestClaimedEventID_ = 0;
+    lastEventID_ = std::numeric_limits<int>::max();
+  }
+
+  /**
+   * @brief Claims the event for the calling thread.
+   * @return whether the thread should write its slice of the event; false once
+   * the run has been closed and the event is beyond the last one
+   */
+  bool claim(int eventID)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (eventID > lastEventID_) {
+      return false;
+    }
+    highestClaimedEventID_ = std::max(highestClaimedEventID_, eventID);
+    return true;
+  }
+
+  /**
+   * @brief Closes the run after the highest event that has been claimed so far.
+   * @return the ID of the last event
+   */
+  int close()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lastEventID_ = highestClaimedEventID_;
+    return lastEventID_;
+  }
+
+private:
+  std::mutex mutex_;
+  int highestClaimedEventID_;
+  int lastEventID_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_EVENTCLAIMTRACKER_HPP_
@@ -0,0 +1,176 @@
+#ifndef DDPDEMO_SRC_FILEMAPPINGCACHE_HPP_
+#define DDPDEMO_SRC_FILEMAPPINGCACHE_HPP_
+/**
+ * @file FileMappingCache.hpp
+ *
+ * FileMappingCache keeps read-only memory mappings of whole files, so that
+ * DataStores can return data blocks that refer to the bytes in the page cache
+ * instead of copying them.  A mapping stays alive for as long as any data
+ * block refers to it, even after the cache has moved on to a newer mapping of
+ * a file that has grown, or that has been modified or replaced.
+ *
+ * The mappings are shared with the file, so the bytes that a data block
+ * refers to change if the file is overwritten in place while the block is
+ * alive (e.g. when HDF5 reuses the space of a deleted dataset), and reading
+ * them raises SIGBUS if the file is truncated.  Only files that are no longer
+ * being written should be mapped.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <ers/Issue.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  InvalidMmapAdvice,
+                  "The mmap advice \"" << advice
+                                       << "\" is not supported; the supported values are \"normal\", \"sequential\", "
+                                          "\"random\" and \"willneed\".",
+                  ((std::string)advice))
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  FileMappingFailed,
+                  "The file \"" << filename << "\" could not be memory-mapped (" << reason
+                                << "), so its data will be copied instead.",
+                  ((std::string)filename)((std::string)reason))
+
+namespace ddpdemo {
+
+/**
+ * @brief FileMappingCache hands out shared, read-only mappings of files.
+ */
+class FileMappingCache
+{
+public:
+  /**
+   * @brief Creates the cache, with the madvise() hint ("normal", "sequential",
+   * "random" or "willneed") that is given for each new mapping.
+   */
+  explicit FileMappingCache(const std::string& adviceName = "normal")
+  {
+    if (adviceName == "normal") {
+      advice_ = MADV_NORMAL;
+    } else if (adviceName == "sequential") {
+      advice_ = MADV_SEQUENTIAL;
+    } else if (adviceName == "random") {
+      advice_ = MADV_RANDOM;
+    } else if (adviceName == "willneed") {
+      advice_ = MADV_WILLNEED;
+    } else {
+      throw InvalidMmapAdvice(ERS_HERE, adviceName);
+    }
+  }
+
+  FileMappingCache(const FileMappingCache&) = delete;
+  FileMappingCache& operator=(const FileMappingCache&) = delete;
+
+  /**
+   * @brief Returns a mapping of the whole file that covers at least the
+   * specified number of bytes, or null if the file is not that long or can
+   * not be mapped.  The file is mapped again if it is not the file that was
+   * mapped before (by device and inode), or if it has been modified since.
+   */
+  std::shared_ptr<const char> getMapping(const std::string& fileName, size_t minimumSize)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = mappings_.find(fileName);
+    if (iter != mappings_.end() && iter->second.size >= minimumSize) {
+      struct stat fileStatus;
+      if (stat(fileName.c_str(), &fileStatus) == 0 && iter->second.isMappingOf(fileStatus)) {
+        return iter->second.data;
+      }
+    }
+
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+    if (fd < 0) {
+      ers::warning(FileMappingFailed(ERS_HERE, fileName, strerror(errno)));
+      return nullptr;
+    }
+    struct stat fileStatus;
+    if (fstat(fd, &fileStatus) != 0 || static_cast<size_t>(fileStatus.st_size) < minimumSize ||
+        fileStatus.st_size == 0) {
+      close(fd);
+      return nullptr;
+    }
+    const size_t mappingSize = fileStatus.st_size;
+    void* address = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (address == MAP_FAILED) {
+      ers::warning(FileMappingFailed(ERS_HERE, fileName, strerror(errno)));
+      return nullptr;
+    }
+    if (advice_ != MADV_NORMAL) {
+      madvise(address, mappingSize, advice_);
+    }
+
+    Mapping& mapping = mappings_[fileName];
+    mapping.data.reset(static_cast<const char*>(address),
+                       [mappingSize](const char* ptr) { munmap(const_cast<char*>(ptr), mappingSize); }); // NOLINT
+    mapping.size = mappingSize;
+    mapping.device = fileStatus.st_dev;
+    mapping.inode = fileStatus.st_ino;
+    mapping.modificationTime = fileStatus.st_mtim;
+    return mapping.data;
+  }
+
+  /**
+   * @brief Drops the cache's references to its mappings; the mappings that
+   * data blocks still refer to stay alive until those blocks are gone.
+   */
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mappings_.clear();
+  }
+
+  size_t getMappingCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mappings_.size();
+  }
+
+private:
+  struct Mapping
+  {
+    std::shared_ptr<const char> data;
+    size_t size = 0;
+    dev_t device = 0;
+    ino_t inode = 0;
+    struct timespec modificationTime = {};
+
+    bool isMappingOf(const struct stat& fileStatus) const
+    {
+      return fileStatus.st_dev == device && fileStatus.st_ino == inode &&
+             fileStatus.st_mtim.tv_sec == modificationTime.tv_sec &&
+             fileStatus.st_mtim.tv_nsec == modificationTime.tv_nsec;
+    }
+  };
+
+  int advice_;
+  std::map<std::string, Mapping> mappings_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_FILEMAPPINGCACHE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
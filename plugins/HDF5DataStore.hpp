@@ -13,6 +13,7 @@
  */
 
 #include "ddpdemo/DataStore.hpp"
+#include "FileMappingCache.hpp"
 #include "HDF5FileUtils.hpp"
 #include "HDF5KeyTranslator.hpp"
 
@@ -21,9 +22,18 @@
 #include <ers/Issue.h>
 
 #include <boost/lexical_cast.hpp>
+#include <hdf5.h>
 #include <highfive/H5File.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <regex>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -54,8 +64,35 @@ ERS_DECLARE_ISSUE_BASE(ddpdemo,
                        ((std::string)name),
                        ((std::string)dataSet)((std::string)filename))
 
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       UnsupportedHDF5FileDriver,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The HDF5 file driver \"" << driver_name
+                                                << "\" is not available in this HDF5 build, the default driver will be used.",
+                       ((std::string)name),
+                       ((std::string)driver_name))
+
 namespace ddpdemo {
 
+#ifdef H5_HAVE_DIRECT
+/**
+ * @brief HighFive file-access property that selects the HDF5 direct (O_DIRECT) VFD.
+ */
+struct HDF5DirectFileDriver
+{
+  static constexpr size_t ALIGNMENT = 4096;
+  static constexpr size_t BLOCK_SIZE = 4096;
+  static constexpr size_t COPY_BUFFER_SIZE = 16 * 1024 * 1024;
+
+  void apply(hid_t propertyList) const
+  {
+    if (H5Pset_fapl_direct(propertyList, ALIGNMENT, BLOCK_SIZE, COPY_BUFFER_SIZE) < 0) {
+      throw HighFive::FileException("Unable to select the HDF5 direct file driver");
+    }
+  }
+};
+#endif
+
 /**
  * @brief HDF5DataStore creates an HDF5 instance
  * of the DataStore class
@@ -74,6 +111,14 @@ public:
     : DataStore( conf["name"].get<std::string>() ) 
     , fullNameOfOpenFile_("")
     , openFlagsOfOpenFile_(0)
+    , openTimes_(nullptr)
+    , groupLookupTimes_(nullptr)
+    , datasetCreateTimes_(nullptr)
+    , datasetReadTimes_(nullptr)
+    , writeRawTimes_(nullptr)
+    , flushTimes_(nullptr)
+    , objectCopyTimes_(nullptr)
+    , mappedReadTimes_(nullptr)
   {
     TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf ; 
     
@@ -86,15 +131,73 @@ public:
       
       throw InvalidOperationMode(ERS_HERE, get_name(), operation_mode_);
     }
+
+    // the "direct" file driver bypasses the page cache, where HDF5 supports it
+    file_driver_ = conf.value<std::string>("file_driver", "default");
+    if (file_driver_ != "default" && file_driver_ != "direct") {
+      throw InvalidOperationMode(ERS_HERE, get_name(), file_driver_);
+    }
+#ifndef H5_HAVE_DIRECT
+    if (file_driver_ == "direct") {
+      ers::warning(UnsupportedHDF5FileDriver(ERS_HERE, get_name(), file_driver_));
+      file_driver_ = "default";
+    }
+#endif
+
+    // in "mmap" read mode, contiguous datasets are returned as views of a mapping of their file
+    std::string readMode = conf.value<std::string>("read_mode", "copy");
+    if (readMode == "mmap") {
+      mappingCache_.reset(new FileMappingCache(conf.value<std::string>("mmap_advice", "normal")));
+    } else if (readMode != "copy") {
+      throw InvalidOperationMode(ERS_HERE, get_name(), readMode);
+    }
+  }
+
+  ~HDF5DataStore()
+  {
+    auto libraryLock = lockLibraryIfNeeded();
+    filePtr.reset();
   }
 
   virtual void setup(const size_t eventId) { ERS_INFO("Setup ... " << eventId); }
 
-  virtual KeyedDataBlock read(const StorageKey& key)
+  /**
+   * @brief Enables (or, with a null pointer, disables) the timing of the
+   * individual steps of reads and writes: file open, group lookup, dataset
+   * creation, dataset read, write_raw, flush, object copy and (in mmap read
+   * mode) mapped read.
+   */
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    statistics_ = statistics;
+    if (statistics_.get() != nullptr) {
+      openTimes_ = &statistics_->getOperation("hdf5_open");
+      groupLookupTimes_ = &statistics_->getOperation("hdf5_group_lookup");
+      datasetCreateTimes_ = &statistics_->getOperation("hdf5_dataset_create");
+      datasetReadTimes_ = &statistics_->getOperation("hdf5_dataset_read");
+      writeRawTimes_ = &statistics_->getOperation("hdf5_write_raw");
+      flushTimes_ = &statistics_->getOperation("hdf5_flush");
+      objectCopyTimes_ = &statistics_->getOperation("hdf5_object_copy");
+      mappedReadTimes_ = &statistics_->getOperation("hdf5_mapped_read");
+    } else {
+      openTimes_ = nullptr;
+      groupLookupTimes_ = nullptr;
+      datasetCreateTimes_ = nullptr;
+      datasetReadTimes_ = nullptr;
+      writeRawTimes_ = nullptr;
+      flushTimes_ = nullptr;
+      objectCopyTimes_ = nullptr;
+      mappedReadTimes_ = nullptr;
+    }
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override
   {
     TLOG(TLVL_DEBUG) << get_name() << ": going to read data block from eventID/geoLocationID "
                      << HDF5KeyTranslator::getPathString(key) << " from file " << getFileNameFromKey(key);
 
+    auto libraryLock = lockLibraryIfNeeded();
+
     // opening the file from Storage Key + path_ + fileName_ + operation_mode_
     std::string fullFileName = getFileNameFromKey(key);
     // filePtr will be the handle to the Opened-File after a call to openFileIfNeeded()
@@ -104,12 +207,14 @@ public:
     const std::string datasetName = std::to_string(key.getGeoLocation());
     KeyedDataBlock dataBlock(key);
 
+    OperationTimer groupLookupTimer(groupLookupTimes_);
     if (!filePtr->exist(groupName)) {
       throw InvalidHDF5Group(ERS_HERE, get_name(), groupName, fullFileName);
 
     } else {
 
       HighFive::Group theGroup = filePtr->getGroup(groupName);
+      groupLookupTimer.stop();
 
       if (!theGroup.isValid()) {
 
@@ -120,7 +225,20 @@ public:
         try { // to determine if the dataset exists in the group and copy it to membuffer
 
           HighFive::DataSet theDataSet = theGroup.getDataSet(datasetName);
+          if (mappingCache_.get() != nullptr) {
+            OperationTimer mappedReadTimer(mappedReadTimes_);
+            std::shared_ptr<const char> mappedData = getMappedDataSet_(theDataSet, dataBlock.data_size);
+            if (mappedData.get() != nullptr) {
+              mappedReadTimer.setBytes(dataBlock.data_size);
+              dataBlock.shared_data_start = mappedData;
+              return dataBlock;
+            }
+            mappedReadTimer.cancel();
+          }
+
+          OperationTimer datasetReadTimer(datasetReadTimes_);
           dataBlock.data_size = theDataSet.getStorageSize();
+          datasetReadTimer.setBytes(dataBlock.data_size);
           HighFive::DataSpace thedataSpace = theDataSet.getSpace();
           char* membuffer = new char[dataBlock.data_size];
           theDataSet.read(membuffer);
@@ -136,6 +254,174 @@ public:
     return dataBlock;
   }
 
+  /**
+   * @brief Reads part of a dataset through a hyperslab selection, so that
+   * only the requested bytes (or, for chunked datasets, the chunks that hold
+   * them) are read from the file.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": going to read " << length << " bytes at offset " << offset
+                     << " of the data block from eventID/geoLocationID " << HDF5KeyTranslator::getPathString(key)
+                     << " from file " << getFileNameFromKey(key);
+
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string fullFileName = getFileNameFromKey(key);
+    openFileIfNeeded(fullFileName, HighFive::File::ReadOnly);
+
+    const std::string groupName = std::to_string(key.getEventID());
+    const std::string datasetName = std::to_string(key.getGeoLocation());
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = 0;
+    dataBlock.unowned_data_start = nullptr;
+
+    OperationTimer groupLookupTimer(groupLookupTimes_);
+    if (!filePtr->exist(groupName)) {
+      throw InvalidHDF5Group(ERS_HERE, get_name(), groupName, fullFileName);
+    }
+    HighFive::Group theGroup = filePtr->getGroup(groupName);
+    groupLookupTimer.stop();
+    if (!theGroup.isValid()) {
+      throw InvalidHDF5Group(ERS_HERE, get_name(), groupName, fullFileName);
+    }
+
+    try {
+      HighFive::DataSet theDataSet = theGroup.getDataSet(datasetName);
+      if (mappingCache_.get() != nullptr) {
+        OperationTimer mappedReadTimer(mappedReadTimes_);
+        size_t datasetSize = 0;
+        std::shared_ptr<const char> mappedData = getMappedDataSet_(theDataSet, datasetSize);
+        if (mappedData.get() != nullptr) {
+          const size_t rangeOffset = std::min(offset, datasetSize);
+          dataBlock.data_size = std::min(length, datasetSize - rangeOffset);
+          mappedReadTimer.setBytes(dataBlock.data_size);
+          dataBlock.shared_data_start = std::shared_ptr<const void>(mappedData, mappedData.get() + rangeOffset);
+          return dataBlock;
+        }
+        mappedReadTimer.cancel();
+      }
+
+      OperationTimer datasetReadTimer(datasetReadTimes_);
+
+      // the datasets are written as { size, 1 } arrays of bytes
+      const size_t datasetSize = theDataSet.getSpace().getDimensions()[0];
+      const size_t rangeOffset = std::min(offset, datasetSize);
+      dataBlock.data_size = std::min(length, datasetSize - rangeOffset);
+      datasetReadTimer.setBytes(dataBlock.data_size);
+      if (dataBlock.data_size > 0) {
+        std::shared_ptr<char> membuffer(new char[dataBlock.data_size], std::default_delete<char[]>());
+        theDataSet.select({ rangeOffset, 0 }, { dataBlock.data_size, 1 }).read(membuffer.get());
+        dataBlock.shared_data_start = membuffer;
+      }
+    } catch (HighFive::DataSetException const&) {
+      ERS_INFO("HDF5DataSet " << datasetName << " not found.");
+    }
+
+    return dataBlock;
+  }
+
+  /**
+   * @brief Asks the kernel to start reading the bytes of a contiguous dataset
+   * (at the file offset that H5Dget_offset() reports) into the page cache.
+   * The hint is skipped for datasets that are chunked or filtered, for files
+   * that this store writes, and with the "direct" file driver, which bypasses
+   * the page cache.
+   */
+  virtual void adviseWillRead(const StorageKey& key) override
+  {
+    if (file_driver_ == "direct") {
+      return;
+    }
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string fullFileName = getFileNameFromKey(key);
+    if (writtenFileNames_.count(fullFileName) > 0 || !std::filesystem::exists(fullFileName)) {
+      return;
+    }
+    try {
+      openFileIfNeeded(fullFileName, HighFive::File::ReadOnly);
+      const std::string groupName = std::to_string(key.getEventID());
+      const std::string datasetName = std::to_string(key.getGeoLocation());
+      if (!filePtr->exist(groupName)) {
+        return;
+      }
+      HighFive::Group theGroup = filePtr->getGroup(groupName);
+      if (!theGroup.exist(datasetName)) {
+        return;
+      }
+      HighFive::DataSet theDataSet = theGroup.getDataSet(datasetName);
+
+      std::string dataFileName;
+      haddr_t fileOffset = 0;
+      size_t storageSize = 0;
+      if (!getDataSetLocation_(theDataSet, dataFileName, fileOffset, storageSize) || storageSize == 0) {
+        return;
+      }
+      int fd = open(dataFileName.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+      if (fd >= 0) {
+        posix_fadvise(fd, fileOffset, storageSize, POSIX_FADV_WILLNEED);
+        close(fd);
+      }
+    } catch (HighFive::Exception const&) {
+      // a hint that can not be given is simply not given; the read reports any problem
+    }
+  }
+
+  /**
+   * @brief Reads all of the fragments of an event with a single pass over the
+   * event's group, directly into the event buffer.  Except in
+   * one-fragment-per-file mode, that takes only one file open.
+   */
+  virtual EventDataBlock readEvent(int eventID) override
+  {
+    if (operation_mode_ == "one-fragment-per-file") {
+      // the fragments are in the files that are named after them
+      std::vector<KeyedDataBlock> fragments;
+      for (auto& key : getKeysOfFragmentFiles_(eventID)) {
+        fragments.push_back(read(key));
+      }
+      return EventDataBlock(eventID, fragments);
+    }
+
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string fullFileName = getFileNameFromKey(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+    openFileIfNeeded(fullFileName, HighFive::File::ReadOnly);
+
+    const std::string groupName = std::to_string(eventID);
+    OperationTimer groupLookupTimer(groupLookupTimes_);
+    if (!filePtr->exist(groupName)) {
+      throw InvalidHDF5Group(ERS_HERE, get_name(), groupName, fullFileName);
+    }
+    HighFive::Group theGroup = filePtr->getGroup(groupName);
+    groupLookupTimer.stop();
+
+    // the datasets of the event, in geoLocation order
+    std::vector<std::pair<int, HighFive::DataSet>> datasetList;
+    for (auto& datasetName : theGroup.listObjectNames()) {
+      datasetList.emplace_back(boost::lexical_cast<int>(datasetName), theGroup.getDataSet(datasetName));
+    }
+    std::sort(datasetList.begin(), datasetList.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.first < rhs.first;
+    });
+
+    EventDataBlock eventBlock(eventID);
+    OperationTimer datasetReadTimer(datasetReadTimes_);
+    for (auto& dataset : datasetList) {
+      eventBlock.addFragment(StorageKey(eventID, StorageKey::INVALID_DETECTORID, dataset.first),
+                             dataset.second.getSpace().getDimensions()[0]);
+    }
+    char* buffer = eventBlock.allocate();
+    for (size_t idx = 0; idx < datasetList.size(); ++idx) {
+      if (eventBlock.getFragmentSize(idx) > 0) {
+        datasetList[idx].second.read(buffer + eventBlock.fragment_offsets[idx]);
+      }
+    }
+    datasetReadTimer.setBytes(eventBlock.getDataSizeBytes());
+    return eventBlock;
+  }
+
   /**
    * @brief HDF5DataStore write()
    * Method used to write constant data
@@ -145,43 +431,147 @@ public:
    */
   virtual void write(const KeyedDataBlock& dataBlock)
   {
+    auto libraryLock = lockLibraryIfNeeded();
+    writeDataBlock_(dataBlock);
+  }
 
-    size_t idx = dataBlock.data_key.getEventID();
-    size_t geoID = dataBlock.data_key.getGeoLocation();
+  /**
+   * @brief Writes an HDF5 external link to the dataset in the file of the
+   * source HDF5DataStore, instead of a copy of the data.  Reads resolve the
+   * link transparently, as long as the source file stays in place.
+   */
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    const HDF5DataStore* hdf5Source = dynamic_cast<const HDF5DataStore*>(&source);
+    if (hdf5Source == nullptr) {
+      return false;
+    }
 
-    // opening the file from Storage Key + path_ + fileName_ + operation_mode_
-    std::string fullFileName = getFileNameFromKey(dataBlock.data_key);
-    // filePtr will be the handle to the Opened-File after a call to openFileIfNeeded()
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string fullFileName = getFileNameFromKey(key);
     openFileIfNeeded(fullFileName, HighFive::File::OpenOrCreate);
 
-    TLOG(TLVL_DEBUG) << get_name() << ": Writing data with event ID " << dataBlock.data_key.getEventID()
-                     << " and geolocation ID " << dataBlock.data_key.getGeoLocation();
+    const std::string groupName = std::to_string(key.getEventID());
+    const std::string datasetName = std::to_string(key.getGeoLocation());
+    HighFive::Group theGroup = getGroupForWriting_(groupName);
+
+    // the target is recorded relative to this file, so that HDF5 finds it
+    // (next to this file) wherever the two are moved together
+    std::string targetFileName =
+      std::filesystem::relative(hdf5Source->getFileNameFromKey(key), std::filesystem::path(fullFileName).parent_path());
+    std::string targetPath = "/" + groupName + "/" + datasetName;
+    OperationTimer datasetCreateTimer(datasetCreateTimes_);
+    if (theGroup.exist(datasetName)) {
+      H5Ldelete(theGroup.getId(), datasetName.c_str(), H5P_DEFAULT);
+    }
+    if (H5Lcreate_external(targetFileName.c_str(), targetPath.c_str(), theGroup.getId(), datasetName.c_str(),
+                           H5P_DEFAULT, H5P_DEFAULT) < 0) {
+      throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetName, fullFileName);
+    }
+    datasetCreateTimer.stop();
 
-    const std::string datagroup_name = std::to_string(idx);
+    OperationTimer flushTimer(flushTimes_);
+    filePtr->flush();
+    return true;
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    return dynamic_cast<const HDF5DataStore*>(&source) != nullptr;
+  }
 
-    // Check if a HDF5 group exists and if not create one
-    if (!filePtr->exist(datagroup_name)) {
-      filePtr->createGroup(datagroup_name);
+  /**
+   * @brief Copies the dataset from the file of the source HDF5DataStore with
+   * H5Ocopy, which keeps its layout (e.g. chunking and compression) and never
+   * passes the data through a user-space buffer.
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    HDF5DataStore* hdf5Source = dynamic_cast<HDF5DataStore*>(&source);
+    if (hdf5Source == nullptr) {
+      return DataStore::writeNativeCopy(source, key);
     }
-    HighFive::Group theGroup = filePtr->getGroup(datagroup_name);
 
-    if (!theGroup.isValid()) {
-      throw InvalidHDF5Group(ERS_HERE, get_name(), datagroup_name, filePtr->getName());
-    } else {
-      const std::string dataset_name = std::to_string(geoID);
-      HighFive::DataSpace theDataSpace = HighFive::DataSpace({ dataBlock.data_size, 1 });
-      HighFive::DataSetCreateProps dataCProps_;
-      HighFive::DataSetAccessProps dataAProps_;
-
-      auto theDataSet = theGroup.createDataSet<char>(dataset_name, theDataSpace, dataCProps_, dataAProps_);
-      if (theDataSet.isValid()) {
-        theDataSet.write_raw(static_cast<const char*>(dataBlock.getDataStart()));
-      } else {
-        throw InvalidHDF5Dataset(ERS_HERE, get_name(), dataset_name, filePtr->getName());
-      }
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string sourceFileName = hdf5Source->getFileNameFromKey(key);
+    hdf5Source->openFileIfNeeded(sourceFileName, HighFive::File::ReadOnly);
+    std::string fullFileName = getFileNameFromKey(key);
+    openFileIfNeeded(fullFileName, HighFive::File::OpenOrCreate);
+
+    const std::string groupName = std::to_string(key.getEventID());
+    const std::string datasetName = std::to_string(key.getGeoLocation());
+    const std::string datasetPath = "/" + groupName + "/" + datasetName;
+    hid_t sourceDataset = H5Dopen2(hdf5Source->filePtr->getId(), datasetPath.c_str(), H5P_DEFAULT);
+    if (sourceDataset < 0) {
+      throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetPath, sourceFileName);
     }
+    size_t dataSize = H5Dget_storage_size(sourceDataset);
+    H5Dclose(sourceDataset);
 
+    HighFive::Group theGroup = getGroupForWriting_(groupName);
+    OperationTimer objectCopyTimer(objectCopyTimes_, dataSize);
+    if (theGroup.exist(datasetName)) {
+      H5Ldelete(theGroup.getId(), datasetName.c_str(), H5P_DEFAULT);
+    }
+    if (H5Ocopy(hdf5Source->filePtr->getId(), datasetPath.c_str(), theGroup.getId(), datasetName.c_str(), H5P_DEFAULT,
+                H5P_DEFAULT) < 0) {
+      throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetName, fullFileName);
+    }
+    objectCopyTimer.stop();
+
+    OperationTimer flushTimer(flushTimes_);
     filePtr->flush();
+    return dataSize;
+  }
+
+  /**
+   * @brief Replaces an HDF5 external link with a dataset that holds a copy of
+   * the data that it points to.
+   */
+  virtual bool materialize(const StorageKey& key) override
+  {
+    auto libraryLock = lockLibraryIfNeeded();
+
+    std::string fullFileName = getFileNameFromKey(key);
+    openFileIfNeeded(fullFileName, HighFive::File::OpenOrCreate);
+
+    const std::string datasetPath = "/" + std::to_string(key.getEventID()) + "/" + std::to_string(key.getGeoLocation());
+    H5L_info_t linkInfo;
+    if (H5Lget_info(filePtr->getId(), datasetPath.c_str(), &linkInfo, H5P_DEFAULT) < 0) {
+      throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetPath, fullFileName);
+    }
+    if (linkInfo.type != H5L_TYPE_EXTERNAL) {
+      return false;
+    }
+
+    // the target file is only read, so it is opened read-only (HDF5 would
+    // otherwise open it with the same intent as this file)
+    KeyedDataBlock dataBlock(key);
+    {
+      OperationTimer datasetReadTimer(datasetReadTimes_);
+      hid_t accessProps = H5Pcreate(H5P_DATASET_ACCESS);
+      H5Pset_elink_acc_flags(accessProps, H5F_ACC_RDONLY);
+      hid_t datasetId = H5Dopen2(filePtr->getId(), datasetPath.c_str(), accessProps);
+      H5Pclose(accessProps);
+      if (datasetId < 0) {
+        throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetPath, fullFileName);
+      }
+      dataBlock.data_size = H5Dget_storage_size(datasetId);
+      datasetReadTimer.setBytes(dataBlock.data_size);
+      std::shared_ptr<char> membuffer(new char[dataBlock.data_size], std::default_delete<char[]>());
+      herr_t readStatus = H5Dread(datasetId, H5T_NATIVE_CHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, membuffer.get());
+      dataBlock.shared_data_start = membuffer;
+      H5Dclose(datasetId);
+      if (readStatus < 0) {
+        throw InvalidHDF5Dataset(ERS_HERE, get_name(), datasetPath, fullFileName);
+      }
+    }
+
+    H5Ldelete(filePtr->getId(), datasetPath.c_str(), H5P_DEFAULT);
+    writeDataBlock_(dataBlock);
+    return true;
   }
 
   /**
@@ -195,23 +585,24 @@ public:
     std::vector<StorageKey> keyList;
     std::vector<std::string> fileList = getAllFiles_();
 
-    for (auto& filename : fileList) {
-      std::unique_ptr<HighFive::File> localFilePtr(new HighFive::File(filename, HighFive::File::ReadOnly));
-      TLOG(TLVL_DEBUG) << get_name() << ": Opened HDF5 file " << filename;
+    auto libraryLock = lockLibraryIfNeeded();
 
-      std::vector<std::string> pathList = HDF5FileUtils::getAllDataSetPaths(*localFilePtr);
-      TLOG(TLVL_DEBUG) << get_name() << ": Path list has element count: " << pathList.size();
+    for (auto& filename : fileList) {
+      std::vector<StorageKey> fileKeyList = getKeysInFile_(filename);
+      keyList.insert(keyList.end(), fileKeyList.begin(), fileKeyList.end());
+    }
 
-      for (auto& path : pathList) {
-        StorageKey thisKey(0, "", 0);
-        thisKey = HDF5KeyTranslator::getKeyFromString(path);
-        keyList.push_back(thisKey);
-      }
+    return keyList;
+  }
 
-      localFilePtr.reset(); // explicit destruction
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    if (!std::regex_match(std::filesystem::path(fileName).filename().string(), std::regex(getFilenamePattern_()))) {
+      return {};
     }
 
-    return keyList;
+    auto libraryLock = lockLibraryIfNeeded();
+    return getKeysInFile_(fileName);
   }
 
 private:
@@ -225,10 +616,134 @@ private:
   std::string path_;
   std::string fileName_;
   std::string operation_mode_;
+  std::string file_driver_;
   std::string fullNameOfOpenFile_;
   unsigned openFlagsOfOpenFile_;
 
-  std::string getFileNameFromKey(const StorageKey& data_key)
+  // timers for the individual steps of reads and writes, which are null unless statistics are attached
+  std::shared_ptr<DataStoreStatistics> statistics_;
+  OperationStatistics* openTimes_;
+  OperationStatistics* groupLookupTimes_;
+  OperationStatistics* datasetCreateTimes_;
+  OperationStatistics* datasetReadTimes_;
+  OperationStatistics* writeRawTimes_;
+  OperationStatistics* flushTimes_;
+  OperationStatistics* objectCopyTimes_;
+  OperationStatistics* mappedReadTimes_;
+
+  // only in mmap read mode
+  std::unique_ptr<FileMappingCache> mappingCache_;
+  // the files that this store has opened for writing, whose datasets are
+  // never mapped, since HDF5 may reuse the space of deleted datasets in them
+  std::set<std::string> writtenFileNames_;
+
+  /**
+   * @brief Returns the data of a dataset as a view of a mapping of the file
+   * that holds it (which, through an external link, may be another file).
+   * That is only possible for contiguous datasets without filters, whose
+   * file offset H5Dget_offset() reports, in files that this store has not
+   * opened for writing; for the others, null is returned.
+   */
+  std::shared_ptr<const char> getMappedDataSet_(const HighFive::DataSet& theDataSet, size_t& size)
+  {
+    std::string fileName;
+    haddr_t fileOffset = 0;
+    size_t storageSize = 0;
+    if (!getDataSetLocation_(theDataSet, fileName, fileOffset, storageSize) || writtenFileNames_.count(fileName) > 0) {
+      return nullptr;
+    }
+
+    std::shared_ptr<const char> mapping = mappingCache_->getMapping(fileName, fileOffset + storageSize);
+    if (mapping.get() == nullptr) {
+      return nullptr;
+    }
+    size = storageSize;
+    return std::shared_ptr<const char>(mapping, mapping.get() + fileOffset);
+  }
+
+  /**
+   * @brief Finds the file (which, through an external link, may be another
+   * file) and the range within it that hold the bytes of a dataset.  That is
+   * only possible for contiguous datasets without filters.
+   * @return whether the dataset has such a location
+   */
+  bool getDataSetLocation_(const HighFive::DataSet& theDataSet,
+                           std::string& fileName,
+                           haddr_t& fileOffset,
+                           size_t& storageSize) const
+  {
+    const hid_t datasetID = theDataSet.getId();
+    fileOffset = H5Dget_offset(datasetID);
+    if (fileOffset == HADDR_UNDEF) {
+      return false;
+    }
+    storageSize = H5Dget_storage_size(datasetID);
+    ssize_t nameLength = H5Fget_name(datasetID, nullptr, 0);
+    if (nameLength <= 0) {
+      return false;
+    }
+    std::vector<char> nameBuffer(nameLength + 1);
+    H5Fget_name(datasetID, nameBuffer.data(), nameBuffer.size());
+    fileName = nameBuffer.data();
+    return true;
+  }
+
+  // returns the group in the open file, creating it if necessary
+  HighFive::Group getGroupForWriting_(const std::string& groupName)
+  {
+    OperationTimer groupLookupTimer(groupLookupTimes_);
+    if (!filePtr->exist(groupName)) {
+      filePtr->createGroup(groupName);
+    }
+    HighFive::Group theGroup = filePtr->getGroup(groupName);
+    groupLookupTimer.stop();
+    if (!theGroup.isValid()) {
+      throw InvalidHDF5Group(ERS_HERE, get_name(), groupName, filePtr->getName());
+    }
+    return theGroup;
+  }
+
+  // writes the data block into a new dataset; the caller holds the library lock
+  void writeDataBlock_(const KeyedDataBlock& dataBlock)
+  {
+    size_t idx = dataBlock.data_key.getEventID();
+    size_t geoID = dataBlock.data_key.getGeoLocation();
+
+    // opening the file from Storage Key + path_ + fileName_ + operation_mode_
+    std::string fullFileName = getFileNameFromKey(dataBlock.data_key);
+    // filePtr will be the handle to the Opened-File after a call to openFileIfNeeded()
+    openFileIfNeeded(fullFileName, HighFive::File::OpenOrCreate);
+
+    TLOG(TLVL_DEBUG) << get_name() << ": Writing data with event ID " << dataBlock.data_key.getEventID()
+                     << " and geolocation ID " << dataBlock.data_key.getGeoLocation();
+
+    const std::string datagroup_name = std::to_string(idx);
+    HighFive::Group theGroup = getGroupForWriting_(datagroup_name);
+
+    const std::string dataset_name = std::to_string(geoID);
+    HighFive::DataSpace theDataSpace = HighFive::DataSpace({ dataBlock.data_size, 1 });
+    HighFive::DataSetCreateProps dataCProps_;
+    HighFive::DataSetAccessProps dataAProps_;
+
+    // a data block that is written again (e.g. by a resumed transfer) replaces the earlier one
+    OperationTimer datasetCreateTimer(datasetCreateTimes_);
+    if (theGroup.exist(dataset_name)) {
+      H5Ldelete(theGroup.getId(), dataset_name.c_str(), H5P_DEFAULT);
+    }
+    auto theDataSet = theGroup.createDataSet<char>(dataset_name, theDataSpace, dataCProps_, dataAProps_);
+    datasetCreateTimer.stop();
+    if (theDataSet.isValid()) {
+      OperationTimer writeRawTimer(writeRawTimes_, dataBlock.data_size);
+      theDataSet.write_raw(static_cast<const char*>(dataBlock.getDataStart()));
+    } else {
+      throw InvalidHDF5Dataset(ERS_HERE, get_name(), dataset_name, filePtr->getName());
+    }
+
+    OperationTimer flushTimer(flushTimes_);
+    filePtr->flush();
+  }
+
+  std::string getFileNameFromKey(const StorageKey& data_key) const
   {
     size_t idx = data_key.getEventID();
     size_t geoID = data_key.getGeoLocation();
@@ -250,7 +765,7 @@ private:
     return file_name;
   }
 
-  std::vector<std::string> getAllFiles_() const
+  std::string getFilenamePattern_() const
   {
     std::string workString = fileName_;
     if (operation_mode_ == "one-event-per-file") {
@@ -260,21 +775,97 @@ private:
     } else {
       workString += "_all_events.hdf5";
     }
+    return workString;
+  }
+
+  std::vector<std::string> getAllFiles_() const
+  {
+    return HDF5FileUtils::getFilesMatchingPattern(path_, getFilenamePattern_());
+  }
+
+  /**
+   * @brief In one-fragment-per-file mode, returns the keys of the fragments of
+   * the specified event, in geoLocation order, from the names of their files.
+   */
+  std::vector<StorageKey> getKeysOfFragmentFiles_(int eventID) const
+  {
+    const std::string eventPrefix = fileName_ + "_event_" + std::to_string(eventID) + "_geoID_";
+    std::vector<StorageKey> keyList;
+    for (auto& fileName : HDF5FileUtils::getFilesMatchingPattern(path_, eventPrefix + "\\d+.hdf5")) {
+      std::string geoLocation = std::filesystem::path(fileName).stem().string().substr(eventPrefix.size());
+      keyList.emplace_back(eventID, StorageKey::INVALID_DETECTORID, boost::lexical_cast<int>(geoLocation));
+    }
+    std::sort(keyList.begin(), keyList.end(), [](const StorageKey& lhs, const StorageKey& rhs) {
+      return lhs.getGeoLocation() < rhs.getGeoLocation();
+    });
+    return keyList;
+  }
+
+  // lists the keys of the datasets in the specified file; the caller holds the library lock
+  std::vector<StorageKey> getKeysInFile_(const std::string& filename) const
+  {
+    std::vector<StorageKey> keyList;
+    std::unique_ptr<HighFive::File> localFilePtr(new HighFive::File(filename, HighFive::File::ReadOnly));
+    TLOG(TLVL_DEBUG) << get_name() << ": Opened HDF5 file " << filename;
+
+    std::vector<std::string> pathList = HDF5FileUtils::getAllDataSetPaths(*localFilePtr);
+    TLOG(TLVL_DEBUG) << get_name() << ": Path list has element count: " << pathList.size();
+
+    for (auto& path : pathList) {
+      StorageKey thisKey(0, "", 0);
+      thisKey = HDF5KeyTranslator::getKeyFromString(path);
+      keyList.push_back(thisKey);
+    }
+
+    localFilePtr.reset(); // explicit destruction
+    return keyList;
+  }
 
-    return HDF5FileUtils::getFilesMatchingPattern(path_, workString);
+  /**
+   * @brief HDF5 libraries that were built without thread-safety must not be
+   * called from several threads at the same time, even for different files.
+   * Since several HDF5DataStore instances may be used from different threads
+   * (e.g. inside a ShardedDataStore), calls into the library are serialized
+   * with a process-wide mutex in that case.
+   */
+  static std::unique_lock<std::mutex> lockLibraryIfNeeded()
+  {
+#ifdef H5_HAVE_THREADSAFE
+    return std::unique_lock<std::mutex>();
+#else
+    static std::mutex libraryMutex;
+    return std::unique_lock<std::mutex>(libraryMutex);
+#endif
   }
 
   void openFileIfNeeded(const std::string& fileName, unsigned openFlags = HighFive::File::ReadOnly)
   {
 
-    if (fullNameOfOpenFile_.compare(fileName) || openFlagsOfOpenFile_ != openFlags) {
+    if (filePtr.get() == nullptr || fullNameOfOpenFile_.compare(fileName) || openFlagsOfOpenFile_ != openFlags) {
 
       // opening file for the first time OR something changed in the name or the way of opening the file
       TLOG(TLVL_DEBUG) << get_name() << ": going to open file " << fileName << " with openFlags "
                        << std::to_string(openFlags);
+      if (openFlags != HighFive::File::ReadOnly) {
+        writtenFileNames_.insert(fileName);
+      }
+      HighFive::FileDriver fileDriver;
+#ifdef H5_HAVE_DIRECT
+      if (file_driver_ == "direct") {
+        fileDriver.add(HDF5DirectFileDriver());
+      }
+#endif
+      OperationTimer openTimer(openTimes_);
+      // the previous handle is closed first, since HDF5 would otherwise hand out
+      // the already-open (e.g. read-only) file again when the names match
+      // (the name and flags are only recorded once the open has succeeded, so
+      // that a failed open is tried again, rather than a null handle being used)
+      filePtr.reset();
+      fullNameOfOpenFile_ = "";
+      openFlagsOfOpenFile_ = 0;
+      filePtr.reset(new HighFive::File(fileName, openFlags, fileDriver));
       fullNameOfOpenFile_ = fileName;
       openFlagsOfOpenFile_ = openFlags;
-      filePtr.reset(new HighFive::File(fileName, openFlags));
       TLOG(TLVL_DEBUG) << get_name() << "Created HDF5 file.";
 
     } else {
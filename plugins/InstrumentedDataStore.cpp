@@ -0,0 +1,3 @@
+#include "InstrumentedDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::InstrumentedDataStore)
@@ -0,0 +1,232 @@
+#ifndef DDPDEMO_SRC_INSTRUMENTEDDATASTORE_HPP_
+#define DDPDEMO_SRC_INSTRUMENTEDDATASTORE_HPP_
+
+/**
+ * @file InstrumentedDataStore.hpp
+ *
+ * An implementation of the DataStore interface that wraps a child DataStore
+ * and records latency histograms, operation counts and byte counts for its
+ * write, read, getAllExistingKeys and flush calls.  Child stores that time
+ * their internal steps (e.g. the HDF5DataStore) add those to the same
+ * statistics.  The statistics are dumped as JSON on flush (i.e. at stop),
+ * when the store is destroyed, or on demand.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/DataStoreStatistics.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       StatisticsDumpFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Unable to write the DataStore statistics to the file \"" << filename << "\".",
+                       ((std::string)name),
+                       ((std::string)filename))
+
+namespace ddpdemo {
+
+/**
+ * @brief InstrumentedDataStore times every call to a child DataStore.
+ */
+class InstrumentedDataStore : public DataStore
+{
+public:
+  explicit InstrumentedDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , statistics_(new DataStoreStatistics())
+    , unreportedOperations_(false)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    outputFile_ = conf.value<std::string>("output_file", "");
+    childStore_ = makeDataStore(conf["child_data_store_parameters"]);
+    if (conf.value<bool>("phase_timers", true)) {
+      childStore_->attachStatistics(statistics_);
+    }
+
+    writeTimes_ = &statistics_->getOperation("write");
+    readTimes_ = &statistics_->getOperation("read");
+    readEventTimes_ = &statistics_->getOperation("read_event");
+    keyListTimes_ = &statistics_->getOperation("get_all_existing_keys");
+    linkTimes_ = &statistics_->getOperation("write_link");
+    materializeTimes_ = &statistics_->getOperation("materialize");
+    nativeCopyTimes_ = &statistics_->getOperation("write_native_copy");
+    keysInFileTimes_ = &statistics_->getOperation("get_keys_in_file");
+    flushTimes_ = &statistics_->getOperation("flush");
+  }
+
+  ~InstrumentedDataStore()
+  {
+    if (unreportedOperations_) {
+      dumpStatistics();
+    }
+  }
+
+  virtual void setup(const size_t eventId) override { childStore_->setup(eventId); }
+
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(writeTimes_, dataBlock.getDataSizeBytes());
+    childStore_->write(dataBlock);
+  }
+
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(linkTimes_);
+    return childStore_->writeLink(source, key);
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    return childStore_->acceptsNativeCopy(source);
+  }
+
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(nativeCopyTimes_);
+    size_t bytes = childStore_->writeNativeCopy(source, key);
+    timer.setBytes(bytes);
+    return bytes;
+  }
+
+  virtual bool materialize(const StorageKey& key) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(materializeTimes_);
+    return childStore_->materialize(key);
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(readTimes_);
+    KeyedDataBlock dataBlock = childStore_->read(key);
+    timer.setBytes(dataBlock.getDataSizeBytes());
+    return dataBlock;
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(readTimes_);
+    KeyedDataBlock dataBlock = childStore_->read(key, offset, length);
+    timer.setBytes(dataBlock.getDataSizeBytes());
+    return dataBlock;
+  }
+
+  virtual void adviseWillRead(const StorageKey& key) override { childStore_->adviseWillRead(key); }
+
+  virtual EventDataBlock readEvent(int eventID) override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(readEventTimes_);
+    EventDataBlock eventBlock = childStore_->readEvent(eventID);
+    timer.setBytes(eventBlock.getDataSizeBytes());
+    return eventBlock;
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(keyListTimes_);
+    return childStore_->getAllExistingKeys();
+  }
+
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    unreportedOperations_ = true;
+    OperationTimer timer(keysInFileTimes_);
+    return childStore_->getKeysInFile(fileName);
+  }
+
+  /**
+   * @brief Flushes the child store, then dumps the statistics.
+   */
+  virtual void flush() override
+  {
+    {
+      OperationTimer timer(flushTimes_);
+      childStore_->flush();
+    }
+    dumpStatistics();
+  }
+
+  /**
+   * @brief Returns the statistics that have been gathered so far, as JSON.
+   */
+  nlohmann::json getStatistics() const
+  {
+    nlohmann::json result;
+    result["name"] = get_name();
+    result["operations"] = statistics_->toJson();
+    return result;
+  }
+
+  /**
+   * @brief Writes the statistics to the configured output file, or logs them
+   * if no output file was configured.
+   */
+  void dumpStatistics()
+  {
+    unreportedOperations_ = false;
+    nlohmann::json statistics = getStatistics();
+    if (outputFile_.empty()) {
+      ERS_INFO(get_name() << ": DataStore statistics: " << statistics.dump());
+      return;
+    }
+
+    std::ofstream outputStream(outputFile_, std::ios::trunc);
+    outputStream << statistics.dump(2) << std::endl;
+    if (!outputStream) {
+      ers::warning(StatisticsDumpFailed(ERS_HERE, get_name(), outputFile_));
+    }
+  }
+
+private:
+  InstrumentedDataStore(const InstrumentedDataStore&) = delete;
+  InstrumentedDataStore& operator=(const InstrumentedDataStore&) = delete;
+  InstrumentedDataStore(InstrumentedDataStore&&) = delete;
+  InstrumentedDataStore& operator=(InstrumentedDataStore&&) = delete;
+
+  std::unique_ptr<DataStore> childStore_;
+  std::shared_ptr<DataStoreStatistics> statistics_;
+  std::string outputFile_;
+  mutable std::atomic<bool> unreportedOperations_;
+
+  OperationStatistics* writeTimes_;
+  OperationStatistics* readTimes_;
+  OperationStatistics* readEventTimes_;
+  OperationStatistics* keyListTimes_;
+  OperationStatistics* linkTimes_;
+  OperationStatistics* materializeTimes_;
+  OperationStatistics* nativeCopyTimes_;
+  OperationStatistics* keysInFileTimes_;
+  OperationStatistics* flushTimes_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_INSTRUMENTEDDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,3 @@
+#include "MemoryRingDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::MemoryRingDataStore)
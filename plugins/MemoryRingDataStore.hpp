@@ -0,0 +1,221 @@
+#ifndef DDPDEMO_SRC_MEMORYRINGDATASTORE_HPP_
+#define DDPDEMO_SRC_MEMORYRINGDATASTORE_HPP_
+
+/**
+ * @file MemoryRingDataStore.hpp
+ *
+ * An implementation of the DataStore interface that keeps the most recent
+ * data blocks in a preallocated ring buffer in memory.  When the ring is
+ * full, the oldest data blocks are evicted to make room for new ones.
+ * This is useful for measuring the overhead of the rest of the pipeline
+ * without any disk I/O, and as a fast buffer of recent data.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       DataBlockTooLarge,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The data block with eventID " << eventID << " and geoLocation " << geoLocation << " has size "
+                                                      << size << ", which is larger than the capacity of "
+                                                      << capacity << " bytes.",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation)((size_t)size)((size_t)capacity))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       MemoryRingKeyNotFound,
+                       appfwk::GeneralDAQModuleIssue,
+                       "No data block with eventID " << eventID << " and geoLocation " << geoLocation
+                                                     << " is currently held in the memory ring.",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation))
+
+namespace ddpdemo {
+
+/**
+ * @brief MemoryRingDataStore stores data blocks in a fixed-size, preallocated
+ * ring buffer, with a hash index from StorageKey to ring entry.
+ */
+class MemoryRingDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_CAPACITY_BYTES = 256 * 1024 * 1024;
+
+  explicit MemoryRingDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , head_(0)
+    , firstSequence_(0)
+    , nextSequence_(0)
+    , evictedCount_(0)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    capacity_ = conf.value<size_t>("capacity_bytes", REASONABLE_DEFAULT_CAPACITY_BYTES);
+    ring_.reset(new char[capacity_]);
+
+    // touch every page up front so that page faults are not part of the write latency
+    memset(ring_.get(), 0, capacity_);
+  }
+
+  ~MemoryRingDataStore()
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Destroying memory ring that holds " << entries_.size() << " entries, "
+                     << evictedCount_ << " entries were evicted.";
+  }
+
+  virtual void setup(const size_t) override { ; }
+
+  /**
+   * @brief Copies the data block into the ring, evicting the oldest entries
+   * that occupy the space that is needed.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    if (size > capacity_) {
+      throw DataBlockTooLarge(
+        ERS_HERE, get_name(), dataBlock.data_key.getEventID(), dataBlock.data_key.getGeoLocation(), size, capacity_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (entries_.empty()) {
+      head_ = 0;
+    }
+    if (head_ + size > capacity_) {
+      // the data block does not fit at the end of the ring, so we wrap around.
+      // The entries between the current position and the end are the oldest ones.
+      while (!entries_.empty() && entries_.front().offset >= head_) {
+        evictOldest_();
+      }
+      head_ = 0;
+    }
+    while (!entries_.empty() && occupies_(entries_.front(), head_, head_ + size)) {
+      evictOldest_();
+    }
+
+    RingEntry entry{ dataBlock.data_key, head_, size, nextSequence_++ };
+    memcpy(ring_.get() + head_, dataBlock.getDataStart(), size);
+    head_ += size;
+
+    index_[entry.key] = entry.sequence;
+    entries_.push_back(std::move(entry));
+  }
+
+  /**
+   * @brief Returns a copy of the specified data block, if it is still in the ring.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto iter = index_.find(key);
+    if (iter == index_.end()) {
+      throw MemoryRingKeyNotFound(ERS_HERE, get_name(), key.getEventID(), key.getGeoLocation());
+    }
+    const RingEntry& entry = entries_[iter->second - firstSequence_];
+
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = entry.size;
+    char* membuffer = new char[entry.size];
+    memcpy(membuffer, ring_.get() + entry.offset, entry.size);
+    std::unique_ptr<char> memPtr(membuffer);
+    dataBlock.owned_data_start = std::move(memPtr);
+    return dataBlock;
+  }
+
+  /**
+   * @brief Returns the keys of the data blocks that are currently held, oldest first.
+   */
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<StorageKey> keyList;
+    keyList.reserve(index_.size());
+    for (auto& entry : entries_) {
+      // skip entries that have been superseded by a later write of the same key
+      auto iter = index_.find(entry.key);
+      if (iter != index_.end() && iter->second == entry.sequence) {
+        keyList.push_back(entry.key);
+      }
+    }
+    return keyList;
+  }
+
+private:
+  MemoryRingDataStore(const MemoryRingDataStore&) = delete;
+  MemoryRingDataStore& operator=(const MemoryRingDataStore&) = delete;
+  MemoryRingDataStore(MemoryRingDataStore&&) = delete;
+  MemoryRingDataStore& operator=(MemoryRingDataStore&&) = delete;
+
+  struct RingEntry
+  {
+    StorageKey key;
+    size_t offset;
+    size_t size;
+    uint64_t sequence;
+  };
+
+  size_t capacity_;
+  std::unique_ptr<char[]> ring_;
+  size_t head_;
+
+  // entries are kept in the order in which they were written, so the ring entry
+  // for a given sequence number is at position (sequence - firstSequence_)
+  std::deque<RingEntry> entries_;
+  std::unordered_map<StorageKey, uint64_t> index_;
+  uint64_t firstSequence_;
+  uint64_t nextSequence_;
+  size_t evictedCount_;
+
+  mutable std::mutex mutex_;
+
+  static bool occupies_(const RingEntry& entry, size_t start, size_t end)
+  {
+    // zero-length entries still hold their place in the ring
+    return entry.offset < end && entry.offset + std::max<size_t>(entry.size, 1) > start;
+  }
+
+  void evictOldest_()
+  {
+    const RingEntry& oldest = entries_.front();
+    auto iter = index_.find(oldest.key);
+    if (iter != index_.end() && iter->second == oldest.sequence) {
+      index_.erase(iter);
+    }
+    entries_.pop_front();
+    ++firstSequence_;
+    ++evictedCount_;
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_MEMORYRINGDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,214 @@
+#ifndef DDPDEMO_SRC_PARTIALEVENTTABLE_HPP_
+#define DDPDEMO_SRC_PARTIALEVENTTABLE_HPP_
+/**
+ * @file PartialEventTable.hpp
+ *
+ * PartialEventTable collects the fragments (data blocks) of events, which may
+ * arrive in any order and from several threads, until each event has a
+ * fragment from every expected geoLocation, or until it has waited too long.
+ * The events are spread over shards, each with its own lock, so that threads
+ * that add fragments of different events rarely contend.  The IDs of the
+ * most recent events that have been taken out of the table are remembered, so
+ * that a fragment which arrives after its event has been written (e.g. after
+ * a timeout) does not start that event again.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/KeyedDataBlock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief PartialEventTable is a concurrent map of partially-built events, by eventID.
+ */
+class PartialEventTable
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  static constexpr size_t REASONABLE_DEFAULT_SHARD_COUNT = 16;
+  static constexpr size_t REASONABLE_DEFAULT_CLOSED_EVENT_COUNT = 65536;
+
+  enum class AddResult
+  {
+    Added,
+    Completed,
+    Duplicate,
+    Late
+  };
+
+  /**
+   * @brief An event that has been taken out of the table, with all of the fragments that it had.
+   */
+  struct Event
+  {
+    int eventID = 0;
+    std::vector<KeyedDataBlock> fragments;
+    size_t bytes = 0;
+    clock_t::time_point firstArrival;
+  };
+
+  /**
+   * @param closedEventCount how many of the most recently closed eventIDs are
+   * remembered (spread over the shards), to recognize late fragments
+   */
+  explicit PartialEventTable(size_t expectedGeoLocationCount,
+                             size_t shardCount = REASONABLE_DEFAULT_SHARD_COUNT,
+                             size_t closedEventCount = REASONABLE_DEFAULT_CLOSED_EVENT_COUNT)
+    : expectedGeoLocationCount_(std::max(expectedGeoLocationCount, static_cast<size_t>(1)))
+    , heldBytes_(0)
+    , eventCount_(0)
+  {
+    shardCount = std::max(shardCount, static_cast<size_t>(1));
+    closedEventsPerShard_ = std::max((closedEventCount + shardCount - 1) / shardCount, static_cast<size_t>(1));
+    for (size_t idx = 0; idx < shardCount; ++idx) {
+      shards_.emplace_back(new Shard);
+    }
+  }
+
+  PartialEventTable(const PartialEventTable&) = delete;
+  PartialEventTable& operator=(const PartialEventTable&) = delete;
+
+  /**
+   * @brief Adds a fragment to its event.  When that completes the event, the
+   * event is taken out of the table and returned in completedEvent.  A second
+   * fragment from the same geoLocation is dropped, and so is a fragment of an
+   * event that has already been taken out of the table (Late).
+   */
+  AddResult add(KeyedDataBlock&& dataBlock, Event& completedEvent)
+  {
+    const int eventID = dataBlock.data_key.getEventID();
+    const size_t bytes = dataBlock.getDataSizeBytes();
+    Shard& shard = getShard_(eventID);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto eventIter = shard.events.find(eventID);
+    if (eventIter == shard.events.end()) {
+      if (shard.closedEvents.count(eventID) > 0) {
+        return AddResult::Late;
+      }
+      eventIter = shard.events.emplace(eventID, PartialEvent()).first;
+      eventIter->second.event.eventID = eventID;
+      eventIter->second.event.firstArrival = clock_t::now();
+      eventIter->second.event.fragments.reserve(expectedGeoLocationCount_);
+      ++eventCount_;
+    }
+    PartialEvent& partialEvent = eventIter->second;
+    if (!partialEvent.geoLocations.insert(dataBlock.data_key.getGeoLocation()).second) {
+      return AddResult::Duplicate;
+    }
+    partialEvent.event.fragments.push_back(std::move(dataBlock));
+    partialEvent.event.bytes += bytes;
+    heldBytes_ += bytes;
+
+    if (partialEvent.geoLocations.size() < expectedGeoLocationCount_) {
+      return AddResult::Added;
+    }
+    completedEvent = std::move(partialEvent.event);
+    shard.events.erase(eventIter);
+    close_(shard, eventID);
+    heldBytes_ -= completedEvent.bytes;
+    --eventCount_;
+    return AddResult::Completed;
+  }
+
+  /**
+   * @brief Takes the events whose first fragment arrived before the cutoff out
+   * of the table, and appends them to expiredEvents.  Returns how many there were.
+   */
+  size_t takeExpired(clock_t::time_point cutoff, std::vector<Event>& expiredEvents)
+  {
+    size_t expiredCount = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (auto eventIter = shard->events.begin(); eventIter != shard->events.end();) {
+        if (eventIter->second.event.firstArrival < cutoff) {
+          heldBytes_ -= eventIter->second.event.bytes;
+          --eventCount_;
+          close_(*shard, eventIter->first);
+          expiredEvents.push_back(std::move(eventIter->second.event));
+          eventIter = shard->events.erase(eventIter);
+          ++expiredCount;
+        } else {
+          ++eventIter;
+        }
+      }
+    }
+    return expiredCount;
+  }
+
+  /**
+   * @brief Takes all of the events out of the table (e.g. at the end of a run).
+   */
+  size_t takeAll(std::vector<Event>& events) { return takeExpired(clock_t::time_point::max(), events); }
+
+  size_t getExpectedGeoLocationCount() const { return expectedGeoLocationCount_; }
+  size_t getShardCount() const { return shards_.size(); }
+
+  /**
+   * @brief Returns the number of payload bytes that are held in partial events.
+   */
+  size_t getHeldBytes() const { return heldBytes_.load(std::memory_order_relaxed); }
+  size_t getEventCount() const { return eventCount_.load(std::memory_order_relaxed); }
+
+private:
+  struct PartialEvent
+  {
+    Event event;
+    std::unordered_set<int> geoLocations;
+  };
+
+  struct Shard
+  {
+    std::mutex mutex;
+    std::unordered_map<int, PartialEvent> events;
+    // the most recently closed eventIDs, oldest first
+    std::unordered_set<int> closedEvents;
+    std::deque<int> closedOrder;
+  };
+
+  Shard& getShard_(int eventID) { return *shards_[static_cast<unsigned>(eventID) % shards_.size()]; }
+
+  // remembers that the event has been taken out of the table; the shard's mutex must be held
+  void close_(Shard& shard, int eventID)
+  {
+    if (!shard.closedEvents.insert(eventID).second) {
+      return;
+    }
+    shard.closedOrder.push_back(eventID);
+    if (shard.closedOrder.size() > closedEventsPerShard_) {
+      shard.closedEvents.erase(shard.closedOrder.front());
+      shard.closedOrder.pop_front();
+    }
+  }
+
+  const size_t expectedGeoLocationCount_;
+  size_t closedEventsPerShard_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<size_t> heldBytes_;
+  std::atomic<size_t> eventCount_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_PARTIALEVENTTABLE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,292 @@
+#ifndef DDPDEMO_SRC_PAYLOADGENERATOR_HPP_
+#define DDPDEMO_SRC_PAYLOADGENERATOR_HPP_
+/**
+ * @file PayloadGenerator.hpp
+ *
+ * PayloadGenerator fills a pool of buffers with synthetic fragment payloads,
+ * so that compression and checksum benchmarks see realistic data instead of
+ * a constant fill.  All of the buffers are generated up front (at configure
+ * time), so that generating data never limits the write rate.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <ers/Issue.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  InvalidPayloadMode,
+                  "The payload mode \"" << mode
+                                        << "\" is not supported; the supported modes are \"constant\", \"random\", "
+                                           "\"entropy\" and \"adc\".",
+                  ((std::string)mode))
+
+namespace ddpdemo {
+
+/**
+ * @brief PayloadGenerator creates a pool of synthetic payload buffers.
+ *
+ * The supported modes are:
+ *   "constant": every byte is 'X' (the original DataGenerator payload)
+ *   "random":   uniformly random bytes, which do not compress at all
+ *   "entropy":  random bytes from an alphabet of 2^"entropy_bits_per_byte"
+ *               symbols, so the compressibility can be dialed in
+ *   "adc":      WIB-like frames of bit-packed 12- or 14-bit ADC samples, with a
+ *               per-channel pedestal, Gaussian noise and occasional pulses
+ */
+class PayloadGenerator
+{
+public:
+  enum class Mode
+  {
+    Constant,
+    Random,
+    Entropy,
+    ADC
+  };
+
+  static constexpr size_t REASONABLE_DEFAULT_POOL_SIZE = 16;
+
+  // WIB-like frame layout: a header, followed by one packed sample per channel
+  static constexpr uint32_t FRAME_MAGIC = 0x57494246; // "WIBF"
+  static constexpr size_t CHANNELS_PER_FRAME = 256;
+  static constexpr uint64_t TICKS_PER_FRAME = 25;
+
+  struct FrameHeader
+  {
+    uint32_t magic;
+    uint16_t adcBits;
+    uint16_t bufferIndex; // index of the buffer in the pool, not the geoLocation of the data block
+    uint64_t timestamp;
+  };
+
+  PayloadGenerator(const nlohmann::json& conf, size_t bufferSize)
+    : bufferSize_(bufferSize)
+  {
+    std::string modeName = conf.value<std::string>("payload_mode", "constant");
+    if (modeName == "constant") {
+      mode_ = Mode::Constant;
+    } else if (modeName == "random") {
+      mode_ = Mode::Random;
+    } else if (modeName == "entropy") {
+      mode_ = Mode::Entropy;
+    } else if (modeName == "adc") {
+      mode_ = Mode::ADC;
+    } else {
+      throw InvalidPayloadMode(ERS_HERE, modeName);
+    }
+
+    // a constant payload only needs a single buffer
+    size_t poolSize = conf.value<size_t>("payload_pool_size", REASONABLE_DEFAULT_POOL_SIZE);
+    poolSize = (mode_ == Mode::Constant) ? 1 : std::max(poolSize, static_cast<size_t>(1));
+    entropyBitsPerByte_ = std::min(std::max(conf.value<double>("entropy_bits_per_byte", 4.0), 0.0), 8.0);
+    adcBits_ = (conf.value<int>("adc_bits", 14) == 12) ? 12 : 14;
+    adcPedestal_ = conf.value<double>("adc_pedestal", 900.0);
+    adcNoiseRms_ = conf.value<double>("adc_noise_rms", 4.0);
+    pulseProbability_ = conf.value<double>("pulse_probability", 0.001);
+    pulseAmplitude_ = conf.value<double>("pulse_amplitude", 400.0);
+    random_.seed(conf.value<uint64_t>("random_seed", 0));
+
+    for (size_t idx = 0; idx < poolSize; ++idx) {
+      // the buffers are padded to whole words, for the generators' benefit
+      std::shared_ptr<uint64_t> buffer(new uint64_t[(bufferSize_ + 7) / 8 + 1], std::default_delete<uint64_t[]>());
+      char* bufferStart = reinterpret_cast<char*>(buffer.get());
+      switch (mode_) {
+        case Mode::Constant:
+          memset(bufferStart, 'X', bufferSize_);
+          break;
+        case Mode::Random:
+          fillRandom_(buffer.get(), (bufferSize_ + 7) / 8);
+          break;
+        case Mode::Entropy:
+          fillEntropy_(reinterpret_cast<uint8_t*>(bufferStart));
+          break;
+        case Mode::ADC:
+          fillADCFrames_(bufferStart, idx);
+          break;
+      }
+      pool_.push_back(std::move(buffer));
+    }
+  }
+
+  Mode getMode() const { return mode_; }
+  size_t getPoolSize() const { return pool_.size(); }
+  size_t getBufferSize() const { return bufferSize_; }
+
+  /**
+   * @brief Returns one of the payload buffers; consecutive indices cycle through the pool.
+   */
+  const void* getBuffer(size_t index) const { return pool_[index % pool_.size()].get(); }
+
+  /**
+   * @brief Returns one of the payload buffers, with shared ownership, for data
+   * blocks that may outlive this generator (e.g. while they wait in a queue).
+   */
+  std::shared_ptr<const void> getSharedBuffer(size_t index) const { return pool_[index % pool_.size()]; }
+
+  /**
+   * @brief Returns the size of an ADC frame (header and packed samples) with the specified sample size.
+   */
+  static size_t getFrameSize(int adcBits) { return sizeof(FrameHeader) + CHANNELS_PER_FRAME * adcBits / 8; }
+
+  /**
+   * @brief Extracts the ADC sample of the specified channel from a packed frame.
+   */
+  static uint16_t getSample(const void* frameStart, size_t channel)
+  {
+    FrameHeader header;
+    memcpy(&header, frameStart, sizeof(header));
+    const uint8_t* samples = static_cast<const uint8_t*>(frameStart) + sizeof(header);
+    size_t bitOffset = channel * header.adcBits;
+    uint32_t word = 0;
+    memcpy(&word, samples + bitOffset / 8, std::min<size_t>(4, CHANNELS_PER_FRAME * header.adcBits / 8 - bitOffset / 8));
+    return (word >> (bitOffset % 8)) & ((1u << header.adcBits) - 1);
+  }
+
+private:
+  /**
+   * @brief xoshiro256** generator: a few shifts and multiplies per 64 random bits,
+   * which the compiler can keep in registers.
+   */
+  struct FastRandom
+  {
+    uint64_t state[4];
+
+    void seed(uint64_t seedValue)
+    {
+      // splitmix64, to spread the seed over the whole state
+      for (auto& word : state) {
+        seedValue += 0x9e3779b97f4a7c15;
+        uint64_t mixed = seedValue;
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111eb;
+        word = mixed ^ (mixed >> 31);
+      }
+    }
+
+    static uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+    uint64_t next()
+    {
+      const uint64_t result = rotl(state[1] * 5, 7) * 9;
+      const uint64_t shifted = state[1] << 17;
+      state[2] ^= state[0];
+      state[3] ^= state[1];
+      state[1] ^= state[2];
+      state[0] ^= state[3];
+      state[2] ^= shifted;
+      state[3] = rotl(state[3], 45);
+      return result;
+    }
+
+    // uniform in [0, 1)
+    double nextDouble() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // approximately standard normal: the sum of four uniforms, scaled to unit variance
+    double nextGaussian()
+    {
+      uint64_t bits = next();
+      double sum = 0;
+      for (int idx = 0; idx < 4; ++idx) {
+        sum += (bits & 0xffff) / 65536.0;
+        bits >>= 16;
+      }
+      return (sum - 2.0) * 1.7320508075688772;
+    }
+  };
+
+  void fillRandom_(uint64_t* words, size_t wordCount)
+  {
+    for (size_t idx = 0; idx < wordCount; ++idx) {
+      words[idx] = random_.next();
+    }
+  }
+
+  void fillEntropy_(uint8_t* bytes)
+  {
+    // uniform symbols from an alphabet of 2^bits entries carry "bits" of entropy each
+    const uint32_t alphabetSize = static_cast<uint32_t>(std::round(std::pow(2.0, entropyBitsPerByte_)));
+    for (size_t idx = 0; idx < bufferSize_;) {
+      uint64_t bits = random_.next();
+      for (int part = 0; part < 4 && idx < bufferSize_; ++part, ++idx) {
+        bytes[idx] = static_cast<uint8_t>(((bits & 0xffff) * alphabetSize) >> 16);
+        bits >>= 16;
+      }
+    }
+  }
+
+  void fillADCFrames_(char* bufferStart, size_t bufferIndex)
+  {
+    const size_t frameSize = getFrameSize(adcBits_);
+    const uint32_t maxSample = (1u << adcBits_) - 1;
+    memset(bufferStart, 0, bufferSize_);
+
+    // each channel has its own pedestal, and a pulse decays over several frames
+    std::vector<double> pedestals(CHANNELS_PER_FRAME);
+    std::vector<double> pulseHeights(CHANNELS_PER_FRAME, 0.0);
+    for (auto& pedestal : pedestals) {
+      pedestal = adcPedestal_ + 20.0 * random_.nextGaussian();
+    }
+
+    std::vector<uint8_t> packed(CHANNELS_PER_FRAME * adcBits_ / 8 + 4);
+    for (size_t frameIdx = 0; (frameIdx + 1) * frameSize <= bufferSize_; ++frameIdx) {
+      FrameHeader header;
+      header.magic = FRAME_MAGIC;
+      header.adcBits = adcBits_;
+      header.bufferIndex = bufferIndex;
+      header.timestamp = frameIdx * TICKS_PER_FRAME;
+
+      std::fill(packed.begin(), packed.end(), 0);
+      for (size_t channel = 0; channel < CHANNELS_PER_FRAME; ++channel) {
+        if (random_.nextDouble() < pulseProbability_) {
+          pulseHeights[channel] += pulseAmplitude_ * (0.5 + random_.nextDouble());
+        }
+        double value = pedestals[channel] + pulseHeights[channel] + adcNoiseRms_ * random_.nextGaussian();
+        pulseHeights[channel] *= 0.8;
+        uint32_t sample = static_cast<uint32_t>(std::min(std::max(std::round(value), 0.0), static_cast<double>(maxSample)));
+
+        size_t bitOffset = channel * adcBits_;
+        uint32_t word;
+        memcpy(&word, &packed[bitOffset / 8], sizeof(word));
+        word |= sample << (bitOffset % 8);
+        memcpy(&packed[bitOffset / 8], &word, sizeof(word));
+      }
+
+      char* frameStart = bufferStart + frameIdx * frameSize;
+      memcpy(frameStart, &header, sizeof(header));
+      memcpy(frameStart + sizeof(header), packed.data(), frameSize - sizeof(header));
+    }
+  }
+
+  size_t bufferSize_;
+  Mode mode_;
+  double entropyBitsPerByte_;
+  int adcBits_;
+  double adcPedestal_;
+  double adcNoiseRms_;
+  double pulseProbability_;
+  double pulseAmplitude_;
+  FastRandom random_;
+  std::vector<std::shared_ptr<uint64_t>> pool_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_PAYLOADGENERATOR_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
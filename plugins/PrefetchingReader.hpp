@@ -0,0 +1,245 @@
+#ifndef DDPDEMO_SRC_PREFETCHINGREADER_HPP_
+#define DDPDEMO_SRC_PREFETCHINGREADER_HPP_
+/**
+ * @file PrefetchingReader.hpp
+ *
+ * PrefetchingReader reads the data blocks of a known sequence of keys ahead
+ * of the consumer, on background threads, so that a consumer that walks the
+ * keys in order (e.g. a transfer or a replay) rarely waits for a cold read.
+ * The read-ahead is limited both in the number of keys and in bytes.  Beyond
+ * that, the store is told (with DataStore::adviseWillRead, e.g. as a
+ * posix_fadvise() hint) about the keys that will be read next, so that their
+ * data can already be on its way into the page cache without holding memory.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief PrefetchingReader hands out the data blocks of a sequence of keys, in
+ * order, reading them ahead of time.
+ */
+class PrefetchingReader
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_DEPTH = 16;
+  static constexpr size_t REASONABLE_DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+  /**
+   * @brief Starts reading ahead.
+   * @param dataStore Store to read from
+   * @param keyList Keys, in the order in which the data blocks will be taken
+   * @param depth Maximum number of data blocks that are read ahead of the consumer
+   * @param maxBytes Maximum number of bytes that are held ahead of the consumer
+   *   (a single data block is always read, however large it is)
+   * @param threadCount Number of background reader threads
+   * @param storeMutex If not null, the reads are serialized with this mutex
+   *   (for stores that are not thread-safe)
+   */
+  PrefetchingReader(DataStore& dataStore,
+                    std::vector<StorageKey> keyList,
+                    size_t depth = REASONABLE_DEFAULT_DEPTH,
+                    size_t maxBytes = REASONABLE_DEFAULT_MAX_BYTES,
+                    size_t threadCount = 1,
+                    std::mutex* storeMutex = nullptr)
+    : dataStore_(dataStore)
+    , keyList_(std::move(keyList))
+    , depth_(std::max(depth, static_cast<size_t>(1)))
+    , maxBytes_(maxBytes)
+    , storeMutex_(storeMutex)
+    , nextReadIndex_(0)
+    , nextTakeIndex_(0)
+    , heldBytes_(0)
+    , stopping_(false)
+    , hitCount_(0)
+    , missCount_(0)
+    , readNanosec_(0)
+  {
+    threadCount = std::max(threadCount, static_cast<size_t>(1));
+    for (size_t idx = 0; idx < threadCount; ++idx) {
+      threads_.emplace_back(&PrefetchingReader::prefetch_, this);
+    }
+  }
+
+  ~PrefetchingReader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    readCondition_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  PrefetchingReader(const PrefetchingReader&) = delete;
+  PrefetchingReader& operator=(const PrefetchingReader&) = delete;
+
+  /**
+   * @brief Takes the data block of the next key in the sequence, waiting for
+   * it if it has not been read yet.  An exception from the read of that key
+   * is thrown here.
+   * @return false once all of the keys have been taken
+   */
+  bool next(KeyedDataBlock& dataBlock)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (nextTakeIndex_ >= keyList_.size()) {
+      return false;
+    }
+    Slot& slot = slots_[nextTakeIndex_ % depth_];
+    if (slotIsReady_(nextTakeIndex_)) {
+      ++hitCount_;
+    } else {
+      ++missCount_;
+      takeCondition_.wait(lock, [&] { return slotIsReady_(nextTakeIndex_); });
+    }
+
+    std::exception_ptr error = slot.error;
+    dataBlock = std::move(*slot.dataBlock);
+    slot.dataBlock.reset();
+    slot.error = nullptr;
+    slot.ready = false;
+    heldBytes_ -= slot.bytes;
+    ++nextTakeIndex_;
+    lock.unlock();
+    readCondition_.notify_all();
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Returns the number of data blocks that were ready when they were taken.
+   */
+  size_t getHitCount() const { return hitCount_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the number of data blocks that had to be waited for.
+   */
+  size_t getMissCount() const { return missCount_.load(std::memory_order_relaxed); }
+
+  double getHitRate() const
+  {
+    size_t total = getHitCount() + getMissCount();
+    return (total > 0) ? static_cast<double>(getHitCount()) / total : 0.0;
+  }
+
+  /**
+   * @brief Returns the time that the background threads spent in reads.
+   */
+  uint64_t getReadNanosec() const { return readNanosec_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot
+  {
+    std::unique_ptr<KeyedDataBlock> dataBlock;
+    std::exception_ptr error;
+    size_t bytes = 0;
+    bool ready = false;
+  };
+
+  bool slotIsReady_(size_t index) const { return slots_[index % depth_].ready; }
+
+  // is there room to read the specified key ahead of the consumer?
+  bool canReadAhead_(size_t index) const
+  {
+    return index - nextTakeIndex_ < depth_ && (heldBytes_ < maxBytes_ || index == nextTakeIndex_);
+  }
+
+  void prefetch_()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      readCondition_.wait(lock, [&] {
+        return stopping_ || nextReadIndex_ >= keyList_.size() || canReadAhead_(nextReadIndex_);
+      });
+      if (stopping_ || nextReadIndex_ >= keyList_.size()) {
+        return;
+      }
+      const size_t index = nextReadIndex_++;
+      Slot& slot = slots_[index % depth_];
+      lock.unlock();
+
+      std::unique_ptr<KeyedDataBlock> dataBlock;
+      std::exception_ptr error;
+      auto readStart = std::chrono::steady_clock::now();
+      try {
+        std::unique_lock<std::mutex> storeLock;
+        if (storeMutex_ != nullptr) {
+          storeLock = std::unique_lock<std::mutex>(*storeMutex_);
+        }
+        // the key that will be read once this one has been taken (each key is hinted once)
+        if (index + depth_ < keyList_.size()) {
+          dataStore_.adviseWillRead(keyList_[index + depth_]);
+        }
+        dataBlock.reset(new KeyedDataBlock(dataStore_.read(keyList_[index])));
+      } catch (...) {
+        dataBlock.reset(new KeyedDataBlock(keyList_[index]));
+        dataBlock->data_size = 0;
+        error = std::current_exception();
+      }
+      readNanosec_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - readStart).count();
+
+      lock.lock();
+      slot.bytes = dataBlock->getDataSizeBytes();
+      slot.dataBlock = std::move(dataBlock);
+      slot.error = error;
+      slot.ready = true;
+      heldBytes_ += slot.bytes;
+      takeCondition_.notify_all();
+    }
+  }
+
+  DataStore& dataStore_;
+  const std::vector<StorageKey> keyList_;
+  const size_t depth_;
+  const size_t maxBytes_;
+  std::mutex* storeMutex_;
+
+  // the slots form a ring of "depth" entries, indexed by the key index modulo depth
+  std::vector<Slot> slots_ = std::vector<Slot>(depth_);
+  size_t nextReadIndex_;
+  size_t nextTakeIndex_;
+  size_t heldBytes_;
+  bool stopping_;
+  std::mutex mutex_;
+  std::condition_variable readCondition_;
+  std::condition_variable takeCondition_;
+  std::vector<std::thread> threads_;
+
+  std::atomic<size_t> hitCount_;
+  std::atomic<size_t> missCount_;
+  std::atomic<uint64_t> readNanosec_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_PREFETCHINGREADER_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,160 @@
+#ifndef DDPDEMO_SRC_QUEUEBATCHWRITER_HPP_
+#define DDPDEMO_SRC_QUEUEBATCHWRITER_HPP_
+/**
+ * @file QueueBatchWriter.hpp
+ *
+ * QueueBatchWriter takes KeyedDataBlocks from a queue and writes them to a
+ * DataStore in batches, with one DataStore::write call per batch.  The first
+ * data block of a batch is waited for, and the rest of the batch is whatever
+ * is already queued, so batching never adds latency.  Several writer threads
+ * may share one QueueBatchWriter (and its statistics).
+ *
+ * The queue type needs can_pop() and pop(item, timeout), where pop throws
+ * TimeoutException if nothing arrives in time (as appfwk::DAQSource does).
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       QueuedDataWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Failed to write a batch of " << count << " data blocks, starting with eventID " << eventID
+                                                     << " and geoLocation " << geoLocation << ".",
+                       ((std::string)name),
+                       ((size_t)count)((int)eventID)((int)geoLocation))
+
+namespace ddpdemo {
+
+/**
+ * @brief QueueBatchWriter writes the data blocks from a queue to a DataStore, in batches.
+ */
+template<typename Queue, typename TimeoutException>
+class QueueBatchWriter
+{
+public:
+  /**
+   * @brief Statistics of the writes.  The interval counts are meant to be
+   * reported and reset (with exchange) periodically; the totals cover the run.
+   * Only data blocks that were written are counted as written; the data
+   * blocks of failed batches are counted separately.
+   */
+  struct Statistics
+  {
+    std::atomic<size_t> blockCount{ 0 };
+    std::atomic<size_t> byteCount{ 0 };
+    std::atomic<size_t> batchCount{ 0 };
+    std::atomic<size_t> fullBatchCount{ 0 };
+    std::atomic<size_t> emptyPollCount{ 0 };
+    std::atomic<size_t> failedBatchCount{ 0 };
+    std::atomic<size_t> failedBlockCount{ 0 };
+    std::atomic<size_t> totalBlockCount{ 0 };
+    std::atomic<size_t> totalFailedBlockCount{ 0 };
+  };
+
+  QueueBatchWriter(const std::string& name, Queue& queue, size_t batchSize, std::chrono::milliseconds queueTimeout)
+    : name_(name)
+    , queue_(queue)
+    , batchSize_(batchSize)
+    , queueTimeout_(queueTimeout)
+  {}
+
+  /**
+   * @brief Writes batches to the store until the running flag is cleared and
+   * the queue has been drained.  If storeMutex is not null, the writes are
+   * serialized with it (for a store that is shared by several threads and is
+   * not thread-safe).
+   */
+  void run(DataStore& store, std::mutex* storeMutex, const std::atomic<bool>& runningFlag)
+  {
+    std::vector<KeyedDataBlock> batch;
+    batch.reserve(batchSize_);
+    while (true) {
+      batch.clear();
+      while (batch.size() < batchSize_) {
+        if (!batch.empty() && !queue_.can_pop()) {
+          break;
+        }
+        KeyedDataBlock dataBlock(
+          StorageKey(StorageKey::INVALID_EVENTID, StorageKey::INVALID_DETECTORID, StorageKey::INVALID_GEOLOCATION));
+        try {
+          queue_.pop(dataBlock, queueTimeout_);
+        } catch (const TimeoutException&) {
+          break;
+        }
+        batch.push_back(std::move(dataBlock));
+      }
+
+      if (batch.empty()) {
+        ++statistics_.emptyPollCount;
+        if (!runningFlag.load()) {
+          break;
+        }
+        continue;
+      }
+
+      writeBatch_(store, storeMutex, batch);
+    }
+  }
+
+  Statistics& getStatistics() { return statistics_; }
+
+private:
+  std::string name_;
+  Queue& queue_;
+  size_t batchSize_;
+  std::chrono::milliseconds queueTimeout_;
+  Statistics statistics_;
+
+  void writeBatch_(DataStore& store, std::mutex* storeMutex, const std::vector<KeyedDataBlock>& batch)
+  {
+    size_t bytes = 0;
+    for (auto& dataBlock : batch) {
+      bytes += dataBlock.getDataSizeBytes();
+    }
+    ++statistics_.batchCount;
+    if (batch.size() == batchSize_) {
+      ++statistics_.fullBatchCount;
+    }
+
+    try {
+      if (storeMutex != nullptr) {
+        std::lock_guard<std::mutex> lock(*storeMutex);
+        store.write(batch);
+      } else {
+        store.write(batch);
+      }
+    } catch (const ers::Issue& excpt) {
+      ers::error(QueuedDataWriteFailed(ERS_HERE, name_, batch.size(), batch[0].data_key.getEventID(),
+                                       batch[0].data_key.getGeoLocation(), excpt));
+      ++statistics_.failedBatchCount;
+      statistics_.failedBlockCount += batch.size();
+      statistics_.totalFailedBlockCount += batch.size();
+      return;
+    }
+
+    statistics_.blockCount += batch.size();
+    statistics_.totalBlockCount += batch.size();
+    statistics_.byteCount += bytes;
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_QUEUEBATCHWRITER_HPP_
@@ -0,0 +1,269 @@
+#ifndef DDPDEMO_SRC_RATEPACER_HPP_
+#define DDPDEMO_SRC_RATEPACER_HPP_
+/**
+ * @file RatePacer.hpp
+ *
+ * RatePacer schedules the output of a data generator so that it follows a
+ * target event rate (or byte rate), with an optional burst profile.  It is a
+ * token bucket: when the generator falls behind its schedule, it may catch up
+ * with a burst of up to the bucket depth, and any shortfall beyond that is
+ * given up (and reported) rather than made up later.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include <ers/Issue.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  InvalidRateProfile,
+                  "The rate profile \"" << profile
+                                        << "\" is not supported; the supported profiles are \"constant\", "
+                                           "\"poisson\", \"periodic\" and \"ramp\".",
+                  ((std::string)profile))
+
+namespace ddpdemo {
+
+/**
+ * @brief RatePacer tells a data generator when to send each event.
+ *
+ * The supported profiles are:
+ *   "constant": evenly spaced events at the target rate
+ *   "poisson":  exponentially distributed gaps, with the target rate on average
+ *   "periodic": spills of "spill_duration_msec" every "spill_period_msec", with
+ *               no output in between; the target rate is the average over a period
+ *   "ramp":     a linear increase from "ramp_start_fraction" of the target rate
+ *               to the full target rate over "ramp_duration_msec"
+ */
+class RatePacer
+{
+public:
+  enum class Profile
+  {
+    Constant,
+    Poisson,
+    Periodic,
+    Ramp
+  };
+
+  static constexpr size_t REASONABLE_DEFAULT_BUCKET_DEPTH_MSEC = 100;
+  static constexpr size_t REASONABLE_DEFAULT_SPILL_PERIOD_MSEC = 1000;
+  static constexpr size_t REASONABLE_DEFAULT_SPILL_DURATION_MSEC = 100;
+  static constexpr size_t REASONABLE_DEFAULT_RAMP_DURATION_MSEC = 60000;
+  static constexpr std::chrono::milliseconds MAX_SLEEP_INTERVAL = std::chrono::milliseconds(100);
+  static constexpr double ROUNDING_SLACK_SEC = 1.0e-9;
+
+  /**
+   * @brief Reads the pacing parameters from the specified configuration.  The
+   * target is "target_events_per_sec" or, if that is not given, "target_bytes_per_sec"
+   * divided by the size of each event.  Pacing is disabled if neither is given.
+   */
+  RatePacer(const nlohmann::json& conf, double eventBytes)
+    : eventCount_(0)
+    , maxLagSec_(0)
+    , droppedCreditSec_(0)
+  {
+    eventRate_ = conf.value<double>("target_events_per_sec", 0.0);
+    if (eventRate_ <= 0 && eventBytes > 0) {
+      eventRate_ = conf.value<double>("target_bytes_per_sec", 0.0) / eventBytes;
+    }
+    eventBytes_ = eventBytes;
+
+    std::string profileName = conf.value<std::string>("rate_profile", "constant");
+    if (profileName == "constant") {
+      profile_ = Profile::Constant;
+    } else if (profileName == "poisson") {
+      profile_ = Profile::Poisson;
+    } else if (profileName == "periodic") {
+      profile_ = Profile::Periodic;
+    } else if (profileName == "ramp") {
+      profile_ = Profile::Ramp;
+    } else {
+      throw InvalidRateProfile(ERS_HERE, profileName);
+    }
+
+    bucketDepthSec_ = conf.value<size_t>("bucket_depth_msec", REASONABLE_DEFAULT_BUCKET_DEPTH_MSEC) / 1000.0;
+    spillPeriodSec_ = conf.value<size_t>("spill_period_msec", REASONABLE_DEFAULT_SPILL_PERIOD_MSEC) / 1000.0;
+    spillDurationSec_ = conf.value<size_t>("spill_duration_msec", REASONABLE_DEFAULT_SPILL_DURATION_MSEC) / 1000.0;
+    spillDurationSec_ = std::max(std::min(spillDurationSec_, spillPeriodSec_), 0.001);
+    spillPeriodSec_ = std::max(spillPeriodSec_, spillDurationSec_);
+    rampDurationSec_ = conf.value<size_t>("ramp_duration_msec", REASONABLE_DEFAULT_RAMP_DURATION_MSEC) / 1000.0;
+    rampStartFraction_ = std::min(std::max(conf.value<double>("ramp_start_fraction", 0.1), 0.001), 1.0);
+    randomEngine_.seed(conf.value<uint64_t>("random_seed", 0));
+
+    start(std::chrono::steady_clock::now());
+  }
+
+  bool isEnabled() const { return eventRate_ > 0; }
+
+  /**
+   * @brief Restarts the schedule (and the statistics) at the specified time.
+   */
+  void start(std::chrono::steady_clock::time_point now)
+  {
+    startTime_ = now;
+    scheduledSec_ = 0;
+    eventCount_ = 0;
+    maxLagSec_ = 0;
+    droppedCreditSec_ = 0;
+  }
+
+  /**
+   * @brief Reserves the next event, and returns the time at which it should be sent.
+   */
+  std::chrono::steady_clock::time_point reserve(std::chrono::steady_clock::time_point now)
+  {
+    const double nowSec = getSecondsSinceStart_(now);
+    const double lagSec = nowSec - scheduledSec_;
+    maxLagSec_ = std::max(maxLagSec_, lagSec);
+    if (lagSec > bucketDepthSec_) {
+      droppedCreditSec_ += lagSec - bucketDepthSec_;
+      scheduledSec_ = nowSec - bucketDepthSec_;
+    }
+
+    double dueSec = scheduledSec_;
+    if (profile_ == Profile::Periodic) {
+      // events that fall between spills are moved to the start of the next spill
+      // (with a little slack for the rounding of the accumulated intervals)
+      double phase = std::fmod(dueSec + ROUNDING_SLACK_SEC, spillPeriodSec_) - ROUNDING_SLACK_SEC;
+      if (phase >= spillDurationSec_ - ROUNDING_SLACK_SEC) {
+        dueSec += spillPeriodSec_ - phase;
+      }
+    }
+    scheduledSec_ = dueSec + getInterval_(dueSec);
+    ++eventCount_;
+
+    return startTime_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                          std::chrono::duration<double>(std::max(dueSec, 0.0)));
+  }
+
+  /**
+   * @brief Waits until the next event should be sent.  Returns false if the
+   * wait was abandoned because the running flag was cleared.
+   */
+  bool acquire(const std::atomic<bool>& running_flag)
+  {
+    auto dueTime = reserve(std::chrono::steady_clock::now());
+    // long waits (e.g. between spills) are split up, so that a stop is not held up
+    while (std::chrono::steady_clock::now() < dueTime) {
+      if (!running_flag.load()) {
+        return false;
+      }
+      std::this_thread::sleep_until(std::min(dueTime, std::chrono::steady_clock::now() + MAX_SLEEP_INTERVAL));
+    }
+    return true;
+  }
+
+  /**
+   * @brief Returns the number of events that the profile calls for between the
+   * start and the specified number of seconds after it.
+   */
+  double getExpectedEventCount(double secondsSinceStart) const
+  {
+    const double elapsed = std::max(secondsSinceStart, 0.0);
+    switch (profile_) {
+      case Profile::Periodic: {
+        double fullPeriods = std::floor(elapsed / spillPeriodSec_);
+        double phase = elapsed - fullPeriods * spillPeriodSec_;
+        double spillRate = eventRate_ * spillPeriodSec_ / spillDurationSec_;
+        return spillRate * (fullPeriods * spillDurationSec_ + std::min(phase, spillDurationSec_));
+      }
+      case Profile::Ramp: {
+        double rampTime = std::min(elapsed, rampDurationSec_);
+        double rampCount = eventRate_ * (rampStartFraction_ * rampTime +
+                                         (1 - rampStartFraction_) * rampTime * rampTime / (2 * rampDurationSec_));
+        return rampCount + eventRate_ * (elapsed - rampTime);
+      }
+      default:
+        return eventRate_ * elapsed;
+    }
+  }
+
+  size_t getEventCount() const { return eventCount_; }
+
+  /**
+   * @brief Returns a summary of the achieved rate, compared with the target.
+   */
+  std::string getReport(std::chrono::steady_clock::time_point now) const
+  {
+    const double elapsed = getSecondsSinceStart_(now);
+    const double expected = getExpectedEventCount(elapsed);
+    const double achievedRate = (elapsed > 0) ? eventCount_ / elapsed : 0;
+    const double shortfall = (expected > 0) ? std::max(1.0 - eventCount_ / expected, 0.0) : 0;
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1) << "achieved " << achievedRate << " events/s ("
+        << achievedRate * eventBytes_ / 1.0e6 << " MB/s) against an average target of "
+        << ((elapsed > 0) ? expected / elapsed : eventRate_) << " events/s, a shortfall of " << shortfall * 100
+        << "%; the output was up to " << maxLagSec_ * 1000 << " msec behind schedule, and " << droppedCreditSec_ * 1000
+        << " msec of the schedule was given up";
+    return oss.str();
+  }
+
+private:
+  double getSecondsSinceStart_(std::chrono::steady_clock::time_point now) const
+  {
+    return std::chrono::duration<double>(now - startTime_).count();
+  }
+
+  double getInterval_(double atSec)
+  {
+    switch (profile_) {
+      case Profile::Poisson: {
+        std::exponential_distribution<double> gapDistribution(eventRate_);
+        return gapDistribution(randomEngine_);
+      }
+      case Profile::Periodic:
+        return spillDurationSec_ / (eventRate_ * spillPeriodSec_);
+      case Profile::Ramp: {
+        double fraction = rampStartFraction_ + (1 - rampStartFraction_) * std::min(atSec / rampDurationSec_, 1.0);
+        return 1.0 / (eventRate_ * fraction);
+      }
+      default:
+        return 1.0 / eventRate_;
+    }
+  }
+
+  // Configuration
+  double eventRate_;
+  double eventBytes_;
+  Profile profile_;
+  double bucketDepthSec_;
+  double spillPeriodSec_;
+  double spillDurationSec_;
+  double rampDurationSec_;
+  double rampStartFraction_;
+  std::mt19937_64 randomEngine_;
+
+  // Schedule, in seconds since the start
+  std::chrono::steady_clock::time_point startTime_;
+  double scheduledSec_;
+
+  // Statistics
+  size_t eventCount_;
+  double maxLagSec_;
+  double droppedCreditSec_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_RATEPACER_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
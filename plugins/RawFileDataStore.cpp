@@ -0,0 +1,3 @@
+#include "RawFileDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::RawFileDataStore)
@@ -0,0 +1,481 @@
+#ifndef DDPDEMO_SRC_RAWFILEDATASTORE_HPP_
+#define DDPDEMO_SRC_RAWFILEDATASTORE_HPP_
+
+/**
+ * @file RawFileDataStore.hpp
+ *
+ * An implementation of the DataStore interface that appends data blocks
+ * to a flat binary log file and records the location and true length of
+ * each block in a separate index file.  The log file can optionally be
+ * written with O_DIRECT so that large data volumes bypass the page cache.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "FileMappingCache.hpp"
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       RawFileOperationFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Unable to " << operation << " file \"" << filename << "\": " << reason,
+                       ((std::string)name),
+                       ((std::string)operation)((std::string)filename)((std::string)reason))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       RawFileKeyNotFound,
+                       appfwk::GeneralDAQModuleIssue,
+                       "No data block with eventID " << eventID << " and geoLocation " << geoLocation
+                                                     << " exists in file \"" << filename << "\"",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation)((std::string)filename))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       DirectIOUnavailable,
+                       appfwk::GeneralDAQModuleIssue,
+                       "O_DIRECT could not be enabled for file \"" << filename << "\" (" << reason
+                                                                   << "), falling back to buffered writes.",
+                       ((std::string)name),
+                       ((std::string)filename)((std::string)reason))
+
+namespace ddpdemo {
+
+/**
+ * @brief RawFileDataStore writes data blocks back-to-back into a single
+ * binary file, using an aligned staging buffer so that the writes to disk
+ * are large and, in direct-I/O mode, satisfy the O_DIRECT alignment rules.
+ */
+class RawFileDataStore : public DataStore
+{
+public:
+  static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+  static constexpr size_t REASONABLE_DEFAULT_STAGING_BUFFER_SIZE = 4 * 1024 * 1024;
+
+  /**
+   * @brief Entry in the index file.  The offset is the position of the
+   * data block in the data file, and the size is the true (unpadded) length.
+   */
+  struct IndexRecord
+  {
+    int32_t event_id;
+    int32_t geo_location;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  explicit RawFileDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , dataFd_(-1)
+    , readFd_(-1)
+    , flushedOffset_(0)
+    , stagingFill_(0)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    std::string path = conf["directory_path"].get<std::string>();
+    std::string prefix = conf["filename_prefix"].get<std::string>();
+    dataFileName_ = path + "/" + prefix + "_raw.dat";
+    indexFileName_ = path + "/" + prefix + "_raw.idx";
+
+    directIO_ = conf.value<bool>("direct_io", false);
+    alignment_ = directIO_ ? DIRECT_IO_ALIGNMENT : 1;
+
+    // the staging buffer is always a whole number of alignment blocks, and at least one
+    stagingSize_ = conf.value<size_t>("staging_buffer_size", REASONABLE_DEFAULT_STAGING_BUFFER_SIZE);
+    stagingSize_ = std::max(stagingSize_, DIRECT_IO_ALIGNMENT);
+    stagingSize_ = ((stagingSize_ + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT) * DIRECT_IO_ALIGNMENT;
+
+    // in "mmap" read mode, the data that is on disk is returned as views of a mapping of the data file
+    std::string readMode = conf.value<std::string>("read_mode", "copy");
+    if (readMode == "mmap") {
+      mappingCache_.reset(new FileMappingCache(conf.value<std::string>("mmap_advice", "normal")));
+    } else if (readMode != "copy") {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "select read mode \"" + readMode + "\" for", dataFileName_,
+                                   "the supported read modes are \"copy\" and \"mmap\"");
+    }
+
+    // anything that is already in the data file can be read back directly
+    struct stat fileStats;
+    if (stat(dataFileName_.c_str(), &fileStats) == 0) {
+      flushedOffset_ = fileStats.st_size;
+    }
+    loadIndex_();
+  }
+
+  ~RawFileDataStore()
+  {
+    try {
+      flush();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    if (dataFd_ >= 0) {
+      close(dataFd_);
+    }
+    if (readFd_ >= 0) {
+      close(readFd_);
+    }
+  }
+
+  virtual void setup(const size_t) override { ; }
+
+  /**
+   * @brief Appends the data block to the staging buffer, writing the buffer
+   * out to disk each time that it fills up.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    openDataFileIfNeeded_();
+
+    IndexRecord record;
+    record.event_id = dataBlock.data_key.getEventID();
+    record.geo_location = dataBlock.data_key.getGeoLocation();
+    record.offset = flushedOffset_ + stagingFill_;
+    record.size = dataBlock.getDataSizeBytes();
+
+    TLOG(TLVL_DEBUG) << get_name() << ": Writing data with event ID " << record.event_id << " and geolocation ID "
+                     << record.geo_location << " at offset " << record.offset;
+
+    // the index record is appended to the index file as soon as all of the
+    // data block has been written to disk
+    pendingIndexRecords_.push_back(record);
+    addToIndex_(record);
+
+    const char* dataPtr = static_cast<const char*>(dataBlock.getDataStart());
+    size_t remaining = record.size;
+    while (remaining > 0) {
+      size_t chunk = std::min(remaining, stagingSize_ - stagingFill_);
+      memcpy(stagingBuffer_.get() + stagingFill_, dataPtr, chunk);
+      stagingFill_ += chunk;
+      dataPtr += chunk;
+      remaining -= chunk;
+      if (stagingFill_ == stagingSize_) {
+        writeStagingBuffer_();
+      }
+    }
+  }
+
+  /**
+   * @brief Writes out any partially-filled staging buffer (padded to the
+   * alignment boundary in direct-I/O mode), which also appends the index
+   * entries for the data that is now on disk to the index file.
+   */
+  virtual void flush() override
+  {
+    if (stagingFill_ > 0) {
+      writeStagingBuffer_();
+    }
+    appendIndexRecords_();
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    const IndexRecord& record = findRecord_(key);
+    return readRange_(key, record, 0, record.size);
+  }
+
+  /**
+   * @brief Reads only the requested range of the data block, with pread.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    const IndexRecord& record = findRecord_(key);
+    const size_t rangeOffset = std::min<size_t>(offset, record.size);
+    return readRange_(key, record, rangeOffset, std::min<size_t>(length, record.size - rangeOffset));
+  }
+
+  /**
+   * @brief Asks the kernel to start reading the part of the data block that
+   * has already been written to disk into the page cache.
+   */
+  virtual void adviseWillRead(const StorageKey& key) override
+  {
+    auto iter = indexLookup_.find(std::make_pair(key.getEventID(), key.getGeoLocation()));
+    if (iter == indexLookup_.end()) {
+      return;
+    }
+    const IndexRecord& record = index_[iter->second];
+    if (record.offset >= flushedOffset_ || record.size == 0) {
+      return;
+    }
+    try {
+      openReadFileIfNeeded_();
+    } catch (const RawFileOperationFailed&) {
+      return; // the read reports the problem
+    }
+    posix_fadvise(readFd_, record.offset, std::min<uint64_t>(record.size, flushedOffset_ - record.offset),
+                  POSIX_FADV_WILLNEED);
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::vector<StorageKey> keyList;
+    for (auto& record : index_) {
+      keyList.emplace_back(record.event_id, StorageKey::INVALID_DETECTORID, record.geo_location);
+    }
+    return keyList;
+  }
+
+  /**
+   * @brief Whether the data file is written with O_DIRECT, which is only known
+   * once the file has been opened for writing (the filesystem may not support it).
+   */
+  bool usesDirectIO() const { return directIO_; }
+
+private:
+  RawFileDataStore(const RawFileDataStore&) = delete;
+  RawFileDataStore& operator=(const RawFileDataStore&) = delete;
+  RawFileDataStore(RawFileDataStore&&) = delete;
+  RawFileDataStore& operator=(RawFileDataStore&&) = delete;
+
+  struct FreeDeleter
+  {
+    void operator()(char* ptr) const { free(ptr); } // NOLINT
+  };
+
+  std::string dataFileName_;
+  std::string indexFileName_;
+  bool directIO_;
+  size_t alignment_;
+  size_t stagingSize_;
+
+  int dataFd_;
+  int readFd_;
+  uint64_t flushedOffset_;
+  std::unique_ptr<char, FreeDeleter> stagingBuffer_;
+  size_t stagingFill_;
+
+  std::vector<IndexRecord> index_;
+  std::map<std::pair<int, int>, size_t> indexLookup_;
+  std::vector<IndexRecord> pendingIndexRecords_;
+
+  // only in mmap read mode
+  std::unique_ptr<FileMappingCache> mappingCache_;
+
+  void addToIndex_(const IndexRecord& record)
+  {
+    auto lookupKey = std::make_pair(static_cast<int>(record.event_id), static_cast<int>(record.geo_location));
+    auto iter = indexLookup_.find(lookupKey);
+    if (iter != indexLookup_.end()) {
+      // a re-written block replaces the earlier one
+      index_[iter->second] = record;
+    } else {
+      indexLookup_[lookupKey] = index_.size();
+      index_.push_back(record);
+    }
+  }
+
+  void loadIndex_()
+  {
+    FILE* indexFile = fopen(indexFileName_.c_str(), "rb");
+    if (indexFile == nullptr) {
+      return;
+    }
+    IndexRecord record;
+    while (fread(&record, sizeof(IndexRecord), 1, indexFile) == 1) {
+      addToIndex_(record);
+    }
+    fclose(indexFile);
+    TLOG(TLVL_DEBUG) << get_name() << ": Loaded " << index_.size() << " index entries from " << indexFileName_;
+  }
+
+  void openDataFileIfNeeded_()
+  {
+    if (dataFd_ >= 0) {
+      return;
+    }
+
+    int flags = O_WRONLY | O_CREAT;
+    if (directIO_) {
+      dataFd_ = open(dataFileName_.c_str(), flags | O_DIRECT, 0644); // NOLINT
+      if (dataFd_ < 0 && errno == EINVAL) {
+        // some filesystems (e.g. tmpfs) do not support O_DIRECT
+        ers::warning(DirectIOUnavailable(ERS_HERE, get_name(), dataFileName_, strerror(errno)));
+        directIO_ = false;
+        alignment_ = 1;
+      }
+    }
+    if (dataFd_ < 0) {
+      dataFd_ = open(dataFileName_.c_str(), flags, 0644); // NOLINT
+    }
+    if (dataFd_ < 0) {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "open", dataFileName_, strerror(errno));
+    }
+
+    // new data is appended after any existing data, starting on an aligned boundary
+    struct stat fileStats;
+    if (fstat(dataFd_, &fileStats) != 0) {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "stat", dataFileName_, strerror(errno));
+    }
+    flushedOffset_ = ((fileStats.st_size + alignment_ - 1) / alignment_) * alignment_;
+
+    void* bufferPtr = nullptr;
+    if (posix_memalign(&bufferPtr, DIRECT_IO_ALIGNMENT, stagingSize_) != 0) {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "allocate a staging buffer for", dataFileName_, "no memory");
+    }
+    stagingBuffer_.reset(static_cast<char*>(bufferPtr));
+    stagingFill_ = 0;
+  }
+
+  void openReadFileIfNeeded_()
+  {
+    if (readFd_ < 0) {
+      readFd_ = open(dataFileName_.c_str(), O_RDONLY); // NOLINT
+      if (readFd_ < 0) {
+        throw RawFileOperationFailed(ERS_HERE, get_name(), "open", dataFileName_, strerror(errno));
+      }
+    }
+  }
+
+  void writeStagingBuffer_()
+  {
+    // in direct-I/O mode, a partially-filled buffer is padded with zeroes up to
+    // the next alignment boundary.  The index keeps the true length of each block.
+    size_t writeSize = ((stagingFill_ + alignment_ - 1) / alignment_) * alignment_;
+    if (writeSize > stagingFill_) {
+      memset(stagingBuffer_.get() + stagingFill_, 0, writeSize - stagingFill_);
+    }
+
+    size_t written = 0;
+    while (written < writeSize) {
+      ssize_t result = pwrite(dataFd_, stagingBuffer_.get() + written, writeSize - written, flushedOffset_ + written);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw RawFileOperationFailed(ERS_HERE, get_name(), "write to", dataFileName_, strerror(errno));
+      }
+      // with O_DIRECT, each write has to start on an alignment boundary, so the
+      // unaligned tail of a short write is written again as part of the next one
+      size_t alignedWritten = ((written + result) / alignment_) * alignment_;
+      if (alignedWritten <= written) {
+        throw RawFileOperationFailed(ERS_HERE, get_name(), "write to", dataFileName_, "short write");
+      }
+      written = alignedWritten;
+    }
+
+    TLOG(TLVL_DEBUG) << get_name() << ": Wrote " << writeSize << " bytes (" << stagingFill_ << " of data) at offset "
+                     << flushedOffset_;
+    flushedOffset_ += writeSize;
+    stagingFill_ = 0;
+    appendIndexRecords_();
+  }
+
+  // Appends the index records of the data blocks that are now completely on
+  // disk to the index file, so that the data can be found after a crash.
+  // The pending records are in file order, so these are always at the front.
+  void appendIndexRecords_()
+  {
+    size_t count = 0;
+    while (count < pendingIndexRecords_.size() &&
+           pendingIndexRecords_[count].offset + pendingIndexRecords_[count].size <= flushedOffset_) {
+      ++count;
+    }
+    if (count == 0) {
+      return;
+    }
+
+    FILE* indexFile = fopen(indexFileName_.c_str(), "ab");
+    if (indexFile == nullptr) {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "open", indexFileName_, strerror(errno));
+    }
+    size_t written = fwrite(pendingIndexRecords_.data(), sizeof(IndexRecord), count, indexFile);
+    fclose(indexFile);
+    if (written != count) {
+      throw RawFileOperationFailed(ERS_HERE, get_name(), "append to", indexFileName_, "short write");
+    }
+    pendingIndexRecords_.erase(pendingIndexRecords_.begin(), pendingIndexRecords_.begin() + count);
+  }
+
+  const IndexRecord& findRecord_(const StorageKey& key) const
+  {
+    auto iter = indexLookup_.find(std::make_pair(key.getEventID(), key.getGeoLocation()));
+    if (iter == indexLookup_.end()) {
+      throw RawFileKeyNotFound(ERS_HERE, get_name(), key.getEventID(), key.getGeoLocation(), dataFileName_);
+    }
+    return index_[iter->second];
+  }
+
+  KeyedDataBlock readRange_(const StorageKey& key, const IndexRecord& record, size_t offset, size_t length)
+  {
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = length;
+    const uint64_t rangeStart = record.offset + offset;
+
+    if (mappingCache_.get() != nullptr && rangeStart + length <= flushedOffset_) {
+      std::shared_ptr<const char> mapping = mappingCache_->getMapping(dataFileName_, rangeStart + length);
+      if (mapping.get() != nullptr) {
+        dataBlock.shared_data_start = std::shared_ptr<const void>(mapping, mapping.get() + rangeStart);
+        return dataBlock;
+      }
+    }
+
+    std::shared_ptr<char> buffer(new char[length], std::default_delete<char[]>());
+    char* membuffer = buffer.get();
+
+    // the part of the range that has already been written to disk
+    size_t onDiskBytes = 0;
+    if (rangeStart < flushedOffset_) {
+      onDiskBytes = std::min<size_t>(length, flushedOffset_ - rangeStart);
+      openReadFileIfNeeded_();
+      preadFully_(membuffer, onDiskBytes, rangeStart);
+    }
+    // and the part that is still sitting in the staging buffer
+    if (onDiskBytes < length) {
+      size_t stagingOffset = rangeStart + onDiskBytes - flushedOffset_;
+      memcpy(membuffer + onDiskBytes, stagingBuffer_.get() + stagingOffset, length - onDiskBytes);
+    }
+
+    dataBlock.shared_data_start = buffer;
+    return dataBlock;
+  }
+
+  void preadFully_(char* buffer, size_t size, uint64_t offset)
+  {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t result = pread(readFd_, buffer + done, size - done, offset + done);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        throw RawFileOperationFailed(ERS_HERE, get_name(), "read from", dataFileName_,
+                                     result < 0 ? strerror(errno) : "unexpected end of file");
+      }
+      done += result;
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_RAWFILEDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,3 @@
+#include "ShardedDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::ShardedDataStore)
@@ -0,0 +1,454 @@
+#ifndef DDPDEMO_SRC_SHARDEDDATASTORE_HPP_
+#define DDPDEMO_SRC_SHARDEDDATASTORE_HPP_
+
+/**
+ * @file ShardedDataStore.hpp
+ *
+ * An implementation of the DataStore interface that distributes data blocks
+ * over several child DataStores (e.g. one per disk or directory), based on
+ * the geographic location or event ID of each block.  Every shard has its
+ * own worker thread, so writes to different shards proceed in parallel.
+ *
+ * The HDF5 library serializes all of its calls within a process (with its
+ * own global lock when it is built thread-safe, and with the HDF5DataStore's
+ * library mutex otherwise), so several HDF5DataStore shards in one process
+ * do not write in parallel.  To scale HDF5 writes with the number of disks,
+ * each shard can instead be a SocketDataStore that is connected to its own
+ * DataStore server process.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidShardConfiguration,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Invalid shard configuration: " << reason,
+                       ((std::string)name),
+                       ((std::string)reason))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       ShardWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Shard " << shard << " failed to write the data block with eventID " << eventID
+                                << " and geoLocation " << geoLocation << ".",
+                       ((std::string)name),
+                       ((size_t)shard)((int)eventID)((int)geoLocation))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       UnwrittenShardDataBlocks,
+                       appfwk::GeneralDAQModuleIssue,
+                       count << " data blocks could not be written to their shards since the previous flush.",
+                       ((std::string)name),
+                       ((size_t)count))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       HDF5ShardsAreSerialized,
+                       appfwk::GeneralDAQModuleIssue,
+                       count << " of the shards are HDF5DataStores in this process; since the HDF5 library "
+                             << "serializes its calls, they will not write in parallel. Use a SocketDataStore "
+                             << "with its own server process for each HDF5 shard instead.",
+                       ((std::string)name),
+                       ((size_t)count))
+
+namespace ddpdemo {
+
+/**
+ * @brief ShardedDataStore routes each data block to one of N child DataStores,
+ * each of which is written by its own worker thread.
+ */
+class ShardedDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_QUEUE_CAPACITY = 64;
+
+  explicit ShardedDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    routingField_ = conf.value<std::string>("routing_field", "geo_location");
+    if (routingField_ != "geo_location" && routingField_ != "event_id") {
+      throw InvalidShardConfiguration(ERS_HERE, get_name(), "unknown routing_field \"" + routingField_ + "\"");
+    }
+    routingMethod_ = conf.value<std::string>("routing_method", "hash");
+    if (routingMethod_ != "hash" && routingMethod_ != "range") {
+      throw InvalidShardConfiguration(ERS_HERE, get_name(), "unknown routing_method \"" + routingMethod_ + "\"");
+    }
+    rangeWidth_ = conf.value<size_t>("range_width", 1);
+    if (rangeWidth_ == 0) {
+      throw InvalidShardConfiguration(ERS_HERE, get_name(), "range_width must be greater than zero");
+    }
+    queueCapacity_ = conf.value<size_t>("queue_capacity", REASONABLE_DEFAULT_QUEUE_CAPACITY);
+
+    const nlohmann::json& shardConfList = conf["shards"];
+    if (!shardConfList.is_array() || shardConfList.empty()) {
+      throw InvalidShardConfiguration(ERS_HERE, get_name(), "at least one shard must be configured");
+    }
+    size_t hdf5ShardCount = 0;
+    for (auto& shardConf : shardConfList) {
+      std::unique_ptr<Shard> shard(new Shard());
+      shard->store = makeDataStore(shardConf);
+      shards_.push_back(std::move(shard));
+      if (shardConf.value<std::string>("type", "") == "HDF5DataStore") {
+        ++hdf5ShardCount;
+      }
+    }
+    if (hdf5ShardCount > 1) {
+      ers::warning(HDF5ShardsAreSerialized(ERS_HERE, get_name(), hdf5ShardCount));
+    }
+    for (size_t idx = 0; idx < shards_.size(); ++idx) {
+      shards_[idx]->worker = std::thread(&ShardedDataStore::workerLoop_, this, idx);
+    }
+  }
+
+  ~ShardedDataStore()
+  {
+    try {
+      flush();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    for (auto& shard : shards_) {
+      {
+        std::lock_guard<std::mutex> lock(shard->queueMutex);
+        shard->stopRequested = true;
+      }
+      shard->queueCondition.notify_all();
+      shard->worker.join();
+    }
+  }
+
+  virtual void setup(const size_t eventId) override
+  {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+      shard->store->setup(eventId);
+    }
+  }
+
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+      shard->store->attachStatistics(statistics);
+    }
+  }
+
+  /**
+   * @brief Copies the data block onto the queue of the shard that it belongs
+   * to.  If that queue is full, this waits for the shard to catch up.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    std::shared_ptr<QueuedBlock> queuedBlock(new QueuedBlock(dataBlock.data_key));
+    queuedBlock->size = dataBlock.getDataSizeBytes();
+    queuedBlock->data.reset(new char[queuedBlock->size]);
+    memcpy(queuedBlock->data.get(), dataBlock.getDataStart(), queuedBlock->size);
+
+    Shard& shard = *shards_[getShardIndex(dataBlock.data_key)];
+    std::unique_lock<std::mutex> lock(shard.queueMutex);
+    shard.spaceCondition.wait(lock, [&] { return shard.queue.size() < queueCapacity_; });
+    shard.queue.push_back(std::move(queuedBlock));
+    shard.queueCondition.notify_all();
+  }
+
+  /**
+   * @brief Waits for every shard to write out its queue, then flushes all of
+   * the child stores.  If any of the shards failed to write a data block since
+   * the previous flush, UnwrittenShardDataBlocks is thrown.
+   */
+  virtual void flush() override
+  {
+    size_t failedCount = 0;
+    for (auto& shard : shards_) {
+      waitForQueue_(*shard);
+      {
+        std::lock_guard<std::mutex> lock(shard->queueMutex);
+        failedCount += shard->failedCount;
+        shard->failedCount = 0;
+      }
+      std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+      shard->store->flush();
+    }
+    if (failedCount > 0) {
+      throw UnwrittenShardDataBlocks(ERS_HERE, get_name(), failedCount);
+    }
+  }
+
+  /**
+   * @brief Writes the reference to the key's shard, once that shard has
+   * written out its queue (so that a queued copy can not replace the reference).
+   */
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    Shard& shard = *shards_[getShardIndex(key)];
+    waitForQueue_(shard);
+    std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+    return shard.store->writeLink(source, key);
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+      if (!shard->store->acceptsNativeCopy(source)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Copies the data block natively into the key's shard, once that
+   * shard has written out its queue.
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    Shard& shard = *shards_[getShardIndex(key)];
+    waitForQueue_(shard);
+    std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+    return shard.store->writeNativeCopy(source, key);
+  }
+
+  virtual bool materialize(const StorageKey& key) override
+  {
+    Shard& shard = *shards_[getShardIndex(key)];
+    waitForQueue_(shard);
+    std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+    return shard.store->materialize(key);
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    Shard& shard = *shards_[getShardIndex(key)];
+
+    // a data block that has not been written yet is returned from the queue
+    std::shared_ptr<QueuedBlock> queuedBlock;
+    {
+      std::lock_guard<std::mutex> lock(shard.queueMutex);
+      for (auto iter = shard.queue.rbegin(); iter != shard.queue.rend(); ++iter) {
+        if ((*iter)->key == key) {
+          queuedBlock = *iter;
+          break;
+        }
+      }
+      if (queuedBlock.get() == nullptr && shard.inFlight.get() != nullptr && shard.inFlight->key == key) {
+        queuedBlock = shard.inFlight;
+      }
+    }
+    if (queuedBlock.get() != nullptr) {
+      KeyedDataBlock dataBlock(key);
+      dataBlock.data_size = queuedBlock->size;
+      char* membuffer = new char[queuedBlock->size];
+      memcpy(membuffer, queuedBlock->data.get(), queuedBlock->size);
+      std::unique_ptr<char> memPtr(membuffer);
+      dataBlock.owned_data_start = std::move(memPtr);
+      return dataBlock;
+    }
+
+    std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+    return shard.store->read(key);
+  }
+
+  /**
+   * @brief Reads part of a data block; only data blocks that have been
+   * written are read (partially) from the shard's store.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    Shard& shard = *shards_[getShardIndex(key)];
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> lock(shard.queueMutex);
+      for (auto& queuedBlock : shard.queue) {
+        queued = queued || queuedBlock->key == key;
+      }
+      queued = queued || (shard.inFlight.get() != nullptr && shard.inFlight->key == key);
+    }
+    if (queued) {
+      return DataStore::read(key, offset, length);
+    }
+
+    std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+    return shard.store->read(key, offset, length);
+  }
+
+  /**
+   * @brief Returns the union of the keys in all of the shards, including the
+   * data blocks that are still queued.
+   */
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::vector<StorageKey> keyList;
+    std::unordered_set<StorageKey> keySet;
+    for (auto& shard : shards_) {
+      std::vector<StorageKey> shardKeys;
+      {
+        std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+        shardKeys = shard->store->getAllExistingKeys();
+      }
+      {
+        std::lock_guard<std::mutex> lock(shard->queueMutex);
+        if (shard->inFlight.get() != nullptr) {
+          shardKeys.push_back(shard->inFlight->key);
+        }
+        for (auto& queuedBlock : shard->queue) {
+          shardKeys.push_back(queuedBlock->key);
+        }
+      }
+      for (auto& key : shardKeys) {
+        if (keySet.insert(key).second) {
+          keyList.push_back(key);
+        }
+      }
+    }
+    return keyList;
+  }
+
+  /**
+   * @brief Returns the keys that any of the shards stored in the specified file.
+   */
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    std::vector<StorageKey> keyList;
+    std::unordered_set<StorageKey> keySet;
+    for (auto& shard : shards_) {
+      std::vector<StorageKey> shardKeys;
+      {
+        std::lock_guard<std::mutex> storeLock(shard->storeMutex);
+        shardKeys = shard->store->getKeysInFile(fileName);
+      }
+      for (auto& key : shardKeys) {
+        if (keySet.insert(key).second) {
+          keyList.push_back(key);
+        }
+      }
+    }
+    return keyList;
+  }
+
+  /**
+   * @brief Returns the index of the shard that the specified key is routed to.
+   */
+  size_t getShardIndex(const StorageKey& key) const
+  {
+    int value = (routingField_ == "event_id") ? key.getEventID() : key.getGeoLocation();
+    if (routingMethod_ == "range") {
+      return (static_cast<size_t>(value) / rangeWidth_) % shards_.size();
+    }
+    return std::hash<int>()(value) % shards_.size();
+  }
+
+private:
+  ShardedDataStore(const ShardedDataStore&) = delete;
+  ShardedDataStore& operator=(const ShardedDataStore&) = delete;
+  ShardedDataStore(ShardedDataStore&&) = delete;
+  ShardedDataStore& operator=(ShardedDataStore&&) = delete;
+
+  struct QueuedBlock
+  {
+    explicit QueuedBlock(const StorageKey& theKey)
+      : key(theKey)
+    {}
+
+    StorageKey key;
+    size_t size = 0;
+    std::unique_ptr<char[]> data;
+  };
+
+  struct Shard
+  {
+    // the child store is only ever accessed with storeMutex held
+    std::unique_ptr<DataStore> store;
+    mutable std::mutex storeMutex;
+
+    // the queue, and the block that is currently being written, are protected by queueMutex
+    std::deque<std::shared_ptr<QueuedBlock>> queue;
+    std::shared_ptr<QueuedBlock> inFlight;
+    size_t failedCount = 0;
+    bool stopRequested = false;
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable spaceCondition;
+
+    std::thread worker;
+  };
+
+  std::string routingField_;
+  std::string routingMethod_;
+  size_t rangeWidth_;
+  size_t queueCapacity_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  void waitForQueue_(Shard& shard)
+  {
+    std::unique_lock<std::mutex> lock(shard.queueMutex);
+    shard.spaceCondition.wait(lock, [&] { return shard.queue.empty() && shard.inFlight.get() == nullptr; });
+  }
+
+  void workerLoop_(size_t shardIndex)
+  {
+    Shard& shard = *shards_[shardIndex];
+    std::unique_lock<std::mutex> lock(shard.queueMutex);
+    while (true) {
+      shard.queueCondition.wait(lock, [&] { return shard.stopRequested || !shard.queue.empty(); });
+      if (shard.queue.empty()) {
+        break;
+      }
+      shard.inFlight = shard.queue.front();
+      shard.queue.pop_front();
+      lock.unlock();
+
+      KeyedDataBlock dataBlock(shard.inFlight->key);
+      dataBlock.unowned_data_start = shard.inFlight->data.get();
+      dataBlock.data_size = shard.inFlight->size;
+      bool failed = false;
+      try {
+        std::lock_guard<std::mutex> storeLock(shard.storeMutex);
+        shard.store->write(dataBlock);
+      } catch (const std::exception& excpt) {
+        ers::error(ShardWriteFailed(
+          ERS_HERE, get_name(), shardIndex, dataBlock.data_key.getEventID(), dataBlock.data_key.getGeoLocation(), excpt));
+        failed = true;
+      }
+
+      lock.lock();
+      if (failed) {
+        ++shard.failedCount;
+      }
+      shard.inFlight.reset();
+      shard.spaceCondition.notify_all();
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_SHARDEDDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
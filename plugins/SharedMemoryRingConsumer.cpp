@@ -0,0 +1,160 @@
+/**
+ * @file SharedMemoryRingConsumer.cpp SharedMemoryRingConsumer class implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "SharedMemoryRingConsumer.hpp"
+
+#include <TRACE/trace.h>
+#include <ers/ers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Name used by TRACE TLOG calls from this source file
+ */
+#define TRACE_NAME "SharedMemoryRingConsumer" // NOLINT
+#define TLVL_ENTER_EXIT_METHODS 10            // NOLINT
+#define TLVL_WORK_STEPS 15                    // NOLINT
+
+namespace dunedaq {
+namespace ddpdemo {
+
+SharedMemoryRingConsumer::SharedMemoryRingConsumer(const std::string& name)
+  : dunedaq::appfwk::DAQModule(name)
+  , thread_(std::bind(&SharedMemoryRingConsumer::do_work, this, std::placeholders::_1))
+{
+  register_command("conf", &SharedMemoryRingConsumer::do_conf);
+  register_command("start", &SharedMemoryRingConsumer::do_start);
+  register_command("stop", &SharedMemoryRingConsumer::do_stop);
+  register_command("unconfigure", &SharedMemoryRingConsumer::do_unconfigure);
+}
+
+void
+SharedMemoryRingConsumer::init(const data_t&)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering init() method";
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
+}
+
+void
+SharedMemoryRingConsumer::do_conf(const data_t& args)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_conf() method";
+  msecBetweenReports_ = args.value<size_t>("msec_between_reports", REASONABLE_DEFAULT_MSECBETWEENREPORTS);
+
+  dataStore_ = makeDataStore(args["data_store_parameters"]);
+
+  // the ring is created here, so that producers can attach to it as soon as they are configured
+  ring_ = SharedMemoryRing::create(args["segment_name"].get<std::string>(),
+                                   args.value<size_t>("slot_count", REASONABLE_DEFAULT_SLOTCOUNT),
+                                   args.value<size_t>("slot_payload_size", REASONABLE_DEFAULT_SLOTPAYLOADSIZE));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
+}
+
+void
+SharedMemoryRingConsumer::do_start(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_start() method";
+  thread_.start_working_thread();
+  ERS_LOG(get_name() << " successfully started");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_start() method";
+}
+
+void
+SharedMemoryRingConsumer::do_stop(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_stop() method";
+  thread_.stop_working_thread();
+  ERS_LOG(get_name() << " successfully stopped");
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
+}
+
+void
+SharedMemoryRingConsumer::do_unconfigure(const data_t& /*args*/)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_unconfigure() method";
+  ring_.reset();
+  dataStore_.reset();
+  msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_unconfigure() method";
+}
+
+void
+SharedMemoryRingConsumer::do_work(std::atomic<bool>& running_flag)
+{
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
+  size_t writtenCount = 0;
+  size_t writtenBytes = 0;
+  size_t failedCount = 0;
+  size_t peakOccupancy = 0;
+
+  // ensure that we have a valid dataStore instance
+  if (dataStore_.get() == nullptr || ring_.get() == nullptr) {
+    throw InvalidDataStoreError(ERS_HERE, get_name(), "writing");
+  }
+
+  // the payloads are written straight from shared memory
+  auto writeBlock = [&](const KeyedDataBlock& dataBlock) {
+    try {
+      dataStore_->write(dataBlock);
+      ++writtenCount;
+      writtenBytes += dataBlock.getDataSizeBytes();
+    } catch (const ers::Issue& excpt) {
+      ++failedCount;
+      ers::error(RingDataWriteFailed(
+        ERS_HERE, get_name(), dataBlock.data_key.getEventID(), dataBlock.data_key.getGeoLocation(), excpt));
+    }
+  };
+
+  auto reportTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecBetweenReports_);
+  size_t backoffUsec = 0;
+  size_t blocksSinceTimeCheck = 0;
+  while (running_flag.load()) {
+    peakOccupancy = std::max(peakOccupancy, ring_->getOccupancy());
+    if (ring_->tryConsume(writeBlock)) {
+      backoffUsec = 0;
+      if (++blocksSinceTimeCheck < 1024) {
+        continue;
+      }
+    } else {
+      // the ring is polled, with an increasing back-off while it stays empty
+      backoffUsec = std::min(std::max<size_t>(backoffUsec * 2, 1), MAX_IDLE_BACKOFF_USEC);
+      std::this_thread::sleep_for(std::chrono::microseconds(backoffUsec));
+    }
+
+    blocksSinceTimeCheck = 0;
+    if (std::chrono::steady_clock::now() >= reportTime) {
+      std::ostringstream oss_prog;
+      oss_prog << ": Ring occupancy is " << ring_->getOccupancy() << " of " << ring_->getSlotCount()
+               << " slots (peak " << peakOccupancy << "), " << writtenCount << " data blocks written so far.";
+      ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_prog.str()));
+      reportTime += std::chrono::milliseconds(msecBetweenReports_);
+      peakOccupancy = 0;
+    }
+  }
+
+  // write out whatever the producers published before the stop
+  TLOG(TLVL_WORK_STEPS) << get_name() << ": Draining " << ring_->getOccupancy() << " data blocks from the ring";
+  while (ring_->tryConsume(writeBlock)) {
+  }
+  dataStore_->flush();
+
+  std::ostringstream oss_summ;
+  oss_summ << ": Exiting the do_work() method, wrote " << writtenCount << " data blocks (" << writtenBytes
+           << " bytes) from the shared-memory ring, " << failedCount << " writes failed.";
+  ers::info(ProgressUpdate(ERS_HERE, get_name(), oss_summ.str()));
+  TLOG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
+}
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+DEFINE_DUNE_DAQ_MODULE(dunedaq::ddpdemo::SharedMemoryRingConsumer)
@@ -0,0 +1,103 @@
+/**
+ * @file SharedMemoryRingConsumer.hpp
+ *
+ * SharedMemoryRingConsumer is a DAQModule that creates a SharedMemoryRing and
+ * writes the data blocks that producers (e.g. a DataGenerator configured with
+ * a SharedMemoryRingDataStore, in another process) publish to it to a
+ * DataStore.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DDPDEMO_SRC_SHAREDMEMORYRINGCONSUMER_HPP_
+#define DDPDEMO_SRC_SHAREDMEMORYRINGCONSUMER_HPP_
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/SharedMemoryRing.hpp"
+
+#include <appfwk/DAQModule.hpp>
+#include <appfwk/ThreadHelper.hpp>
+#include <ers/Issue.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ddpdemo {
+
+/**
+ * @brief SharedMemoryRingConsumer writes the data blocks from a shared-memory ring to a DataStore.
+ */
+class SharedMemoryRingConsumer : public dunedaq::appfwk::DAQModule
+{
+public:
+  /**
+   * @brief SharedMemoryRingConsumer Constructor
+   * @param name Instance name for this SharedMemoryRingConsumer instance
+   */
+  explicit SharedMemoryRingConsumer(const std::string& name);
+
+  SharedMemoryRingConsumer(const SharedMemoryRingConsumer&) = delete;            ///< not copy-constructible
+  SharedMemoryRingConsumer& operator=(const SharedMemoryRingConsumer&) = delete; ///< not copy-assignable
+  SharedMemoryRingConsumer(SharedMemoryRingConsumer&&) = delete;                 ///< not move-constructible
+  SharedMemoryRingConsumer& operator=(SharedMemoryRingConsumer&&) = delete;      ///< not move-assignable
+
+  void init(const data_t&) override;
+
+private:
+  // Commands
+  void do_conf(const data_t&);
+  void do_start(const data_t&);
+  void do_stop(const data_t&);
+  void do_unconfigure(const data_t&);
+
+  // Threading
+  dunedaq::appfwk::ThreadHelper thread_;
+  void do_work(std::atomic<bool>&);
+
+  // Configuration defaults
+  const size_t REASONABLE_DEFAULT_SLOTCOUNT = 1024;
+  const size_t REASONABLE_DEFAULT_SLOTPAYLOADSIZE = 1024 * 1024;
+  const size_t REASONABLE_DEFAULT_MSECBETWEENREPORTS = 10000;
+  const size_t MAX_IDLE_BACKOFF_USEC = 1000;
+
+  // Configuration
+  size_t msecBetweenReports_ = REASONABLE_DEFAULT_MSECBETWEENREPORTS;
+
+  // Workers
+  std::unique_ptr<SharedMemoryRing> ring_;
+  std::unique_ptr<DataStore> dataStore_;
+};
+} // namespace ddpdemo
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       ProgressUpdate,
+                       appfwk::GeneralDAQModuleIssue,
+                       message,
+                       ((std::string)name),
+                       ((std::string)message))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidDataStoreError,
+                       appfwk::GeneralDAQModuleIssue,
+                       "A valid dataStore instance is not available for "
+                         << operation
+                         << ", so it will not be possible to write data. A likely cause for this is a skipped or "
+                            "missed Configure transition.",
+                       ((std::string)name),
+                       ((std::string)operation))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       RingDataWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Failed to write the data block with eventID " << eventID << " and geoLocation " << geoLocation
+                                                                      << " from the shared-memory ring.",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation))
+
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_SHAREDMEMORYRINGCONSUMER_HPP_
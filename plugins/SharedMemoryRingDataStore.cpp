@@ -0,0 +1,3 @@
+#include "SharedMemoryRingDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::SharedMemoryRingDataStore)
@@ -0,0 +1,171 @@
+#ifndef DDPDEMO_SRC_SHAREDMEMORYRINGDATASTORE_HPP_
+#define DDPDEMO_SRC_SHAREDMEMORYRINGDATASTORE_HPP_
+
+/**
+ * @file SharedMemoryRingDataStore.hpp
+ *
+ * An implementation of the DataStore interface that publishes data blocks to
+ * a SharedMemoryRing, from which a SharedMemoryRingConsumer module in another
+ * process writes them to a DataStore of its own.  This is a write-only store:
+ * the data blocks belong to the consumer once they are published.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/SharedMemoryRing.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       SharedMemoryRingIsWriteOnly,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Data blocks can not be read back from the shared-memory ring.",
+                       ((std::string)name),
+                       ERS_EMPTY)
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       SharedMemoryRingPublishTimedOut,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The data block with eventID " << eventID << " and geoLocation " << geoLocation
+                                                      << " could not be published within " << timeout
+                                                      << " msec; the ring has been full since then.",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation)((size_t)timeout))
+
+namespace ddpdemo {
+
+/**
+ * @brief SharedMemoryRingDataStore is the producer side of a SharedMemoryRing.
+ */
+class SharedMemoryRingDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_ATTACH_TIMEOUT_MSEC = 10000;
+  static constexpr size_t REASONABLE_DEFAULT_PUBLISH_TIMEOUT_MSEC = 10000;
+  static constexpr size_t MAX_BACKOFF_USEC = 1000;
+
+  explicit SharedMemoryRingDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , fullCount_(0)
+    , blockedNsec_(0)
+    , peakOccupancy_(0)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    ring_ = SharedMemoryRing::attach(conf["segment_name"].get<std::string>(),
+                                     conf.value<size_t>("attach_timeout_msec", REASONABLE_DEFAULT_ATTACH_TIMEOUT_MSEC));
+    publishTimeout_ =
+      std::chrono::milliseconds(conf.value<size_t>("publish_timeout_msec", REASONABLE_DEFAULT_PUBLISH_TIMEOUT_MSEC));
+  }
+
+  virtual void setup(const size_t) override { ; }
+
+  /**
+   * @brief Publishes the data block.  If the ring is full, this waits (with an
+   * increasing back-off, up to MAX_BACKOFF_USEC) for the consumer to catch up,
+   * and throws SharedMemoryRingPublishTimedOut if it has not done so within the
+   * publish timeout (e.g. because the consumer has gone away).
+   * Several threads may write at the same time, so the statistics are atomic.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    if (ring_->tryPublish(dataBlock)) {
+      updateMaximum_(peakOccupancy_, ring_->getOccupancy());
+      return;
+    }
+
+    fullCount_.fetch_add(1, std::memory_order_relaxed);
+    auto startTime = std::chrono::steady_clock::now();
+    auto deadline = startTime + publishTimeout_;
+    size_t backoffUsec = 1;
+    while (!ring_->tryPublish(dataBlock)) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        blockedNsec_.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count(),
+          std::memory_order_relaxed);
+        throw SharedMemoryRingPublishTimedOut(ERS_HERE,
+                                              get_name(),
+                                              dataBlock.data_key.getEventID(),
+                                              dataBlock.data_key.getGeoLocation(),
+                                              publishTimeout_.count());
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(backoffUsec));
+      backoffUsec = std::min(backoffUsec * 2, MAX_BACKOFF_USEC);
+    }
+    blockedNsec_.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count(),
+      std::memory_order_relaxed);
+    updateMaximum_(peakOccupancy_, ring_->getSlotCount());
+  }
+
+  /**
+   * @brief Reports the back-pressure since the previous flush: the peak ring
+   * occupancy, and how often and for how long writes had to wait for space.
+   */
+  virtual void flush() override
+  {
+    size_t peakOccupancy = peakOccupancy_.exchange(0);
+    size_t fullCount = fullCount_.exchange(0);
+    int64_t blockedNsec = blockedNsec_.exchange(0);
+    ERS_INFO(get_name() << ": Peak ring occupancy was " << peakOccupancy << " of " << ring_->getSlotCount()
+                        << " slots; the ring was full for " << fullCount << " data blocks, which waited for a total of "
+                        << (blockedNsec / 1000000) << " msec.");
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::vector<StorageKey> emptyList;
+    return emptyList;
+  }
+
+  virtual KeyedDataBlock read(const StorageKey&) override { throw SharedMemoryRingIsWriteOnly(ERS_HERE, get_name()); }
+
+  /**
+   * @brief Returns the number of data blocks in the ring that the consumer has not yet written.
+   */
+  size_t getOccupancy() const { return ring_->getOccupancy(); }
+
+private:
+  SharedMemoryRingDataStore(const SharedMemoryRingDataStore&) = delete;
+  SharedMemoryRingDataStore& operator=(const SharedMemoryRingDataStore&) = delete;
+  SharedMemoryRingDataStore(SharedMemoryRingDataStore&&) = delete;
+  SharedMemoryRingDataStore& operator=(SharedMemoryRingDataStore&&) = delete;
+
+  std::unique_ptr<SharedMemoryRing> ring_;
+  std::chrono::milliseconds publishTimeout_;
+  std::atomic<size_t> fullCount_;
+  std::atomic<int64_t> blockedNsec_;
+  std::atomic<size_t> peakOccupancy_;
+
+  static void updateMaximum_(std::atomic<size_t>& maximum, size_t value)
+  {
+    size_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_SHAREDMEMORYRINGDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -151,6 +151,7 @@ SimpleDiskWriter::do_work(std::atomic<bool>& running_flag)
     std::this_thread::sleep_for(std::chrono::milliseconds(waitBetweenSendsMsec_));
     TLOG(TLVL_WORK_STEPS) << get_name() << ": End of do_work loop";
   }
+  dataWriter_->flush();
 
   std::ostringstream oss_summ;
   oss_summ << ": Exiting the do_work() method, generated " << generatedCount << " fake events and successfully wrote "
@@ -0,0 +1,3 @@
+#include "SocketDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::SocketDataStore)
@@ -0,0 +1,659 @@
+#ifndef DDPDEMO_SRC_SOCKETDATASTORE_HPP_
+#define DDPDEMO_SRC_SOCKETDATASTORE_HPP_
+
+/**
+ * @file SocketDataStore.hpp
+ *
+ * An implementation of the DataStore interface that forwards all operations
+ * to a DataStore that is hosted by a separate server process (see
+ * SocketDataStoreServer.hpp), over a Unix-domain socket.  Data payloads are
+ * copied once, into a shared-memory arena that the server maps, so bulk data
+ * never goes through the socket.  Writes are pipelined (write() returns once
+ * the payload is in shared memory) and batched into as few packets as possible.
+ * Packets are only sent by the calling threads and by a sender thread of the
+ * client's own, never by the thread that receives the server's responses, so
+ * a server that is blocked sending to the client is always drained.
+ * readEvent() is not forwarded: it uses the default implementation, which
+ * reads the fragments of the event one at a time.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/SocketDataStoreProtocol.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       DataStoreServerUnavailable,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The DataStore server at \"" << socket_path << "\" is not available: " << reason,
+                       ((std::string)name),
+                       ((std::string)socket_path)((std::string)reason))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       DataStoreServerRequestFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The DataStore server failed to perform a " << operation << " request: " << reason,
+                       ((std::string)name),
+                       ((std::string)operation)((std::string)reason))
+
+namespace ddpdemo {
+
+/**
+ * @brief SocketDataStore is the client side of an out-of-process DataStore.
+ */
+class SocketDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_SHM_SIZE_BYTES = 64 * 1024 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_BATCH_SIZE = 32;
+  static constexpr size_t REASONABLE_DEFAULT_MAX_IN_FLIGHT = 256;
+  static constexpr size_t REASONABLE_DEFAULT_CONNECT_TIMEOUT_MSEC = 5000;
+  static constexpr size_t ARENA_ALIGNMENT = 64;
+
+  explicit SocketDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , connection_(new Connection())
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    socketPath_ = conf["socket_path"].get<std::string>();
+    arenaSize_ = conf.value<size_t>("shm_size_bytes", REASONABLE_DEFAULT_SHM_SIZE_BYTES);
+    arenaSize_ = (arenaSize_ + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    batchSize_ = std::max<size_t>(conf.value<size_t>("batch_size", REASONABLE_DEFAULT_BATCH_SIZE), 1);
+    maxInFlight_ = std::max<size_t>(conf.value<size_t>("max_in_flight", REASONABLE_DEFAULT_MAX_IN_FLIGHT), 1);
+    size_t connectTimeoutMsec = conf.value<size_t>("connect_timeout_msec", REASONABLE_DEFAULT_CONNECT_TIMEOUT_MSEC);
+
+    connect_(connectTimeoutMsec);
+
+    // the server creates the hosted DataStore from these parameters
+    Protocol::MessageHeader hello;
+    hello.type = Protocol::Hello;
+    hello.dataSize = arenaSize_;
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    hello.requestId = ++connection_->nextRequestId;
+    std::string packet;
+    Protocol::appendMessage(packet, hello, conf["data_store_parameters"].dump());
+    try {
+      Protocol::sendPacket(connection_->socketFd, packet, connection_->arenaFd);
+    } catch (const ers::Issue& excpt) {
+      lock.unlock();
+      disconnect_();
+      throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, "unable to send the configuration", excpt);
+    }
+    connection_->lastSentId = hello.requestId;
+
+    connection_->receiverThread = std::thread(&SocketDataStore::receiverLoop_, this);
+    connection_->senderThread = std::thread(&SocketDataStore::senderLoop_, this);
+    try {
+      waitForResponse_(lock, hello.requestId, "create");
+    } catch (...) {
+      lock.unlock();
+      disconnect_();
+      throw;
+    }
+  }
+
+  ~SocketDataStore()
+  {
+    try {
+      std::unique_lock<std::mutex> lock(connection_->mutex);
+      sendPendingRequests_(lock);
+      connection_->completionCondition.wait(lock, [&] {
+        return connection_->lastCompleted >= connection_->lastSentId || connection_->connectionLost;
+      });
+      throwIfFailed_();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    disconnect_();
+  }
+
+  virtual void setup(const size_t eventId) override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::Setup;
+    request.offset = eventId;
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    waitForResponse_(lock, sendRequest_(lock, request, ""), "setup");
+  }
+
+  /**
+   * @brief Copies the data block into shared memory and queues the write
+   * request.  This returns without waiting for the server, unless the shared
+   * memory is full or too many requests are already in flight.  Failures of
+   * earlier writes are reported by the next write or flush.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    Protocol::MessageHeader request;
+    request.type = Protocol::Write;
+    request.eventId = dataBlock.data_key.getEventID();
+    request.geoLocation = dataBlock.data_key.getGeoLocation();
+    request.dataSize = size;
+
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    throwIfFailed_();
+    if (connection_->inFlight.size() >= maxInFlight_) {
+      sendPendingRequests_(lock);
+      connection_->completionCondition.wait(
+        lock, [&] { return connection_->inFlight.size() < maxInFlight_ || connection_->connectionLost; });
+      throwIfFailed_();
+    }
+
+    if (size > arenaSize_) {
+      // blocks that do not fit in the arena get a shared-memory file of their own
+      int payloadFd = Protocol::createSharedMemory("ddpdemo_write", size);
+      try {
+        void* payload = Protocol::mapSharedMemory(payloadFd, size, true);
+        memcpy(payload, dataBlock.getDataStart(), size);
+        munmap(payload, size);
+        request.type = Protocol::WriteWithFd;
+        sendPendingRequests_(lock);
+        sendRequest_(lock, request, dataBlock.data_key.getDetectorID(), payloadFd);
+      } catch (...) {
+        close(payloadFd);
+        throw;
+      }
+      close(payloadFd);
+      return;
+    }
+
+    request.offset = allocateArenaSpace_(lock, size);
+    memcpy(static_cast<char*>(connection_->arena) + request.offset, dataBlock.getDataStart(), size);
+    sendRequest_(lock, request, dataBlock.data_key.getDetectorID());
+  }
+
+  /**
+   * @brief Waits for all queued writes to complete, then flushes the hosted DataStore.
+   */
+  virtual void flush() override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::Flush;
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    throwIfFailed_();
+    waitForResponse_(lock, sendRequest_(lock, request, ""), "flush");
+    throwIfFailed_();
+  }
+
+  /**
+   * @brief Reads the data block from the hosted DataStore.  The returned block
+   * refers to a shared-memory copy that the server has made, which is unmapped
+   * when the last reference to it is released.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::Read;
+    return readFromServer_(key, request);
+  }
+
+  /**
+   * @brief Reads part of the data block.  The range is read by the hosted
+   * DataStore, so only the requested bytes are copied to shared memory.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::ReadRange;
+    request.offset = offset;
+    request.dataSize = length;
+    return readFromServer_(key, request);
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::GetKeys;
+    return getKeysFromServer_(request, "", "getAllExistingKeys");
+  }
+
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    Protocol::MessageHeader request;
+    request.type = Protocol::GetKeysInFile;
+    return getKeysFromServer_(request, fileName, "getKeysInFile");
+  }
+
+private:
+  SocketDataStore(const SocketDataStore&) = delete;
+  SocketDataStore& operator=(const SocketDataStore&) = delete;
+  SocketDataStore(SocketDataStore&&) = delete;
+  SocketDataStore& operator=(SocketDataStore&&) = delete;
+
+  typedef SocketDataStoreProtocol Protocol;
+
+  struct Response
+  {
+    Protocol::Message message;
+    std::shared_ptr<const void> payload;
+  };
+
+  struct InFlightWrite
+  {
+    uint64_t requestId;
+    size_t arenaEnd;
+  };
+
+  // The connection state is kept separately, so that the const methods can use it, too.
+  struct Connection
+  {
+    int socketFd = -1;
+    int arenaFd = -1;
+    void* arena = nullptr;
+    std::thread receiverThread;
+    std::thread senderThread;
+
+    // everything below is protected by the mutex
+    std::mutex mutex;
+    std::condition_variable completionCondition;
+    uint64_t nextRequestId = 0;
+    uint64_t lastSentId = 0;
+    uint64_t lastCompleted = 0;
+    std::string pendingPacket;
+    size_t pendingCount = 0;
+    uint64_t pendingLastId = 0;
+    std::deque<InFlightWrite> inFlight;
+    size_t arenaHead = 0;
+    size_t arenaTail = 0;
+    std::map<uint64_t, std::vector<Response>> responses;
+    std::string firstWriteError;
+    bool connectionLost = false;
+    bool stopping = false;
+    // signalled when batched-up writes can be sent, because the server has become idle
+    std::condition_variable senderCondition;
+
+    // held while sending, so that packets go out in the order of their request IDs
+    std::mutex sendMutex;
+  };
+
+  std::string socketPath_;
+  size_t arenaSize_;
+  size_t batchSize_;
+  size_t maxInFlight_;
+  std::unique_ptr<Connection> connection_;
+
+  void connect_(size_t timeoutMsec)
+  {
+    struct sockaddr_un address;
+    if (socketPath_.size() >= sizeof(address.sun_path)) {
+      throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, "the socket path is too long");
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath_.c_str(), sizeof(address.sun_path) - 1);
+
+    // the server may still be starting up, so connecting is retried until the timeout
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMsec);
+    while (true) {
+      connection_->socketFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+      if (connection_->socketFd < 0) {
+        throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, strerror(errno));
+      }
+      if (connect(connection_->socketFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) { // NOLINT
+        break;
+      }
+      int savedErrno = errno;
+      close(connection_->socketFd);
+      connection_->socketFd = -1;
+      if ((savedErrno != ENOENT && savedErrno != ECONNREFUSED) || std::chrono::steady_clock::now() >= deadline) {
+        throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, strerror(savedErrno));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    try {
+      connection_->arenaFd = Protocol::createSharedMemory("ddpdemo_arena", arenaSize_);
+      connection_->arena = Protocol::mapSharedMemory(connection_->arenaFd, arenaSize_, true);
+    } catch (const ers::Issue& excpt) {
+      disconnect_();
+      throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, "unable to create the shared memory", excpt);
+    }
+  }
+
+  void disconnect_()
+  {
+    {
+      std::lock_guard<std::mutex> lock(connection_->mutex);
+      connection_->stopping = true;
+      connection_->senderCondition.notify_all();
+    }
+    if (connection_->senderThread.joinable()) {
+      connection_->senderThread.join();
+    }
+    if (connection_->socketFd >= 0) {
+      shutdown(connection_->socketFd, SHUT_RDWR);
+    }
+    if (connection_->receiverThread.joinable()) {
+      connection_->receiverThread.join();
+    }
+    if (connection_->socketFd >= 0) {
+      close(connection_->socketFd);
+      connection_->socketFd = -1;
+    }
+    if (connection_->arena != nullptr) {
+      munmap(connection_->arena, arenaSize_);
+      connection_->arena = nullptr;
+    }
+    if (connection_->arenaFd >= 0) {
+      close(connection_->arenaFd);
+      connection_->arenaFd = -1;
+    }
+  }
+
+  void throwIfFailed_() const
+  {
+    if (connection_->connectionLost) {
+      throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, "the connection has been lost");
+    }
+    if (!connection_->firstWriteError.empty()) {
+      std::string reason;
+      reason.swap(connection_->firstWriteError);
+      throw DataStoreServerRequestFailed(ERS_HERE, get_name(), "write", reason);
+    }
+  }
+
+  /**
+   * @brief Adds the request to the pending packet and sends the packet if it is
+   * full, or if the server is idle (so that batching never adds latency when
+   * the server is keeping up).  Requests with a file descriptor are always sent
+   * on their own.
+   * @return the request ID
+   */
+  uint64_t sendRequest_(std::unique_lock<std::mutex>& lock,
+                        Protocol::MessageHeader& request,
+                        const std::string& extra,
+                        int fdToPass = -1) const
+  {
+    Connection& conn = *connection_;
+    if (conn.connectionLost) {
+      throwIfFailed_();
+    }
+    if (!Protocol::fitsInPacket(conn.pendingPacket, extra)) {
+      sendPendingRequests_(lock);
+    }
+
+    request.requestId = ++conn.nextRequestId;
+    if (request.type == Protocol::Write || request.type == Protocol::WriteWithFd) {
+      // the arena space up to the current head is released when this write completes
+      InFlightWrite inFlightWrite;
+      inFlightWrite.requestId = request.requestId;
+      inFlightWrite.arenaEnd = conn.arenaHead;
+      conn.inFlight.push_back(inFlightWrite);
+    }
+    Protocol::appendMessage(conn.pendingPacket, request, extra);
+    ++conn.pendingCount;
+    conn.pendingLastId = request.requestId;
+
+    if (fdToPass >= 0 || request.type != Protocol::Write || conn.pendingCount >= batchSize_ ||
+        conn.lastCompleted >= conn.lastSentId) {
+      sendPendingRequests_(lock, fdToPass);
+    }
+    return request.requestId;
+  }
+
+  void sendPendingRequests_(std::unique_lock<std::mutex>& lock, int fdToPass = -1) const
+  {
+    Connection& conn = *connection_;
+    if (conn.pendingPacket.empty()) {
+      return;
+    }
+    std::string packet;
+    packet.swap(conn.pendingPacket);
+    conn.pendingCount = 0;
+    conn.lastSentId = conn.pendingLastId;
+
+    std::unique_lock<std::mutex> sendLock(conn.sendMutex);
+    lock.unlock();
+    try {
+      Protocol::sendPacket(conn.socketFd, packet, fdToPass);
+    } catch (const ers::Issue& excpt) {
+      sendLock.unlock();
+      lock.lock();
+      conn.connectionLost = true;
+      conn.completionCondition.notify_all();
+      throw DataStoreServerUnavailable(ERS_HERE, get_name(), socketPath_, "unable to send a request", excpt);
+    }
+    sendLock.unlock();
+    lock.lock();
+  }
+
+  /**
+   * @brief Reserves space for a payload in the arena, which is used as a ring
+   * buffer: space is released in request order, as the server completes writes.
+   * @return the offset of the reserved space
+   */
+  size_t allocateArenaSpace_(std::unique_lock<std::mutex>& lock, size_t size)
+  {
+    Connection& conn = *connection_;
+    size_t alignedSize = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    while (true) {
+      bool arenaEmpty = conn.inFlight.empty();
+      if (arenaEmpty) {
+        conn.arenaHead = 0;
+        conn.arenaTail = 0;
+      }
+      size_t offset = arenaSize_;
+      if (conn.arenaHead >= conn.arenaTail) {
+        if (arenaSize_ - conn.arenaHead >= alignedSize) {
+          offset = conn.arenaHead;
+        } else if (conn.arenaTail > alignedSize) {
+          offset = 0;
+        }
+      } else if (conn.arenaTail - conn.arenaHead > alignedSize) {
+        offset = conn.arenaHead;
+      }
+      if (offset != arenaSize_) {
+        conn.arenaHead = offset + alignedSize;
+        return offset;
+      }
+
+      sendPendingRequests_(lock);
+      uint64_t oldestId = conn.inFlight.front().requestId;
+      conn.completionCondition.wait(lock, [&] {
+        return conn.inFlight.empty() || conn.inFlight.front().requestId != oldestId || conn.connectionLost;
+      });
+      throwIfFailed_();
+    }
+  }
+
+  KeyedDataBlock readFromServer_(const StorageKey& key, Protocol::MessageHeader& request)
+  {
+    request.eventId = key.getEventID();
+    request.geoLocation = key.getGeoLocation();
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    std::vector<Response> responses = waitForResponse_(lock, sendRequest_(lock, request, key.getDetectorID()), "read");
+
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = 0;
+    dataBlock.unowned_data_start = nullptr;
+    for (auto& response : responses) {
+      if (response.message.header.type == Protocol::ReadResult) {
+        dataBlock.data_size = response.message.header.dataSize;
+        dataBlock.shared_data_start = std::move(response.payload);
+      }
+    }
+    return dataBlock;
+  }
+
+  std::vector<StorageKey> getKeysFromServer_(Protocol::MessageHeader& request,
+                                             const std::string& extra,
+                                             const std::string& operation) const
+  {
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    std::vector<Response> responses = waitForResponse_(lock, sendRequest_(lock, request, extra), operation);
+
+    std::vector<StorageKey> keyList;
+    for (auto& response : responses) {
+      if (response.message.header.type == Protocol::KeyList) {
+        size_t position = 0;
+        while (position < response.message.extra.size()) {
+          keyList.push_back(Protocol::extractKey(response.message.extra, position));
+        }
+      }
+    }
+    return keyList;
+  }
+
+  /**
+   * @brief Waits for the server to complete the request and returns its
+   * responses.  An error from the server is thrown as an issue.
+   */
+  std::vector<Response> waitForResponse_(std::unique_lock<std::mutex>& lock,
+                                         uint64_t requestId,
+                                         const std::string& operation) const
+  {
+    Connection& conn = *connection_;
+    conn.completionCondition.wait(lock, [&] { return conn.lastCompleted >= requestId || conn.connectionLost; });
+    std::vector<Response> responses;
+    auto iter = conn.responses.find(requestId);
+    if (iter != conn.responses.end()) {
+      responses = std::move(iter->second);
+      conn.responses.erase(iter);
+    }
+    if (conn.lastCompleted < requestId) {
+      throwIfFailed_();
+    }
+    for (auto& response : responses) {
+      if (response.message.header.type == Protocol::Error) {
+        throw DataStoreServerRequestFailed(ERS_HERE, get_name(), operation, response.message.extra);
+      }
+    }
+    return responses;
+  }
+
+  void receiverLoop_()
+  {
+    Connection& conn = *connection_;
+    std::vector<Protocol::Message> messages;
+    int receivedFd = -1;
+    try {
+      while (Protocol::receivePacket(conn.socketFd, messages, receivedFd)) {
+        // map read results before taking the lock
+        std::shared_ptr<const void> payload;
+        if (receivedFd >= 0) {
+          size_t payloadSize = messages.empty() ? 0 : messages[0].header.dataSize;
+          void* address = nullptr;
+          try {
+            address = Protocol::mapSharedMemory(receivedFd, payloadSize, false);
+          } catch (const ers::Issue& excpt) {
+            ers::error(excpt);
+          }
+          close(receivedFd);
+          if (address != nullptr) {
+            payload.reset(address, [payloadSize](const void* ptr) { munmap(const_cast<void*>(ptr), payloadSize); });
+          }
+        }
+
+        std::unique_lock<std::mutex> lock(conn.mutex);
+        for (auto& message : messages) {
+          if (message.header.type == Protocol::Completed) {
+            conn.lastCompleted = message.header.requestId;
+            while (!conn.inFlight.empty() && conn.inFlight.front().requestId <= conn.lastCompleted) {
+              conn.arenaTail = conn.inFlight.front().arenaEnd;
+              conn.inFlight.pop_front();
+            }
+            continue;
+          }
+
+          // errors of writes are reported by a later call, since nobody waits for them
+          auto inFlightIter = conn.inFlight.begin();
+          while (inFlightIter != conn.inFlight.end() && inFlightIter->requestId < message.header.requestId) {
+            ++inFlightIter;
+          }
+          if (message.header.type == Protocol::Error && inFlightIter != conn.inFlight.end() &&
+              inFlightIter->requestId == message.header.requestId) {
+            if (conn.firstWriteError.empty()) {
+              conn.firstWriteError = message.extra;
+            } else {
+              TLOG(TLVL_DEBUG) << get_name() << ": Another write failed: " << message.extra;
+            }
+            continue;
+          }
+
+          Response response;
+          response.message = std::move(message);
+          if (response.message.header.type == Protocol::ReadResult) {
+            response.payload = payload;
+          }
+          conn.responses[response.message.header.requestId].push_back(std::move(response));
+        }
+        conn.completionCondition.notify_all();
+
+        // writes that were batched up while the server was busy are sent as
+        // soon as it is idle, by the sender thread: a blocking send here would
+        // stop this thread from draining the server's responses
+        if (conn.lastCompleted >= conn.lastSentId && !conn.pendingPacket.empty()) {
+          conn.senderCondition.notify_one();
+        }
+      }
+    } catch (const ers::Issue& excpt) {
+      if (receivedFd >= 0) {
+        close(receivedFd);
+      }
+      TLOG(TLVL_DEBUG) << get_name() << ": The connection to the DataStore server was lost: " << excpt.what();
+    }
+
+    std::lock_guard<std::mutex> lock(conn.mutex);
+    conn.connectionLost = true;
+    conn.completionCondition.notify_all();
+    conn.senderCondition.notify_all();
+  }
+
+  void senderLoop_()
+  {
+    Connection& conn = *connection_;
+    std::unique_lock<std::mutex> lock(conn.mutex);
+    while (true) {
+      conn.senderCondition.wait(lock, [&] {
+        return conn.stopping || conn.connectionLost ||
+               (!conn.pendingPacket.empty() && conn.lastCompleted >= conn.lastSentId);
+      });
+      if (conn.stopping || conn.connectionLost) {
+        break;
+      }
+      try {
+        sendPendingRequests_(lock);
+      } catch (const ers::Issue& excpt) {
+        // the callers find out from the lost connection
+        TLOG(TLVL_DEBUG) << get_name() << ": " << excpt.what();
+        break;
+      }
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_SOCKETDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
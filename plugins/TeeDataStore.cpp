@@ -0,0 +1,3 @@
+#include "TeeDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::TeeDataStore)
@@ -0,0 +1,506 @@
+#ifndef DDPDEMO_SRC_TEEDATASTORE_HPP_
+#define DDPDEMO_SRC_TEEDATASTORE_HPP_
+
+/**
+ * @file TeeDataStore.hpp
+ *
+ * An implementation of the DataStore interface that forwards each data
+ * block to several child DataStores (e.g. local disk and a monitoring
+ * sink).  Each destination has a policy: "required" destinations are
+ * written before write() returns, while "best-effort" and "sampled"
+ * destinations are written in the background and drop data rather than
+ * slowing down the required ones.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidTeeConfiguration,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Invalid tee configuration: " << reason,
+                       ((std::string)name),
+                       ((std::string)reason))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       OptionalDestinationWriteFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The optional destination " << destination
+                                                   << " failed to write the data block with eventID " << eventID
+                                                   << " and geoLocation " << geoLocation << ".",
+                       ((std::string)name),
+                       ((std::string)destination)((int)eventID)((int)geoLocation))
+
+namespace ddpdemo {
+
+/**
+ * @brief TeeDataStore writes each data block to a list of child DataStores,
+ * sharing the payload between them instead of copying it.
+ */
+class TeeDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_QUEUE_CAPACITY = 16;
+
+  explicit TeeDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    const nlohmann::json& destConfList = conf["destinations"];
+    if (!destConfList.is_array() || destConfList.empty()) {
+      throw InvalidTeeConfiguration(ERS_HERE, get_name(), "at least one destination must be configured");
+    }
+    for (auto& destConf : destConfList) {
+      std::unique_ptr<Destination> dest(new Destination());
+      dest->policy = destConf.value<std::string>("policy", "required");
+      if (dest->policy != "required" && dest->policy != "best-effort" && dest->policy != "sampled") {
+        throw InvalidTeeConfiguration(ERS_HERE, get_name(), "unknown policy \"" + dest->policy + "\"");
+      }
+      dest->sampleInterval = destConf.value<size_t>("sample_interval", 1);
+      if (dest->sampleInterval == 0) {
+        throw InvalidTeeConfiguration(ERS_HERE, get_name(), "sample_interval must be greater than zero");
+      }
+      dest->queueCapacity = destConf.value<size_t>("queue_capacity", REASONABLE_DEFAULT_QUEUE_CAPACITY);
+      dest->store = makeDataStore(destConf["data_store_parameters"]);
+      destinations_.push_back(std::move(dest));
+    }
+
+    // the first required destination is written from the caller's thread and serves reads
+    primary_ = destinations_.size();
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      if (destinations_[idx]->policy == "required") {
+        primary_ = idx;
+        break;
+      }
+    }
+    if (primary_ == destinations_.size()) {
+      throw InvalidTeeConfiguration(ERS_HERE, get_name(), "at least one destination must be required");
+    }
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      if (idx != primary_) {
+        destinations_[idx]->worker = std::thread(&TeeDataStore::workerLoop_, this, idx);
+      }
+    }
+  }
+
+  ~TeeDataStore()
+  {
+    try {
+      flush();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      Destination& dest = *destinations_[idx];
+      if (idx == primary_) {
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(dest.queueMutex);
+        dest.stopRequested = true;
+      }
+      dest.queueCondition.notify_all();
+      dest.worker.join();
+      if (dest.droppedCount > 0) {
+        TLOG(TLVL_INFO) << get_name() << ": Destination " << dest.store->get_name() << " dropped " << dest.droppedCount
+                        << " data blocks because it could not keep up.";
+      }
+    }
+  }
+
+  virtual void setup(const size_t eventId) override
+  {
+    for (auto& dest : destinations_) {
+      std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+      dest->store->setup(eventId);
+    }
+  }
+
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    for (auto& dest : destinations_) {
+      std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+      dest->store->attachStatistics(statistics);
+    }
+  }
+
+  /**
+   * @brief Writes the data block to all destinations.  The required destinations
+   * are written concurrently, directly from the caller's buffer, and this method
+   * returns once they are done.  Optional destinations are handed a shared
+   * reference to the payload; if their queue is full, the data block is dropped
+   * for that destination.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    // the payload is only copied if an optional destination needs to hold on
+    // to it after this call returns, and the caller has not already provided
+    // shared ownership of it.  Even then, a single copy is shared by all of them.
+    std::shared_ptr<const void> sharedPayload = dataBlock.shared_data_start;
+
+    // the required destinations report back to this call only, since write()
+    // may be called from several threads at once
+    WriteCompletion completion;
+
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      Destination& dest = *destinations_[idx];
+      if (idx == primary_) {
+        continue;
+      }
+
+      Task task(dataBlock.data_key);
+      task.size = dataBlock.getDataSizeBytes();
+      if (dest.policy == "required") {
+        task.data = dataBlock.getDataStart();
+        task.completion = &completion;
+        {
+          std::lock_guard<std::mutex> lock(completion.mutex);
+          ++completion.pending;
+        }
+        std::lock_guard<std::mutex> lock(dest.queueMutex);
+        dest.queue.push_back(std::move(task));
+        dest.queueCondition.notify_all();
+        continue;
+      }
+
+      // a slot is reserved before the payload is copied, so that data blocks
+      // that are dropped (or not sampled) are never copied
+      {
+        std::lock_guard<std::mutex> lock(dest.queueMutex);
+        if (dest.policy == "sampled" && (dest.sampleCounter++ % dest.sampleInterval) != 0) {
+          continue;
+        }
+        if (dest.queue.size() + dest.reservedSlots >= dest.queueCapacity) {
+          ++dest.droppedCount;
+          continue;
+        }
+        ++dest.reservedSlots;
+      }
+      if (sharedPayload.get() == nullptr) {
+        char* payloadCopy = new char[task.size];
+        memcpy(payloadCopy, dataBlock.getDataStart(), task.size);
+        sharedPayload.reset(payloadCopy, std::default_delete<char[]>());
+      }
+      task.keepAlive = sharedPayload;
+      task.data = sharedPayload.get();
+
+      std::lock_guard<std::mutex> lock(dest.queueMutex);
+      --dest.reservedSlots;
+      dest.queue.push_back(std::move(task));
+      dest.queueCondition.notify_all();
+    }
+
+    // write the primary destination from this thread, while the others work
+    std::exception_ptr firstError;
+    try {
+      Destination& primary = *destinations_[primary_];
+      std::lock_guard<std::mutex> storeLock(primary.storeMutex);
+      primary.store->write(dataBlock);
+    } catch (...) {
+      firstError = std::current_exception();
+    }
+
+    // and wait for the other required destinations to finish with the caller's buffer
+    {
+      std::unique_lock<std::mutex> lock(completion.mutex);
+      completion.doneCondition.wait(lock, [&] { return completion.pending == 0; });
+      if (completion.error && !firstError) {
+        firstError = completion.error;
+      }
+    }
+
+    if (firstError) {
+      std::rethrow_exception(firstError);
+    }
+  }
+
+  /**
+   * @brief Returns the number of data blocks that the specified (optional)
+   * destination dropped because its queue was full.
+   */
+  size_t getDroppedCount(size_t destIndex) const
+  {
+    const Destination& dest = *destinations_.at(destIndex);
+    std::lock_guard<std::mutex> lock(dest.queueMutex);
+    return dest.droppedCount;
+  }
+
+  /**
+   * @brief Writes the reference to all destinations, once they have written
+   * out their queues (so that a queued copy can not replace the reference).
+   * @return whether every destination wrote the reference; if one refused, the
+   * caller is expected to copy the data block instead, which replaces the
+   * references that the others wrote
+   */
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    bool allLinked = true;
+    for (auto& dest : destinations_) {
+      waitForQueue_(*dest);
+      std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+      allLinked = dest->store->writeLink(source, key) && allLinked;
+    }
+    return allLinked;
+  }
+
+  /**
+   * @brief Native copies are only accepted if every destination accepts them;
+   * otherwise, the data blocks go through write(), with its policies.
+   */
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    for (auto& dest : destinations_) {
+      std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+      if (!dest->store->acceptsNativeCopy(source)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Copies the data block natively into all destinations, once they
+   * have written out their queues.
+   * @return the number of bytes that were copied into the primary destination
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    size_t bytes = 0;
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      Destination& dest = *destinations_[idx];
+      waitForQueue_(dest);
+      std::lock_guard<std::mutex> storeLock(dest.storeMutex);
+      size_t destBytes = dest.store->writeNativeCopy(source, key);
+      if (idx == primary_) {
+        bytes = destBytes;
+      }
+    }
+    return bytes;
+  }
+
+  /**
+   * @brief Replaces the reference in all destinations.
+   * @return whether the primary destination replaced one
+   */
+  virtual bool materialize(const StorageKey& key) override
+  {
+    bool materialized = false;
+    for (size_t idx = 0; idx < destinations_.size(); ++idx) {
+      Destination& dest = *destinations_[idx];
+      waitForQueue_(dest);
+      std::lock_guard<std::mutex> storeLock(dest.storeMutex);
+      bool destMaterialized = dest.store->materialize(key);
+      if (idx == primary_) {
+        materialized = destMaterialized;
+      }
+    }
+    return materialized;
+  }
+
+  /**
+   * @brief Waits for all destinations to write out their queues, then flushes them.
+   */
+  virtual void flush() override
+  {
+    for (auto& dest : destinations_) {
+      waitForQueue_(*dest);
+      std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+      dest->store->flush();
+    }
+  }
+
+  /**
+   * @brief Reads are served by the primary (first required) destination.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    Destination& primary = *destinations_[primary_];
+    std::lock_guard<std::mutex> storeLock(primary.storeMutex);
+    return primary.store->read(key);
+  }
+
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    Destination& primary = *destinations_[primary_];
+    std::lock_guard<std::mutex> storeLock(primary.storeMutex);
+    return primary.store->read(key, offset, length);
+  }
+
+  virtual EventDataBlock readEvent(int eventID) override
+  {
+    Destination& primary = *destinations_[primary_];
+    std::lock_guard<std::mutex> storeLock(primary.storeMutex);
+    return primary.store->readEvent(eventID);
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    const Destination& primary = *destinations_[primary_];
+    std::lock_guard<std::mutex> storeLock(primary.storeMutex);
+    return primary.store->getAllExistingKeys();
+  }
+
+  /**
+   * @brief Returns the keys that any of the destinations stored in the
+   * specified file (destinations may share a directory, or not).
+   */
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    std::vector<StorageKey> keyList;
+    std::unordered_set<StorageKey> keySet;
+    for (auto& dest : destinations_) {
+      std::vector<StorageKey> destKeys;
+      {
+        std::lock_guard<std::mutex> storeLock(dest->storeMutex);
+        destKeys = dest->store->getKeysInFile(fileName);
+      }
+      for (auto& key : destKeys) {
+        if (keySet.insert(key).second) {
+          keyList.push_back(key);
+        }
+      }
+    }
+    return keyList;
+  }
+
+private:
+  TeeDataStore(const TeeDataStore&) = delete;
+  TeeDataStore& operator=(const TeeDataStore&) = delete;
+  TeeDataStore(TeeDataStore&&) = delete;
+  TeeDataStore& operator=(TeeDataStore&&) = delete;
+
+  // The outcome of the required destinations' part of one write() call.
+  struct WriteCompletion
+  {
+    size_t pending = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable doneCondition;
+  };
+
+  struct Task
+  {
+    explicit Task(const StorageKey& theKey)
+      : key(theKey)
+    {}
+
+    StorageKey key;
+    size_t size = 0;
+    const void* data = nullptr;
+    std::shared_ptr<const void> keepAlive;
+    // only set for required destinations, whose caller waits for the task
+    WriteCompletion* completion = nullptr;
+  };
+
+  struct Destination
+  {
+    std::string policy;
+    size_t sampleInterval = 1;
+    size_t sampleCounter = 0; // protected by queueMutex
+    size_t queueCapacity = REASONABLE_DEFAULT_QUEUE_CAPACITY;
+
+    // the child store is only ever accessed with storeMutex held
+    std::unique_ptr<DataStore> store;
+    mutable std::mutex storeMutex;
+
+    // everything below is protected by queueMutex
+    std::deque<Task> queue;
+    size_t reservedSlots = 0;
+    bool busy = false;
+    bool stopRequested = false;
+    size_t droppedCount = 0;
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable doneCondition;
+
+    std::thread worker;
+  };
+
+  std::vector<std::unique_ptr<Destination>> destinations_;
+  size_t primary_;
+
+  // (the primary destination has no queue, so this returns at once for it)
+  void waitForQueue_(Destination& dest)
+  {
+    std::unique_lock<std::mutex> lock(dest.queueMutex);
+    dest.doneCondition.wait(lock, [&] { return dest.queue.empty() && dest.reservedSlots == 0 && !dest.busy; });
+  }
+
+  void workerLoop_(size_t destIndex)
+  {
+    Destination& dest = *destinations_[destIndex];
+    std::unique_lock<std::mutex> lock(dest.queueMutex);
+    while (true) {
+      dest.queueCondition.wait(lock, [&] { return dest.stopRequested || !dest.queue.empty(); });
+      if (dest.queue.empty()) {
+        break;
+      }
+      Task task = std::move(dest.queue.front());
+      dest.queue.pop_front();
+      dest.busy = true;
+      lock.unlock();
+
+      KeyedDataBlock dataBlock(task.key);
+      dataBlock.unowned_data_start = task.data;
+      dataBlock.data_size = task.size;
+      std::exception_ptr error;
+      try {
+        std::lock_guard<std::mutex> storeLock(dest.storeMutex);
+        dest.store->write(dataBlock);
+      } catch (const std::exception& excpt) {
+        if (task.completion != nullptr) {
+          error = std::current_exception();
+        } else {
+          ers::warning(OptionalDestinationWriteFailed(
+            ERS_HERE, get_name(), dest.store->get_name(), task.key.getEventID(), task.key.getGeoLocation(), excpt));
+        }
+      }
+
+      if (task.completion != nullptr) {
+        // (the caller's completion goes away as soon as it sees pending reach
+        // zero, so it is only touched with its mutex held)
+        std::lock_guard<std::mutex> completionLock(task.completion->mutex);
+        if (error && !task.completion->error) {
+          task.completion->error = error;
+        }
+        --task.completion->pending;
+        task.completion->doneCondition.notify_all();
+      }
+
+      lock.lock();
+      dest.busy = false;
+      dest.doneCondition.notify_all();
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_TEEDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,3 @@
+#include "TieredDataStore.hpp"
+
+DEFINE_DUNE_DATA_STORE(dunedaq::ddpdemo::TieredDataStore)
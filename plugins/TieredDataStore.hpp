@@ -0,0 +1,560 @@
+#ifndef DDPDEMO_SRC_TIEREDDATASTORE_HPP_
+#define DDPDEMO_SRC_TIEREDDATASTORE_HPP_
+
+/**
+ * @file TieredDataStore.hpp
+ *
+ * An implementation of the DataStore interface that accepts data blocks
+ * into a bounded memory tier and spills them to a slower child DataStore
+ * (e.g. an HDF5DataStore) in the background.  This absorbs bursts that
+ * the child store can not keep up with, as long as the average rate is
+ * sustainable.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+
+#include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       MemoryTierHighWaterMark,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The memory tier has reached the " << percent << "% high-water mark (" << used_bytes << " of "
+                                                          << capacity_bytes << " bytes in use).",
+                       ((std::string)name),
+                       ((int)percent)((size_t)used_bytes)((size_t)capacity_bytes))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       SpillToChildStoreFailed,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Failed to spill the data block with eventID " << eventID << " and geoLocation " << geoLocation
+                                                                      << " to the child DataStore.",
+                       ((std::string)name),
+                       ((int)eventID)((int)geoLocation))
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       UnspilledDataBlocks,
+                       appfwk::GeneralDAQModuleIssue,
+                       count << " data blocks could not be spilled to the child DataStore; they are still held in "
+                             << "the memory tier.",
+                       ((std::string)name),
+                       ((size_t)count))
+
+namespace ddpdemo {
+
+/**
+ * @brief TieredDataStore buffers data blocks in memory and writes them to a
+ * child DataStore from a background spill thread.
+ */
+class TieredDataStore : public DataStore
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_MEMORY_CAPACITY_BYTES = 1024 * 1024 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_SPILL_BATCH_BYTES = 16 * 1024 * 1024;
+  static constexpr size_t REASONABLE_DEFAULT_SPILL_MAX_AGE_MSEC = 1000;
+  static constexpr size_t REASONABLE_DEFAULT_SPILL_RETRY_MSEC = 1000;
+  static constexpr size_t MAXIMUM_SPILL_RETRY_MSEC = 60000;
+
+  explicit TieredDataStore(const nlohmann::json& conf)
+    : DataStore(conf["name"].get<std::string>())
+    , memoryBytes_(0)
+    , pendingBytes_(0)
+    , peakMemoryBytes_(0)
+    , spillsInProgress_(0)
+    , reportedHighWaterMarks_(0)
+    , flushRequested_(false)
+    , stopRequested_(false)
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
+
+    memoryCapacity_ = conf.value<size_t>("memory_capacity_bytes", REASONABLE_DEFAULT_MEMORY_CAPACITY_BYTES);
+    spillBatchBytes_ = conf.value<size_t>("spill_batch_bytes", REASONABLE_DEFAULT_SPILL_BATCH_BYTES);
+    spillMaxAge_ = std::chrono::milliseconds(
+      conf.value<size_t>("spill_max_age_msec", REASONABLE_DEFAULT_SPILL_MAX_AGE_MSEC));
+    spillRetryInterval_ = std::chrono::milliseconds(
+      std::max(conf.value<size_t>("spill_retry_msec", REASONABLE_DEFAULT_SPILL_RETRY_MSEC), static_cast<size_t>(1)));
+    retryBackoff_ = spillRetryInterval_;
+    highWaterMarks_ = conf.value<std::vector<double>>("high_water_marks", std::vector<double>{ 0.5, 0.75, 0.9 });
+    std::sort(highWaterMarks_.begin(), highWaterMarks_.end());
+
+    childStore_ = makeDataStore(conf["child_data_store_parameters"]);
+
+    spillThread_ = std::thread(&TieredDataStore::spillLoop_, this);
+  }
+
+  ~TieredDataStore()
+  {
+    try {
+      flush();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopRequested_ = true;
+    }
+    spillCondition_.notify_all();
+    spillThread_.join();
+
+    TLOG(TLVL_DEBUG) << get_name() << ": Peak memory tier usage was " << peakMemoryBytes_ << " of " << memoryCapacity_
+                     << " bytes.";
+  }
+
+  virtual void setup(const size_t eventId) override { childStore_->setup(eventId); }
+
+  virtual void attachStatistics(std::shared_ptr<DataStoreStatistics> statistics) override
+  {
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    childStore_->attachStatistics(statistics);
+  }
+
+  /**
+   * @brief Copies the data block into the memory tier.  If the memory tier is
+   * full, this waits for the spill thread to make room.  Data blocks that are
+   * larger than the whole memory tier are written straight to the child store,
+   * once any earlier copy of them has left the memory tier.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    if (size > memoryCapacity_) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        discardFromMemory_(lock, dataBlock.data_key);
+      }
+      std::lock_guard<std::mutex> childLock(childMutex_);
+      childStore_->write(dataBlock);
+      return;
+    }
+
+    std::shared_ptr<TierEntry> entry(new TierEntry(dataBlock.data_key));
+    entry->size = size;
+    entry->data.reset(new char[size]);
+    memcpy(entry->data.get(), dataBlock.getDataStart(), size);
+    entry->arrivalTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    spaceCondition_.wait(lock, [&] { return memoryBytes_ + size <= memoryCapacity_; });
+
+    const bool wasIdle = pending_.empty();
+    memoryBytes_ += size;
+    pendingBytes_ += size;
+    memoryIndex_[entry->key] = entry;
+    pending_.push_back(entry);
+    if (memoryBytes_ > peakMemoryBytes_) {
+      peakMemoryBytes_ = memoryBytes_;
+    }
+    checkHighWaterMarks_();
+
+    // the spill thread waits without a deadline while nothing is pending, so
+    // it needs to hear about the first entry (for its age limit) as well
+    if (wasIdle || pendingBytes_ >= spillBatchBytes_) {
+      spillCondition_.notify_all();
+    }
+  }
+
+  /**
+   * @brief Writes the reference to the child store, once any copy of the data
+   * block has left the memory tier (so that it can not replace the reference).
+   */
+  virtual bool writeLink(const DataStore& source, const StorageKey& key) override
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      discardFromMemory_(lock, key);
+    }
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->writeLink(source, key);
+  }
+
+  virtual bool acceptsNativeCopy(const DataStore& source) const override
+  {
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->acceptsNativeCopy(source);
+  }
+
+  /**
+   * @brief Native copies bypass the memory tier, like large data blocks do.
+   */
+  virtual size_t writeNativeCopy(DataStore& source, const StorageKey& key) override
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      discardFromMemory_(lock, key);
+    }
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->writeNativeCopy(source, key);
+  }
+
+  virtual bool materialize(const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->materialize(key);
+  }
+
+  /**
+   * @brief Waits until everything in the memory tier has been spilled, then
+   * flushes the child store.  Data blocks whose spill failed earlier are tried
+   * again; if they still can not be written, they stay in the memory tier and
+   * UnspilledDataBlocks is thrown.
+   */
+  virtual void flush() override
+  {
+    size_t unspilledCount = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      requeueFailedEntries_();
+      flushRequested_ = true;
+      spillCondition_.notify_all();
+      spaceCondition_.wait(lock, [&] { return pending_.empty() && spillsInProgress_ == 0; });
+      flushRequested_ = false;
+      unspilledCount = failedEntries_.size();
+    }
+
+    {
+      std::lock_guard<std::mutex> childLock(childMutex_);
+      childStore_->flush();
+    }
+    if (unspilledCount > 0) {
+      throw UnspilledDataBlocks(ERS_HERE, get_name(), unspilledCount);
+    }
+  }
+
+  /**
+   * @brief Returns the data block from the memory tier, if it is still there,
+   * and from the child store otherwise.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    std::shared_ptr<TierEntry> entry;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto iter = memoryIndex_.find(key);
+      if (iter != memoryIndex_.end()) {
+        entry = iter->second;
+      }
+    }
+
+    if (entry.get() != nullptr) {
+      KeyedDataBlock dataBlock(key);
+      dataBlock.data_size = entry->size;
+      char* membuffer = new char[entry->size];
+      memcpy(membuffer, entry->data.get(), entry->size);
+      std::unique_ptr<char> memPtr(membuffer);
+      dataBlock.owned_data_start = std::move(memPtr);
+      return dataBlock;
+    }
+
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->read(key);
+  }
+
+  /**
+   * @brief Reads part of a data block; only data blocks that are no longer
+   * held in memory are read (partially) from the child store.
+   */
+  virtual KeyedDataBlock read(const StorageKey& key, size_t offset, size_t length) override
+  {
+    bool inMemory = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      inMemory = (memoryIndex_.count(key) > 0);
+    }
+    if (inMemory) {
+      // (if the block is evicted in the meantime, read() finds it in the child store)
+      return DataStore::read(key, offset, length);
+    }
+
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->read(key, offset, length);
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
+  {
+    std::vector<StorageKey> keyList;
+    {
+      std::lock_guard<std::mutex> childLock(childMutex_);
+      keyList = childStore_->getAllExistingKeys();
+    }
+    std::unordered_set<StorageKey> keySet(keyList.begin(), keyList.end());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& indexEntry : memoryIndex_) {
+      if (keySet.insert(indexEntry.first).second) {
+        keyList.push_back(indexEntry.first);
+      }
+    }
+    return keyList;
+  }
+
+  size_t getMemoryTierBytes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryBytes_;
+  }
+
+  size_t getPeakMemoryTierBytes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peakMemoryBytes_;
+  }
+
+  /**
+   * @brief Files are written by the child store, so only the data blocks that
+   * have been spilled are in them.
+   */
+  virtual std::vector<StorageKey> getKeysInFile(const std::string& fileName) const override
+  {
+    std::lock_guard<std::mutex> childLock(childMutex_);
+    return childStore_->getKeysInFile(fileName);
+  }
+
+private:
+  TieredDataStore(const TieredDataStore&) = delete;
+  TieredDataStore& operator=(const TieredDataStore&) = delete;
+  TieredDataStore(TieredDataStore&&) = delete;
+  TieredDataStore& operator=(TieredDataStore&&) = delete;
+
+  struct TierEntry
+  {
+    explicit TierEntry(const StorageKey& theKey)
+      : key(theKey)
+    {}
+
+    StorageKey key;
+    size_t size = 0;
+    std::unique_ptr<char[]> data;
+    std::chrono::steady_clock::time_point arrivalTime;
+  };
+
+  // Configuration
+  size_t memoryCapacity_;
+  size_t spillBatchBytes_;
+  std::chrono::milliseconds spillMaxAge_;
+  std::chrono::milliseconds spillRetryInterval_;
+  std::vector<double> highWaterMarks_;
+
+  // Child store, which is only ever accessed with childMutex_ held
+  std::unique_ptr<DataStore> childStore_;
+  mutable std::mutex childMutex_;
+
+  // Memory tier, protected by mutex_.  Entries stay in the index until they
+  // have been written to the child store, so that reads always find them.
+  std::unordered_map<StorageKey, std::shared_ptr<TierEntry>> memoryIndex_;
+  std::deque<std::shared_ptr<TierEntry>> pending_;
+  // entries whose spill failed; they stay in memory until the spill thread
+  // retries them (at retryTime_, backing off while they keep failing) or flush() does
+  std::vector<std::shared_ptr<TierEntry>> failedEntries_;
+  std::chrono::milliseconds retryBackoff_;
+  std::chrono::steady_clock::time_point retryTime_;
+  std::unordered_set<StorageKey> spillingKeys_;
+  size_t memoryBytes_;
+  size_t pendingBytes_;
+  size_t peakMemoryBytes_;
+  size_t spillsInProgress_;
+  size_t reportedHighWaterMarks_;
+  bool flushRequested_;
+  bool stopRequested_;
+  mutable std::mutex mutex_;
+  std::condition_variable spillCondition_;
+  std::condition_variable spaceCondition_;
+
+  std::thread spillThread_;
+
+  // must be called with mutex_ held
+  void checkHighWaterMarks_()
+  {
+    double fraction = static_cast<double>(memoryBytes_) / memoryCapacity_;
+    while (reportedHighWaterMarks_ < highWaterMarks_.size() && fraction >= highWaterMarks_[reportedHighWaterMarks_]) {
+      int percent = static_cast<int>(highWaterMarks_[reportedHighWaterMarks_] * 100);
+      ers::warning(MemoryTierHighWaterMark(ERS_HERE, get_name(), percent, memoryBytes_, memoryCapacity_));
+      ++reportedHighWaterMarks_;
+    }
+    // marks are re-armed once the memory tier has drained below them
+    while (reportedHighWaterMarks_ > 0 && fraction < highWaterMarks_[reportedHighWaterMarks_ - 1]) {
+      --reportedHighWaterMarks_;
+    }
+  }
+
+  // Drops the copies of the key that are waiting in the memory tier, and waits
+  // for one that is being spilled, so that neither can later overwrite (or be
+  // read instead of) data that is written straight to the child store.
+  // must be called with mutex_ held
+  void discardFromMemory_(std::unique_lock<std::mutex>& lock, const StorageKey& key)
+  {
+    spaceCondition_.wait(lock, [&] { return spillingKeys_.count(key) == 0; });
+    if (memoryIndex_.erase(key) == 0) {
+      return;
+    }
+    for (auto iter = pending_.begin(); iter != pending_.end();) {
+      if ((*iter)->key == key) {
+        pendingBytes_ -= (*iter)->size;
+        memoryBytes_ -= (*iter)->size;
+        iter = pending_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+    for (auto iter = failedEntries_.begin(); iter != failedEntries_.end();) {
+      if ((*iter)->key == key) {
+        memoryBytes_ -= (*iter)->size;
+        iter = failedEntries_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+    checkHighWaterMarks_();
+    spaceCondition_.notify_all();
+  }
+
+  // Puts the entries whose spill failed back at the front of the queue, in
+  // their original order.  Entries that have been replaced by a newer copy of
+  // the same key in the meantime are dropped instead.
+  // must be called with mutex_ held
+  void requeueFailedEntries_()
+  {
+    for (auto iter = failedEntries_.rbegin(); iter != failedEntries_.rend(); ++iter) {
+      auto indexIter = memoryIndex_.find((*iter)->key);
+      if (indexIter != memoryIndex_.end() && indexIter->second == *iter) {
+        pending_.push_front(*iter);
+        pendingBytes_ += (*iter)->size;
+      } else {
+        memoryBytes_ -= (*iter)->size;
+      }
+    }
+    failedEntries_.clear();
+    checkHighWaterMarks_();
+    spaceCondition_.notify_all();
+  }
+
+  // must be called with mutex_ held
+  bool spillIsDue_() const
+  {
+    if (pending_.empty()) {
+      return false;
+    }
+    return flushRequested_ || stopRequested_ || pendingBytes_ >= spillBatchBytes_ ||
+           std::chrono::steady_clock::now() - pending_.front()->arrivalTime >= spillMaxAge_;
+  }
+
+  void spillLoop_()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_ || !pending_.empty()) {
+      // failed entries that are due for a retry are spilled right away, whatever their age
+      const bool retryIsWaiting = !failedEntries_.empty() && !stopRequested_;
+      const bool retryIsDue = retryIsWaiting && std::chrono::steady_clock::now() >= retryTime_;
+      if (retryIsDue) {
+        requeueFailedEntries_();
+      }
+      if (!retryIsDue && !spillIsDue_()) {
+        // wake up in time to honor the age limit of the oldest pending entry, and to retry failed entries
+        auto wakeTime = std::chrono::steady_clock::time_point::max();
+        if (!pending_.empty()) {
+          wakeTime = pending_.front()->arrivalTime + spillMaxAge_;
+        }
+        if (retryIsWaiting) {
+          wakeTime = std::min(wakeTime, retryTime_);
+        }
+        if (wakeTime == std::chrono::steady_clock::time_point::max()) {
+          spillCondition_.wait(lock);
+        } else {
+          spillCondition_.wait_until(lock, wakeTime);
+        }
+        continue;
+      }
+
+      // take a batch of the oldest entries
+      std::vector<std::shared_ptr<TierEntry>> batch;
+      size_t batchBytes = 0;
+      while (!pending_.empty() && (batch.empty() || batchBytes + pending_.front()->size <= spillBatchBytes_)) {
+        batchBytes += pending_.front()->size;
+        spillingKeys_.insert(pending_.front()->key);
+        batch.push_back(pending_.front());
+        pending_.pop_front();
+      }
+      pendingBytes_ -= batchBytes;
+      ++spillsInProgress_;
+      lock.unlock();
+
+      TLOG(TLVL_DEBUG) << get_name() << ": Spilling " << batch.size() << " data blocks (" << batchBytes
+                       << " bytes) to the child store";
+      std::vector<bool> spilled(batch.size(), false);
+      {
+        std::lock_guard<std::mutex> childLock(childMutex_);
+        for (size_t idx = 0; idx < batch.size(); ++idx) {
+          TierEntry& entry = *batch[idx];
+          KeyedDataBlock dataBlock(entry.key);
+          dataBlock.unowned_data_start = entry.data.get();
+          dataBlock.data_size = entry.size;
+          try {
+            childStore_->write(dataBlock);
+            spilled[idx] = true;
+          } catch (const std::exception& excpt) {
+            ers::error(
+              SpillToChildStoreFailed(ERS_HERE, get_name(), entry.key.getEventID(), entry.key.getGeoLocation(), excpt));
+          }
+        }
+      }
+
+      lock.lock();
+      bool anyFailed = false;
+      for (size_t idx = 0; idx < batch.size(); ++idx) {
+        auto& entry = batch[idx];
+        auto iter = memoryIndex_.find(entry->key);
+        const bool isCurrent = (iter != memoryIndex_.end() && iter->second == entry);
+        if (!spilled[idx] && isCurrent) {
+          // the memory tier holds the only copy, so it is kept (and stays readable)
+          failedEntries_.push_back(entry);
+          anyFailed = true;
+          continue;
+        }
+        if (isCurrent) {
+          memoryIndex_.erase(iter);
+        }
+        memoryBytes_ -= entry->size;
+      }
+      // failures are retried later, and less often while they keep failing
+      if (anyFailed) {
+        retryTime_ = std::chrono::steady_clock::now() + retryBackoff_;
+        retryBackoff_ = std::min(retryBackoff_ * 2, std::chrono::milliseconds(MAXIMUM_SPILL_RETRY_MSEC));
+      } else {
+        retryBackoff_ = spillRetryInterval_;
+      }
+      spillingKeys_.clear();
+      --spillsInProgress_;
+      checkHighWaterMarks_();
+      spaceCondition_.notify_all();
+    }
+  }
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_TIEREDDATASTORE_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,287 @@
+#ifndef DDPDEMO_SRC_TRANSFERPROGRESS_HPP_
+#define DDPDEMO_SRC_TRANSFERPROGRESS_HPP_
+/**
+ * @file TransferProgress.hpp
+ *
+ * TransferProgress keeps track of the data blocks that a transfer has
+ * completed, and persists that record in a file, so that a later transfer
+ * (after a crash, or of a run that has grown since) can skip them.  The
+ * record is compact: for each data stream (detector and geoLocation), the
+ * completed eventIDs are stored as ranges.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/StorageKey.hpp"
+
+#include <ers/Issue.h>
+#include <nlohmann/json.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ddpdemo,
+                  InvalidTransferProgressFile,
+                  "The transfer progress file \"" << filename << "\" could not be " << operation << ".",
+                  ((std::string)filename)((std::string)operation))
+
+namespace ddpdemo {
+
+/**
+ * @brief TransferProgress is a persistent record of the completed data blocks.
+ */
+class TransferProgress
+{
+public:
+  static constexpr size_t REASONABLE_DEFAULT_SAVE_INTERVAL_MSEC = 1000;
+
+  using StreamID = std::pair<std::string, int>;
+
+  /**
+   * @brief A copy of the record at one point in time, to be saved later (e.g.
+   * once the output up to that point has been flushed).
+   */
+  struct Snapshot
+  {
+    std::map<StreamID, std::map<int, int>> ranges;
+    size_t doneCount = 0;
+  };
+
+  /**
+   * @brief Loads the record from the specified file, if it exists.
+   */
+  explicit TransferProgress(const std::string& fileName,
+                            size_t saveIntervalMsec = REASONABLE_DEFAULT_SAVE_INTERVAL_MSEC)
+    : fileName_(fileName)
+    , saveInterval_(saveIntervalMsec)
+    , doneCount_(0)
+    , savedDoneCount_(0)
+    , lastSaveTime_(std::chrono::steady_clock::now())
+  {
+    std::ifstream inputFile(fileName_);
+    if (!inputFile.is_open()) {
+      return;
+    }
+    try {
+      nlohmann::json record = nlohmann::json::parse(inputFile);
+      for (auto& stream : record["streams"]) {
+        auto& ranges = ranges_[StreamID(stream["detector_id"].get<std::string>(), stream["geo_location"].get<int>())];
+        for (auto& range : stream["events"]) {
+          ranges[range[0].get<int>()] = range[1].get<int>();
+          doneCount_ += range[1].get<int>() - range[0].get<int>() + 1;
+        }
+      }
+    } catch (const nlohmann::json::exception& excpt) {
+      throw InvalidTransferProgressFile(ERS_HERE, fileName_, "read", excpt);
+    }
+    savedDoneCount_ = doneCount_;
+  }
+
+  ~TransferProgress()
+  {
+    try {
+      save();
+    } catch (const ers::Issue& excpt) {
+      ers::error(excpt);
+    }
+  }
+
+  TransferProgress(const TransferProgress&) = delete;
+  TransferProgress& operator=(const TransferProgress&) = delete;
+
+  bool isDone(const StorageKey& key) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto streamIter = ranges_.find(StreamID(key.getDetectorID(), key.getGeoLocation()));
+    if (streamIter == ranges_.end()) {
+      return false;
+    }
+    auto rangeIter = streamIter->second.upper_bound(key.getEventID());
+    return rangeIter != streamIter->second.begin() && std::prev(rangeIter)->second >= key.getEventID();
+  }
+
+  /**
+   * @brief Records that the data block with the specified key has been transferred.
+   */
+  void markDone(const StorageKey& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& ranges = ranges_[StreamID(key.getDetectorID(), key.getGeoLocation())];
+    const int eventID = key.getEventID();
+
+    // extend (or merge) the neighbouring ranges where possible
+    auto nextIter = ranges.upper_bound(eventID);
+    if (nextIter != ranges.begin()) {
+      auto prevIter = std::prev(nextIter);
+      if (prevIter->second >= eventID) {
+        return;
+      }
+      if (prevIter->second == eventID - 1) {
+        prevIter->second = eventID;
+        if (nextIter != ranges.end() && nextIter->first == eventID + 1) {
+          prevIter->second = nextIter->second;
+          ranges.erase(nextIter);
+        }
+        ++doneCount_;
+        return;
+      }
+    }
+    if (nextIter != ranges.end() && nextIter->first == eventID + 1) {
+      int last = nextIter->second;
+      ranges.erase(nextIter);
+      ranges[eventID] = last;
+    } else {
+      ranges[eventID] = eventID;
+    }
+    ++doneCount_;
+  }
+
+  /**
+   * @brief Tells whether the record has changed and the save interval has passed.
+   */
+  bool isSaveDue() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return doneCount_ > savedDoneCount_ && std::chrono::steady_clock::now() - lastSaveTime_ >= saveInterval_;
+  }
+
+  void save()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (doneCount_ > savedDoneCount_) {
+      save_(ranges_, doneCount_);
+    }
+  }
+
+  Snapshot takeSnapshot() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Snapshot snapshot;
+    snapshot.ranges = ranges_;
+    snapshot.doneCount = doneCount_;
+    return snapshot;
+  }
+
+  /**
+   * @brief Saves an earlier snapshot of the record.  A snapshot that is not
+   * newer than the saved record is ignored, so that concurrent savers cannot
+   * replace a newer record with an older one.
+   */
+  void save(const Snapshot& snapshot)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (snapshot.doneCount > savedDoneCount_) {
+      save_(snapshot.ranges, snapshot.doneCount);
+    }
+  }
+
+  size_t getDoneCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return doneCount_;
+  }
+
+  size_t getRangeCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t rangeCount = 0;
+    for (auto& stream : ranges_) {
+      rangeCount += stream.second.size();
+    }
+    return rangeCount;
+  }
+
+private:
+  void save_(const std::map<StreamID, std::map<int, int>>& ranges, size_t doneCount)
+  {
+    nlohmann::json record;
+    record["streams"] = nlohmann::json::array();
+    for (auto& stream : ranges) {
+      nlohmann::json streamRecord;
+      streamRecord["detector_id"] = stream.first.first;
+      streamRecord["geo_location"] = stream.first.second;
+      streamRecord["events"] = nlohmann::json::array();
+      for (auto& range : stream.second) {
+        streamRecord["events"].push_back({ range.first, range.second });
+      }
+      record["streams"].push_back(streamRecord);
+    }
+
+    // the new record replaces the old one in a single rename, so that a crash
+    // leaves one or the other behind, never a partial file.  The new file is
+    // synced before the rename, and the directory after it, so that the
+    // rename cannot reach the disk before the contents do.
+    std::string tempFileName = fileName_ + ".tmp";
+    writeAndSync_(tempFileName, record.dump());
+    if (std::rename(tempFileName.c_str(), fileName_.c_str()) != 0) {
+      throw InvalidTransferProgressFile(ERS_HERE, fileName_, "replaced");
+    }
+    std::string directoryName = std::filesystem::path(fileName_).parent_path().string();
+    int directoryFd = open(directoryName.empty() ? "." : directoryName.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+      fsync(directoryFd);
+      close(directoryFd);
+    }
+    savedDoneCount_ = doneCount;
+    lastSaveTime_ = std::chrono::steady_clock::now();
+  }
+
+  static void writeAndSync_(const std::string& fileName, const std::string& contents)
+  {
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw InvalidTransferProgressFile(ERS_HERE, fileName, "created");
+    }
+    size_t written = 0;
+    while (written < contents.size()) {
+      ssize_t result = write(fd, contents.data() + written, contents.size() - written);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        close(fd);
+        throw InvalidTransferProgressFile(ERS_HERE, fileName, "written");
+      }
+      written += result;
+    }
+    if (fsync(fd) != 0) {
+      close(fd);
+      throw InvalidTransferProgressFile(ERS_HERE, fileName, "synced");
+    }
+    close(fd);
+  }
+
+  std::string fileName_;
+  std::chrono::milliseconds saveInterval_;
+
+  // completed eventIDs for each stream, as a map from the first to the last of each range
+  std::map<StreamID, std::map<int, int>> ranges_;
+  size_t doneCount_;
+  size_t savedDoneCount_;
+  std::chrono::steady_clock::time_point lastSaveTime_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace ddpdemo
+} // namespace dunedaq
+
+#endif // DDPDEMO_SRC_TRANSFERPROGRESS_HPP_
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
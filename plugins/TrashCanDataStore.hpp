@@ -5,8 +5,9 @@
  * @file TrashCanDataStore.hpp
  *
  * An implementation of the DataStore interface that simply throws
- * data away instead of storing it.  Obviously, this class is just
- * for demonstration and testing purposes.
+ * data away instead of storing it.  It keeps counts of what it has
+ * received, so it can be used as a null sink when benchmarking the
+ * rest of the data flow.
  *
  * This is part of the DUNE DAQ Application Framework, copyright 2020.
  * Licensing/copyright details are in the COPYING file that you should have
@@ -15,51 +16,165 @@
 
 #include "ddpdemo/DataStore.hpp"
 
-#include <ers/Issue.h>
 #include <TRACE/trace.h>
+#include <appfwk/DAQModule.hpp>
+#include <ers/Issue.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
+#include <limits>
 #include <string>
 #include <vector>
 #include <sstream>
 
 namespace dunedaq {
+
+ERS_DECLARE_ISSUE_BASE(ddpdemo,
+                       InvalidPayloadAccess,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Unknown payload_access \"" << payloadAccess << "\"",
+                       ((std::string)name),
+                       ((std::string)payloadAccess))
+
 namespace ddpdemo {
 
 class TrashCanDataStore : public DataStore
 {
 public:
-  explicit TrashCanDataStore( const nlohmann::json & conf ) 
+  explicit TrashCanDataStore( const nlohmann::json & conf )
     : DataStore( conf["name"].get<std::string>() )
-  { ; }
+  {
+    TLOG(TLVL_DEBUG) << get_name() << ": Configuration: " << conf;
 
-  virtual void write(const KeyedDataBlock& dataBlock) override 
+    std::string payloadAccess = conf.value<std::string>("payload_access", "none");
+    if (payloadAccess == "touch") {
+      payloadAccess_ = PayloadAccess::Touch;
+    } else if (payloadAccess == "checksum") {
+      payloadAccess_ = PayloadAccess::Checksum;
+    } else if (payloadAccess == "none") {
+      payloadAccess_ = PayloadAccess::None;
+    } else {
+      throw InvalidPayloadAccess(ERS_HERE, get_name(), payloadAccess);
+    }
+    logSampleInterval_ = conf.value<size_t>("log_sample_interval", 0);
+    resetCounters_();
+  }
+
+  ~TrashCanDataStore()
   {
-    const void* dataPtr = dataBlock.getDataStart();
+    if (fragmentCount_.load() > 0) {
+      reportStatistics_();
+    }
+  }
+
+  /**
+   * @brief Counts the data block and throws it away.  Depending on the
+   * configuration, the payload is first touched (one byte per cache line)
+   * or checksummed (every byte), so that memory bandwidth is exercised.
+   */
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    const size_t size = dataBlock.getDataSizeBytes();
+    const uint8_t * interpreted_data_ptr = static_cast<const uint8_t*>( dataBlock.getDataStart() ) ;
+
+    if (payloadAccess_ == PayloadAccess::Touch) {
+      checksum_.fetch_add(touchPayload_(interpreted_data_ptr, size), std::memory_order_relaxed);
+    } else if (payloadAccess_ == PayloadAccess::Checksum) {
+      checksum_.fetch_add(checksumPayload_(interpreted_data_ptr, size), std::memory_order_relaxed);
+    }
 
-    const uint8_t * interpreted_data_ptr = reinterpret_cast<const uint8_t*>( dataPtr ) ;  // NOLINT 
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t noTimeYet = 0;
+    firstWriteNsec_.compare_exchange_strong(noTimeYet, now, std::memory_order_relaxed);
+    lastWriteNsec_.store(now, std::memory_order_relaxed);
 
-    std::stringstream msg ;
-    msg << "Throwing away the data from event ID "
-	<< dataBlock.data_key.getEventID() << ", which has size of " << dataBlock.data_size
-	<< " bytes, and the following data "
-	<< "in the first few bytes: 0x" << std::hex << std::setfill('0') << std::setw(2)
-	<< interpreted_data_ptr[0] << " 0x" << interpreted_data_ptr[1] << " 0x"
-	<< interpreted_data_ptr[2] << " 0x" << interpreted_data_ptr[3] << std::dec ;
+    byteCount_.fetch_add(size, std::memory_order_relaxed);
+    size_t count = fragmentCount_.fetch_add(1, std::memory_order_relaxed) + 1;
+    updateMinimum_(minSize_, size);
+    updateMaximum_(maxSize_, size);
 
-    TLOG(TLVL_INFO) << msg.str() ;
+    if (logSampleInterval_ > 0 && (count % logSampleInterval_) == 0) {
+      std::stringstream msg ;
+      msg << "Throwing away the data from event ID "
+          << dataBlock.data_key.getEventID() << ", which has size of " << size << " bytes";
+      if (size > 0) {
+        msg << ", and the following data in the first few bytes:" << std::hex << std::setfill('0');
+        for (size_t idx = 0; idx < std::min<size_t>(size, 4); ++idx) {
+          msg << " 0x" << std::setw(2) << static_cast<unsigned>(interpreted_data_ptr[idx]);
+        }
+        msg << std::dec;
+      }
+      TLOG(TLVL_INFO) << msg.str() ;
+    }
   }
 
-  virtual std::vector<StorageKey> getAllExistingKeys() const override 
+  /**
+   * @brief Reports the statistics that have been gathered since the previous
+   * flush (in practice, since the start of the run) and resets them.
+   */
+  virtual void flush() override
+  {
+    reportStatistics_();
+    resetCounters_();
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override
   {
     std::vector<StorageKey> emptyList;
     return emptyList;
   }
 
-  virtual void setup(const size_t) override { ; } 
+  virtual void setup(const size_t) override { ; }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override {
+    KeyedDataBlock dataBlock(key);
+    dataBlock.data_size = 0;
+    dataBlock.unowned_data_start = nullptr;
+    return dataBlock;
+  }
+
+  size_t getFragmentCount() const { return fragmentCount_.load(std::memory_order_relaxed); }
+  size_t getByteCount() const { return byteCount_.load(std::memory_order_relaxed); }
+  uint64_t getChecksum() const { return checksum_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief The data rate since the first write, in MB/s, or zero if fewer than
+   * two writes have happened at different times.
+   */
+  double getRateMBps() const
+  {
+    double seconds = getElapsedSeconds_();
+    return (seconds > 0) ? (byteCount_.load() / 1.0e6 / seconds) : 0.0;
+  }
+
+  /**
+   * @brief The summary that is reported on flush and on destruction.
+   */
+  std::string getStatisticsSummary() const
+  {
+    size_t count = fragmentCount_.load();
+    size_t bytes = byteCount_.load();
+    if (count == 0) {
+      return get_name() + ": No data blocks were received.";
+    }
 
-  virtual KeyedDataBlock read(const StorageKey& key) override { 
-    return  KeyedDataBlock (key);
+    double seconds = getElapsedSeconds_();
+    std::ostringstream summary;
+    summary << get_name() << ": Threw away " << count << " data blocks with " << bytes
+            << " bytes (size min/avg/max = " << minSize_.load() << "/" << (bytes / count) << "/" << maxSize_.load()
+            << ") in " << seconds << " s: ";
+    if (seconds > 0) {
+      summary << std::fixed << std::setprecision(1) << getRateMBps() << " MB/s, " << (count / seconds)
+              << " fragments/s";
+    } else {
+      summary << "rate not available";
+    }
+    summary << ". Payload checksum = 0x" << std::hex << checksum_.load() << std::dec;
+    return summary.str();
   }
 
 private:
@@ -68,6 +183,81 @@ private:
   TrashCanDataStore& operator=(const TrashCanDataStore&) = delete;
   TrashCanDataStore(TrashCanDataStore&&) = delete;
   TrashCanDataStore& operator=(TrashCanDataStore&&) = delete;
+
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  enum class PayloadAccess
+  {
+    None,
+    Touch,
+    Checksum
+  };
+
+  // Configuration
+  PayloadAccess payloadAccess_;
+  size_t logSampleInterval_;
+
+  // Statistics
+  std::atomic<size_t> fragmentCount_;
+  std::atomic<size_t> byteCount_;
+  std::atomic<size_t> minSize_;
+  std::atomic<size_t> maxSize_;
+  std::atomic<uint64_t> checksum_;
+  std::atomic<int64_t> firstWriteNsec_;
+  std::atomic<int64_t> lastWriteNsec_;
+
+  void resetCounters_()
+  {
+    fragmentCount_ = 0;
+    byteCount_ = 0;
+    minSize_ = std::numeric_limits<size_t>::max();
+    maxSize_ = 0;
+    checksum_ = 0;
+    firstWriteNsec_ = 0;
+    lastWriteNsec_ = 0;
+  }
+
+  double getElapsedSeconds_() const { return (lastWriteNsec_.load() - firstWriteNsec_.load()) / 1.0e9; }
+
+  void reportStatistics_() const { ERS_INFO(getStatisticsSummary()); }
+
+  static void updateMinimum_(std::atomic<size_t>& minimum, size_t value)
+  {
+    size_t current = minimum.load(std::memory_order_relaxed);
+    while (value < current && !minimum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  static void updateMaximum_(std::atomic<size_t>& maximum, size_t value)
+  {
+    size_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  static uint64_t touchPayload_(const uint8_t* data, size_t size)
+  {
+    uint64_t sum = 0;
+    for (size_t idx = 0; idx < size; idx += CACHE_LINE_SIZE) {
+      sum += data[idx];
+    }
+    return sum;
+  }
+
+  static uint64_t checksumPayload_(const uint8_t* data, size_t size)
+  {
+    uint64_t sum = 0;
+    size_t idx = 0;
+    for (; idx + sizeof(uint64_t) <= size; idx += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, data + idx, sizeof(uint64_t));
+      sum += word;
+    }
+    for (; idx < size; ++idx) {
+      sum += data[idx];
+    }
+    return sum;
+  }
 };
 
 } // namespace ddpdemo
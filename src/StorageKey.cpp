@@ -40,5 +40,24 @@ StorageKey::getGeoLocation() const
   return m_key.m_geoLocation;
 }
 
+bool
+StorageKey::operator==(const StorageKey& other) const
+{
+  return m_key.m_event_id == other.m_key.m_event_id && m_key.m_geoLocation == other.m_key.m_geoLocation &&
+         m_key.m_detector_id == other.m_key.m_detector_id;
+}
+
+bool
+StorageKey::operator<(const StorageKey& other) const
+{
+  if (m_key.m_event_id != other.m_key.m_event_id) {
+    return m_key.m_event_id < other.m_key.m_event_id;
+  }
+  if (m_key.m_geoLocation != other.m_key.m_geoLocation) {
+    return m_key.m_geoLocation < other.m_key.m_geoLocation;
+  }
+  return m_key.m_detector_id < other.m_key.m_detector_id;
+}
+
 } // namespace ddpdemo
 } // namespace dunedaq
@@ -0,0 +1,152 @@
+/**
+ * @file socket_datastore_benchmark.cxx
+ *
+ * Compares the write throughput of DataStores that are used in-process with
+ * the same DataStores hosted by a server process and used through the
+ * SocketDataStore.  The server is started as a child process.
+ *
+ * Usage: socket_datastore_benchmark <directory> [block count] [block size in bytes]
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStore.hpp"
+#include "ddpdemo/SocketDataStoreServer.hpp"
+
+#include "ers/ers.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+SocketDataStoreServer* theServer = nullptr;
+
+void
+stopServer(int /*signal*/)
+{
+  if (theServer != nullptr) {
+    theServer->stop();
+  }
+}
+
+int
+runServer(const std::string& socketPath)
+{
+  try {
+    SocketDataStoreServer server(socketPath);
+    theServer = &server;
+    struct sigaction action;
+    action.sa_handler = stopServer;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGTERM, &action, nullptr);
+    server.run();
+    theServer = nullptr;
+  } catch (const ers::Issue& excpt) {
+    ers::fatal(excpt);
+    return 1;
+  }
+  return 0;
+}
+
+nlohmann::json
+makeStoreConfig(const std::string& type, const std::string& directory, const std::string& prefix)
+{
+  nlohmann::json conf;
+  conf["name"] = prefix;
+  conf["type"] = type;
+  conf["directory_path"] = directory;
+  conf["filename_prefix"] = prefix;
+  conf["mode"] = "all-per-file";
+  return conf;
+}
+
+double
+measureWriteRate(DataStore& store, size_t blockCount, const std::vector<char>& payload)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  for (size_t idx = 0; idx < blockCount; ++idx) {
+    KeyedDataBlock dataBlock(StorageKey(idx / 10 + 1, StorageKey::INVALID_DETECTORID, idx % 10));
+    dataBlock.unowned_data_start = payload.data();
+    dataBlock.data_size = payload.size();
+    store.write(dataBlock);
+  }
+  store.flush();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+  return blockCount * payload.size() / 1.0e6 / elapsed.count();
+}
+
+} // namespace ""
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <directory> [block count] [block size in bytes]" << std::endl;
+    return 1;
+  }
+  std::string directory = argv[1];
+  size_t blockCount = (argc > 2) ? std::stoul(argv[2]) : 10000;
+  size_t blockSize = (argc > 3) ? std::stoul(argv[3]) : 100000;
+  std::string socketPath = directory + "/socket_datastore_benchmark.sock";
+
+  // the server is forked before any threads are started in this process
+  pid_t serverPid = fork();
+  if (serverPid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (serverPid == 0) {
+    return runServer(socketPath);
+  }
+
+  std::vector<char> payload(blockSize, 'x');
+  int status = 0;
+  std::cout << std::fixed << std::setprecision(1);
+  try {
+    for (std::string type : { "TrashCanDataStore", "HDF5DataStore" }) {
+      std::string inProcessPrefix = "benchmark_in_process";
+      std::string socketPrefix = "benchmark_socket";
+      std::remove((directory + "/" + inProcessPrefix + "_all_events.hdf5").c_str());
+      std::remove((directory + "/" + socketPrefix + "_all_events.hdf5").c_str());
+
+      std::unique_ptr<DataStore> inProcessStore = makeDataStore(makeStoreConfig(type, directory, inProcessPrefix));
+      double inProcessRate = measureWriteRate(*inProcessStore, blockCount, payload);
+      inProcessStore.reset();
+
+      nlohmann::json socketConf;
+      socketConf["name"] = "benchmarkSocketStore";
+      socketConf["type"] = "SocketDataStore";
+      socketConf["socket_path"] = socketPath;
+      socketConf["data_store_parameters"] = makeStoreConfig(type, directory, socketPrefix);
+      std::unique_ptr<DataStore> socketStore = makeDataStore(socketConf);
+      double socketRate = measureWriteRate(*socketStore, blockCount, payload);
+      socketStore.reset();
+
+      std::cout << type << ", " << blockCount << " blocks of " << blockSize << " bytes: in-process " << inProcessRate
+                << " MB/s, through the socket server " << socketRate << " MB/s" << std::endl;
+    }
+  } catch (const ers::Issue& excpt) {
+    ers::fatal(excpt);
+    status = 1;
+  }
+
+  kill(serverPid, SIGTERM);
+  waitpid(serverPid, nullptr, 0);
+  return status;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file BoundedQueue_test.cxx Application that tests and demonstrates
+ * the functionality of the BoundedQueue class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/BoundedQueue.hpp"
+
+#define BOOST_TEST_MODULE BoundedQueue_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+BOOST_AUTO_TEST_SUITE(BoundedQueue_test)
+
+BOOST_AUTO_TEST_CASE(CloseDrainsQueue)
+{
+  BoundedQueue<int> queue(4);
+  BOOST_REQUIRE(queue.push(1));
+  BOOST_REQUIRE(queue.push(2));
+  queue.close();
+  BOOST_REQUIRE(!queue.push(3));
+
+  int item = 0;
+  BOOST_REQUIRE(queue.pop(item));
+  BOOST_REQUIRE_EQUAL(item, 1);
+  BOOST_REQUIRE(queue.pop(item));
+  BOOST_REQUIRE_EQUAL(item, 2);
+  BOOST_REQUIRE(!queue.pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(ProducersWaitForSpace)
+{
+  const int ITEM_COUNT = 10000;
+  const int CONSUMER_COUNT = 3;
+  BoundedQueue<int> queue(2);
+  std::atomic<long> sum(0);
+  std::atomic<size_t> maxSize(0);
+
+  std::vector<std::thread> consumers;
+  for (int idx = 0; idx < CONSUMER_COUNT; ++idx) {
+    consumers.emplace_back([&] {
+      int item = 0;
+      while (queue.pop(item)) {
+        sum += item;
+      }
+    });
+  }
+  for (int item = 1; item <= ITEM_COUNT; ++item) {
+    BOOST_REQUIRE(queue.push(int(item)));
+    maxSize = std::max(maxSize.load(), queue.size());
+  }
+  queue.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+
+  BOOST_REQUIRE_EQUAL(sum.load(), static_cast<long>(ITEM_COUNT) * (ITEM_COUNT + 1) / 2);
+  BOOST_REQUIRE(maxSize.load() <= queue.capacity());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
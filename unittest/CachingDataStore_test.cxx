@@ -0,0 +1,142 @@
+/**
+ * @file CachingDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the CachingDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/CachingDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE CachingDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc, size_t size, char fill)
+{
+  std::vector<char> dummyData(size, fill);
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+StorageKey
+makeKey(int eventID, int geoLoc)
+{
+  return StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc);
+}
+
+nlohmann::json
+makeConfig(const std::string& filePath, const std::string& filePrefix, size_t capacity, size_t shardCount)
+{
+  nlohmann::json childConf;
+  childConf["name"] = "tempWriter";
+  childConf["type"] = "HDF5DataStore";
+  childConf["filename_prefix"] = filePrefix;
+  childConf["directory_path"] = filePath;
+  childConf["mode"] = "all-per-file";
+
+  nlohmann::json conf;
+  conf["name"] = "tempCache";
+  conf["capacity_bytes"] = capacity;
+  conf["shard_count"] = shardCount;
+  conf["child_data_store_parameters"] = childConf;
+  return conf;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(CachingDataStore_test)
+
+BOOST_AUTO_TEST_CASE(HitsShareTheCachedPayload)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "caching" + std::to_string(getpid());
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+
+  CachingDataStore store(makeConfig(filePath, filePrefix, 100000, 4));
+  for (int eventID = 1; eventID <= 5; ++eventID) {
+    writeBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+  }
+
+  KeyedDataBlock first = store.read(makeKey(3, 0));
+  BOOST_REQUIRE_EQUAL(store.getMissCount(), 1);
+  BOOST_REQUIRE_EQUAL(first.getDataSizeBytes(), 1000);
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(first.getDataStart())[999], 3);
+
+  KeyedDataBlock second = store.read(makeKey(3, 0));
+  BOOST_REQUIRE_EQUAL(store.getHitCount(), 1);
+  BOOST_REQUIRE_EQUAL(second.getDataStart(), first.getDataStart());
+  BOOST_REQUIRE_EQUAL(store.getCachedBytes(), 1000);
+
+  // ranged reads of cached data blocks refer to the same payload
+  DataStore* basePtr = &store;
+  KeyedDataBlock range = basePtr->read(makeKey(3, 0), 100, 50);
+  BOOST_REQUIRE_EQUAL(store.getHitCount(), 2);
+  BOOST_REQUIRE_EQUAL(range.getDataSizeBytes(), 50);
+  BOOST_REQUIRE_EQUAL(range.getDataStart(), static_cast<const char*>(first.getDataStart()) + 100);
+
+  // a write replaces the cached copy
+  writeBlock(store, 3, 0, 500, 42);
+  BOOST_REQUIRE_EQUAL(store.getCachedBytes(), 0);
+  KeyedDataBlock third = store.read(makeKey(3, 0));
+  BOOST_REQUIRE_EQUAL(third.getDataSizeBytes(), 500);
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(third.getDataStart())[0], 42);
+  // the earlier handles are still valid
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(first.getDataStart())[0], 3);
+
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+}
+
+BOOST_AUTO_TEST_CASE(LeastRecentlyUsedBlocksAreEvicted)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "cachingLRU" + std::to_string(getpid());
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+
+  // room for three data blocks
+  CachingDataStore store(makeConfig(filePath, filePrefix, 3500, 1));
+  for (int eventID = 1; eventID <= 4; ++eventID) {
+    writeBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+  }
+  writeBlock(store, 5, 0, 5000, 5);
+
+  store.read(makeKey(1, 0));
+  store.read(makeKey(2, 0));
+  store.read(makeKey(3, 0));
+  store.read(makeKey(1, 0)); // event 2 is now the least recently used
+  BOOST_REQUIRE_EQUAL(store.getHitCount(), 1);
+  store.read(makeKey(4, 0));
+  BOOST_REQUIRE_EQUAL(store.getEvictionCount(), 1);
+  BOOST_REQUIRE_EQUAL(store.getCachedBytes(), 3000);
+
+  store.read(makeKey(1, 0));
+  store.read(makeKey(3, 0));
+  BOOST_REQUIRE_EQUAL(store.getHitCount(), 3);
+  store.read(makeKey(2, 0));
+  BOOST_REQUIRE_EQUAL(store.getMissCount(), 5);
+
+  // data blocks that are larger than the budget are not cached
+  KeyedDataBlock large = store.read(makeKey(5, 0));
+  BOOST_REQUIRE_EQUAL(large.getDataSizeBytes(), 5000);
+  BOOST_REQUIRE_EQUAL(store.getEvictionCount(), 2);
+  BOOST_REQUIRE_EQUAL(store.getCachedBytes(), 3000);
+
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+/**
+ * @file CoalescingDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the CoalescingDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/CoalescingDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE CoalescingDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc, size_t size)
+{
+  std::vector<char> dummyData(size, static_cast<char>(eventID + geoLoc));
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+void
+checkBlock(DataStore& store, const StorageKey& key, size_t size)
+{
+  KeyedDataBlock dataBlock = store.read(key);
+  BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), size);
+  const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+  for (size_t idx = 0; idx < size; ++idx) {
+    BOOST_REQUIRE_EQUAL(data_ptr[idx], static_cast<char>(key.getEventID() + key.getGeoLocation()));
+  }
+}
+
+nlohmann::json
+makeConfig(const std::string& filePath, const std::string& filePrefix)
+{
+  nlohmann::json childConf;
+  childConf["name"] = "tempWriter";
+  childConf["type"] = "HDF5DataStore";
+  childConf["filename_prefix"] = filePrefix;
+  childConf["directory_path"] = filePath;
+  childConf["mode"] = "all-per-file";
+
+  nlohmann::json conf;
+  conf["name"] = "tempCoalescer";
+  conf["small_block_threshold_bytes"] = 1000;
+  conf["pack_size_bytes"] = 10000;
+  conf["pack_max_age_msec"] = 60000;
+  conf["child_data_store_parameters"] = childConf;
+  return conf;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(CoalescingDataStore_test)
+
+BOOST_AUTO_TEST_CASE(PackedBlocksAreTransparent)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "coalescing" + std::to_string(getpid());
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+
+  const int EVENT_COUNT = 20;
+  const int GEOLOC_COUNT = 5;
+  const size_t SMALL_SIZE = 200;
+  const size_t LARGE_SIZE = 5000;
+  {
+    std::unique_ptr<CoalescingDataStore> dsPtr(new CoalescingDataStore(makeConfig(filePath, filePrefix)));
+    for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+      for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+        writeBlock(*dsPtr, eventID, geoLoc, SMALL_SIZE);
+      }
+      // large blocks bypass the packing
+      writeBlock(*dsPtr, eventID, GEOLOC_COUNT, LARGE_SIZE);
+    }
+
+    // blocks in the pack that is still being filled can be read, too
+    BOOST_REQUIRE_EQUAL(dsPtr->getAllExistingKeys().size(), EVENT_COUNT * (GEOLOC_COUNT + 1));
+    checkBlock(*dsPtr, StorageKey(EVENT_COUNT, StorageKey::INVALID_DETECTORID, 0), SMALL_SIZE);
+    checkBlock(*dsPtr, StorageKey(1, StorageKey::INVALID_DETECTORID, 0), SMALL_SIZE);
+  }
+
+  // a new instance finds the packs that were written by the previous one
+  std::unique_ptr<CoalescingDataStore> dsPtr(new CoalescingDataStore(makeConfig(filePath, filePrefix)));
+  std::vector<StorageKey> keyList = dsPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), EVENT_COUNT * (GEOLOC_COUNT + 1));
+  for (auto& key : keyList) {
+    BOOST_REQUIRE(key.getEventID() != CoalescingDataStore::PACK_EVENTID);
+    checkBlock(*dsPtr, key, (key.getGeoLocation() == GEOLOC_COUNT) ? LARGE_SIZE : SMALL_SIZE);
+  }
+
+  // blocks that are written again replace the packed ones
+  writeBlock(*dsPtr, 3, 1, 50);
+  dsPtr->flush();
+  BOOST_REQUIRE_EQUAL(dsPtr->getAllExistingKeys().size(), EVENT_COUNT * (GEOLOC_COUNT + 1));
+  checkBlock(*dsPtr, StorageKey(3, StorageKey::INVALID_DETECTORID, 1), 50);
+
+  dsPtr.reset();
+  std::filesystem::remove(filePath + "/" + filePrefix + "_all_events.hdf5");
+}
+
+BOOST_AUTO_TEST_CASE(ReplacedBlocksStayReplacedInANewInstance)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "coalescingraw" + std::to_string(getpid());
+  std::filesystem::remove(filePath + "/" + filePrefix + "_raw.dat");
+  std::filesystem::remove(filePath + "/" + filePrefix + "_raw.idx");
+
+  nlohmann::json conf = makeConfig(filePath, filePrefix);
+  conf["child_data_store_parameters"]["type"] = "RawFileDataStore";
+  {
+    CoalescingDataStore store(conf);
+    writeBlock(store, 1, 0, 200);
+    writeBlock(store, 1, 1, 200);
+    writeBlock(store, 2, 0, 200);
+    store.flush();
+
+    // the packed blocks are replaced by a large one, and by a small one that follows a large one
+    writeBlock(store, 1, 0, 5000);
+    writeBlock(store, 2, 0, 5000);
+    writeBlock(store, 2, 0, 100);
+    store.flush();
+    checkBlock(store, StorageKey(1, StorageKey::INVALID_DETECTORID, 0), 5000);
+    checkBlock(store, StorageKey(2, StorageKey::INVALID_DETECTORID, 0), 100);
+  }
+
+  CoalescingDataStore store(conf);
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), 3);
+  checkBlock(store, StorageKey(1, StorageKey::INVALID_DETECTORID, 0), 5000);
+  checkBlock(store, StorageKey(1, StorageKey::INVALID_DETECTORID, 1), 200);
+  checkBlock(store, StorageKey(2, StorageKey::INVALID_DETECTORID, 0), 100);
+
+  std::filesystem::remove(filePath + "/" + filePrefix + "_raw.dat");
+  std::filesystem::remove(filePath + "/" + filePrefix + "_raw.idx");
+}
+
+BOOST_AUTO_TEST_CASE(OldPacksAreWrittenWithoutFurtherWrites)
+{
+  nlohmann::json childConf;
+  childConf["name"] = "tempRing";
+  childConf["type"] = "MemoryRingDataStore";
+  childConf["capacity_bytes"] = 1024 * 1024;
+
+  nlohmann::json conf;
+  conf["name"] = "tempCoalescer";
+  conf["small_block_threshold_bytes"] = 1000;
+  conf["pack_size_bytes"] = 10000;
+  conf["pack_max_age_msec"] = 50;
+  conf["child_data_store_parameters"] = childConf;
+  CoalescingDataStore store(conf);
+
+  writeBlock(store, 1, 0, 200);
+  BOOST_REQUIRE_EQUAL(store.getPackCount(), 0);
+
+  // nothing else is written, but the pack goes out once it is old enough
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (store.getPackCount() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_REQUIRE_EQUAL(store.getPackCount(), 1);
+  checkBlock(store, StorageKey(1, StorageKey::INVALID_DETECTORID, 0), 200);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
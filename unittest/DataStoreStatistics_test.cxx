@@ -0,0 +1,86 @@
+/**
+ * @file DataStoreStatistics_test.cxx Application that tests and demonstrates
+ * the functionality of the LatencyHistogram and DataStoreStatistics classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/DataStoreStatistics.hpp"
+
+#define BOOST_TEST_MODULE DataStoreStatistics_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <string>
+
+using namespace dunedaq::ddpdemo;
+
+BOOST_AUTO_TEST_SUITE(DataStoreStatistics_test)
+
+BOOST_AUTO_TEST_CASE(BucketBoundaries)
+{
+  // small values each have their own bucket
+  for (uint64_t value = 0; value < LatencyHistogram::SUB_BUCKET_COUNT; ++value) {
+    BOOST_REQUIRE_EQUAL(LatencyHistogram::getBucketIndex(value), value);
+    BOOST_REQUIRE_EQUAL(LatencyHistogram::getBucketUpperBound(value), value);
+  }
+
+  // every value is at or below the upper bound of its bucket, and within the resolution of it
+  for (uint64_t value : { 8UL, 9UL, 15UL, 16UL, 17UL, 1000UL, 123456789UL, UINT64_MAX }) {
+    size_t index = LatencyHistogram::getBucketIndex(value);
+    BOOST_REQUIRE(index < LatencyHistogram::BUCKET_COUNT);
+    uint64_t upperBound = LatencyHistogram::getBucketUpperBound(index);
+    BOOST_REQUIRE(value <= upperBound);
+    BOOST_REQUIRE(upperBound - value <= value / LatencyHistogram::SUB_BUCKET_COUNT);
+    if (value < UINT64_MAX) {
+      BOOST_REQUIRE_EQUAL(LatencyHistogram::getBucketIndex(upperBound + 1), index + 1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Percentiles)
+{
+  LatencyHistogram histogram;
+  BOOST_REQUIRE_EQUAL(histogram.getValueAtPercentile(50.0), 0);
+
+  for (uint64_t value = 1; value <= 1000; ++value) {
+    histogram.record(value * 1000);
+  }
+  BOOST_REQUIRE_EQUAL(histogram.getCount(), 1000);
+
+  uint64_t median = histogram.getValueAtPercentile(50.0);
+  BOOST_REQUIRE(median >= 500000 && median <= 500000 + 500000 / LatencyHistogram::SUB_BUCKET_COUNT);
+  BOOST_REQUIRE_EQUAL(histogram.getValueAtPercentile(100.0), 1000000);
+
+  nlohmann::json summary = histogram.toJson();
+  BOOST_REQUIRE_EQUAL(summary["count"].get<uint64_t>(), 1000);
+  BOOST_REQUIRE_EQUAL(summary["min_nsec"].get<uint64_t>(), 1000);
+  BOOST_REQUIRE_EQUAL(summary["max_nsec"].get<uint64_t>(), 1000000);
+  BOOST_REQUIRE_EQUAL(summary["mean_nsec"].get<uint64_t>(), 500500);
+}
+
+BOOST_AUTO_TEST_CASE(NamedOperations)
+{
+  DataStoreStatistics statistics;
+  OperationStatistics& writes = statistics.getOperation("write");
+  BOOST_REQUIRE_EQUAL(&writes, &statistics.getOperation("write"));
+
+  writes.record(100, 4096);
+  {
+    OperationTimer timer(&writes, 1024);
+  }
+  {
+    // a timer without statistics records nothing
+    OperationTimer timer(nullptr, 1024);
+  }
+
+  nlohmann::json summary = statistics.toJson();
+  BOOST_REQUIRE_EQUAL(summary.size(), 1);
+  BOOST_REQUIRE_EQUAL(summary["write"]["count"].get<uint64_t>(), 2);
+  BOOST_REQUIRE_EQUAL(summary["write"]["bytes"].get<uint64_t>(), 5120);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
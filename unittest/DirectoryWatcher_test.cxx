@@ -0,0 +1,124 @@
+/**
+ * @file DirectoryWatcher_test.cxx Application that tests and demonstrates
+ * the functionality of the DirectoryWatcher class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/DirectoryWatcher.hpp"
+
+#define BOOST_TEST_MODULE DirectoryWatcher_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+std::string
+makeEmptyDirectory(const std::string& name)
+{
+  std::string directoryPath =
+    std::string(std::filesystem::temp_directory_path()) + "/" + name + std::to_string(getpid());
+  std::filesystem::remove_all(directoryPath);
+  std::filesystem::create_directory(directoryPath);
+  return directoryPath;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(DirectoryWatcher_test)
+
+BOOST_AUTO_TEST_CASE(ClosedFilesAreComplete)
+{
+  std::string directoryPath = makeEmptyDirectory("watchclose");
+  nlohmann::json conf;
+  conf["completeness_rule"] = "close";
+  conf["follow_poll_msec"] = 50;
+  DirectoryWatcher watcher(directoryPath, conf);
+  BOOST_REQUIRE(watcher.isUsingInotify());
+
+  std::ofstream openFile(directoryPath + "/open.dat");
+  openFile << "still being written";
+  openFile.flush();
+  {
+    std::ofstream closedFile(directoryPath + "/closed.dat");
+    closedFile << "finished";
+  }
+
+  std::vector<std::string> fileList = watcher.waitForCompleteFiles();
+  BOOST_REQUIRE_EQUAL(fileList.size(), 1);
+  BOOST_REQUIRE_EQUAL(fileList[0], directoryPath + "/closed.dat");
+
+  // each file is only reported once, unless it is retried
+  openFile.close();
+  fileList = watcher.waitForCompleteFiles();
+  BOOST_REQUIRE_EQUAL(fileList.size(), 1);
+  BOOST_REQUIRE_EQUAL(fileList[0], directoryPath + "/open.dat");
+  watcher.retryLater(fileList[0]);
+  fileList = watcher.waitForCompleteFiles();
+  BOOST_REQUIRE_EQUAL(fileList.size(), 1);
+  BOOST_REQUIRE(watcher.waitForCompleteFiles().empty());
+
+  std::filesystem::remove_all(directoryPath);
+}
+
+BOOST_AUTO_TEST_CASE(FilesAreCompleteAfterAnEventOverflow)
+{
+  size_t maxQueuedEvents = 0;
+  std::ifstream limitFile("/proc/sys/fs/inotify/max_queued_events");
+  if (!(limitFile >> maxQueuedEvents) || maxQueuedEvents > 100000) {
+    BOOST_TEST_MESSAGE("The inotify event queue is too large to overflow, skipping this test.");
+    return;
+  }
+
+  std::string directoryPath = makeEmptyDirectory("watchoverflow");
+  nlohmann::json conf;
+  conf["completeness_rule"] = "close";
+  conf["settle_msec"] = 100;
+  conf["follow_poll_msec"] = 50;
+  DirectoryWatcher watcher(directoryPath, conf);
+  BOOST_REQUIRE(watcher.isUsingInotify());
+
+  // more closed files than the event queue can hold, so some of their events are lost
+  const size_t FILE_COUNT = maxQueuedEvents + 100;
+  for (size_t idx = 0; idx < FILE_COUNT; ++idx) {
+    std::ofstream closedFile(directoryPath + "/file" + std::to_string(idx) + ".dat");
+  }
+
+  size_t reportedCount = 0;
+  for (int poll = 0; poll < 100 && reportedCount < FILE_COUNT; ++poll) {
+    reportedCount += watcher.waitForCompleteFiles().size();
+  }
+  BOOST_REQUIRE_EQUAL(reportedCount, FILE_COUNT);
+
+  std::filesystem::remove_all(directoryPath);
+}
+
+BOOST_AUTO_TEST_CASE(MarkedFilesAreComplete)
+{
+  std::string directoryPath = makeEmptyDirectory("watchmarker");
+  { std::ofstream existingFile(directoryPath + "/existing.dat"); }
+
+  nlohmann::json conf;
+  conf["completeness_rule"] = "marker";
+  conf["follow_poll_msec"] = 50;
+  DirectoryWatcher watcher(directoryPath, conf);
+  BOOST_REQUIRE(watcher.waitForCompleteFiles().empty());
+
+  { std::ofstream markerFile(directoryPath + "/existing.dat.done"); }
+  std::vector<std::string> fileList = watcher.waitForCompleteFiles();
+  BOOST_REQUIRE_EQUAL(fileList.size(), 1);
+  BOOST_REQUIRE_EQUAL(fileList[0], directoryPath + "/existing.dat");
+
+  std::filesystem::remove_all(directoryPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,105 @@
+/**
+ * @file EventClaimTracker_test.cxx Application that tests and demonstrates
+ * the functionality of the EventClaimTracker class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/EventClaimTracker.hpp"
+#include "../plugins/MemoryRingDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE EventClaimTracker_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+BOOST_AUTO_TEST_SUITE(EventClaimTracker_test)
+
+BOOST_AUTO_TEST_CASE(ClaimsStopAfterTheLastEvent)
+{
+  EventClaimTracker claims;
+  BOOST_REQUIRE(claims.claim(1));
+  BOOST_REQUIRE(claims.claim(3));
+  BOOST_REQUIRE(claims.claim(2));
+  BOOST_REQUIRE_EQUAL(claims.close(), 3);
+  BOOST_REQUIRE(claims.claim(3));
+  BOOST_REQUIRE(!claims.claim(4));
+
+  // a new run starts without a last event
+  claims.reset();
+  BOOST_REQUIRE(claims.claim(4));
+  BOOST_REQUIRE_EQUAL(claims.close(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(EventsAreCompleteAfterAStop)
+{
+  // the same scheme as the DataGenerator: every thread writes a slice of the
+  // geoIDs of each event, at its own pace, to a DataStore of its own
+  const size_t THREAD_COUNT = 4;
+  const size_t GEOID_COUNT = 10;
+  EventClaimTracker claims;
+  std::vector<std::unique_ptr<MemoryRingDataStore>> stores;
+  for (size_t idx = 0; idx < THREAD_COUNT; ++idx) {
+    nlohmann::json conf;
+    conf["name"] = "tempRing" + std::to_string(idx);
+    conf["capacity_bytes"] = 64 * 1024 * 1024;
+    stores.emplace_back(new MemoryRingDataStore(conf));
+  }
+
+  std::atomic<bool> running(true);
+  std::vector<std::thread> generators;
+  for (size_t threadIndex = 0; threadIndex < THREAD_COUNT; ++threadIndex) {
+    generators.emplace_back([&, threadIndex] {
+      const size_t firstGeoID = threadIndex * GEOID_COUNT / THREAD_COUNT;
+      const size_t endGeoID = (threadIndex + 1) * GEOID_COUNT / THREAD_COUNT;
+      char payload[16] = {};
+      for (int eventID = 1; claims.claim(eventID); ++eventID) {
+        for (size_t geoID = firstGeoID; geoID < endGeoID; ++geoID) {
+          KeyedDataBlock dataBlock(StorageKey(eventID, "FELIX", geoID));
+          dataBlock.unowned_data_start = payload;
+          dataBlock.data_size = sizeof(payload);
+          stores[threadIndex]->write(dataBlock);
+        }
+        // the threads run at different speeds, so they are out of step when the run stops
+        if (running.load()) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100 * (threadIndex + 1)));
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  int lastEventID = claims.close();
+  running.store(false);
+  for (auto& generator : generators) {
+    generator.join();
+  }
+  BOOST_REQUIRE_GT(lastEventID, 0);
+
+  std::map<int, std::set<int>> geoIDsByEvent;
+  for (auto& store : stores) {
+    for (auto& key : store->getAllExistingKeys()) {
+      BOOST_REQUIRE(geoIDsByEvent[key.getEventID()].insert(key.getGeoLocation()).second);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(geoIDsByEvent.size(), static_cast<size_t>(lastEventID));
+  for (int eventID = 1; eventID <= lastEventID; ++eventID) {
+    BOOST_REQUIRE_EQUAL(geoIDsByEvent[eventID].size(), GEOID_COUNT);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
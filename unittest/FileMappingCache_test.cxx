@@ -0,0 +1,75 @@
+/**
+ * @file FileMappingCache_test.cxx Application that tests and demonstrates
+ * the functionality of the FileMappingCache class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/FileMappingCache.hpp"
+
+#define BOOST_TEST_MODULE FileMappingCache_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+writeFile(const std::string& fileName, const std::string& contents)
+{
+  std::ofstream outputFile(fileName, std::ios::binary | std::ios::trunc);
+  outputFile << contents;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(FileMappingCache_test)
+
+BOOST_AUTO_TEST_CASE(MappingsAreReused)
+{
+  std::string fileName = std::string(std::filesystem::temp_directory_path()) + "/mapping" + std::to_string(getpid());
+  writeFile(fileName, "0123456789");
+
+  FileMappingCache cache;
+  std::shared_ptr<const char> mapping = cache.getMapping(fileName, 10);
+  BOOST_REQUIRE(mapping.get() != nullptr);
+  BOOST_REQUIRE_EQUAL(std::string(mapping.get(), 10), "0123456789");
+  BOOST_REQUIRE(cache.getMapping(fileName, 5) == mapping);
+  BOOST_REQUIRE(cache.getMapping(fileName, 11).get() == nullptr);
+
+  std::filesystem::remove(fileName);
+}
+
+BOOST_AUTO_TEST_CASE(ReplacedFilesAreMappedAgain)
+{
+  std::string fileName = std::string(std::filesystem::temp_directory_path()) + "/mapping" + std::to_string(getpid());
+  writeFile(fileName, "0123456789");
+
+  FileMappingCache cache;
+  std::shared_ptr<const char> oldMapping = cache.getMapping(fileName, 10);
+  BOOST_REQUIRE(oldMapping.get() != nullptr);
+
+  // a new file with the same name, which is not mistaken for the one that is mapped
+  writeFile(fileName + ".new", "abcdefghij");
+  std::filesystem::rename(fileName + ".new", fileName);
+  std::shared_ptr<const char> newMapping = cache.getMapping(fileName, 10);
+  BOOST_REQUIRE(newMapping.get() != nullptr);
+  BOOST_REQUIRE(newMapping != oldMapping);
+  BOOST_REQUIRE_EQUAL(std::string(newMapping.get(), 10), "abcdefghij");
+
+  // the old mapping stays alive, and still refers to the replaced file
+  BOOST_REQUIRE_EQUAL(std::string(oldMapping.get(), 10), "0123456789");
+  BOOST_REQUIRE_EQUAL(cache.getMappingCount(), 1);
+
+  std::filesystem::remove(fileName);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -168,4 +169,134 @@ BOOST_AUTO_TEST_CASE(CombineFragmentsIntoEvents)
   fileList = deleteFilesMatchingPattern(filePath, deletePattern);
 }
 
+BOOST_AUTO_TEST_CASE(LinkFragmentsIntoEvents)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demolink" + std::to_string(getpid());
+  std::string eventPrefix = "demolinkevents" + std::to_string(getpid());
+  const int EVENT_COUNT = 3;
+  const int GEOLOC_COUNT = 4;
+  const int DUMMYDATA_SIZE = 65536;
+
+  std::string deletePattern = "demolink.*" + std::to_string(getpid()) + ".*.hdf5";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  // write the fragment files, with a different fill for each fragment
+  nlohmann::json conf;
+  conf["name"] = "hdfDataStore";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["mode"] = "one-fragment-per-file";
+  std::unique_ptr<HDF5DataStore> inputPtr(new HDF5DataStore(conf));
+  std::vector<char> dummyData(DUMMYDATA_SIZE);
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      std::fill(dummyData.begin(), dummyData.end(), static_cast<char>(eventID * 16 + geoLoc));
+      KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+      dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+      dataBlock.data_size = DUMMYDATA_SIZE;
+      inputPtr->write(dataBlock);
+    }
+  }
+
+  // link the fragments into event files
+  conf["name"] = "hdfLinker";
+  conf["filename_prefix"] = eventPrefix;
+  conf["mode"] = "one-event-per-file";
+  std::unique_ptr<HDF5DataStore> outputPtr(new HDF5DataStore(conf));
+  std::vector<StorageKey> keyList = inputPtr->getAllExistingKeys();
+  for (auto& key : keyList) {
+    BOOST_REQUIRE(outputPtr->writeLink(*inputPtr, key));
+  }
+  inputPtr.reset();
+  outputPtr.reset();
+
+  // the event files only hold the links, and reads follow them
+  std::vector<std::string> fileList = getFilesMatchingPattern(filePath, eventPrefix + "_event_\\d+.hdf5");
+  BOOST_REQUIRE_EQUAL(fileList.size(), EVENT_COUNT);
+  BOOST_REQUIRE(std::filesystem::file_size(fileList[0]) < DUMMYDATA_SIZE);
+
+  auto checkEvents = [&](HDF5DataStore& store) {
+    std::vector<StorageKey> eventKeyList = store.getAllExistingKeys();
+    BOOST_REQUIRE_EQUAL(eventKeyList.size(), (EVENT_COUNT * GEOLOC_COUNT));
+    for (auto& key : eventKeyList) {
+      KeyedDataBlock dataBlock = store.read(key);
+      BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), DUMMYDATA_SIZE);
+      const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+      BOOST_REQUIRE_EQUAL(data_ptr[DUMMYDATA_SIZE - 1], static_cast<char>(key.getEventID() * 16 + key.getGeoLocation()));
+    }
+  };
+  outputPtr.reset(new HDF5DataStore(conf));
+  checkEvents(*outputPtr);
+
+  // after the links are materialized, the event files no longer need the fragment files
+  for (auto& key : keyList) {
+    BOOST_REQUIRE(outputPtr->materialize(key));
+    BOOST_REQUIRE(!outputPtr->materialize(key));
+  }
+  outputPtr.reset();
+  deleteFilesMatchingPattern(filePath, filePrefix + "_event_\\d+_geoID_\\d+.hdf5");
+  outputPtr.reset(new HDF5DataStore(conf));
+  checkEvents(*outputPtr);
+  outputPtr.reset();
+
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_CASE(NativeCopyFragmentsIntoEvents)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "democopy" + std::to_string(getpid());
+  const int EVENT_COUNT = 3;
+  const int GEOLOC_COUNT = 4;
+  const int DUMMYDATA_SIZE = 4096;
+
+  std::string deletePattern = filePrefix + ".*.hdf5";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "hdfReader";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["mode"] = "one-fragment-per-file";
+  std::unique_ptr<HDF5DataStore> inputPtr(new HDF5DataStore(conf));
+  std::vector<char> dummyData(DUMMYDATA_SIZE);
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      std::fill(dummyData.begin(), dummyData.end(), static_cast<char>(eventID * 16 + geoLoc));
+      KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+      dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+      dataBlock.data_size = DUMMYDATA_SIZE;
+      inputPtr->write(dataBlock);
+    }
+  }
+
+  // copy the fragments into event files with H5Ocopy
+  conf["name"] = "hdfWriter";
+  conf["mode"] = "one-event-per-file";
+  std::unique_ptr<HDF5DataStore> outputPtr(new HDF5DataStore(conf));
+  BOOST_REQUIRE(outputPtr->acceptsNativeCopy(*inputPtr));
+  std::vector<StorageKey> keyList = inputPtr->getAllExistingKeys();
+  for (auto& key : keyList) {
+    BOOST_REQUIRE_EQUAL(outputPtr->writeNativeCopy(*inputPtr, key), DUMMYDATA_SIZE);
+  }
+  inputPtr.reset();
+  outputPtr.reset();
+
+  std::vector<std::string> fileList = getFilesMatchingPattern(filePath, filePrefix + "_event_\\d+.hdf5");
+  BOOST_REQUIRE_EQUAL(fileList.size(), EVENT_COUNT);
+  outputPtr.reset(new HDF5DataStore(conf));
+  keyList = outputPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), (EVENT_COUNT * GEOLOC_COUNT));
+  for (auto& key : keyList) {
+    KeyedDataBlock dataBlock = outputPtr->read(key);
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), DUMMYDATA_SIZE);
+    const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+    BOOST_REQUIRE_EQUAL(data_ptr[0], static_cast<char>(key.getEventID() * 16 + key.getGeoLocation()));
+  }
+  outputPtr.reset();
+
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -243,4 +245,206 @@ BOOST_AUTO_TEST_CASE(ReadSingleFile)
   deleteFilesMatchingPattern(filePath, deletePattern);
 }
 
+BOOST_AUTO_TEST_CASE(ReadPartialDataBlocks)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  const int GEOLOC_COUNT = 3;
+  const int DUMMYDATA_SIZE = 1000;
+
+  // delete any pre-existing files so that we start with a clean slate
+  std::string deletePattern = filePrefix + ".*.hdf5";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["mode"] = "one-event-per-file";
+  std::unique_ptr<HDF5DataStore> dsPtr(new HDF5DataStore(conf));
+
+  char dummyData[DUMMYDATA_SIZE];
+  for (int idx = 0; idx < DUMMYDATA_SIZE; ++idx) {
+    dummyData[idx] = static_cast<char>(idx % 127);
+  }
+  for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+    KeyedDataBlock dataBlock(StorageKey(1, StorageKey::INVALID_DETECTORID, geoLoc));
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = DUMMYDATA_SIZE;
+    dsPtr->write(dataBlock);
+  }
+  dsPtr.reset(); // explicit destruction
+
+  conf["name"] = "tempReader";
+  std::unique_ptr<DataStore> dsPtr2(new HDF5DataStore(conf));
+
+  // the first bytes of every fragment, as for a header check
+  for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+    KeyedDataBlock dataBlock = dsPtr2->read(StorageKey(1, StorageKey::INVALID_DETECTORID, geoLoc), 0, 64);
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), 64);
+    BOOST_REQUIRE_EQUAL(memcmp(dataBlock.getDataStart(), dummyData, 64), 0);
+  }
+
+  // a window in the middle, a range that is clipped at the end, and one past the end
+  StorageKey key(1, StorageKey::INVALID_DETECTORID, 1);
+  KeyedDataBlock window = dsPtr2->read(key, 300, 200);
+  BOOST_REQUIRE_EQUAL(window.getDataSizeBytes(), 200);
+  BOOST_REQUIRE_EQUAL(memcmp(window.getDataStart(), dummyData + 300, 200), 0);
+  KeyedDataBlock tail = dsPtr2->read(key, 900, 500);
+  BOOST_REQUIRE_EQUAL(tail.getDataSizeBytes(), 100);
+  BOOST_REQUIRE_EQUAL(memcmp(tail.getDataStart(), dummyData + 900, 100), 0);
+  BOOST_REQUIRE_EQUAL(dsPtr2->read(key, 2000, 10).getDataSizeBytes(), 0);
+  dsPtr2.reset(); // explicit destruction
+
+  // clean up the files that were created
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+void
+readWholeEvents(const std::string& mode)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  const int EVENT_COUNT = 3;
+  const int GEOLOC_COUNT = 4;
+
+  // delete any pre-existing files so that we start with a clean slate
+  std::string deletePattern = filePrefix + ".*.hdf5";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["mode"] = mode;
+  std::unique_ptr<HDF5DataStore> dsPtr(new HDF5DataStore(conf));
+
+  // fragments of different sizes, each filled with its own value, written out of geoLocation order
+  std::vector<char> dummyData(1000);
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = GEOLOC_COUNT - 1; geoLoc >= 0; --geoLoc) {
+      std::fill(dummyData.begin(), dummyData.end(), static_cast<char>(eventID * 10 + geoLoc));
+      KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+      dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+      dataBlock.data_size = 100 * (geoLoc + 1);
+      dsPtr->write(dataBlock);
+    }
+  }
+  dsPtr.reset(); // explicit destruction
+
+  conf["name"] = "tempReader";
+  std::unique_ptr<DataStore> dsPtr2(new HDF5DataStore(conf));
+  EventDataBlock eventBlock = dsPtr2->readEvent(2);
+  BOOST_REQUIRE_EQUAL(eventBlock.event_id, 2);
+  BOOST_REQUIRE_EQUAL(eventBlock.getFragmentCount(), GEOLOC_COUNT);
+  BOOST_REQUIRE_EQUAL(eventBlock.getDataSizeBytes(), 100 + 200 + 300 + 400);
+
+  // the fragments are contiguous, in geoLocation order
+  size_t expectedOffset = 0;
+  for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+    BOOST_REQUIRE_EQUAL(eventBlock.fragment_keys[geoLoc].getGeoLocation(), geoLoc);
+    BOOST_REQUIRE_EQUAL(eventBlock.fragment_offsets[geoLoc], expectedOffset);
+    BOOST_REQUIRE_EQUAL(eventBlock.getFragmentSize(geoLoc), 100 * (geoLoc + 1));
+    const char* fragmentStart = static_cast<const char*>(eventBlock.getFragmentStart(geoLoc));
+    BOOST_REQUIRE_EQUAL(fragmentStart[0], static_cast<char>(20 + geoLoc));
+    BOOST_REQUIRE_EQUAL(fragmentStart[eventBlock.getFragmentSize(geoLoc) - 1], static_cast<char>(20 + geoLoc));
+    expectedOffset += eventBlock.getFragmentSize(geoLoc);
+  }
+
+  // a fragment can be taken out as a data block, which shares the event buffer
+  KeyedDataBlock fragment = eventBlock.getFragment(3);
+  BOOST_REQUIRE_EQUAL(fragment.getDataSizeBytes(), 400);
+  BOOST_REQUIRE_EQUAL(fragment.getDataStart(), eventBlock.getFragmentStart(3));
+  dsPtr2.reset(); // explicit destruction
+
+  // clean up the files that were created
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_CASE(ReadWholeEventFromEventFiles)
+{
+  readWholeEvents("one-event-per-file");
+}
+
+BOOST_AUTO_TEST_CASE(ReadWholeEventFromFragmentFiles)
+{
+  readWholeEvents("one-fragment-per-file");
+}
+
+BOOST_AUTO_TEST_CASE(ReadMappedDataBlocks)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  const int GEOLOC_COUNT = 3;
+  const int DUMMYDATA_SIZE = 5000;
+
+  // delete any pre-existing files so that we start with a clean slate
+  std::string deletePattern = filePrefix + ".*.hdf5";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["mode"] = "all-per-file";
+  std::unique_ptr<HDF5DataStore> dsPtr(new HDF5DataStore(conf));
+
+  char dummyData[DUMMYDATA_SIZE];
+  for (int idx = 0; idx < DUMMYDATA_SIZE; ++idx) {
+    dummyData[idx] = static_cast<char>(idx % 101);
+  }
+  for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+    KeyedDataBlock dataBlock(StorageKey(1, StorageKey::INVALID_DETECTORID, geoLoc));
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = DUMMYDATA_SIZE;
+    dsPtr->write(dataBlock);
+  }
+  dsPtr.reset(); // explicit destruction
+
+  conf["name"] = "tempReader";
+  conf["read_mode"] = "mmap";
+  conf["mmap_advice"] = "sequential";
+  std::unique_ptr<DataStore> dsPtr2(new HDF5DataStore(conf));
+  std::shared_ptr<DataStoreStatistics> statistics(new DataStoreStatistics());
+  dsPtr2->attachStatistics(statistics);
+
+  // the data blocks refer to the mapped file, instead of owning a copy
+  std::vector<KeyedDataBlock> dataBlockList;
+  for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+    dataBlockList.push_back(dsPtr2->read(StorageKey(1, StorageKey::INVALID_DETECTORID, geoLoc)));
+    BOOST_REQUIRE_EQUAL(dataBlockList.back().getDataSizeBytes(), DUMMYDATA_SIZE);
+    BOOST_REQUIRE(dataBlockList.back().owned_data_start.get() == nullptr);
+    BOOST_REQUIRE(dataBlockList.back().shared_data_start.get() != nullptr);
+    BOOST_REQUIRE_EQUAL(memcmp(dataBlockList.back().getDataStart(), dummyData, DUMMYDATA_SIZE), 0);
+  }
+  KeyedDataBlock window = dsPtr2->read(StorageKey(1, StorageKey::INVALID_DETECTORID, 2), 1000, 64);
+  BOOST_REQUIRE_EQUAL(window.getDataSizeBytes(), 64);
+  BOOST_REQUIRE_EQUAL(memcmp(window.getDataStart(), dummyData + 1000, 64), 0);
+  BOOST_REQUIRE_EQUAL(statistics->getOperation("hdf5_mapped_read").getHistogram().getCount(), GEOLOC_COUNT + 1);
+
+  // the mapping outlives the DataStore, for as long as the data blocks refer to it
+  dsPtr2.reset(); // explicit destruction
+  BOOST_REQUIRE_EQUAL(memcmp(dataBlockList[1].getDataStart(), dummyData, DUMMYDATA_SIZE), 0);
+
+  conf["mmap_advice"] = "eventually";
+  BOOST_REQUIRE_THROW(HDF5DataStore badStore(conf), dunedaq::ddpdemo::InvalidMmapAdvice);
+
+  // a store that has written to a file copies the datasets of that file, instead of mapping them
+  conf["name"] = "tempReaderWriter";
+  conf["mmap_advice"] = "normal";
+  {
+    HDF5DataStore readerWriter(conf);
+    KeyedDataBlock dataBlock(StorageKey(1, StorageKey::INVALID_DETECTORID, GEOLOC_COUNT));
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = DUMMYDATA_SIZE;
+    readerWriter.write(dataBlock);
+    KeyedDataBlock copiedBlock = readerWriter.read(StorageKey(1, StorageKey::INVALID_DETECTORID, 0));
+    BOOST_REQUIRE(copiedBlock.owned_data_start.get() != nullptr);
+    BOOST_REQUIRE_EQUAL(memcmp(copiedBlock.getDataStart(), dummyData, DUMMYDATA_SIZE), 0);
+  }
+
+  // clean up the files that were created
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
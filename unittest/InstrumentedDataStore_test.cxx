@@ -0,0 +1,115 @@
+/**
+ * @file InstrumentedDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the InstrumentedDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/InstrumentedDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE InstrumentedDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+nlohmann::json
+makeConfig()
+{
+  nlohmann::json conf;
+  conf["name"] = "tempInstrumented";
+  conf["child_data_store_parameters"]["name"] = "tempRing";
+  conf["child_data_store_parameters"]["type"] = "MemoryRingDataStore";
+  conf["child_data_store_parameters"]["capacity_bytes"] = 100000;
+  return conf;
+}
+
+void
+writeBlock(DataStore& store, int eventID, size_t size)
+{
+  std::vector<char> dummyData(size, static_cast<char>(eventID));
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = dummyData.size();
+  store.write(dataBlock);
+}
+
+// the number of entries in the histogram buckets of an operation
+uint64_t
+getBucketPopulation(const nlohmann::json& operation)
+{
+  uint64_t population = 0;
+  for (auto& bucket : operation["buckets"]) {
+    population += bucket[1].get<uint64_t>();
+  }
+  return population;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(InstrumentedDataStore_test)
+
+BOOST_AUTO_TEST_CASE(OperationsAreCounted)
+{
+  InstrumentedDataStore store(makeConfig());
+  writeBlock(store, 1, 100);
+  writeBlock(store, 2, 200);
+  writeBlock(store, 3, 300);
+  BOOST_REQUIRE_EQUAL(store.read(StorageKey(1, StorageKey::INVALID_DETECTORID, 0)).getDataSizeBytes(), 100);
+  BOOST_REQUIRE_EQUAL(store.read(StorageKey(3, StorageKey::INVALID_DETECTORID, 0)).getDataSizeBytes(), 300);
+  store.flush();
+
+  nlohmann::json operations = store.getStatistics()["operations"];
+  BOOST_REQUIRE_EQUAL(operations["write"]["count"].get<uint64_t>(), 3);
+  BOOST_REQUIRE_EQUAL(operations["write"]["bytes"].get<uint64_t>(), 600);
+  BOOST_REQUIRE_EQUAL(getBucketPopulation(operations["write"]), 3);
+  BOOST_REQUIRE_EQUAL(operations["read"]["count"].get<uint64_t>(), 2);
+  BOOST_REQUIRE_EQUAL(operations["read"]["bytes"].get<uint64_t>(), 400);
+  BOOST_REQUIRE_EQUAL(getBucketPopulation(operations["read"]), 2);
+  BOOST_REQUIRE_EQUAL(operations["flush"]["count"].get<uint64_t>(), 1);
+  BOOST_REQUIRE_EQUAL(operations["flush"]["bytes"].get<uint64_t>(), 0);
+  BOOST_REQUIRE_EQUAL(getBucketPopulation(operations["flush"]), 1);
+
+  // operations that were not used have empty histograms
+  BOOST_REQUIRE_EQUAL(operations["materialize"]["count"].get<uint64_t>(), 0);
+  BOOST_REQUIRE(operations["materialize"].count("buckets") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(StatisticsAreDumpedOnFlush)
+{
+  std::string outputFile =
+    std::string(std::filesystem::temp_directory_path()) + "/instrumented" + std::to_string(getpid()) + ".json";
+  std::filesystem::remove(outputFile);
+
+  nlohmann::json conf = makeConfig();
+  conf["output_file"] = outputFile;
+  InstrumentedDataStore store(conf);
+  writeBlock(store, 1, 100);
+  store.flush();
+
+  nlohmann::json statistics;
+  std::ifstream inputStream(outputFile);
+  inputStream >> statistics;
+  BOOST_REQUIRE_EQUAL(statistics["name"].get<std::string>(), "tempInstrumented");
+  BOOST_REQUIRE_EQUAL(statistics["operations"]["write"]["count"].get<uint64_t>(), 1);
+  BOOST_REQUIRE_EQUAL(statistics["operations"]["write"]["bytes"].get<uint64_t>(), 100);
+  BOOST_REQUIRE_EQUAL(statistics["operations"]["flush"]["count"].get<uint64_t>(), 1);
+
+  std::filesystem::remove(outputFile);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
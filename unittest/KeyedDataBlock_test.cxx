@@ -103,4 +103,30 @@ BOOST_AUTO_TEST_CASE(TransferredBufferOwnership)
   BOOST_REQUIRE_NE(buff_ptr[0], 'X');
 }
 
+BOOST_AUTO_TEST_CASE(SharedBufferOwnership)
+{
+  const int BUFFER_SIZE = 100;
+  StorageKey sampleKey(1, "2", 3);
+  std::shared_ptr<char> bufferPtr(new char[BUFFER_SIZE], std::default_delete<char[]>());
+  memset(bufferPtr.get(), 'X', BUFFER_SIZE);
+
+  {
+    // two KeyedDataBlocks share the same buffer, without copying it
+    KeyedDataBlock dataBlock1(sampleKey);
+    dataBlock1.shared_data_start = bufferPtr;
+    dataBlock1.data_size = BUFFER_SIZE;
+    KeyedDataBlock dataBlock2(sampleKey);
+    dataBlock2.shared_data_start = dataBlock1.shared_data_start;
+    dataBlock2.data_size = BUFFER_SIZE;
+
+    BOOST_REQUIRE_EQUAL(dataBlock1.getDataStart(), bufferPtr.get());
+    BOOST_REQUIRE_EQUAL(dataBlock2.getDataStart(), bufferPtr.get());
+    BOOST_REQUIRE_EQUAL(bufferPtr.use_count(), 3);
+  }
+
+  // the buffer stays alive as long as anybody holds a reference to it
+  BOOST_REQUIRE_EQUAL(bufferPtr.use_count(), 1);
+  BOOST_REQUIRE_EQUAL(bufferPtr.get()[0], 'X');
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+/**
+ * @file MemoryRingDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the MemoryRingDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/MemoryRingDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE MemoryRingDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc, size_t size)
+{
+  std::vector<char> dummyData(size, static_cast<char>(eventID + geoLoc));
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(MemoryRingDataStore_test)
+
+BOOST_AUTO_TEST_CASE(WriteAndRead)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempRing";
+  conf["capacity_bytes"] = 10000;
+  std::unique_ptr<MemoryRingDataStore> dsPtr(new MemoryRingDataStore(conf));
+
+  const int EVENT_COUNT = 3;
+  const int GEOLOC_COUNT = 3;
+  const size_t DUMMYDATA_SIZE = 100;
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      writeBlock(*dsPtr, eventID, geoLoc, DUMMYDATA_SIZE);
+    }
+  }
+
+  std::vector<StorageKey> keyList = dsPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), EVENT_COUNT * GEOLOC_COUNT);
+
+  for (auto& key : keyList) {
+    KeyedDataBlock dataBlock = dsPtr->read(key);
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), DUMMYDATA_SIZE);
+    const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+    for (size_t idx = 0; idx < DUMMYDATA_SIZE; ++idx) {
+      BOOST_REQUIRE_EQUAL(data_ptr[idx], static_cast<char>(key.getEventID() + key.getGeoLocation()));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(OldestFirstEviction)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempRing";
+  conf["capacity_bytes"] = 1000;
+  std::unique_ptr<MemoryRingDataStore> dsPtr(new MemoryRingDataStore(conf));
+
+  // each block takes 300 bytes, so at most three of them fit in the ring
+  for (int eventID = 1; eventID <= 10; ++eventID) {
+    writeBlock(*dsPtr, eventID, 0, 300);
+  }
+
+  std::vector<StorageKey> keyList = dsPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), 3);
+  BOOST_REQUIRE_EQUAL(keyList[0].getEventID(), 8);
+  BOOST_REQUIRE_EQUAL(keyList[2].getEventID(), 10);
+
+  BOOST_REQUIRE_THROW(dsPtr->read(StorageKey(7, StorageKey::INVALID_DETECTORID, 0)),
+                      dunedaq::ddpdemo::MemoryRingKeyNotFound);
+  KeyedDataBlock dataBlock = dsPtr->read(StorageKey(9, StorageKey::INVALID_DETECTORID, 0));
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[299], 9);
+
+  // a large block evicts as many older blocks as it needs to
+  writeBlock(*dsPtr, 11, 0, 900);
+  keyList = dsPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), 1);
+  BOOST_REQUIRE_EQUAL(keyList[0].getEventID(), 11);
+
+  // and blocks that are larger than the ring are rejected
+  BOOST_REQUIRE_THROW(writeBlock(*dsPtr, 12, 0, 1001), dunedaq::ddpdemo::DataBlockTooLarge);
+}
+
+BOOST_AUTO_TEST_CASE(RewrittenKey)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempRing";
+  conf["capacity_bytes"] = 1000;
+  std::unique_ptr<MemoryRingDataStore> dsPtr(new MemoryRingDataStore(conf));
+
+  writeBlock(*dsPtr, 1, 0, 100);
+  writeBlock(*dsPtr, 1, 0, 200);
+
+  std::vector<StorageKey> keyList = dsPtr->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(keyList.size(), 1);
+  BOOST_REQUIRE_EQUAL(dsPtr->read(keyList[0]).getDataSizeBytes(), 200);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+/**
+ * @file PartialEventTable_test.cxx Application that tests and demonstrates
+ * the functionality of the PartialEventTable class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/PartialEventTable.hpp"
+
+#define BOOST_TEST_MODULE PartialEventTable_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+KeyedDataBlock
+makeFragment(int eventID, int geoLocation, size_t size = 100)
+{
+  KeyedDataBlock dataBlock(StorageKey(eventID, "FELIX", geoLocation));
+  dataBlock.data_size = size;
+  dataBlock.unowned_data_start = nullptr;
+  return dataBlock;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(PartialEventTable_test)
+
+BOOST_AUTO_TEST_CASE(OutOfOrderFragmentsComplete)
+{
+  PartialEventTable table(3, 4);
+  PartialEventTable::Event event;
+
+  // fragments of two events, interleaved and out of order
+  BOOST_REQUIRE(table.add(makeFragment(2, 1), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE(table.add(makeFragment(1, 2), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE(table.add(makeFragment(2, 0), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE(table.add(makeFragment(1, 0), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 2);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 400);
+
+  BOOST_REQUIRE(table.add(makeFragment(2, 2), event) == PartialEventTable::AddResult::Completed);
+  BOOST_REQUIRE_EQUAL(event.eventID, 2);
+  BOOST_REQUIRE_EQUAL(event.fragments.size(), 3);
+  BOOST_REQUIRE_EQUAL(event.bytes, 300);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 1);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 200);
+}
+
+BOOST_AUTO_TEST_CASE(DuplicatesAreDropped)
+{
+  PartialEventTable table(2);
+  PartialEventTable::Event event;
+  BOOST_REQUIRE(table.add(makeFragment(5, 0), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE(table.add(makeFragment(5, 0), event) == PartialEventTable::AddResult::Duplicate);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 100);
+  BOOST_REQUIRE(table.add(makeFragment(5, 1), event) == PartialEventTable::AddResult::Completed);
+  BOOST_REQUIRE_EQUAL(event.fragments.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(ExpiredEventsAreTaken)
+{
+  PartialEventTable table(4);
+  PartialEventTable::Event event;
+  table.add(makeFragment(1, 0), event);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto cutoff = PartialEventTable::clock_t::now();
+  table.add(makeFragment(2, 0), event);
+  table.add(makeFragment(1, 1), event);
+
+  // only the event whose first fragment arrived before the cutoff has expired
+  std::vector<PartialEventTable::Event> expiredEvents;
+  BOOST_REQUIRE_EQUAL(table.takeExpired(cutoff, expiredEvents), 1);
+  BOOST_REQUIRE_EQUAL(expiredEvents[0].eventID, 1);
+  BOOST_REQUIRE_EQUAL(expiredEvents[0].fragments.size(), 2);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 1);
+
+  BOOST_REQUIRE_EQUAL(table.takeAll(expiredEvents), 1);
+  BOOST_REQUIRE_EQUAL(expiredEvents[1].eventID, 2);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 0);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(LateFragmentsAreDropped)
+{
+  PartialEventTable table(2, 1, 2);
+  PartialEventTable::Event event;
+  std::vector<PartialEventTable::Event> expiredEvents;
+
+  // a fragment of an event that timed out, or that is already complete, does not start it again
+  table.add(makeFragment(1, 0), event);
+  BOOST_REQUIRE_EQUAL(table.takeAll(expiredEvents), 1);
+  BOOST_REQUIRE(table.add(makeFragment(1, 1), event) == PartialEventTable::AddResult::Late);
+  table.add(makeFragment(2, 0), event);
+  BOOST_REQUIRE(table.add(makeFragment(2, 1), event) == PartialEventTable::AddResult::Completed);
+  BOOST_REQUIRE(table.add(makeFragment(2, 1), event) == PartialEventTable::AddResult::Late);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 0);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 0);
+
+  // only the most recently closed events are remembered
+  table.add(makeFragment(3, 0), event);
+  table.add(makeFragment(3, 1), event);
+  BOOST_REQUIRE(table.add(makeFragment(1, 1), event) == PartialEventTable::AddResult::Added);
+  BOOST_REQUIRE(table.add(makeFragment(2, 0), event) == PartialEventTable::AddResult::Late);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentAddsCompleteEveryEvent)
+{
+  const int eventCount = 1000;
+  const int geoLocationCount = 8;
+  PartialEventTable table(geoLocationCount, 8);
+  std::atomic<int> completedCount(0);
+
+  // each thread adds the fragments of some geoLocations, for all of the events
+  std::vector<std::thread> threads;
+  for (int threadIdx = 0; threadIdx < 4; ++threadIdx) {
+    threads.emplace_back([&, threadIdx]() {
+      PartialEventTable::Event event;
+      for (int eventID = eventCount; eventID > 0; --eventID) {
+        for (int geoLocation = threadIdx; geoLocation < geoLocationCount; geoLocation += 4) {
+          if (table.add(makeFragment(eventID, geoLocation), event) == PartialEventTable::AddResult::Completed) {
+            ++completedCount;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  BOOST_REQUIRE_EQUAL(completedCount.load(), eventCount);
+  BOOST_REQUIRE_EQUAL(table.getEventCount(), 0);
+  BOOST_REQUIRE_EQUAL(table.getHeldBytes(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
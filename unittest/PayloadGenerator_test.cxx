@@ -0,0 +1,113 @@
+/**
+ * @file PayloadGenerator_test.cxx Application that tests and demonstrates
+ * the functionality of the PayloadGenerator class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/PayloadGenerator.hpp"
+
+#define BOOST_TEST_MODULE PayloadGenerator_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+double
+getEntropyBitsPerByte(const void* buffer, size_t size)
+{
+  std::vector<size_t> histogram(256, 0);
+  const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+  for (size_t idx = 0; idx < size; ++idx) {
+    ++histogram[bytes[idx]];
+  }
+  double entropy = 0;
+  for (auto count : histogram) {
+    if (count > 0) {
+      double probability = static_cast<double>(count) / size;
+      entropy -= probability * std::log2(probability);
+    }
+  }
+  return entropy;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(PayloadGenerator_test)
+
+BOOST_AUTO_TEST_CASE(ByteModes)
+{
+  const size_t BUFFER_SIZE = 1000000;
+  nlohmann::json conf = nlohmann::json::object();
+  PayloadGenerator constantGenerator(conf, BUFFER_SIZE);
+  BOOST_REQUIRE_EQUAL(constantGenerator.getPoolSize(), 1);
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(constantGenerator.getBuffer(5))[BUFFER_SIZE - 1], 'X');
+
+  conf["payload_mode"] = "random";
+  conf["payload_pool_size"] = 4;
+  PayloadGenerator randomGenerator(conf, BUFFER_SIZE);
+  BOOST_REQUIRE_EQUAL(randomGenerator.getPoolSize(), 4);
+  BOOST_REQUIRE(randomGenerator.getBuffer(0) != randomGenerator.getBuffer(1));
+  BOOST_REQUIRE_GT(getEntropyBitsPerByte(randomGenerator.getBuffer(3), BUFFER_SIZE), 7.99);
+
+  conf["payload_mode"] = "entropy";
+  conf["entropy_bits_per_byte"] = 3.0;
+  PayloadGenerator entropyGenerator(conf, BUFFER_SIZE);
+  BOOST_REQUIRE_CLOSE(getEntropyBitsPerByte(entropyGenerator.getBuffer(0), BUFFER_SIZE), 3.0, 1);
+
+  conf["payload_mode"] = "compressed";
+  BOOST_REQUIRE_THROW(PayloadGenerator(conf, BUFFER_SIZE), dunedaq::ddpdemo::InvalidPayloadMode);
+}
+
+BOOST_AUTO_TEST_CASE(ADCFrames)
+{
+  for (int adcBits : { 12, 14 }) {
+    nlohmann::json conf;
+    conf["payload_mode"] = "adc";
+    conf["payload_pool_size"] = 2;
+    conf["adc_bits"] = adcBits;
+    conf["adc_pedestal"] = 1000.0;
+    conf["adc_noise_rms"] = 5.0;
+    conf["pulse_probability"] = 0.0;
+
+    const size_t FRAME_COUNT = 100;
+    const size_t frameSize = PayloadGenerator::getFrameSize(adcBits);
+    PayloadGenerator generator(conf, FRAME_COUNT * frameSize);
+    const char* buffer = static_cast<const char*>(generator.getBuffer(1));
+
+    double sum = 0;
+    double sumOfSquares = 0;
+    for (size_t frameIdx = 0; frameIdx < FRAME_COUNT; ++frameIdx) {
+      const char* frameStart = buffer + frameIdx * frameSize;
+      PayloadGenerator::FrameHeader header;
+      memcpy(&header, frameStart, sizeof(header));
+      BOOST_REQUIRE_EQUAL(header.magic, PayloadGenerator::FRAME_MAGIC);
+      BOOST_REQUIRE_EQUAL(header.adcBits, adcBits);
+      BOOST_REQUIRE_EQUAL(header.bufferIndex, 1);
+      BOOST_REQUIRE_EQUAL(header.timestamp, frameIdx * PayloadGenerator::TICKS_PER_FRAME);
+
+      // the noise is measured around channel 0's own pedestal
+      for (size_t channel = 0; channel < PayloadGenerator::CHANNELS_PER_FRAME; ++channel) {
+        uint16_t sample = PayloadGenerator::getSample(frameStart, channel);
+        BOOST_REQUIRE_LT(sample, 1u << adcBits);
+        BOOST_REQUIRE(std::abs(sample - 1000.0) < 200);
+        if (channel == 0) {
+          sum += sample;
+          sumOfSquares += sample * sample;
+        }
+      }
+    }
+    double mean = sum / FRAME_COUNT;
+    double rms = std::sqrt(sumOfSquares / FRAME_COUNT - mean * mean);
+    BOOST_REQUIRE_CLOSE(rms, 5.0, 30);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
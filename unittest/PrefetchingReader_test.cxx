@@ -0,0 +1,200 @@
+/**
+ * @file PrefetchingReader_test.cxx Application that tests and demonstrates
+ * the functionality of the PrefetchingReader class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/MemoryRingDataStore.hpp"
+#include "../plugins/PrefetchingReader.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE PrefetchingReader_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+/**
+ * @brief Reads slowly from a MemoryRingDataStore, and counts the reads and
+ * the read-ahead hints.
+ */
+class SlowDataStore : public DataStore
+{
+public:
+  explicit SlowDataStore(size_t readDelayMsec)
+    : DataStore("slowStore")
+    , readDelay_(readDelayMsec)
+    , readCount_(0)
+    , hintedReadCount_(0)
+  {
+    nlohmann::json conf;
+    conf["name"] = "ring";
+    conf["capacity_bytes"] = 1024 * 1024;
+    ring_.reset(new MemoryRingDataStore(conf));
+  }
+
+  virtual void setup(const size_t) override {}
+  virtual void write(const KeyedDataBlock& dataBlock) override { ring_->write(dataBlock); }
+  virtual std::vector<StorageKey> getAllExistingKeys() const override { return ring_->getAllExistingKeys(); }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override
+  {
+    ++readCount_;
+    {
+      std::lock_guard<std::mutex> lock(hintMutex_);
+      if (hintedEvents_.count(key.getEventID()) > 0) {
+        ++hintedReadCount_;
+      }
+    }
+    std::this_thread::sleep_for(readDelay_);
+    if (key.getGeoLocation() < 0) {
+      throw std::runtime_error("unreadable key");
+    }
+    return ring_->read(key);
+  }
+
+  virtual void adviseWillRead(const StorageKey& key) override
+  {
+    std::lock_guard<std::mutex> lock(hintMutex_);
+    hintedEvents_.insert(key.getEventID());
+  }
+
+  size_t getReadCount() const { return readCount_.load(); }
+  size_t getHintedReadCount() const { return hintedReadCount_.load(); }
+
+  size_t getHintCount() const
+  {
+    std::lock_guard<std::mutex> lock(hintMutex_);
+    return hintedEvents_.size();
+  }
+
+private:
+  std::unique_ptr<MemoryRingDataStore> ring_;
+  std::chrono::milliseconds readDelay_;
+  std::atomic<size_t> readCount_;
+  std::atomic<size_t> hintedReadCount_;
+  std::set<int> hintedEvents_;
+  mutable std::mutex hintMutex_;
+};
+
+std::vector<StorageKey>
+writeBlocks(DataStore& store, int eventCount, size_t size)
+{
+  std::vector<StorageKey> keyList;
+  for (int eventID = 1; eventID <= eventCount; ++eventID) {
+    std::vector<char> dummyData(size, static_cast<char>(eventID));
+    KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+    dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+    dataBlock.data_size = size;
+    store.write(dataBlock);
+    keyList.push_back(dataBlock.data_key);
+  }
+  return keyList;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(PrefetchingReader_test)
+
+BOOST_AUTO_TEST_CASE(BlocksAreReturnedInOrder)
+{
+  SlowDataStore store(1);
+  std::vector<StorageKey> keyList = writeBlocks(store, 50, 100);
+  PrefetchingReader reader(store, keyList, 8, 1024 * 1024, 4);
+
+  KeyedDataBlock dataBlock(keyList[0]);
+  for (auto& key : keyList) {
+    BOOST_REQUIRE(reader.next(dataBlock));
+    BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), key.getEventID());
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), 100);
+    BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[99], static_cast<char>(key.getEventID()));
+  }
+  BOOST_REQUIRE(!reader.next(dataBlock));
+  BOOST_REQUIRE_EQUAL(reader.getHitCount() + reader.getMissCount(), keyList.size());
+}
+
+BOOST_AUTO_TEST_CASE(SlowConsumerHitsPrefetchedBlocks)
+{
+  SlowDataStore store(1);
+  std::vector<StorageKey> keyList = writeBlocks(store, 20, 100);
+  PrefetchingReader reader(store, keyList, 4);
+
+  // the consumer takes longer than a read, so only the first block is waited for
+  KeyedDataBlock dataBlock(keyList[0]);
+  while (reader.next(dataBlock)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_REQUIRE_LE(reader.getMissCount(), 2);
+  BOOST_REQUIRE_GT(reader.getHitRate(), 0.8);
+}
+
+BOOST_AUTO_TEST_CASE(KeysBeyondTheReadAheadAreHinted)
+{
+  SlowDataStore store(0);
+  std::vector<StorageKey> keyList = writeBlocks(store, 20, 100);
+  PrefetchingReader reader(store, keyList, 4, 1024 * 1024, 2);
+
+  // every key after the first "depth" ones is hinted before it is read
+  KeyedDataBlock dataBlock(keyList[0]);
+  while (reader.next(dataBlock)) {
+  }
+  BOOST_REQUIRE_EQUAL(store.getHintCount(), keyList.size() - 4);
+  BOOST_REQUIRE_EQUAL(store.getHintedReadCount(), keyList.size() - 4);
+}
+
+BOOST_AUTO_TEST_CASE(ReadAheadIsLimited)
+{
+  SlowDataStore store(0);
+  std::vector<StorageKey> keyList = writeBlocks(store, 40, 100);
+
+  // by depth
+  {
+    PrefetchingReader reader(store, keyList, 5, 1024 * 1024);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_REQUIRE_EQUAL(store.getReadCount(), 5);
+    KeyedDataBlock dataBlock(keyList[0]);
+    BOOST_REQUIRE(reader.next(dataBlock));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_REQUIRE_EQUAL(store.getReadCount(), 6);
+  }
+
+  // and by bytes
+  SlowDataStore store2(0);
+  keyList = writeBlocks(store2, 40, 100);
+  PrefetchingReader reader(store2, keyList, 20, 250);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_REQUIRE_EQUAL(store2.getReadCount(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(ReadErrorsAreThrownInOrder)
+{
+  SlowDataStore store(0);
+  std::vector<StorageKey> keyList = writeBlocks(store, 3, 100);
+  keyList.insert(keyList.begin() + 1, StorageKey(99, StorageKey::INVALID_DETECTORID, -1));
+  PrefetchingReader reader(store, keyList, 4);
+
+  KeyedDataBlock dataBlock(keyList[0]);
+  BOOST_REQUIRE(reader.next(dataBlock));
+  BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), 1);
+  BOOST_REQUIRE_THROW(reader.next(dataBlock), std::runtime_error);
+  BOOST_REQUIRE(reader.next(dataBlock));
+  BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
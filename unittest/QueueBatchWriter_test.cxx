@@ -0,0 +1,210 @@
+/**
+ * @file QueueBatchWriter_test.cxx Application that tests and demonstrates
+ * the functionality of the QueueBatchWriter class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/QueueBatchWriter.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE QueueBatchWriter_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+struct QueueTimeout
+{};
+
+// the subset of the appfwk::DAQSource interface that QueueBatchWriter uses
+class TestQueue
+{
+public:
+  void push(KeyedDataBlock&& dataBlock)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(dataBlock));
+    condition_.notify_one();
+  }
+
+  bool can_pop()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !queue_.empty();
+  }
+
+  void pop(KeyedDataBlock& dataBlock, std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!condition_.wait_for(lock, timeout, [&] { return !queue_.empty(); })) {
+      throw QueueTimeout();
+    }
+    dataBlock = std::move(queue_.front());
+    queue_.pop_front();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<KeyedDataBlock> queue_;
+};
+
+// records the batches that it is given, and fails those that contain a negative geoLocation
+class RecordingDataStore : public DataStore
+{
+public:
+  RecordingDataStore()
+    : DataStore("recorder")
+  {}
+
+  virtual void setup(const size_t) override {}
+
+  virtual void write(const KeyedDataBlock& dataBlock) override
+  {
+    std::vector<KeyedDataBlock> dataBlockList;
+    dataBlockList.emplace_back(dataBlock.data_key);
+    write(dataBlockList);
+  }
+
+  virtual void write(const std::vector<KeyedDataBlock>& dataBlockList) override
+  {
+    for (auto& dataBlock : dataBlockList) {
+      if (dataBlock.data_key.getGeoLocation() < 0) {
+        throw DataStoreCreationFailed(ERS_HERE, "recorder", nlohmann::json());
+      }
+    }
+    batchSizes.push_back(dataBlockList.size());
+    for (auto& dataBlock : dataBlockList) {
+      keys.push_back(dataBlock.data_key);
+    }
+  }
+
+  virtual std::vector<StorageKey> getAllExistingKeys() const override { return keys; }
+
+  virtual KeyedDataBlock read(const StorageKey& key) override { return KeyedDataBlock(key); }
+
+  std::vector<size_t> batchSizes;
+  std::vector<StorageKey> keys;
+};
+
+KeyedDataBlock
+makeBlock(int eventID, int geoLoc)
+{
+  KeyedDataBlock dataBlock(StorageKey(eventID, "FELIX", geoLoc));
+  dataBlock.data_size = 100;
+  dataBlock.unowned_data_start = nullptr;
+  return dataBlock;
+}
+
+using TestBatchWriter = QueueBatchWriter<TestQueue, QueueTimeout>;
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(QueueBatchWriter_test)
+
+BOOST_AUTO_TEST_CASE(BatchesTakeWhatIsQueued)
+{
+  TestQueue queue;
+  for (int eventID = 1; eventID <= 10; ++eventID) {
+    queue.push(makeBlock(eventID, 0));
+  }
+
+  // with the running flag already cleared, the writer drains the queue and returns
+  RecordingDataStore store;
+  TestBatchWriter writer("tempWriter", queue, 4, std::chrono::milliseconds(10));
+  std::atomic<bool> running(false);
+  writer.run(store, nullptr, running);
+
+  BOOST_REQUIRE_EQUAL(store.batchSizes.size(), 3);
+  BOOST_REQUIRE_EQUAL(store.batchSizes[0], 4);
+  BOOST_REQUIRE_EQUAL(store.batchSizes[1], 4);
+  BOOST_REQUIRE_EQUAL(store.batchSizes[2], 2);
+  for (int eventID = 1; eventID <= 10; ++eventID) {
+    BOOST_REQUIRE_EQUAL(store.keys[eventID - 1].getEventID(), eventID);
+  }
+
+  TestBatchWriter::Statistics& statistics = writer.getStatistics();
+  BOOST_REQUIRE_EQUAL(statistics.batchCount.load(), 3);
+  BOOST_REQUIRE_EQUAL(statistics.fullBatchCount.load(), 2);
+  BOOST_REQUIRE_EQUAL(statistics.blockCount.load(), 10);
+  BOOST_REQUIRE_EQUAL(statistics.byteCount.load(), 1000);
+  BOOST_REQUIRE_EQUAL(statistics.emptyPollCount.load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(QueueIsDrainedOnStop)
+{
+  TestQueue queue;
+  RecordingDataStore store;
+  std::mutex storeMutex;
+  TestBatchWriter writer("tempWriter", queue, 16, std::chrono::milliseconds(10));
+  std::atomic<bool> running(true);
+  std::vector<std::thread> writerThreads;
+  for (int idx = 0; idx < 3; ++idx) {
+    writerThreads.emplace_back([&] { writer.run(store, &storeMutex, running); });
+  }
+
+  // the writers are stopped as soon as the producer is done, with data still queued
+  const int EVENT_COUNT = 2000;
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    queue.push(makeBlock(eventID, 0));
+  }
+  running.store(false);
+  for (auto& writerThread : writerThreads) {
+    writerThread.join();
+  }
+
+  BOOST_REQUIRE(!queue.can_pop());
+  BOOST_REQUIRE_EQUAL(writer.getStatistics().totalBlockCount.load(), EVENT_COUNT);
+  std::set<int> eventIDs;
+  for (auto& key : store.keys) {
+    BOOST_REQUIRE(eventIDs.insert(key.getEventID()).second);
+  }
+  BOOST_REQUIRE_EQUAL(eventIDs.size(), EVENT_COUNT);
+  for (auto batchSize : store.batchSizes) {
+    BOOST_REQUIRE_LE(batchSize, 16);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FailedBatchesAreCountedSeparately)
+{
+  TestQueue queue;
+  for (int eventID = 1; eventID <= 4; ++eventID) {
+    queue.push(makeBlock(eventID, 0));
+  }
+  queue.push(makeBlock(5, -1));
+  queue.push(makeBlock(6, 0));
+
+  RecordingDataStore store;
+  TestBatchWriter writer("tempWriter", queue, 2, std::chrono::milliseconds(10));
+  std::atomic<bool> running(false);
+  writer.run(store, nullptr, running);
+
+  // the third batch (events 5 and 6) fails as a whole
+  TestBatchWriter::Statistics& statistics = writer.getStatistics();
+  BOOST_REQUIRE_EQUAL(store.keys.size(), 4);
+  BOOST_REQUIRE_EQUAL(statistics.batchCount.load(), 3);
+  BOOST_REQUIRE_EQUAL(statistics.blockCount.load(), 4);
+  BOOST_REQUIRE_EQUAL(statistics.totalBlockCount.load(), 4);
+  BOOST_REQUIRE_EQUAL(statistics.byteCount.load(), 400);
+  BOOST_REQUIRE_EQUAL(statistics.failedBatchCount.load(), 1);
+  BOOST_REQUIRE_EQUAL(statistics.failedBlockCount.load(), 2);
+  BOOST_REQUIRE_EQUAL(statistics.totalFailedBlockCount.load(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,125 @@
+/**
+ * @file RatePacer_test.cxx Application that tests and demonstrates
+ * the functionality of the RatePacer class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/RatePacer.hpp"
+
+#define BOOST_TEST_MODULE RatePacer_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cmath>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+double
+getSeconds(std::chrono::steady_clock::duration interval)
+{
+  return std::chrono::duration<double>(interval).count();
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(RatePacer_test)
+
+BOOST_AUTO_TEST_CASE(ConstantRateFromByteTarget)
+{
+  nlohmann::json conf;
+  conf["target_bytes_per_sec"] = 10000000;
+  conf["bucket_depth_msec"] = 100;
+  RatePacer pacer(conf, 10000.0);
+  BOOST_REQUIRE(pacer.isEnabled());
+
+  // 1000 events/s, evenly spaced
+  auto startTime = std::chrono::steady_clock::now();
+  pacer.start(startTime);
+  for (int idx = 0; idx < 100; ++idx) {
+    BOOST_REQUIRE_CLOSE(getSeconds(pacer.reserve(startTime) - startTime), idx * 0.001, 0.01);
+  }
+
+  // a generator that falls far behind catches up with at most a bucket's worth of events
+  auto lateTime = startTime + std::chrono::seconds(1);
+  BOOST_REQUIRE_CLOSE(getSeconds(pacer.reserve(lateTime) - startTime), 0.9, 0.01);
+  BOOST_REQUIRE_CLOSE(pacer.getExpectedEventCount(2.0), 2000, 0.01);
+
+  nlohmann::json disabledConf = nlohmann::json::object();
+  BOOST_REQUIRE(!RatePacer(disabledConf, 10000.0).isEnabled());
+  conf["rate_profile"] = "sawtooth";
+  BOOST_REQUIRE_THROW(RatePacer(conf, 10000.0), dunedaq::ddpdemo::InvalidRateProfile);
+}
+
+BOOST_AUTO_TEST_CASE(PoissonAverage)
+{
+  nlohmann::json conf;
+  conf["target_events_per_sec"] = 1000;
+  conf["rate_profile"] = "poisson";
+  RatePacer pacer(conf, 100.0);
+
+  auto startTime = std::chrono::steady_clock::now();
+  pacer.start(startTime);
+  const int EVENT_COUNT = 20000;
+  double lastDue = 0;
+  int shortGaps = 0;
+  for (int idx = 0; idx < EVENT_COUNT; ++idx) {
+    double due = getSeconds(pacer.reserve(startTime) - startTime);
+    if (due - lastDue < 0.0005) {
+      ++shortGaps;
+    }
+    lastDue = due;
+  }
+  // the mean gap is 1 msec, and about 39% of the gaps are shorter than half of that
+  BOOST_REQUIRE_CLOSE(lastDue, EVENT_COUNT * 0.001, 5);
+  BOOST_REQUIRE_CLOSE(static_cast<double>(shortGaps) / EVENT_COUNT, 1 - std::exp(-0.5), 5);
+}
+
+BOOST_AUTO_TEST_CASE(PeriodicSpills)
+{
+  nlohmann::json conf;
+  conf["target_events_per_sec"] = 100;
+  conf["rate_profile"] = "periodic";
+  conf["spill_period_msec"] = 100;
+  conf["spill_duration_msec"] = 20;
+  RatePacer pacer(conf, 100.0);
+
+  auto startTime = std::chrono::steady_clock::now();
+  pacer.start(startTime);
+  for (int idx = 0; idx < 100; ++idx) {
+    double due = getSeconds(pacer.reserve(startTime) - startTime);
+    BOOST_REQUIRE_LT(std::fmod(due + 1e-6, 0.1), 0.02);
+  }
+  // 10 events per spill, so the 100th event is at the end of the 10th spill
+  BOOST_REQUIRE_CLOSE(getSeconds(pacer.reserve(startTime) - startTime), 1.0, 0.01);
+  BOOST_REQUIRE_CLOSE(pacer.getExpectedEventCount(1.01), 105, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(Ramp)
+{
+  nlohmann::json conf;
+  conf["target_events_per_sec"] = 1000;
+  conf["rate_profile"] = "ramp";
+  conf["ramp_duration_msec"] = 1000;
+  conf["ramp_start_fraction"] = 0.5;
+  RatePacer pacer(conf, 100.0);
+
+  // 750 events during the ramp, and then 1000 per second
+  BOOST_REQUIRE_CLOSE(pacer.getExpectedEventCount(1.0), 750, 0.01);
+  BOOST_REQUIRE_CLOSE(pacer.getExpectedEventCount(2.0), 1750, 0.01);
+
+  auto startTime = std::chrono::steady_clock::now();
+  pacer.start(startTime);
+  double due = 0;
+  for (int idx = 0; idx < 750; ++idx) {
+    due = getSeconds(pacer.reserve(startTime) - startTime);
+  }
+  BOOST_REQUIRE_CLOSE(due, 1.0, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
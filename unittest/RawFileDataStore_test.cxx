@@ -0,0 +1,312 @@
+/**
+ * @file RawFileDataStore_test.cxx Application that tests and demonstrates
+ * the write and read functionality of the RawFileDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/RawFileDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE RawFileDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+std::vector<std::string>
+deleteFilesMatchingPattern(const std::string& path, const std::string& pattern)
+{
+  std::regex regexSearchPattern(pattern);
+  std::vector<std::string> fileList;
+  for (const auto& entry : std::filesystem::directory_iterator(path)) {
+    if (std::regex_match(entry.path().filename().string(), regexSearchPattern)) {
+      if (std::filesystem::remove(entry.path())) {
+        fileList.push_back(entry.path());
+      }
+    }
+  }
+  return fileList;
+}
+
+void
+writeAndReadBack(bool directIO)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  const int EVENT_COUNT = 5;
+  const int GEOLOC_COUNT = 3;
+  const int STAGING_SIZE = 8192;
+
+  // delete any pre-existing files so that we start with a clean slate
+  std::string deletePattern = filePrefix + "_raw.*";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  // create the DataStore instance for writing, with a small staging buffer so
+  // that some of the fragments span several buffers
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["direct_io"] = directIO;
+  conf["staging_buffer_size"] = STAGING_SIZE;
+  std::unique_ptr<RawFileDataStore> dsPtr(new RawFileDataStore(conf));
+
+  // write fragments with a variety of sizes, each filled with a different value
+  std::vector<StorageKey> keyList;
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      size_t dataSize = 100 + 3000 * geoLoc * eventID;
+      std::vector<char> dummyData(dataSize, static_cast<char>(eventID * 10 + geoLoc));
+      StorageKey key(eventID, StorageKey::INVALID_DETECTORID, geoLoc);
+      KeyedDataBlock dataBlock(key);
+      dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+      dataBlock.data_size = dataSize;
+      dsPtr->write(dataBlock);
+      keyList.push_back(key);
+    }
+  }
+
+  // data that is still in the staging buffer can be read back before a flush
+  KeyedDataBlock unflushedBlock = dsPtr->read(keyList.back());
+  BOOST_REQUIRE_EQUAL(unflushedBlock.getDataSizeBytes(), 100 + 3000 * (GEOLOC_COUNT - 1) * EVENT_COUNT);
+
+  // part of a block can be read, whether it is on disk or in the staging buffer, or both
+  KeyedDataBlock unflushedRange = dsPtr->read(keyList.back(), 1000, 20000);
+  BOOST_REQUIRE_EQUAL(unflushedRange.getDataSizeBytes(), 20000);
+  for (size_t idx = 0; idx < 20000; ++idx) {
+    BOOST_REQUIRE_EQUAL(static_cast<const char*>(unflushedRange.getDataStart())[idx],
+                        static_cast<char>(EVENT_COUNT * 10 + GEOLOC_COUNT - 1));
+  }
+  dsPtr.reset(); // explicit destruction, which flushes the data
+
+  // create a new DataStore instance to read back the data that was written
+  nlohmann::json read_conf;
+  read_conf["name"] = "tempReader";
+  read_conf["filename_prefix"] = filePrefix;
+  read_conf["directory_path"] = filePath;
+  std::unique_ptr<RawFileDataStore> dsPtr2(new RawFileDataStore(read_conf));
+
+  std::vector<StorageKey> readKeyList = dsPtr2->getAllExistingKeys();
+  BOOST_REQUIRE_EQUAL(readKeyList.size(), keyList.size());
+
+  for (auto& key : keyList) {
+    KeyedDataBlock dataBlock = dsPtr2->read(key);
+    size_t expectedSize = 100 + 3000 * key.getGeoLocation() * key.getEventID();
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), expectedSize);
+
+    const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+    char expectedValue = static_cast<char>(key.getEventID() * 10 + key.getGeoLocation());
+    for (size_t idx = 0; idx < expectedSize; ++idx) {
+      BOOST_REQUIRE_EQUAL(data_ptr[idx], expectedValue);
+    }
+  }
+
+  // a range that extends past the end of a block is clipped
+  KeyedDataBlock rangeBlock = dsPtr2->read(keyList[4], 5000, 10000);
+  BOOST_REQUIRE_EQUAL(rangeBlock.getDataSizeBytes(), 100 + 3000 * 1 * 2 - 5000);
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(rangeBlock.getDataStart())[0], static_cast<char>(2 * 10 + 1));
+  BOOST_REQUIRE_EQUAL(dsPtr2->read(keyList[4], 10000, 64).getDataSizeBytes(), 0);
+
+  // asking for a key that was never written is an error
+  StorageKey missingKey(EVENT_COUNT + 1, StorageKey::INVALID_DETECTORID, 0);
+  BOOST_REQUIRE_THROW(dsPtr2->read(missingKey), dunedaq::ddpdemo::RawFileKeyNotFound);
+  dsPtr2.reset(); // explicit destruction
+
+  // clean up the files that were created
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_SUITE(RawFileDataStore_test)
+
+BOOST_AUTO_TEST_CASE(BufferedWriteAndRead)
+{
+  writeAndReadBack(false);
+}
+
+BOOST_AUTO_TEST_CASE(DirectWriteAndRead)
+{
+  writeAndReadBack(true);
+}
+
+BOOST_AUTO_TEST_CASE(AlignedBlocksInDirectMode)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  std::string deletePattern = filePrefix + "_raw.*";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["direct_io"] = true;
+  std::unique_ptr<RawFileDataStore> dsPtr(new RawFileDataStore(conf));
+
+  // two small fragments are merged into one aligned block, and each flush
+  // pads the file out to the next alignment boundary
+  char dummyData[10] = { 0 };
+  for (int eventID = 1; eventID <= 2; ++eventID) {
+    KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = sizeof(dummyData);
+    dsPtr->write(dataBlock);
+  }
+  dsPtr->flush();
+
+  // (if the filesystem does not support O_DIRECT, nothing is padded)
+  const size_t alignment = dsPtr->usesDirectIO() ? RawFileDataStore::DIRECT_IO_ALIGNMENT : 2 * sizeof(dummyData);
+  std::string dataFileName = filePath + "/" + filePrefix + "_raw.dat";
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(dataFileName), alignment);
+
+  KeyedDataBlock dataBlock(StorageKey(3, StorageKey::INVALID_DETECTORID, 0));
+  dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+  dataBlock.data_size = sizeof(dummyData);
+  dsPtr->write(dataBlock);
+  dsPtr->flush();
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(dataFileName), alignment + sizeof(dummyData) +
+                                                                   (dsPtr->usesDirectIO() ? alignment - sizeof(dummyData) : 0));
+
+  // the index records the true lengths
+  KeyedDataBlock readBlock = dsPtr->read(StorageKey(3, StorageKey::INVALID_DETECTORID, 0));
+  BOOST_REQUIRE_EQUAL(readBlock.getDataSizeBytes(), sizeof(dummyData));
+  dsPtr.reset();
+
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_CASE(IndexIsWrittenWithTheData)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  std::string deletePattern = filePrefix + "_raw.*";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["direct_io"] = true;
+  conf["staging_buffer_size"] = 8192;
+  std::unique_ptr<RawFileDataStore> dsPtr(new RawFileDataStore(conf));
+
+  // the first two blocks fill the staging buffer, and the third one is only
+  // partly written out with it
+  std::vector<char> dummyData(4096, 'x');
+  for (int eventID = 1; eventID <= 3; ++eventID) {
+    KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = eventID == 3 ? 2 * dummyData.size() + 100 : dummyData.size();
+    dsPtr->write(dataBlock);
+  }
+
+  // without a flush, a second instance finds the blocks that are on disk
+  conf["name"] = "tempReader";
+  std::unique_ptr<RawFileDataStore> dsPtr2(new RawFileDataStore(conf));
+  BOOST_REQUIRE_EQUAL(dsPtr2->getAllExistingKeys().size(), 2);
+  KeyedDataBlock readBlock = dsPtr2->read(StorageKey(2, StorageKey::INVALID_DETECTORID, 0));
+  BOOST_REQUIRE_EQUAL(readBlock.getDataSizeBytes(), dummyData.size());
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(readBlock.getDataStart())[0], 'x');
+  dsPtr2.reset();
+
+  dsPtr->flush();
+  dsPtr2.reset(new RawFileDataStore(conf));
+  BOOST_REQUIRE_EQUAL(dsPtr2->getAllExistingKeys().size(), 3);
+  dsPtr2.reset();
+  dsPtr.reset();
+
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_CASE(EmptyStagingBufferIsEnlarged)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  std::string deletePattern = filePrefix + "_raw.*";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  // a staging buffer of zero bytes is made one alignment block long
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["staging_buffer_size"] = 0;
+  std::unique_ptr<RawFileDataStore> dsPtr(new RawFileDataStore(conf));
+
+  std::vector<char> dummyData(3 * RawFileDataStore::DIRECT_IO_ALIGNMENT + 100, 'y');
+  KeyedDataBlock dataBlock(StorageKey(1, StorageKey::INVALID_DETECTORID, 0));
+  dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+  dataBlock.data_size = dummyData.size();
+  dsPtr->write(dataBlock);
+  dsPtr->flush();
+
+  KeyedDataBlock readBlock = dsPtr->read(StorageKey(1, StorageKey::INVALID_DETECTORID, 0));
+  BOOST_REQUIRE_EQUAL(readBlock.getDataSizeBytes(), dummyData.size());
+  BOOST_REQUIRE_EQUAL(static_cast<const char*>(readBlock.getDataStart())[dummyData.size() - 1], 'y');
+  dsPtr.reset();
+
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_CASE(MappedReads)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "demo" + std::to_string(getpid());
+  std::string deletePattern = filePrefix + "_raw.*";
+  deleteFilesMatchingPattern(filePath, deletePattern);
+
+  nlohmann::json conf;
+  conf["name"] = "tempWriter";
+  conf["filename_prefix"] = filePrefix;
+  conf["directory_path"] = filePath;
+  conf["staging_buffer_size"] = 8192;
+  conf["read_mode"] = "mmap";
+  std::unique_ptr<RawFileDataStore> dsPtr(new RawFileDataStore(conf));
+
+  std::vector<char> dummyData(20000);
+  for (size_t idx = 0; idx < dummyData.size(); ++idx) {
+    dummyData[idx] = static_cast<char>(idx % 113);
+  }
+  StorageKey firstKey(1, StorageKey::INVALID_DETECTORID, 0);
+  StorageKey lastKey(2, StorageKey::INVALID_DETECTORID, 0);
+  for (auto& key : { firstKey, lastKey }) {
+    KeyedDataBlock dataBlock(key);
+    dataBlock.unowned_data_start = static_cast<void*>(&dummyData[0]);
+    dataBlock.data_size = dummyData.size();
+    dsPtr->write(dataBlock);
+  }
+
+  // the block that is on disk is mapped, and the one that is partly still staged is copied
+  // (both are handed out with shared ownership)
+  KeyedDataBlock mappedBlock = dsPtr->read(firstKey);
+  BOOST_REQUIRE(mappedBlock.shared_data_start.get() != nullptr);
+  BOOST_REQUIRE_EQUAL(memcmp(mappedBlock.getDataStart(), dummyData.data(), dummyData.size()), 0);
+  KeyedDataBlock stagedBlock = dsPtr->read(lastKey);
+  BOOST_REQUIRE(stagedBlock.shared_data_start.get() != nullptr);
+  BOOST_REQUIRE_EQUAL(memcmp(stagedBlock.getDataStart(), dummyData.data(), dummyData.size()), 0);
+  dsPtr.reset(); // explicit destruction, which flushes the data
+
+  conf["name"] = "tempReader";
+  conf["mmap_advice"] = "willneed";
+  std::unique_ptr<RawFileDataStore> dsPtr2(new RawFileDataStore(conf));
+  KeyedDataBlock window = dsPtr2->read(lastKey, 15000, 100);
+  BOOST_REQUIRE(window.shared_data_start.get() != nullptr);
+  BOOST_REQUIRE_EQUAL(memcmp(window.getDataStart(), dummyData.data() + 15000, 100), 0);
+  dsPtr2.reset(); // explicit destruction
+  BOOST_REQUIRE_EQUAL(memcmp(window.getDataStart(), dummyData.data() + 15000, 100), 0);
+
+  // clean up the files that were created
+  deleteFilesMatchingPattern(filePath, deletePattern);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,173 @@
+/**
+ * @file ShardedDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the ShardedDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/RawFileDataStore.hpp"
+#include "../plugins/ShardedDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE ShardedDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+const int SHARD_COUNT = 3;
+
+void
+deleteFilesMatchingPattern(const std::string& path, const std::string& pattern)
+{
+  std::regex regexSearchPattern(pattern);
+  for (const auto& entry : std::filesystem::directory_iterator(path)) {
+    if (std::regex_match(entry.path().filename().string(), regexSearchPattern)) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+}
+
+nlohmann::json
+makeShardConfig(const std::string& filePath, const std::string& filePrefix, int shardIndex)
+{
+  nlohmann::json shardConf;
+  shardConf["name"] = "tempShard" + std::to_string(shardIndex);
+  shardConf["type"] = "RawFileDataStore";
+  shardConf["directory_path"] = filePath;
+  shardConf["filename_prefix"] = filePrefix + "_shard" + std::to_string(shardIndex);
+  return shardConf;
+}
+
+nlohmann::json
+makeConfig(const std::string& filePath, const std::string& filePrefix)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempSharded";
+  conf["routing_field"] = "geo_location";
+  conf["routing_method"] = "range";
+  conf["range_width"] = 2;
+  conf["queue_capacity"] = 4;
+  for (int idx = 0; idx < SHARD_COUNT; ++idx) {
+    conf["shards"].push_back(makeShardConfig(filePath, filePrefix, idx));
+  }
+  return conf;
+}
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc)
+{
+  std::vector<char> dummyData(100 + geoLoc, static_cast<char>(eventID * 10 + geoLoc));
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = dummyData.size();
+  store.write(dataBlock);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(ShardedDataStore_test)
+
+BOOST_AUTO_TEST_CASE(KeysAreRoutedToShards)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "sharded" + std::to_string(getpid());
+  deleteFilesMatchingPattern(filePath, filePrefix + "_shard.*");
+
+  ShardedDataStore store(makeConfig(filePath, filePrefix));
+  // with a range width of 2, geoIDs 0-1 go to shard 0, 2-3 to shard 1, 4-5 to shard 2, 6-7 to shard 0 again
+  for (int geoLoc = 0; geoLoc < 8; ++geoLoc) {
+    BOOST_REQUIRE_EQUAL(store.getShardIndex(StorageKey(1, StorageKey::INVALID_DETECTORID, geoLoc)),
+                        static_cast<size_t>((geoLoc / 2) % SHARD_COUNT));
+  }
+
+  nlohmann::json badConf = makeConfig(filePath, filePrefix);
+  badConf["routing_method"] = "random";
+  BOOST_REQUIRE_THROW(ShardedDataStore badStore(badConf), dunedaq::ddpdemo::InvalidShardConfiguration);
+  badConf = makeConfig(filePath, filePrefix);
+  badConf["shards"] = nlohmann::json::array();
+  BOOST_REQUIRE_THROW(ShardedDataStore badStore(badConf), dunedaq::ddpdemo::InvalidShardConfiguration);
+
+  deleteFilesMatchingPattern(filePath, filePrefix + "_shard.*");
+}
+
+BOOST_AUTO_TEST_CASE(FlushWritesEveryShard)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  std::string filePrefix = "sharded" + std::to_string(getpid());
+  deleteFilesMatchingPattern(filePath, filePrefix + "_shard.*");
+
+  const int EVENT_COUNT = 5;
+  const int GEOLOC_COUNT = 6;
+  ShardedDataStore store(makeConfig(filePath, filePrefix));
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      writeBlock(store, eventID, geoLoc);
+    }
+  }
+
+  // the keys of all shards (and of the queued blocks) are merged, without duplicates
+  writeBlock(store, 1, 0);
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), EVENT_COUNT * GEOLOC_COUNT);
+  store.flush();
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), EVENT_COUNT * GEOLOC_COUNT);
+
+  // after the flush, each shard's files hold exactly the keys that were routed to it
+  for (int idx = 0; idx < SHARD_COUNT; ++idx) {
+    nlohmann::json shardConf = makeShardConfig(filePath, filePrefix, idx);
+    shardConf["name"] = "tempReader" + std::to_string(idx);
+    RawFileDataStore shardReader(shardConf);
+    std::vector<StorageKey> shardKeys = shardReader.getAllExistingKeys();
+    BOOST_REQUIRE_EQUAL(shardKeys.size(), EVENT_COUNT * 2);
+    for (auto& key : shardKeys) {
+      BOOST_REQUIRE_EQUAL(store.getShardIndex(key), static_cast<size_t>(idx));
+      KeyedDataBlock dataBlock = shardReader.read(key);
+      BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), static_cast<size_t>(100 + key.getGeoLocation()));
+      BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[0],
+                          static_cast<char>(key.getEventID() * 10 + key.getGeoLocation()));
+    }
+  }
+
+  // and every block can be read back through the sharded store
+  for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+    for (int geoLoc = 0; geoLoc < GEOLOC_COUNT; ++geoLoc) {
+      KeyedDataBlock dataBlock = store.read(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+      BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), static_cast<size_t>(100 + geoLoc));
+    }
+  }
+
+  deleteFilesMatchingPattern(filePath, filePrefix + "_shard.*");
+}
+
+BOOST_AUTO_TEST_CASE(FailedWritesAreReportedByFlush)
+{
+  // the shards can not create their files until their directory exists
+  std::string directoryPath =
+    std::string(std::filesystem::temp_directory_path()) + "/shardedfail" + std::to_string(getpid());
+  std::filesystem::remove_all(directoryPath);
+
+  ShardedDataStore store(makeConfig(directoryPath, "sharded"));
+  writeBlock(store, 1, 0);
+  writeBlock(store, 1, 2);
+  BOOST_REQUIRE_THROW(store.flush(), dunedaq::ddpdemo::UnwrittenShardDataBlocks);
+
+  // each failure is reported by one flush only
+  std::filesystem::create_directory(directoryPath);
+  writeBlock(store, 2, 0);
+  BOOST_REQUIRE_NO_THROW(store.flush());
+
+  std::filesystem::remove_all(directoryPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
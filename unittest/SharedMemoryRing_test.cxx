@@ -0,0 +1,176 @@
+/**
+ * @file SharedMemoryRing_test.cxx Application that tests and demonstrates
+ * the functionality of the SharedMemoryRing class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/SharedMemoryRingDataStore.hpp"
+#include "ddpdemo/SharedMemoryRing.hpp"
+
+#define BOOST_TEST_MODULE SharedMemoryRing_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+std::string
+getSegmentName()
+{
+  return "/ddpdemo_ring_test_" + std::to_string(getpid());
+}
+
+bool
+publishBlock(SharedMemoryRing& ring, int eventID, int geoLoc, size_t size)
+{
+  std::vector<char> dummyData(size, static_cast<char>(eventID + geoLoc));
+  KeyedDataBlock dataBlock(StorageKey(eventID, "FELIX", geoLoc));
+  dataBlock.unowned_data_start = dummyData.data();
+  dataBlock.data_size = size;
+  return ring.tryPublish(dataBlock);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(SharedMemoryRing_test)
+
+BOOST_AUTO_TEST_CASE(PublishAndConsume)
+{
+  std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::create(getSegmentName(), 3, 100);
+  BOOST_REQUIRE_EQUAL(ring->getSlotCount(), 4);
+  BOOST_REQUIRE_EQUAL(ring->getSlotPayloadSize(), 128);
+
+  // the ring wraps around several times, and reports when it is full
+  int nextEventID = 1;
+  int expectedEventID = 1;
+  for (int round = 0; round < 5; ++round) {
+    while (publishBlock(*ring, nextEventID, 2, 100)) {
+      ++nextEventID;
+    }
+    BOOST_REQUIRE_EQUAL(ring->getOccupancy(), 4);
+
+    while (ring->tryConsume([&](const KeyedDataBlock& dataBlock) {
+      BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), expectedEventID);
+      BOOST_REQUIRE_EQUAL(dataBlock.data_key.getDetectorID(), "FELIX");
+      BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), 100);
+      BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[99], static_cast<char>(expectedEventID + 2));
+      ++expectedEventID;
+    })) {
+    }
+    BOOST_REQUIRE_EQUAL(ring->getOccupancy(), 0);
+  }
+  BOOST_REQUIRE_EQUAL(expectedEventID, 21);
+
+  BOOST_REQUIRE_THROW(publishBlock(*ring, 1, 1, 129), dunedaq::ddpdemo::SharedMemoryRingSlotTooSmall);
+}
+
+BOOST_AUTO_TEST_CASE(MultipleProducers)
+{
+  std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::create(getSegmentName(), 16, 64);
+  std::unique_ptr<SharedMemoryRing> attachedRing = SharedMemoryRing::attach(getSegmentName(), 0);
+
+  const int PRODUCER_COUNT = 4;
+  const int EVENT_COUNT = 10000;
+  std::vector<std::thread> producers;
+  for (int geoLoc = 0; geoLoc < PRODUCER_COUNT; ++geoLoc) {
+    producers.emplace_back([&, geoLoc]() {
+      for (int eventID = 0; eventID < EVENT_COUNT; ++eventID) {
+        while (!publishBlock(*attachedRing, eventID, geoLoc, 64)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // every producer's blocks arrive complete and in order
+  std::vector<int> nextEventID(PRODUCER_COUNT, 0);
+  int consumedCount = 0;
+  while (consumedCount < PRODUCER_COUNT * EVENT_COUNT) {
+    if (!ring->tryConsume([&](const KeyedDataBlock& dataBlock) {
+          int geoLoc = dataBlock.data_key.getGeoLocation();
+          BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), nextEventID[geoLoc]);
+          BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[63],
+                              static_cast<char>(nextEventID[geoLoc] + geoLoc));
+          ++nextEventID[geoLoc];
+        })) {
+      std::this_thread::yield();
+      continue;
+    }
+    ++consumedCount;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  BOOST_REQUIRE_EQUAL(ring->getOccupancy(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ProducerInAnotherProcess)
+{
+  const int EVENT_COUNT = 1000;
+  const std::string segmentName = getSegmentName();
+  pid_t producerPid = fork();
+  BOOST_REQUIRE(producerPid >= 0);
+  if (producerPid == 0) {
+    // the producer waits for the consumer to create the ring
+    std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::attach(segmentName, 10000);
+    for (int eventID = 0; eventID < EVENT_COUNT; ++eventID) {
+      while (!publishBlock(*ring, eventID, 7, 1000)) {
+        std::this_thread::yield();
+      }
+    }
+    _exit(0);
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::create(segmentName, 8, 1000);
+  int nextEventID = 0;
+  while (nextEventID < EVENT_COUNT) {
+    ring->tryConsume([&](const KeyedDataBlock& dataBlock) {
+      BOOST_REQUIRE_EQUAL(dataBlock.data_key.getEventID(), nextEventID);
+      BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), 1000);
+      ++nextEventID;
+    });
+  }
+  int status = -1;
+  waitpid(producerPid, &status, 0);
+  BOOST_REQUIRE_EQUAL(status, 0);
+}
+
+BOOST_AUTO_TEST_CASE(PublishingToAFullRingTimesOut)
+{
+  std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::create(getSegmentName(), 2, 100);
+
+  nlohmann::json conf;
+  conf["name"] = "tempProducer";
+  conf["segment_name"] = getSegmentName();
+  conf["publish_timeout_msec"] = 50;
+  SharedMemoryRingDataStore store(conf);
+
+  // nothing consumes the ring, so the third data block can not be published
+  std::vector<char> dummyData(100, 'z');
+  KeyedDataBlock dataBlock(StorageKey(1, "FELIX", 0));
+  dataBlock.unowned_data_start = dummyData.data();
+  dataBlock.data_size = dummyData.size();
+  store.write(dataBlock);
+  store.write(dataBlock);
+  auto startTime = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_THROW(store.write(dataBlock), dunedaq::ddpdemo::SharedMemoryRingPublishTimedOut);
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - startTime >= std::chrono::milliseconds(50));
+  BOOST_REQUIRE_EQUAL(ring->getOccupancy(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
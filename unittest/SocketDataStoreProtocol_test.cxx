@@ -0,0 +1,96 @@
+/**
+ * @file SocketDataStoreProtocol_test.cxx Application that tests and demonstrates
+ * the message handling of the SocketDataStoreProtocol class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ddpdemo/SocketDataStoreProtocol.hpp"
+
+#define BOOST_TEST_MODULE SocketDataStoreProtocol_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+BOOST_AUTO_TEST_SUITE(SocketDataStoreProtocol_test)
+
+BOOST_AUTO_TEST_CASE(KeyEncoding)
+{
+  std::string buffer;
+  SocketDataStoreProtocol::appendKey(buffer, StorageKey(1, "FELIX", 2));
+  SocketDataStoreProtocol::appendKey(buffer, StorageKey(3, "", 4));
+
+  size_t position = 0;
+  StorageKey firstKey = SocketDataStoreProtocol::extractKey(buffer, position);
+  StorageKey secondKey = SocketDataStoreProtocol::extractKey(buffer, position);
+  BOOST_REQUIRE_EQUAL(position, buffer.size());
+  BOOST_REQUIRE(firstKey == StorageKey(1, "FELIX", 2));
+  BOOST_REQUIRE(secondKey == StorageKey(3, "", 4));
+
+  buffer.resize(buffer.size() - 1);
+  position = 0;
+  SocketDataStoreProtocol::extractKey(buffer, position);
+  BOOST_REQUIRE_THROW(SocketDataStoreProtocol::extractKey(buffer, position), dunedaq::ddpdemo::SocketCommunicationFailed);
+}
+
+BOOST_AUTO_TEST_CASE(BatchedMessagesWithSharedMemory)
+{
+  int sockets[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+
+  // the payload goes into shared memory, and only its location through the socket
+  const size_t PAYLOAD_SIZE = 4096;
+  int payloadFd = SocketDataStoreProtocol::createSharedMemory("test_payload", PAYLOAD_SIZE);
+  void* payload = SocketDataStoreProtocol::mapSharedMemory(payloadFd, PAYLOAD_SIZE, true);
+  memset(payload, 'z', PAYLOAD_SIZE);
+  munmap(payload, PAYLOAD_SIZE);
+
+  std::string packet;
+  const int MESSAGE_COUNT = 5;
+  for (int idx = 0; idx < MESSAGE_COUNT; ++idx) {
+    SocketDataStoreProtocol::MessageHeader header;
+    header.type = SocketDataStoreProtocol::Write;
+    header.requestId = idx + 1;
+    header.eventId = idx;
+    header.offset = idx * 100;
+    header.dataSize = 100;
+    SocketDataStoreProtocol::appendMessage(packet, header, "detector" + std::to_string(idx));
+  }
+  SocketDataStoreProtocol::sendPacket(sockets[0], packet, payloadFd);
+  close(payloadFd);
+
+  std::vector<SocketDataStoreProtocol::Message> messages;
+  int receivedFd = -1;
+  BOOST_REQUIRE(SocketDataStoreProtocol::receivePacket(sockets[1], messages, receivedFd));
+  BOOST_REQUIRE_EQUAL(messages.size(), MESSAGE_COUNT);
+  for (int idx = 0; idx < MESSAGE_COUNT; ++idx) {
+    BOOST_REQUIRE_EQUAL(messages[idx].header.requestId, idx + 1);
+    BOOST_REQUIRE_EQUAL(messages[idx].header.offset, idx * 100);
+    BOOST_REQUIRE_EQUAL(messages[idx].extra, "detector" + std::to_string(idx));
+  }
+
+  BOOST_REQUIRE(receivedFd >= 0);
+  const char* received = static_cast<const char*>(SocketDataStoreProtocol::mapSharedMemory(receivedFd, PAYLOAD_SIZE, false));
+  BOOST_REQUIRE_EQUAL(received[0], 'z');
+  BOOST_REQUIRE_EQUAL(received[PAYLOAD_SIZE - 1], 'z');
+  munmap(const_cast<char*>(received), PAYLOAD_SIZE);
+  close(receivedFd);
+
+  // a closed connection is reported as the end of the messages
+  close(sockets[0]);
+  BOOST_REQUIRE(!SocketDataStoreProtocol::receivePacket(sockets[1], messages, receivedFd));
+  close(sockets[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
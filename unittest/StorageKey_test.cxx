@@ -16,6 +16,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <string>
+#include <unordered_set>
 
 namespace {
 
@@ -74,4 +75,25 @@ BOOST_AUTO_TEST_CASE(check_placeholder_values)
   BOOST_CHECK_EQUAL(key4.getGeoLocation(), SAMPLE_GEOLOCATION);
 }
 
+BOOST_AUTO_TEST_CASE(comparisons_and_hashing)
+{
+  StorageKey key1(1, "FELIX", 2);
+  StorageKey key2(1, "FELIX", 2);
+  StorageKey key3(1, "FELIX", 3);
+  StorageKey key4(2, "FELIX", 0);
+
+  BOOST_CHECK(key1 == key2);
+  BOOST_CHECK(key1 != key3);
+  BOOST_CHECK(key1 < key3);
+  BOOST_CHECK(key3 < key4);
+  BOOST_CHECK(!(key2 < key1));
+
+  std::unordered_set<StorageKey> keySet;
+  keySet.insert(key1);
+  keySet.insert(key2);
+  keySet.insert(key3);
+  BOOST_CHECK_EQUAL(keySet.size(), 2);
+  BOOST_CHECK_EQUAL(keySet.count(key4), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,230 @@
+/**
+ * @file TeeDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the TeeDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/MemoryRingDataStore.hpp"
+#include "../plugins/RawFileDataStore.hpp"
+#include "../plugins/TeeDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE TeeDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+deleteFilesMatchingPattern(const std::string& path, const std::string& pattern)
+{
+  std::regex regexSearchPattern(pattern);
+  for (const auto& entry : std::filesystem::directory_iterator(path)) {
+    if (std::regex_match(entry.path().filename().string(), regexSearchPattern)) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+}
+
+std::string
+filePrefix(const std::string& destName)
+{
+  return "tee" + std::to_string(getpid()) + "_" + destName;
+}
+
+nlohmann::json
+makeFileDestination(const std::string& destName, const std::string& policy)
+{
+  nlohmann::json storeConf;
+  storeConf["name"] = destName;
+  storeConf["type"] = "RawFileDataStore";
+  storeConf["directory_path"] = std::string(std::filesystem::temp_directory_path());
+  storeConf["filename_prefix"] = filePrefix(destName);
+
+  nlohmann::json destConf;
+  destConf["policy"] = policy;
+  destConf["data_store_parameters"] = storeConf;
+  return destConf;
+}
+
+nlohmann::json
+makeRingDestination(const std::string& destName, const std::string& policy, size_t capacity)
+{
+  nlohmann::json storeConf;
+  storeConf["name"] = destName;
+  storeConf["type"] = "MemoryRingDataStore";
+  storeConf["capacity_bytes"] = capacity;
+
+  nlohmann::json destConf;
+  destConf["policy"] = policy;
+  destConf["data_store_parameters"] = storeConf;
+  return destConf;
+}
+
+// the keys that a file destination holds on disk
+std::vector<StorageKey>
+getKeysOnDisk(const std::string& destName)
+{
+  nlohmann::json conf;
+  conf["name"] = destName + "Reader";
+  conf["directory_path"] = std::string(std::filesystem::temp_directory_path());
+  conf["filename_prefix"] = filePrefix(destName);
+  RawFileDataStore reader(conf);
+  return reader.getAllExistingKeys();
+}
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc, size_t size)
+{
+  std::vector<char> dummyData(size, static_cast<char>(eventID));
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(TeeDataStore_test)
+
+BOOST_AUTO_TEST_CASE(PoliciesSelectTheDataBlocks)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  deleteFilesMatchingPattern(filePath, filePrefix("") + ".*");
+
+  nlohmann::json conf;
+  conf["name"] = "tempTee";
+  conf["destinations"].push_back(makeFileDestination("primary", "required"));
+  conf["destinations"].push_back(makeFileDestination("secondary", "required"));
+  conf["destinations"].push_back(makeFileDestination("sampled", "sampled"));
+  conf["destinations"].back()["sample_interval"] = 3;
+  // a best-effort destination without room in its queue drops everything
+  conf["destinations"].push_back(makeFileDestination("dropping", "best-effort"));
+  conf["destinations"].back()["queue_capacity"] = 0;
+
+  const int EVENT_COUNT = 9;
+  {
+    TeeDataStore store(conf);
+    for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+      writeBlock(store, eventID, 0, 1000);
+    }
+    store.flush();
+    BOOST_REQUIRE_EQUAL(store.getDroppedCount(2), 0);
+    BOOST_REQUIRE_EQUAL(store.getDroppedCount(3), EVENT_COUNT);
+
+    // reads are served by the primary destination
+    BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), EVENT_COUNT);
+    KeyedDataBlock dataBlock = store.read(StorageKey(5, StorageKey::INVALID_DETECTORID, 0));
+    BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), 1000);
+    BOOST_REQUIRE_EQUAL(static_cast<const char*>(dataBlock.getDataStart())[999], 5);
+  }
+
+  BOOST_REQUIRE_EQUAL(getKeysOnDisk("primary").size(), EVENT_COUNT);
+  BOOST_REQUIRE_EQUAL(getKeysOnDisk("secondary").size(), EVENT_COUNT);
+  std::vector<StorageKey> sampledKeys = getKeysOnDisk("sampled");
+  BOOST_REQUIRE_EQUAL(sampledKeys.size(), EVENT_COUNT / 3);
+  for (auto& key : sampledKeys) {
+    BOOST_REQUIRE_EQUAL((key.getEventID() - 1) % 3, 0);
+  }
+  BOOST_REQUIRE_EQUAL(getKeysOnDisk("dropping").size(), 0);
+
+  deleteFilesMatchingPattern(filePath, filePrefix("") + ".*");
+}
+
+BOOST_AUTO_TEST_CASE(DroppedBlocksAreCounted)
+{
+  std::string filePath(std::filesystem::temp_directory_path());
+  deleteFilesMatchingPattern(filePath, filePrefix("") + ".*");
+
+  nlohmann::json conf;
+  conf["name"] = "tempTee";
+  conf["destinations"].push_back(makeRingDestination("primary", "required", 1024 * 1024));
+  conf["destinations"].push_back(makeFileDestination("bestEffort", "best-effort"));
+  conf["destinations"].back()["queue_capacity"] = 1;
+
+  // whether or not the background destination keeps up, every block is either written or counted
+  const int EVENT_COUNT = 200;
+  size_t droppedCount = 0;
+  {
+    TeeDataStore store(conf);
+    for (int eventID = 1; eventID <= EVENT_COUNT; ++eventID) {
+      writeBlock(store, eventID, 0, 1000);
+    }
+    store.flush();
+    droppedCount = store.getDroppedCount(1);
+  }
+  BOOST_REQUIRE_EQUAL(getKeysOnDisk("bestEffort").size() + droppedCount, EVENT_COUNT);
+
+  deleteFilesMatchingPattern(filePath, filePrefix("") + ".*");
+}
+
+BOOST_AUTO_TEST_CASE(RequiredErrorsArePropagated)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempTee";
+  conf["destinations"].push_back(makeRingDestination("primary", "required", 1024 * 1024));
+  conf["destinations"].push_back(makeRingDestination("secondary", "required", 1000));
+  conf["destinations"].push_back(makeRingDestination("optional", "best-effort", 100));
+  TeeDataStore store(conf);
+
+  // a failure of an optional destination is only reported
+  writeBlock(store, 1, 0, 500);
+  store.flush();
+
+  // but a failure of a required one is thrown to the caller
+  BOOST_REQUIRE_THROW(writeBlock(store, 2, 0, 2000), dunedaq::ddpdemo::DataBlockTooLarge);
+  writeBlock(store, 3, 0, 500);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentCallersOnlySeeTheirOwnErrors)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempTee";
+  conf["destinations"].push_back(makeRingDestination("primary", "required", 1024 * 1024));
+  conf["destinations"].push_back(makeRingDestination("secondary", "required", 1000));
+  conf["destinations"].push_back(makeRingDestination("sampled", "sampled", 1024 * 1024));
+  conf["destinations"].back()["sample_interval"] = 2;
+  TeeDataStore store(conf);
+
+  // the first thread's blocks are too large for the secondary destination
+  const int THREAD_COUNT = 4;
+  const int BLOCKS_PER_THREAD = 200;
+  std::vector<std::atomic<int>> errorCounts(THREAD_COUNT);
+  std::vector<std::thread> writers;
+  for (int threadIdx = 0; threadIdx < THREAD_COUNT; ++threadIdx) {
+    writers.emplace_back([&, threadIdx] {
+      for (int count = 0; count < BLOCKS_PER_THREAD; ++count) {
+        try {
+          writeBlock(store, count + 1, threadIdx, threadIdx == 0 ? 2000 : 10);
+        } catch (const dunedaq::ddpdemo::DataBlockTooLarge&) {
+          ++errorCounts[threadIdx];
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  store.flush();
+
+  BOOST_REQUIRE_EQUAL(errorCounts[0].load(), BLOCKS_PER_THREAD);
+  for (int threadIdx = 1; threadIdx < THREAD_COUNT; ++threadIdx) {
+    BOOST_REQUIRE_EQUAL(errorCounts[threadIdx].load(), 0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
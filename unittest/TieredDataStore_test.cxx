@@ -0,0 +1,214 @@
+/**
+ * @file TieredDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the TieredDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/TieredDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE TieredDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+void
+writeBlock(DataStore& store, int eventID, int geoLoc, size_t size, char fill)
+{
+  std::vector<char> dummyData(size, fill);
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+void
+checkBlock(DataStore& store, int eventID, int geoLoc, size_t size, char fill)
+{
+  KeyedDataBlock dataBlock = store.read(StorageKey(eventID, StorageKey::INVALID_DETECTORID, geoLoc));
+  BOOST_REQUIRE_EQUAL(dataBlock.getDataSizeBytes(), size);
+  const char* data_ptr = static_cast<const char*>(dataBlock.getDataStart());
+  BOOST_REQUIRE_EQUAL(data_ptr[0], fill);
+  BOOST_REQUIRE_EQUAL(data_ptr[size - 1], fill);
+}
+
+nlohmann::json
+makeConfig(size_t memoryCapacity, size_t spillBatchBytes, size_t spillMaxAgeMsec, size_t childCapacity = 1024 * 1024)
+{
+  nlohmann::json childConf;
+  childConf["name"] = "tempRing";
+  childConf["type"] = "MemoryRingDataStore";
+  childConf["capacity_bytes"] = childCapacity;
+
+  nlohmann::json conf;
+  conf["name"] = "tempTiered";
+  conf["memory_capacity_bytes"] = memoryCapacity;
+  conf["spill_batch_bytes"] = spillBatchBytes;
+  conf["spill_max_age_msec"] = spillMaxAgeMsec;
+  conf["child_data_store_parameters"] = childConf;
+  return conf;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(TieredDataStore_test)
+
+BOOST_AUTO_TEST_CASE(BlocksAreReadableFromEitherTier)
+{
+  // nothing is spilled until the flush
+  TieredDataStore store(makeConfig(100000, 100000, 60000));
+  for (int eventID = 1; eventID <= 10; ++eventID) {
+    writeBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+  }
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 10000);
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), 10);
+  checkBlock(store, 3, 0, 1000, 3);
+
+  store.flush();
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  BOOST_REQUIRE_EQUAL(store.getPeakMemoryTierBytes(), 10000);
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), 10);
+  for (int eventID = 1; eventID <= 10; ++eventID) {
+    checkBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SpillsAreTriggeredBySizeAndAge)
+{
+  // by size: a full batch is spilled right away
+  {
+    TieredDataStore store(makeConfig(100000, 3000, 60000));
+    for (int eventID = 1; eventID <= 3; ++eventID) {
+      writeBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (store.getMemoryTierBytes() > 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  }
+
+  // by age
+  TieredDataStore store(makeConfig(100000, 100000, 50));
+  writeBlock(store, 1, 0, 1000, 1);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (store.getMemoryTierBytes() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  checkBlock(store, 1, 0, 1000, 1);
+}
+
+BOOST_AUTO_TEST_CASE(AgeLimitAppliesAfterAnIdlePeriod)
+{
+  TieredDataStore store(makeConfig(100000, 100000, 50));
+  writeBlock(store, 1, 0, 1000, 1);
+  store.flush();
+
+  // the spill thread has been waiting with nothing pending, and a small block must still wake it up
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  writeBlock(store, 2, 0, 1000, 2);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (store.getMemoryTierBytes() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  checkBlock(store, 2, 0, 1000, 2);
+}
+
+BOOST_AUTO_TEST_CASE(WritesWaitForRoomInTheMemoryTier)
+{
+  TieredDataStore store(makeConfig(5000, 2000, 10));
+  for (int eventID = 1; eventID <= 50; ++eventID) {
+    writeBlock(store, eventID, 0, 1000, static_cast<char>(eventID));
+    BOOST_REQUIRE_LE(store.getMemoryTierBytes(), 5000);
+  }
+  store.flush();
+  BOOST_REQUIRE_LE(store.getPeakMemoryTierBytes(), 5000);
+  BOOST_REQUIRE_EQUAL(store.getAllExistingKeys().size(), 50);
+  checkBlock(store, 50, 0, 1000, 50);
+}
+
+BOOST_AUTO_TEST_CASE(LargeWriteReplacesTheCopyInMemory)
+{
+  TieredDataStore store(makeConfig(5000, 100000, 60000));
+  writeBlock(store, 1, 0, 1000, 1);
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 1000);
+
+  // too large for the memory tier, so it goes straight to the child store
+  writeBlock(store, 1, 0, 8000, 2);
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  checkBlock(store, 1, 0, 8000, 2);
+
+  // and the older copy is not spilled over it
+  store.flush();
+  checkBlock(store, 1, 0, 8000, 2);
+}
+
+BOOST_AUTO_TEST_CASE(FailedSpillsStayInMemory)
+{
+  // the child ring can not hold the larger block, so its spill fails
+  TieredDataStore store(makeConfig(5000, 100000, 60000, 1000));
+  writeBlock(store, 1, 0, 2000, 1);
+  writeBlock(store, 2, 0, 500, 2);
+  BOOST_REQUIRE_THROW(store.flush(), dunedaq::ddpdemo::UnspilledDataBlocks);
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 2000);
+  checkBlock(store, 1, 0, 2000, 1);
+  checkBlock(store, 2, 0, 500, 2);
+
+  // it is tried again on the next flush
+  BOOST_REQUIRE_THROW(store.flush(), dunedaq::ddpdemo::UnspilledDataBlocks);
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 2000);
+
+  // until a newer copy of the data block replaces it
+  writeBlock(store, 1, 0, 500, 3);
+  store.flush();
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  checkBlock(store, 1, 0, 500, 3);
+}
+
+BOOST_AUTO_TEST_CASE(FailedSpillsAreRetriedInTheBackground)
+{
+  // the child store can not create its file until its directory exists
+  std::string directoryPath =
+    std::string(std::filesystem::temp_directory_path()) + "/tieredretry" + std::to_string(getpid());
+  std::filesystem::remove_all(directoryPath);
+
+  nlohmann::json conf = makeConfig(5000, 100000, 10);
+  conf["spill_retry_msec"] = 20;
+  conf["child_data_store_parameters"]["type"] = "RawFileDataStore";
+  conf["child_data_store_parameters"]["directory_path"] = directoryPath;
+  conf["child_data_store_parameters"]["filename_prefix"] = "tiered";
+  TieredDataStore store(conf);
+  writeBlock(store, 1, 0, 1000, 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 1000);
+
+  // once the child store works again, the block is spilled without a flush
+  std::filesystem::create_directory(directoryPath);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (store.getMemoryTierBytes() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  BOOST_REQUIRE_EQUAL(store.getMemoryTierBytes(), 0);
+  store.flush();
+  checkBlock(store, 1, 0, 1000, 1);
+
+  std::filesystem::remove_all(directoryPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+/**
+ * @file TransferProgress_test.cxx Application that tests and demonstrates
+ * the functionality of the TransferProgress class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/TransferProgress.hpp"
+
+#define BOOST_TEST_MODULE TransferProgress_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using namespace dunedaq::ddpdemo;
+
+BOOST_AUTO_TEST_SUITE(TransferProgress_test)
+
+BOOST_AUTO_TEST_CASE(RangesAreMerged)
+{
+  std::string fileName =
+    std::string(std::filesystem::temp_directory_path()) + "/progress" + std::to_string(getpid()) + ".json";
+  std::filesystem::remove(fileName);
+
+  TransferProgress progress(fileName);
+  for (int eventID : { 1, 2, 3, 7, 5, 6, 9 }) {
+    progress.markDone(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+  }
+  progress.markDone(StorageKey(3, StorageKey::INVALID_DETECTORID, 1));
+  progress.markDone(StorageKey(2, StorageKey::INVALID_DETECTORID, 0));
+
+  // 1-3, 5-7 and 9 for geoLocation 0, and 3 for geoLocation 1
+  BOOST_REQUIRE_EQUAL(progress.getDoneCount(), 8);
+  BOOST_REQUIRE_EQUAL(progress.getRangeCount(), 4);
+  BOOST_REQUIRE(progress.isDone(StorageKey(6, StorageKey::INVALID_DETECTORID, 0)));
+  BOOST_REQUIRE(!progress.isDone(StorageKey(4, StorageKey::INVALID_DETECTORID, 0)));
+  BOOST_REQUIRE(!progress.isDone(StorageKey(10, StorageKey::INVALID_DETECTORID, 0)));
+  BOOST_REQUIRE(!progress.isDone(StorageKey(2, StorageKey::INVALID_DETECTORID, 1)));
+
+  progress.markDone(StorageKey(4, StorageKey::INVALID_DETECTORID, 0));
+  BOOST_REQUIRE_EQUAL(progress.getRangeCount(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(RecordIsReloaded)
+{
+  std::string fileName =
+    std::string(std::filesystem::temp_directory_path()) + "/progress" + std::to_string(getpid()) + ".json";
+  std::filesystem::remove(fileName);
+
+  {
+    TransferProgress progress(fileName, 0);
+    for (int eventID = 1; eventID <= 100; ++eventID) {
+      progress.markDone(StorageKey(eventID, "detector", eventID % 4));
+    }
+    BOOST_REQUIRE(progress.isSaveDue());
+    progress.save();
+    BOOST_REQUIRE(!progress.isSaveDue());
+    progress.markDone(StorageKey(101, "detector", 1));
+  } // the destructor saves the rest
+
+  TransferProgress progress(fileName);
+  BOOST_REQUIRE_EQUAL(progress.getDoneCount(), 101);
+  BOOST_REQUIRE(progress.isDone(StorageKey(50, "detector", 2)));
+  BOOST_REQUIRE(progress.isDone(StorageKey(101, "detector", 1)));
+  BOOST_REQUIRE(!progress.isDone(StorageKey(50, "other", 2)));
+
+  std::filesystem::remove(fileName);
+}
+
+BOOST_AUTO_TEST_CASE(SnapshotsDoNotRunAhead)
+{
+  std::string fileName =
+    std::string(std::filesystem::temp_directory_path()) + "/progress" + std::to_string(getpid()) + ".json";
+  std::filesystem::remove(fileName);
+
+  {
+    TransferProgress progress(fileName, 0);
+    for (int eventID = 1; eventID <= 10; ++eventID) {
+      progress.markDone(StorageKey(eventID, "detector", 0));
+    }
+    // data blocks that are marked as done after the snapshot are not saved with it
+    TransferProgress::Snapshot olderSnapshot = progress.takeSnapshot();
+    progress.markDone(StorageKey(11, "detector", 0));
+    TransferProgress::Snapshot newerSnapshot = progress.takeSnapshot();
+    progress.markDone(StorageKey(12, "detector", 0));
+
+    progress.save(newerSnapshot);
+    BOOST_REQUIRE(progress.isSaveDue());
+    // an older snapshot does not replace a newer one
+    progress.save(olderSnapshot);
+    BOOST_REQUIRE(!std::filesystem::exists(fileName + ".tmp"));
+
+    TransferProgress reloaded(fileName);
+    BOOST_REQUIRE_EQUAL(reloaded.getDoneCount(), 11);
+    BOOST_REQUIRE(reloaded.isDone(StorageKey(11, "detector", 0)));
+    BOOST_REQUIRE(!reloaded.isDone(StorageKey(12, "detector", 0)));
+  } // the destructor saves the rest
+
+  TransferProgress progress(fileName);
+  BOOST_REQUIRE_EQUAL(progress.getDoneCount(), 12);
+
+  std::filesystem::remove(fileName);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
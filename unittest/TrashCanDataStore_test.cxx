@@ -0,0 +1,95 @@
+/**
+ * @file TrashCanDataStore_test.cxx Application that tests and demonstrates
+ * the functionality of the TrashCanDataStore class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "../plugins/TrashCanDataStore.hpp"
+
+#include "ers/ers.h"
+
+#define BOOST_TEST_MODULE TrashCanDataStore_test // NOLINT
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ddpdemo;
+
+namespace {
+
+nlohmann::json
+makeConfig(const std::string& payloadAccess)
+{
+  nlohmann::json conf;
+  conf["name"] = "tempTrashCan";
+  conf["payload_access"] = payloadAccess;
+  return conf;
+}
+
+void
+writeBlock(DataStore& store, int eventID, size_t size)
+{
+  std::vector<char> dummyData(size, 1);
+  KeyedDataBlock dataBlock(StorageKey(eventID, StorageKey::INVALID_DETECTORID, 0));
+  dataBlock.unowned_data_start = static_cast<void*>(dummyData.data());
+  dataBlock.data_size = size;
+  store.write(dataBlock);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_SUITE(TrashCanDataStore_test)
+
+BOOST_AUTO_TEST_CASE(CountersAreResetByFlush)
+{
+  TrashCanDataStore store(makeConfig("touch"));
+  BOOST_REQUIRE_EQUAL(store.getStatisticsSummary(), "tempTrashCan: No data blocks were received.");
+
+  writeBlock(store, 1, 100);
+  writeBlock(store, 2, 300);
+  writeBlock(store, 3, 200);
+  BOOST_REQUIRE_EQUAL(store.getFragmentCount(), 3);
+  BOOST_REQUIRE_EQUAL(store.getByteCount(), 600);
+  // every byte is 1, and one byte is read per cache line: 2 + 5 + 4 of them
+  BOOST_REQUIRE_EQUAL(store.getChecksum(), 11);
+  std::string summary = store.getStatisticsSummary();
+  BOOST_REQUIRE(summary.find("3 data blocks with 600 bytes") != std::string::npos);
+  BOOST_REQUIRE(summary.find("min/avg/max = 100/200/300") != std::string::npos);
+
+  store.flush();
+  BOOST_REQUIRE_EQUAL(store.getFragmentCount(), 0);
+  BOOST_REQUIRE_EQUAL(store.getByteCount(), 0);
+  BOOST_REQUIRE_EQUAL(store.getChecksum(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(RateIsReportedInMBps)
+{
+  TrashCanDataStore store(makeConfig("none"));
+  const size_t BLOCK_SIZE = 1000000;
+  writeBlock(store, 1, BLOCK_SIZE);
+  BOOST_REQUIRE_EQUAL(store.getRateMBps(), 0.0);
+  BOOST_REQUIRE(store.getStatisticsSummary().find("rate not available") != std::string::npos);
+
+  // two MB in at least 20 msec is at most 100 MB/s
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  writeBlock(store, 2, BLOCK_SIZE);
+  double rate = store.getRateMBps();
+  BOOST_REQUIRE_GT(rate, 0.0);
+  BOOST_REQUIRE_LE(rate, 100.0);
+  BOOST_REQUIRE(store.getStatisticsSummary().find(" MB/s, ") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(UnknownPayloadAccessIsRejected)
+{
+  BOOST_REQUIRE_THROW(TrashCanDataStore store(makeConfig("peek")), dunedaq::ddpdemo::InvalidPayloadAccess);
+  TrashCanDataStore store(makeConfig("checksum"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()